@@ -0,0 +1,1724 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "sv/net/balance.hpp"
+#include "sv/net/broker.hpp"
+#include "sv/net/checksum.hpp"
+#include "sv/net/durable.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/membership.hpp"
+#include "sv/net/protocol.hpp"
+#include "sv/net/proxy.hpp"
+#include "sv/net/shard.hpp"
+#include "sv/net/trace.hpp"
+#include "sv/net/tuning.hpp"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // __linux__
+
+#if defined(SV_NET_HAS_TLS)
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include "sv/net/tls.hpp"
+#endif // SV_NET_HAS_TLS
+
+namespace sv
+{
+namespace bench
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+using clock_type = std::chrono::steady_clock;
+
+inline double seconds_since(clock_type::time_point _begin)
+{
+  return std::chrono::duration<double>(clock_type::now() - _begin).count();
+}
+
+// a thread that is joined when it goes out of scope, also while an exception
+// unwinds past it, after _stop makes it return. an exception thrown on the
+// thread is rethrown by join().
+class scoped_thread
+{
+public:
+  template<class F>
+  explicit scoped_thread(F&& _run, std::function<void()> _stop = nullptr)
+    : m_stop(std::move(_stop))
+    , m_thread([this, run = std::forward<F>(_run)]() mutable
+               {
+                 try
+                 {
+                   run();
+                 }
+                 catch (...)
+                 {
+                   m_error = std::current_exception();
+                 }
+               })
+  {
+  }
+  scoped_thread(scoped_thread const&) = delete;
+  scoped_thread& operator=(scoped_thread const&) = delete;
+  ~scoped_thread()
+  {
+    if (m_thread.joinable())
+    {
+      if (m_stop)
+      {
+        m_stop();
+      }
+      m_thread.join();
+    }
+  }
+  void join()
+  {
+    m_thread.join();
+    if (m_error)
+    {
+      std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+  }
+
+private:
+  std::function<void()> m_stop;
+  std::exception_ptr m_error;
+  std::thread m_thread;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// accept storm
+//
+// _count clients connect at once, like after a deploy; the time is until
+// the server has handed every one of them to on_session.
+////////////////////////////////////////////////////////////////////////////////
+inline double accept_storm(sv::net::engine::accept_policy _policy, std::size_t _count)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+
+  std::atomic<std::size_t> accepted{ 0 };
+  auto server = server_t::make();
+  _policy.trace = false;
+  server->set_accept_policy(_policy);
+  server->on_session([&](session_t::ptr const&) { ++accepted; });
+  server->execute(0);
+
+  asio::io_context ioc;
+  asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), server->local_endpoint().port());
+  std::vector<std::unique_ptr<asio::ip::tcp::socket>> clients;
+  auto begin = clock_type::now();
+  for (std::size_t i = 0; i < _count; ++i)
+  {
+    clients.push_back(std::make_unique<asio::ip::tcp::socket>(ioc));
+    clients.back()->async_connect(endpoint, [](error_code const&) {});
+  }
+  ioc.run();
+  while (accepted < _count && seconds_since(begin) < 30)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  auto elapsed = seconds_since(begin);
+  clients.clear();
+  return elapsed;
+}
+
+inline void run_accept(std::size_t _connections)
+{
+  struct variant
+  {
+    const char* name;
+    sv::net::engine::accept_policy policy;
+  };
+  sv::net::engine::accept_policy one, pending, drain, workers;
+  pending.pending = 16;
+  drain.drain = true;
+  workers.drain = true;
+  workers.workers = 2;
+  variant variants[] = {
+    { "1 pending accept", one },
+    { "16 pending accepts", pending },
+    { "accept4 drain", drain },
+    { "accept4 drain, 2 workers", workers },
+  };
+
+  for (auto const& e : variants)
+  {
+    auto elapsed = accept_storm(e.policy, _connections);
+    std::printf("accept %zu connections, %s: %.1f ms\n", _connections, e.name, elapsed * 1000);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// request latency
+//
+// each request goes out as two messages and the server answers the second,
+// the write-write-read pattern that Nagle and delayed acks stall.
+////////////////////////////////////////////////////////////////////////////////
+inline double request_latency(sv::net::tuning::options const& _tuning, std::size_t _requests)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using packet_t = sv::net::packet::string_packet;
+
+  auto server = server_t::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->set_tuning(_tuning);
+  server->on_session([](session_t::ptr const& session)
+  {
+    auto* protocol = &session->protocol();
+    auto received = std::make_shared<std::size_t>(0);
+    auto id = session->id();
+    protocol->on_receive([protocol, received, id](sv::net::packet::base::ptr)
+    {
+      if (++*received % 2 == 0)
+      {
+        protocol->send(packet_t::make("response", id));
+      }
+    });
+  });
+  server->execute(0);
+
+  std::atomic<std::size_t> responses{ 0 };
+  std::atomic<session_t*> client_session{ nullptr };
+  auto client = client_t::make();
+  client->set_tuning(_tuning);
+  client->on_session([&](session_t::ptr const& session)
+  {
+    session->protocol().on_receive([&](sv::net::packet::base::ptr) { ++responses; });
+    client_session = session.get();
+  });
+  client->execute("127.0.0.1", server->local_endpoint().port());
+
+  auto begin = clock_type::now();
+  while (client_session == nullptr && seconds_since(begin) < 5)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (client_session == nullptr)
+  {
+    return 0;
+  }
+
+  auto& protocol = client_session.load()->protocol();
+  auto id = client_session.load()->id();
+  begin = clock_type::now();
+  for (std::size_t i = 0; i < _requests; ++i)
+  {
+    protocol.send(packet_t::make("request", id));
+    protocol.send(packet_t::make("commit", id));
+    while (responses <= i && seconds_since(begin) < 60)
+    {
+      std::this_thread::yield();
+    }
+  }
+  return seconds_since(begin) / _requests;
+}
+
+inline void run_latency(std::size_t _requests)
+{
+  struct variant
+  {
+    const char* name;
+    sv::net::tuning::options tuning;
+  };
+  sv::net::tuning::options nagle, no_delay, tuned;
+  nagle.no_delay = false;
+  tuned.quick_ack = true;
+  tuned.busy_poll = 50;
+  tuned.cpus = { 0 };
+  variant variants[] = {
+    { "nagle", nagle },
+    { "no_delay", no_delay },
+    { "no_delay, quick_ack, busy_poll, pinned", tuned },
+  };
+
+  for (auto const& e : variants)
+  {
+    auto latency = request_latency(e.tuning, _requests);
+    std::printf("request latency, %s: %.1f us\n", e.name, latency * 1000000);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// transports
+//
+// one client and server over each transport: the round trip of a 64-byte
+// message, one at a time, then the rate of a one-way stream of _requests of
+// them until the server has read them all or, over udp, none arrive for
+// 200 ms.
+////////////////////////////////////////////////////////////////////////////////
+struct transport_result
+{
+  double round_trip = 0;
+  double rate = 0;
+  std::size_t lost = 0;
+};
+
+template<class Server, class Client, class Listen, class Connect>
+transport_result transport_run(Listen&& _listen, Connect&& _connect, std::size_t _requests)
+{
+  using packet_t = sv::net::packet::string_packet;
+  using packet_ptr = sv::net::packet::base::ptr;
+
+  std::atomic<std::size_t> received{ 0 };
+  auto server = Server::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&received](auto const& session)
+  {
+    auto* protocol = &session->protocol();
+    protocol->on_receive([protocol, &received](packet_ptr packet)
+    {
+      // pings are answered, the stream only counted.
+      if (static_cast<packet_t&>(*packet).get_value()[0] == 'p')
+        protocol->send(packet);
+      else
+        ++received;
+    });
+  });
+  _listen(*server);
+
+  std::atomic<std::size_t> responses{ 0 };
+  std::promise<std::function<void(packet_ptr)>> connected;
+  auto client = Client::make();
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&responses](packet_ptr) { ++responses; });
+    connected.set_value([session](packet_ptr packet) { session->protocol().send(packet); });
+  });
+  _connect(*client, *server);
+
+  transport_result result;
+  auto ready = connected.get_future();
+  if (ready.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+  {
+    return result;
+  }
+  auto send = ready.get();
+
+  auto ping = packet_t::make(std::string(64, 'p'), 0);
+  auto begin = clock_type::now();
+  for (std::size_t i = 0; i < _requests; ++i)
+  {
+    // a lost ping (udp) is given up after a second.
+    auto sent = clock_type::now();
+    send(ping);
+    while (responses <= i && seconds_since(sent) < 1)
+    {
+      std::this_thread::yield();
+    }
+  }
+  result.round_trip = seconds_since(begin) / _requests;
+
+  auto message = packet_t::make(std::string(64, 's'), 0);
+  begin = clock_type::now();
+  for (std::size_t i = 0; i < _requests; ++i)
+  {
+    send(message);
+  }
+  auto last = clock_type::now();
+  std::size_t seen = 0;
+  while (seen < _requests && seconds_since(last) < 0.2)
+  {
+    if (received != seen)
+    {
+      seen = received;
+      last = clock_type::now();
+    }
+    std::this_thread::yield();
+  }
+  result.rate = seen / std::chrono::duration<double>(last - begin).count();
+  result.lost = _requests - seen;
+  send = nullptr;
+  return result;
+}
+
+inline void print_transport(const char* _name, transport_result const& _result)
+{
+  std::printf("%-6s round trip %.1f us, %.0f messages/s", _name, _result.round_trip * 1000000, _result.rate);
+  if (_result.lost != 0)
+  {
+    std::printf(", %zu lost", _result.lost);
+  }
+  std::printf("\n");
+}
+
+inline transport_result tcp_run(std::size_t _requests)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  return transport_run<server_t, client_t>([](server_t& s) { s.execute(0); },
+                                           [](client_t& c, server_t& s)
+                                           { c.execute(std::string("127.0.0.1"), s.local_endpoint().port()); },
+                                           _requests);
+}
+
+// tcp over loopback against a unix socket and the in-process transport.
+inline void run_inproc(std::size_t _requests)
+{
+  print_transport("tcp", tcp_run(_requests));
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+  {
+    using server_t = sv::net::engine::basic_local_server<sv::net::protocol::basic>;
+    using client_t = sv::net::engine::basic_local_client<sv::net::protocol::basic>;
+    auto path = (std::filesystem::temp_directory_path() / "sv.net.bench.sock").string();
+    print_transport("local", transport_run<server_t, client_t>([&](server_t& s) { s.execute(path); },
+                                                              [&](client_t& c, server_t&) { c.execute(path); },
+                                                              _requests));
+    std::filesystem::remove(path);
+  }
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+  using server_t = sv::net::engine::basic_inproc_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_inproc_client<sv::net::protocol::basic>;
+  std::string name = "sv.net.bench";
+  print_transport("inproc", transport_run<server_t, client_t>([&](server_t& s) { s.execute(name); },
+                                                             [&](client_t& c, server_t&) { c.execute(name); },
+                                                             _requests));
+}
+
+// tcp against udp over loopback, one message per datagram with nothing
+// resent: what the kernel drops of the stream is counted as lost.
+inline void run_udp(std::size_t _requests)
+{
+  print_transport("tcp", tcp_run(_requests));
+  using server_t = sv::net::engine::basic_udp_server<sv::net::protocol::datagram_basic>;
+  using client_t = sv::net::engine::basic_udp_client<sv::net::protocol::datagram_basic>;
+  auto result = transport_run<server_t, client_t>([](server_t& s) { s.execute(0); },
+                                                  [](client_t& c, server_t& s)
+                                                  { c.execute(std::string("127.0.0.1"), s.local_endpoint().port()); },
+                                                  _requests);
+  print_transport("udp", result);
+}
+
+#if defined(__linux__)
+
+// tcp over loopback against the shared-memory rings; both ends in this
+// process, as the transport does not care.
+inline void run_shm(std::size_t _requests)
+{
+  print_transport("tcp", tcp_run(_requests));
+  using server_t = sv::net::engine::basic_shm_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_shm_client<sv::net::protocol::basic>;
+  auto path = (std::filesystem::temp_directory_path() / "sv.net.bench.shm").string();
+  print_transport("shm", transport_run<server_t, client_t>([&](server_t& s) { s.execute(path); },
+                                                          [&](client_t& c, server_t&) { c.execute(path); },
+                                                          _requests));
+  std::filesystem::remove(path);
+}
+
+#else // __linux__
+
+inline void run_shm(std::size_t)
+{
+  std::printf("shm transport needs linux\n");
+}
+
+#endif // __linux__
+
+////////////////////////////////////////////////////////////////////////////////
+// hot restart
+//
+// every session is sent a backlog its client reads slowly. a third of the
+// clients connect before the first server hands its listener to a second
+// one, a third while it does and drains, and a third after. none should be
+// refused, and every client should read its whole backlog, from whichever
+// server accepted it.
+////////////////////////////////////////////////////////////////////////////////
+#if !defined(_WIN32)
+
+inline void run_restart(std::size_t _clients)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using packet_t = sv::net::packet::string_packet;
+
+  static constexpr std::size_t sc_messages = 64;
+  const std::string path = "/tmp/sv.net.bench.handoff";
+  const std::string body(16 * 1024, 'x');
+  const std::size_t expected = sc_messages * packet_t::make(body, 0)->get_header().length;
+
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  std::atomic<std::size_t> successor_sessions{ 0 };
+  auto on_session = [&](std::atomic<std::size_t>* _count)
+  {
+    return [&, _count](session_t::ptr const& session)
+    {
+      if (_count != nullptr)
+      {
+        ++*_count;
+      }
+      for (std::size_t i = 0; i < sc_messages; ++i)
+      {
+        session->protocol().send(packet_t::make(body, session->id()));
+      }
+    };
+  };
+  auto old_server = server_t::make();
+  old_server->set_accept_policy(policy);
+  old_server->on_session(on_session(nullptr));
+  old_server->execute(0);
+  auto port = old_server->local_endpoint().port();
+
+  auto new_server = server_t::make();
+  new_server->set_accept_policy(policy);
+  new_server->on_session(on_session(&successor_sessions));
+  scoped_thread successor([&]() { new_server->take_over(path); });
+
+  // clients read 4 KiB at a time with a pause, so the backlogs are still
+  // queued in the old server when it hands over.
+  struct client
+  {
+    explicit client(asio::io_context& _ioc) : socket(_ioc), timer(_ioc) {}
+    asio::ip::tcp::socket socket;
+    asio::steady_timer timer;
+    std::array<char, 4096> buffer;
+    std::atomic<std::size_t> received{ 0 };
+  };
+  asio::io_context ioc;
+  auto guard = asio::make_work_guard(ioc);
+  scoped_thread reader([&]() { ioc.run(); }, [&]() { ioc.stop(); });
+  std::list<client> clients;
+  std::function<void(client*)> read;
+  read = [&](client* c)
+  {
+    c->socket.async_read_some(asio::buffer(c->buffer), [&, c](error_code const& ec, std::size_t n)
+    {
+      c->received += n;
+      if (!!ec || c->received >= expected)
+      {
+        return;
+      }
+      c->timer.expires_after(std::chrono::microseconds(200));
+      c->timer.async_wait([&, c](error_code const&) { read(c); });
+    });
+  };
+
+  std::size_t refused = 0;
+  std::mutex mutex;
+  auto connect = [&](std::size_t _count)
+  {
+    for (std::size_t i = 0; i < _count; ++i)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      clients.emplace_back(ioc);
+      auto* c = &clients.back();
+      error_code ec;
+      c->socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port), ec);
+      if (!!ec)
+      {
+        ++refused;
+        continue;
+      }
+      asio::post(ioc, [&, c]() { read(c); });
+    }
+  };
+
+  connect(_clients / 3);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  auto begin = clock_type::now();
+  bool flushed = false;
+  scoped_thread restart([&]() { flushed = old_server->hand_off(path); });
+  connect(_clients / 3);
+  restart.join();
+  auto handoff_time = seconds_since(begin);
+  successor.join();
+  connect(_clients - 2 * (_clients / 3));
+
+  auto complete = [&]()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t n = 0;
+    for (auto const& c : clients)
+    {
+      n += (c.received >= expected) ? 1 : 0;
+    }
+    return n;
+  };
+  while (complete() + refused < clients.size() && seconds_since(begin) < 30)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::printf("restart with %zu clients: %zu refused, %zu of %zu backlogs complete, %zu served by the successor, "
+              "old server %s in %.0f ms\n",
+              _clients, refused, complete(), clients.size(), successor_sessions.load(), flushed ? "flushed" : "cut off",
+              handoff_time * 1000);
+
+  new_server->shutdown(std::chrono::seconds(1));
+  guard.reset();
+  ioc.stop();
+  reader.join();
+}
+
+#else // _WIN32
+
+inline void run_restart(std::size_t)
+{
+  std::printf("hot restart needs unix sockets\n");
+}
+
+#endif // _WIN32
+
+////////////////////////////////////////////////////////////////////////////////
+// broker fan-out
+//
+// a publisher sends one message at a time to _fanout subscribers of its
+// topic (half subscribed to it, half to "bench/*"), with _background other
+// subscriptions in the broker. the latency is from the publish until a
+// subscriber has read the message, over every copy.
+////////////////////////////////////////////////////////////////////////////////
+inline std::pair<double, double> broker_fanout(std::size_t _fanout, std::size_t _messages, std::size_t _background)
+{
+  using broker_t = sv::net::broker::basic_tcp_broker<>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using header_t = sv::net::packet::header;
+
+  auto broker = broker_t::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  broker->server().set_accept_policy(policy);
+  broker->execute(0);
+  auto port = broker->server().local_endpoint().port();
+  asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+
+  // subscribers are plain sockets on one thread, reading whole messages.
+  struct subscriber
+  {
+    explicit subscriber(asio::io_context& _ioc) : socket(_ioc) {}
+    asio::ip::tcp::socket socket;
+    std::array<char, sizeof(header_t)> header;
+    std::vector<char> body;
+  };
+  asio::io_context ioc;
+  std::vector<double> latencies;
+  std::atomic<std::size_t> received{ 0 };
+  std::function<void(subscriber*)> read;
+  read = [&](subscriber* s)
+  {
+    asio::async_read(s->socket, asio::buffer(s->header), [&, s](error_code const& ec, std::size_t)
+    {
+      if (!!ec)
+      {
+        return;
+      }
+      header_t h;
+      std::memcpy(&h, s->header.data(), sizeof(h));
+      s->body.resize(std::size_t(h.length) - sizeof(h));
+      asio::async_read(s->socket, asio::buffer(s->body), [&, s](error_code const& ec, std::size_t)
+      {
+        if (!!ec)
+        {
+          return;
+        }
+        auto now = clock_type::now().time_since_epoch().count();
+        // the payload is the last field of the variable data: the send time.
+        std::int64_t sent;
+        std::memcpy(&sent, s->body.data() + s->body.size() - sizeof(sent), sizeof(sent));
+        latencies.push_back(std::chrono::duration<double>(clock_type::duration(now - sent)).count());
+        ++received;
+        read(s);
+      });
+    });
+  };
+
+  auto subscription = [](std::string const& _topic)
+  {
+    return sv::net::packet::serialize(*sv::net::broker::make_subscribe(_topic));
+  };
+  asio::ip::tcp::socket background(ioc);
+  background.connect(endpoint);
+  std::string subscriptions;
+  for (std::size_t i = 0; i < _background; ++i)
+  {
+    subscriptions += subscription("tenant/" + std::to_string(i % 1000) + "/device/" + std::to_string(i));
+  }
+  asio::write(background, asio::buffer(subscriptions));
+
+  std::list<subscriber> subscribers;
+  for (std::size_t i = 0; i < _fanout; ++i)
+  {
+    subscribers.emplace_back(ioc);
+    auto* s = &subscribers.back();
+    s->socket.connect(endpoint);
+    s->socket.set_option(asio::ip::tcp::no_delay(true));
+    asio::write(s->socket, asio::buffer(subscription(i % 2 == 0 ? "bench/tick" : "bench/*")));
+    read(s);
+  }
+  scoped_thread reader([&]() { ioc.run(); }, [&]() { ioc.stop(); });
+
+  auto begin = clock_type::now();
+  while (broker->subscriptions() < _background + _fanout && seconds_since(begin) < 30)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::atomic<session_t*> publisher{ nullptr };
+  auto client = client_t::make();
+  client->on_session([&](session_t::ptr const& session) { publisher = session.get(); });
+  client->execute("127.0.0.1", port);
+  while (publisher == nullptr && seconds_since(begin) < 30)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  begin = clock_type::now();
+  for (std::size_t i = 0; i < _messages && publisher != nullptr; ++i)
+  {
+    std::int64_t sent = clock_type::now().time_since_epoch().count();
+    publisher.load()->protocol().send(
+      sv::net::broker::make_publish("bench/tick", std::string(reinterpret_cast<const char*>(&sent), sizeof(sent))));
+    while (received < (i + 1) * _fanout && seconds_since(begin) < 30)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  asio::post(ioc, [&]()
+  {
+    for (auto& e : subscribers)
+    {
+      e.socket.close();
+    }
+    background.close();
+  });
+  reader.join();
+
+  if (latencies.empty())
+  {
+    return { 0, 0 };
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double total = 0;
+  for (auto e : latencies)
+  {
+    total += e;
+  }
+  return { total / latencies.size(), latencies[latencies.size() * 99 / 100] };
+}
+
+inline void run_broker(std::size_t _messages)
+{
+  static constexpr std::size_t sc_background = 100000;
+
+  for (std::size_t fanout : { 1, 10, 100, 1000 })
+  {
+    auto latency = broker_fanout(fanout, _messages, sc_background);
+    std::printf("broker fan-out %zu, %zu other subscriptions: mean %.1f us, p99 %.1f us\n", fanout, sc_background,
+                latency.first * 1000000, latency.second * 1000000);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// durable queue
+//
+// _messages messages of 256 bytes to a server, once sent straight from a
+// basic_tcp_client and once pushed into a durable::basic_tcp_sender, each
+// timed until the server has read every one.
+////////////////////////////////////////////////////////////////////////////////
+#if defined(SV_NET_HAS_WAL)
+
+inline void run_durable(std::size_t _messages)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using packet_t = sv::net::packet::string_packet;
+
+  const std::string directory = "/tmp/sv.net.bench.wal";
+  const std::string body(256, 'x');
+
+  std::atomic<std::size_t> received{ 0 };
+  sv::net::durable::receiver receiver([&](sv::net::packet::base::ptr) { ++received; });
+  auto server = server_t::make();
+  server->on_session([&](session_t::ptr const& session) { receiver.attach(session); });
+  server->execute(0);
+  auto port = server->local_endpoint().port();
+
+  auto wait_for = [&](std::size_t _count)
+  {
+    while (received < _count)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  };
+
+  double memory;
+  {
+    std::promise<session_t*> connected;
+    auto client = client_t::make();
+    client->on_session([&](session_t::ptr const& session) { connected.set_value(session.get()); });
+    client->execute(std::string("127.0.0.1"), port);
+    auto* session = connected.get_future().get();
+
+    auto begin = clock_type::now();
+    for (std::size_t i = 0; i < _messages; ++i)
+    {
+      session->protocol().send(packet_t::make(body, session->id()));
+    }
+    wait_for(_messages);
+    memory = seconds_since(begin);
+  }
+
+  double durable;
+  double pushed;
+  {
+    // a fresh queue; what a previous run left would be sent first.
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+    sv::net::durable::basic_tcp_sender<> sender(directory);
+    sender.execute(std::string("127.0.0.1"), port);
+
+    auto packet = packet_t::make(body, 0);
+    auto begin = clock_type::now();
+    for (std::size_t i = 0; i < _messages; ++i)
+    {
+      sender.push(*packet);
+    }
+    sender.commit();
+    pushed = seconds_since(begin);
+    wait_for(2 * _messages);
+    durable = seconds_since(begin);
+  }
+  std::filesystem::remove_all(directory);
+
+  std::printf("in memory: %zu messages in %.3f s, %.0f msg/s\n", _messages, memory, _messages / memory);
+  std::printf("durable:   %zu messages in %.3f s, %.0f msg/s (pushed and synced in %.3f s), %.2fx in memory\n",
+              _messages, durable, _messages / durable, pushed, durable / memory);
+}
+
+#else // SV_NET_HAS_WAL
+
+inline void run_durable(std::size_t)
+{
+  std::printf("built without the write-ahead log\n");
+}
+
+#endif // SV_NET_HAS_WAL
+
+////////////////////////////////////////////////////////////////////////////////
+// relay throughput
+//
+// _megabytes packets of 1 MiB to a sink, straight over loopback, through a
+// proxy::tcp_relay, and through a basic_tcp_server that hands every packet it
+// receives to a basic_tcp_client (decoded and encoded again).
+////////////////////////////////////////////////////////////////////////////////
+#if defined(SV_NET_HAS_PROXY)
+
+// MB/s from the first write to _port until _sink has read everything.
+inline double stream_through(asio::ip::tcp::acceptor& _sink, unsigned short _port, std::string const& _message,
+                             std::size_t _count)
+{
+  const std::size_t expected = _message.size() * _count;
+  clock_type::time_point end;
+  scoped_thread reader([&]()
+  {
+    asio::ip::tcp::socket socket(_sink.get_executor());
+    _sink.accept(socket);
+    std::vector<char> buffer(1024 * 1024);
+    std::size_t total = 0;
+    error_code ec;
+    while (total < expected && !ec)
+    {
+      total += socket.read_some(asio::buffer(buffer), ec);
+    }
+    end = clock_type::now();
+  }, [&]()
+  {
+    error_code ec;
+    _sink.close(ec);
+  });
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket out(ioc);
+  out.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), _port));
+  auto begin = clock_type::now();
+  for (std::size_t i = 0; i < _count; ++i)
+  {
+    asio::write(out, asio::buffer(_message));
+  }
+  reader.join();
+  return expected / (1024.0 * 1024.0) / std::chrono::duration<double>(end - begin).count();
+}
+
+inline void run_proxy(std::size_t _megabytes)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+
+  auto message = sv::net::packet::serialize(*sv::net::packet::string_packet::make(std::string(1024 * 1024, 'x'), 0));
+
+  asio::io_context ioc;
+  asio::ip::tcp::acceptor sink(ioc, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), 0));
+  auto sink_port = sink.local_endpoint().port();
+
+  auto direct = stream_through(sink, sink_port, message, _megabytes);
+
+  double relayed;
+  {
+    sv::net::proxy::tcp_relay relay;
+    relay.add_backend(std::string("127.0.0.1"), sink_port);
+    relay.execute(0);
+    relayed = stream_through(sink, relay.local_endpoint().port(), message, _megabytes);
+  }
+
+  double forwarded;
+  {
+    std::promise<session_t*> connected;
+    auto backend = client_t::make();
+    backend->on_session([&](session_t::ptr const& session) { connected.set_value(session.get()); });
+    // the sink accepts it once the stream starts; the backlog holds it till then.
+    backend->execute(std::string("127.0.0.1"), sink_port);
+    auto* out = connected.get_future().get();
+
+    auto front = server_t::make();
+    front->on_session([out](session_t::ptr const& session)
+    {
+      session->protocol().on_receive([out](sv::net::packet::base::ptr packet) { out->protocol().send(packet); });
+    });
+    front->execute(0);
+    forwarded = stream_through(sink, front->local_endpoint().port(), message, _megabytes);
+  }
+
+  std::printf("loopback:            %.0f MB/s\n", direct);
+  std::printf("proxy::tcp_relay:    %.0f MB/s (%.0f%% of loopback)\n", relayed, 100 * relayed / direct);
+  std::printf("decode and re-encode: %.0f MB/s (%.0f%% of loopback)\n", forwarded, 100 * forwarded / direct);
+}
+
+#else // SV_NET_HAS_PROXY
+
+inline void run_proxy(std::size_t)
+{
+  std::printf("built without splice support\n");
+}
+
+#endif // SV_NET_HAS_PROXY
+
+////////////////////////////////////////////////////////////////////////////////
+// load balancing
+//
+// _requests requests, 8 in flight at a time, from a balance::basic_tcp_balancer
+// to three servers, one of which answers 10 ms late; once round robin and
+// once least loaded. latency is per request, from send to answer.
+////////////////////////////////////////////////////////////////////////////////
+inline std::vector<double> balanced_latency(sv::net::balance::policy _policy, std::size_t _requests, double& _seconds)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using packet_t = sv::net::packet::string_packet;
+
+  static constexpr std::size_t sc_servers = 3;
+  static constexpr std::size_t sc_in_flight = 8;
+
+  // the slow server's answers wait here, so it still takes every request.
+  asio::io_context delays;
+  auto guard = asio::make_work_guard(delays);
+  scoped_thread delayer([&]() { delays.run(); }, [&]() { delays.stop(); });
+
+  std::vector<server_t::ptr> servers;
+  for (std::size_t i = 0; i < sc_servers; ++i)
+  {
+    auto server = server_t::make();
+    sv::net::engine::accept_policy policy;
+    policy.trace = false;
+    server->set_accept_policy(policy);
+    server->on_session([&delays, slow = i == 0](session_t::ptr const& session)
+    {
+      sv::net::balance::serve(session, [&delays, slow](sv::net::packet::base::ptr request, sv::net::balance::answer_type answer)
+      {
+        if (!slow)
+        {
+          answer(std::move(request));
+          return;
+        }
+        auto timer = std::make_shared<asio::steady_timer>(delays, std::chrono::milliseconds(10));
+        timer->async_wait([timer, request, answer](error_code const&) { answer(request); });
+      });
+    });
+    server->execute(0);
+    servers.push_back(server);
+  }
+
+  sv::net::balance::options options;
+  options.policy = _policy;
+  std::vector<double> latencies;
+  std::mutex mutex;
+  std::atomic<std::size_t> answered{ 0 };
+  {
+    sv::net::balance::basic_tcp_balancer<> balancer(options);
+    for (std::size_t i = 0; i < sc_servers; ++i)
+    {
+      balancer.add_endpoint(std::string("127.0.0.1"), servers[i]->local_endpoint().port());
+    }
+    auto connected = [&balancer]()
+    {
+      auto stats = balancer.stats();
+      return std::all_of(stats.begin(), stats.end(), [](auto const& e) { return e.connected; });
+    };
+    auto begin = clock_type::now();
+    while (!connected() && seconds_since(begin) < 5)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto request = packet_t::make("request", 0);
+    begin = clock_type::now();
+    for (std::size_t i = 0; i < _requests; ++i)
+    {
+      while (i - answered >= sc_in_flight && seconds_since(begin) < 60)
+      {
+        std::this_thread::yield();
+      }
+      auto sent = clock_type::now();
+      balancer.request(request, [&, sent](error_code const&, sv::net::packet::base::ptr)
+      {
+        auto latency = seconds_since(sent);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          latencies.push_back(latency);
+        }
+        ++answered;
+      });
+    }
+    while (answered < _requests && seconds_since(begin) < 60)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    _seconds = seconds_since(begin);
+  }
+
+  guard.reset();
+  delayer.join();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+inline void run_balance(std::size_t _requests)
+{
+  struct variant
+  {
+    const char* name;
+    sv::net::balance::policy policy;
+  };
+  variant variants[] = {
+    { "round robin", sv::net::balance::policy::round_robin },
+    { "least loaded", sv::net::balance::policy::least_loaded },
+  };
+
+  for (auto const& e : variants)
+  {
+    double seconds = 0;
+    auto latencies = balanced_latency(e.policy, _requests, seconds);
+    if (latencies.empty())
+    {
+      continue;
+    }
+    auto at = [&](double _share) { return latencies[std::size_t(_share * (latencies.size() - 1))] * 1000; };
+    std::printf("%-12s %.0f req/s, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, p99.9 %.2f ms\n", e.name,
+                latencies.size() / seconds, at(0.5), at(0.9), at(0.99), at(0.999));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// sharding
+//
+// _keys keys on a shard::ring of 8 and of 64 nodes (160 points each): the
+// time of a lookup, how unevenly the keys spread, and the share that moves
+// to another node when a node is added, against hashing modulo the count.
+////////////////////////////////////////////////////////////////////////////////
+inline void run_shard(std::size_t _keys)
+{
+  std::vector<std::string> keys;
+  keys.reserve(_keys);
+  for (std::size_t i = 0; i < _keys; ++i)
+  {
+    keys.push_back("user/" + std::to_string(i * 7919));
+  }
+
+  for (std::size_t nodes : { 8, 64 })
+  {
+    sv::net::shard::basic_ring<std::size_t> ring;
+    for (std::size_t i = 0; i < nodes; ++i)
+    {
+      ring.add("node-" + std::to_string(i), i);
+    }
+
+    std::vector<std::size_t> owner(_keys);
+    std::vector<std::size_t> load(nodes + 1);
+    auto begin = clock_type::now();
+    for (std::size_t i = 0; i < _keys; ++i)
+    {
+      owner[i] = *ring.find(keys[i]);
+    }
+    auto lookup = seconds_since(begin) / _keys;
+    for (auto e : owner)
+    {
+      ++load[e];
+    }
+    auto busiest = *std::max_element(load.begin(), load.end());
+
+    ring.add("node-" + std::to_string(nodes), nodes);
+    std::size_t moved = 0;
+    std::size_t moved_modulo = 0;
+    for (std::size_t i = 0; i < _keys; ++i)
+    {
+      moved += *ring.find(keys[i]) != owner[i];
+      auto h = sv::net::shard::hash(keys[i]);
+      moved_modulo += h % nodes != h % (nodes + 1);
+    }
+
+    std::printf("%zu nodes: lookup %.0f ns, busiest node %.2fx the mean, a node added moves %.1f%% of keys "
+                "(modulo: %.1f%%, ideal: %.1f%%)\n",
+                nodes, lookup * 1e9, double(busiest) * nodes / _keys, 100.0 * moved / _keys, 100.0 * moved_modulo / _keys,
+                100.0 / (nodes + 1));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// membership
+//
+// _nodes membership::cluster members on loopback (one io_context, period
+// 100ms), and a quarter as many: the time until every member knows all the
+// others, the messages each member sends per second once settled, and the
+// time until a stopped member is declared dead everywhere.
+////////////////////////////////////////////////////////////////////////////////
+inline void run_membership(std::size_t _nodes)
+{
+  namespace membership = sv::net::membership;
+
+  membership::options options;
+  options.period = std::chrono::milliseconds(100);
+  options.probe_timeout = std::chrono::milliseconds(40);
+
+  for (std::size_t nodes : { std::max<std::size_t>(_nodes / 4, 2), std::max<std::size_t>(_nodes, 2) })
+  {
+    auto count = [](membership::cluster& _cluster, membership::state _state, unsigned short _port) {
+      std::size_t result = 0;
+      for (auto const& e : _cluster.members())
+      {
+        result += e.state == _state && (_port == 0 || e.endpoint.port() == _port);
+      }
+      return result;
+    };
+
+    asio::io_context context;
+    auto work = asio::make_work_guard(context);
+    std::vector<std::unique_ptr<membership::cluster>> cluster;
+    for (std::size_t i = 0; i < nodes; ++i)
+    {
+      cluster.push_back(std::make_unique<membership::cluster>(
+        context, membership::endpoint_type(asio::ip::address_v4::loopback(), 0), options));
+    }
+    scoped_thread runner([&] { context.run(); }, [&] { context.stop(); });
+
+    auto begin = clock_type::now();
+    auto seed = cluster.front()->local();
+    for (auto& e : cluster)
+    {
+      e->start({ seed });
+    }
+    auto converged = [&] {
+      return std::all_of(cluster.begin(), cluster.end(),
+                         [&](auto& _e) { return count(*_e, membership::state::alive, 0) == nodes - 1; });
+    };
+    while (!converged() && seconds_since(begin) < 30)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    auto convergence = seconds_since(begin);
+    auto settled = converged();
+
+    auto sent = [&] {
+      std::uint64_t result = 0;
+      for (auto& e : cluster)
+      {
+        result += e->stats().sent;
+      }
+      return result;
+    };
+    auto before = sent();
+    begin = clock_type::now();
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    auto rate = double(sent() - before) / seconds_since(begin) / nodes;
+
+    auto port = cluster.back()->local().port();
+    cluster.back()->stop();
+    begin = clock_type::now();
+    auto detected = [&] {
+      return std::all_of(cluster.begin(), cluster.end() - 1,
+                         [&](auto& _e) { return count(*_e, membership::state::dead, port) == 1; });
+    };
+    while (!detected() && seconds_since(begin) < 30)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    auto detection = seconds_since(begin);
+    auto noticed = detected();
+
+    std::printf("%zu members: converged%s in %.2f s, %.1f messages/member/s, a stopped member dead everywhere%s "
+                "in %.2f s\n",
+                nodes, settled ? "" : " (not)", convergence, rate, noticed ? "" : " (not)", detection);
+
+    work.reset();
+    context.stop();
+    runner.join();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// tracing
+//
+// ping-pong round trips without a tracer, with one that samples nothing, 1%
+// and every request; the server's reply continues the request's trace.
+////////////////////////////////////////////////////////////////////////////////
+inline double traced_round_trip(sv::net::trace::tracer::ptr const& _tracer, std::size_t _requests)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using packet_t = sv::net::packet::string_packet;
+
+  auto server = server_t::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&](session_t::ptr const& session)
+  {
+    auto* protocol = &session->protocol();
+    auto id = session->id();
+    protocol->set_tracer(_tracer);
+    protocol->on_receive([protocol, id](sv::net::packet::base::ptr request)
+    {
+      auto reply = packet_t::make("pong", id);
+      sv::net::trace::tracer::follow(*reply, *request);
+      protocol->send(reply);
+    });
+  });
+  server->execute(0);
+
+  std::atomic<std::size_t> responses{ 0 };
+  std::atomic<session_t*> client_session{ nullptr };
+  auto client = client_t::make();
+  client->on_session([&](session_t::ptr const& session)
+  {
+    session->protocol().set_tracer(_tracer);
+    session->protocol().on_receive([&](sv::net::packet::base::ptr) { ++responses; });
+    client_session = session.get();
+  });
+  client->execute("127.0.0.1", server->local_endpoint().port());
+
+  auto begin = clock_type::now();
+  while (client_session == nullptr && seconds_since(begin) < 5)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (client_session == nullptr)
+  {
+    return 0;
+  }
+
+  auto& protocol = client_session.load()->protocol();
+  auto id = client_session.load()->id();
+  begin = clock_type::now();
+  for (std::size_t i = 0; i < _requests; ++i)
+  {
+    auto request = packet_t::make("ping", id);
+    if (_tracer)
+    {
+      _tracer->start(*request);
+    }
+    protocol.send(request);
+    while (responses <= i && seconds_since(begin) < 60)
+    {
+      std::this_thread::yield();
+    }
+  }
+  return seconds_since(begin) / _requests;
+}
+
+inline void run_trace(std::size_t _requests)
+{
+  auto path = (std::filesystem::temp_directory_path() / "sv.net.trace.json").string();
+  struct variant
+  {
+    const char* name;
+    double rate;
+  };
+  variant variants[] = {
+    { "no tracer", -1 },
+    { "sampling off", 0 },
+    { "1% sampled", 0.01 },
+    { "all sampled", 1 },
+  };
+
+  for (auto const& e : variants)
+  {
+    auto tracer = e.rate < 0 ? sv::net::trace::tracer::ptr() : sv::net::trace::tracer::make(path, e.rate);
+    auto latency = traced_round_trip(tracer, _requests);
+    std::printf("round trip, %s: %.1f us", e.name, latency * 1000000);
+    if (tracer)
+    {
+      tracer->close();
+      std::printf(", %zu spans, %ju bytes", tracer->spans(), std::uintmax_t(std::filesystem::file_size(path)));
+    }
+    std::printf("\n");
+  }
+  std::printf("spans of the last run: %s\n", path.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// checksum
+//
+// crc32c throughput over _megabytes of buffers of several sizes, with the
+// crc32 instruction (when the processor has it) and the portable tables.
+////////////////////////////////////////////////////////////////////////////////
+inline void run_checksum(std::size_t _megabytes)
+{
+  std::printf("crc32c, %s\n", sv::net::checksum::hardware() ? "sse4.2" : "no sse4.2: portable only");
+  for (std::size_t size : { 64, 1024, 16 * 1024, 1024 * 1024 })
+  {
+    std::string buffer(size, '\0');
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      buffer[i] = static_cast<char>(i * 131);
+    }
+    auto rounds = std::max<std::size_t>(_megabytes * 1024 * 1024 / size, 1);
+
+    std::uint32_t crc = 0;
+    auto begin = clock_type::now();
+    for (std::size_t i = 0; i < rounds; ++i)
+    {
+      crc = sv::net::checksum::crc32c(buffer.data(), size, crc);
+    }
+    auto fast = double(rounds * size) / seconds_since(begin);
+
+    std::uint32_t check = 0;
+    begin = clock_type::now();
+    for (std::size_t i = 0; i < rounds; ++i)
+    {
+      check = sv::net::checksum::crc32c_software(buffer.data(), size, check);
+    }
+    auto portable = double(rounds * size) / seconds_since(begin);
+
+    std::printf("%7zu bytes: %6.2f GB/s, portable %5.2f GB/s%s\n", size, fast / 1e9, portable / 1e9,
+                crc == check ? "" : " (mismatch)");
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// idle sessions
+//
+// _connections loopback connections that send nothing, opened by a child
+// process so that only the server's memory is counted: the resident memory
+// the server gains per idle session, with everything asio and the kernel
+// keep in the process.
+////////////////////////////////////////////////////////////////////////////////
+#if defined(__linux__)
+
+inline std::size_t resident_bytes()
+{
+  std::size_t pages = 0;
+  std::size_t resident = 0;
+  if (auto* file = std::fopen("/proc/self/statm", "r"))
+  {
+    if (std::fscanf(file, "%zu %zu", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    std::fclose(file);
+  }
+  return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+inline void run_idle(std::size_t _connections)
+{
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+
+  rlimit limit{};
+  ::getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+  if (_connections + 64 > limit.rlim_cur)
+  {
+    _connections = limit.rlim_cur > 64 ? static_cast<std::size_t>(limit.rlim_cur) - 64 : 0;
+    std::printf("open files limited to %ju, %zu connections\n", std::uintmax_t(limit.rlim_cur), _connections);
+  }
+
+  std::atomic<std::size_t> sessions{ 0 };
+  std::atomic<std::size_t> closed{ 0 };
+  auto server = server_t::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  policy.drain = true;
+  server->set_accept_policy(policy);
+  server->on_session([&](session_t::ptr const& session)
+  {
+    ++sessions;
+    session->protocol().on_close([&](error_code const&) { ++closed; });
+  });
+  server->execute(0);
+  auto port = server->local_endpoint().port();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto before = resident_bytes();
+
+  // the child only makes system calls: it is forked from a process with
+  // threads running.
+  int ready[2];
+  int done[2];
+  if (::pipe(ready) != 0 || ::pipe(done) != 0)
+  {
+    std::printf("pipe failed\n");
+    return;
+  }
+  pid_t child = ::fork();
+  if (child == 0)
+  {
+    ::close(ready[0]);
+    ::close(done[1]);
+    sockaddr_in to{};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::size_t opened = 0;
+    for (std::size_t i = 0; i < _connections; ++i)
+    {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&to), sizeof(to)) != 0)
+      {
+        break;
+      }
+      ++opened;
+    }
+    ssize_t written = ::write(ready[1], &opened, sizeof(opened));
+    char c;
+    ssize_t read = ::read(done[0], &c, 1);
+    (void)written;
+    (void)read;
+    ::_exit(0);
+  }
+  ::close(ready[1]);
+  ::close(done[0]);
+
+  std::size_t opened = 0;
+  if (::read(ready[0], &opened, sizeof(opened)) != sizeof(opened))
+  {
+    opened = 0;
+  }
+  auto begin = clock_type::now();
+  while (sessions < opened && seconds_since(begin) < 60)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  auto after = resident_bytes();
+
+  std::printf("%zu idle sessions: %.1f MB resident, %.0f bytes per session\n", sessions.load(),
+              double(after - before) / (1024 * 1024), sessions ? double(after - before) / sessions : 0.0);
+
+  // every session would report its peer's close on std::cerr.
+  auto* errors = std::cerr.rdbuf(nullptr);
+  ::close(done[1]);
+  ::close(ready[0]);
+  ::waitpid(child, nullptr, 0);
+  begin = clock_type::now();
+  while (closed < sessions && seconds_since(begin) < 10)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  server->shutdown(std::chrono::seconds(1));
+  std::cerr.rdbuf(errors);
+  std::cerr.clear();
+}
+
+#else // __linux__
+
+inline void run_idle(std::size_t)
+{
+  std::printf("idle sessions needs linux\n");
+}
+
+#endif // __linux__
+
+#if defined(SV_NET_HAS_TLS)
+
+namespace tls = sv::net::tls;
+
+// self-signed P-256 certificate for _name, valid for a day: { cert, key } pem.
+inline std::pair<std::string, std::string> make_certificate(std::string const& _name)
+{
+  auto* key = EVP_EC_gen("P-256");
+  auto* cert = X509_new();
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+  X509_set_pubkey(cert, key);
+
+  auto* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(_name.c_str()), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  std::string alt = "DNS:" + _name;
+  auto* ext = X509V3_EXT_conf_nid(nullptr, nullptr, NID_subject_alt_name, alt.c_str());
+  X509_add_ext(cert, ext, -1);
+  X509_EXTENSION_free(ext);
+  X509_sign(cert, key, EVP_sha256());
+
+  auto to_string = [](BIO* bio)
+  {
+    char* data = nullptr;
+    auto size = BIO_get_mem_data(bio, &data);
+    std::string s(data, static_cast<std::size_t>(size));
+    BIO_free(bio);
+    return s;
+  };
+  auto* cert_bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_X509(cert_bio, cert);
+  auto* key_bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_PrivateKey(key_bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return { to_string(cert_bio), to_string(key_bio) };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// tls_bench
+//
+// client and server on one io_context over loopback. a handshake counts once
+// the client has read the first byte the server sends, so tls 1.3 tickets
+// are received and stored before the connection closes.
+////////////////////////////////////////////////////////////////////////////////
+class tls_bench
+{
+public:
+  static constexpr std::size_t sc_chunk = 256 * 1024;
+
+  tls_bench(bool _kernel_tls)
+    : m_ioc()
+  {
+    auto cert = make_certificate("localhost");
+
+    tls::config server;
+    server.certificate_chain = cert.first;
+    server.private_key = cert.second;
+    server.kernel_tls = _kernel_tls;
+    m_server = tls::context::make(server);
+
+    tls::config client;
+    client.ca = cert.first;
+    client.server_name = "localhost";
+    client.kernel_tls = _kernel_tls;
+    m_client = tls::context::make(client);
+    client.resumption = false;
+    m_client_full = tls::context::make(client);
+
+    m_acceptor = std::make_unique<tls::acceptor>(m_ioc, tls::stream::endpoint_type(asio::ip::address_v4::loopback(), 0), m_server);
+    m_endpoint = m_acceptor->local_endpoint();
+  }
+
+  // handshakes per second; resumed counts how many reused a session.
+  double handshakes(std::size_t _count, bool _resume, std::size_t& _resumed)
+  {
+    auto ctx = _resume ? m_client : m_client_full;
+    _resumed = 0;
+    m_client->clear_sessions();
+
+    std::size_t left = _count;
+    std::function<void()> next;
+    auto begin = clock_type::now();
+    next = [&]()
+    {
+      if (left-- == 0)
+      {
+        m_acceptor->close();
+        return;
+      }
+      auto client = std::make_shared<tls::stream>(m_ioc);
+      auto byte = std::make_shared<char>();
+      client->async_connect(m_endpoint, ctx, [&, client, byte](error_code const& ec)
+      {
+        if (!!ec)
+        {
+          std::printf("connect: %s\n", ec.message().c_str());
+          return;
+        }
+        asio::async_read(*client, asio::buffer(byte.get(), 1), [&, client, byte](error_code const& ec, std::size_t)
+        {
+          if (!ec && client->resumed())
+          {
+            ++_resumed;
+          }
+          client->close();
+          next();
+        });
+      });
+    };
+
+    reopen();
+    accept([](std::shared_ptr<tls::stream> const& server)
+    {
+      static const char sc_hello = 'h';
+      asio::async_write(*server, asio::buffer(&sc_hello, 1), [server](error_code const&, std::size_t) {});
+    });
+    next();
+    run();
+    return _count / seconds_since(begin);
+  }
+
+  // mega bytes per second the server reads from one client.
+  double throughput(std::size_t _megabytes, bool& _kernel_tls)
+  {
+    std::vector<char> out(sc_chunk, 'x');
+    std::vector<char> in(sc_chunk);
+    std::size_t total = _megabytes * 1024 * 1024;
+    std::size_t received = 0;
+    clock_type::time_point begin;
+
+    auto client = std::make_shared<tls::stream>(m_ioc);
+    std::size_t sent = 0;
+    std::function<void()> write;
+    write = [&]()
+    {
+      if (sent >= total)
+      {
+        return;
+      }
+      auto n = std::min(sc_chunk, total - sent);
+      sent += n;
+      asio::async_write(*client, asio::buffer(out.data(), n), [&](error_code const& ec, std::size_t)
+      {
+        if (!ec)
+        {
+          write();
+        }
+      });
+    };
+
+    reopen();
+    std::function<void(std::shared_ptr<tls::stream> const&)> read;
+    read = [&](std::shared_ptr<tls::stream> const& server)
+    {
+      server->async_read_some(asio::buffer(in), [&, server](error_code const& ec, std::size_t n)
+      {
+        received += n;
+        if (!!ec || received >= total)
+        {
+          server->close();
+          client->close();
+          m_acceptor->close();
+          return;
+        }
+        read(server);
+      });
+    };
+    accept(read);
+    client->async_connect(m_endpoint, m_client, [&](error_code const& ec)
+    {
+      if (!ec)
+      {
+        _kernel_tls = client->kernel_tls();
+        begin = clock_type::now();
+        write();
+      }
+    });
+    run();
+    return (received / (1024.0 * 1024.0)) / seconds_since(begin);
+  }
+
+private:
+  void reopen()
+  {
+    if (!m_acceptor->is_open())
+    {
+      m_acceptor = std::make_unique<tls::acceptor>(m_ioc, m_endpoint, m_server);
+    }
+  }
+  void accept(std::function<void(std::shared_ptr<tls::stream> const&)> _on_accept)
+  {
+    auto server = std::make_shared<tls::stream>(m_ioc);
+    m_acceptor->async_accept(*server, [this, server, _on_accept](error_code const& ec)
+    {
+      if (!!ec)
+      {
+        return;
+      }
+      _on_accept(server);
+      accept(_on_accept);
+    });
+  }
+  void run()
+  {
+    m_ioc.restart();
+    m_ioc.run();
+  }
+
+private:
+  asio::io_context m_ioc;
+  tls::context::ptr m_server;
+  tls::context::ptr m_client;
+  tls::context::ptr m_client_full;
+  std::unique_ptr<tls::acceptor> m_acceptor;
+  tls::stream::endpoint_type m_endpoint;
+};
+
+inline void run_tls(std::size_t _handshakes, std::size_t _megabytes)
+{
+  for (bool kernel_tls : { false, true })
+  {
+    tls_bench bench(kernel_tls);
+    std::size_t resumed = 0;
+    auto full = bench.handshakes(_handshakes, false, resumed);
+    std::printf("tls%s handshakes: full %.0f/s", kernel_tls ? "+ktls" : "", full);
+    auto fast = bench.handshakes(_handshakes, true, resumed);
+    std::printf(", resumed %.0f/s (%zu of %zu reused)\n", fast, resumed, _handshakes);
+
+    bool offloaded = false;
+    auto rate = bench.throughput(_megabytes, offloaded);
+    std::printf("tls%s throughput: %.1f MB/s%s\n", kernel_tls ? "+ktls" : "", rate,
+                (kernel_tls && !offloaded) ? " (kernel tls unavailable, fell back to openssl)" : "");
+  }
+}
+
+#else // SV_NET_HAS_TLS
+
+inline void run_tls(std::size_t, std::size_t)
+{
+  std::printf("built without tls (SV_NET_TLS=OFF)\n");
+}
+
+#endif // SV_NET_HAS_TLS
+
+} // namespace sv::bench
+} // namespace sv
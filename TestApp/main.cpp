@@ -1,10 +1,14 @@
 #include <iostream>
 #include <string>
 
+#include "bench.h"
+#include "replay.h"
 #include "util.h"
-#include "node.hpp"
-#include "packet.hpp"
-#include "protocol.hpp"
+#include "sv/net/broker.hpp"
+#include "sv/net/capture.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
 
 namespace sv
 {
@@ -13,13 +17,16 @@ namespace app
 
 class demo
 {
-  using server_t = sv::net::node::basic_tcp_server<sv::net::protocol::basic>;
-  using client_t = sv::net::node::basic_tcp_client<sv::net::protocol::basic>;
+  using server_t = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+  using broker_t = sv::net::broker::basic_tcp_broker<>;
 
 public:
   demo()
     : m_server(nullptr)
     , m_client(nullptr)
+    , m_broker(nullptr)
   {
   }
   ~demo()
@@ -37,21 +44,126 @@ public:
       } while (line.empty());
 
       auto tokens = sv::util::tokenize(line);
-      // exit | quit
-      if (tokens.size() == 1 && (tokens[0] == "exit" || tokens[0] == "quit"))
+      // a command that fails, e.g. a bench whose server cannot bind, is
+      // reported and the prompt comes back.
+      try
       {
-        std::cout << "terminating program...";
-        break;
+        // exit | quit
+        if (tokens.size() == 1 && (tokens[0] == "exit" || tokens[0] == "quit"))
+        {
+          std::cout << "terminating program...";
+          break;
+        }
+        // client [target] [port]
+        else if (tokens.size() == 3 && tokens[0] == "client")
+        {
+          on_client(tokens[1], static_cast<unsigned short>(std::stoi(tokens[2])));
+        }
+        // server [port]
+        else if (tokens.size() == 2 && tokens[0] == "server")
+        {
+          on_server(static_cast<unsigned short>(std::stoi(tokens[1])));
+        }
+        // server [port] [capture file]
+        else if (tokens.size() == 3 && tokens[0] == "server")
+        {
+          on_server(static_cast<unsigned short>(std::stoi(tokens[1])), tokens[2]);
+        }
+        // broker [port]
+        else if (tokens.size() == 2 && tokens[0] == "broker")
+        {
+          on_broker(static_cast<unsigned short>(std::stoi(tokens[1])));
+        }
+        // replay [capture file] [target] [port] [speed] [connections]
+        else if (tokens.size() == 6 && tokens[0] == "replay")
+        {
+          sv::replay::run(tokens[1], tokens[2], static_cast<unsigned short>(std::stoi(tokens[3])),
+                          std::stod(tokens[4]), std::stoul(tokens[5]));
+        }
+        // bench accept [connections]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "accept")
+        {
+          sv::bench::run_accept(std::stoul(tokens[2]));
+        }
+        // bench idle [connections]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "idle")
+        {
+          sv::bench::run_idle(std::stoul(tokens[2]));
+        }
+        // bench latency [requests]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "latency")
+        {
+          sv::bench::run_latency(std::stoul(tokens[2]));
+        }
+        // bench inproc [requests]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "inproc")
+        {
+          sv::bench::run_inproc(std::stoul(tokens[2]));
+        }
+        // bench shm [requests]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "shm")
+        {
+          sv::bench::run_shm(std::stoul(tokens[2]));
+        }
+        // bench udp [requests]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "udp")
+        {
+          sv::bench::run_udp(std::stoul(tokens[2]));
+        }
+        // bench balance [requests]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "balance")
+        {
+          sv::bench::run_balance(std::stoul(tokens[2]));
+        }
+        // bench broker [messages]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "broker")
+        {
+          sv::bench::run_broker(std::stoul(tokens[2]));
+        }
+        // bench checksum [megabytes]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "checksum")
+        {
+          sv::bench::run_checksum(std::stoul(tokens[2]));
+        }
+        // bench durable [messages]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "durable")
+        {
+          sv::bench::run_durable(std::stoul(tokens[2]));
+        }
+        // bench membership [nodes]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "membership")
+        {
+          sv::bench::run_membership(std::stoul(tokens[2]));
+        }
+        // bench proxy [megabytes]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "proxy")
+        {
+          sv::bench::run_proxy(std::stoul(tokens[2]));
+        }
+        // bench shard [keys]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "shard")
+        {
+          sv::bench::run_shard(std::stoul(tokens[2]));
+        }
+        // bench trace [requests]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "trace")
+        {
+          sv::bench::run_trace(std::stoul(tokens[2]));
+        }
+        // bench restart [clients]
+        else if (tokens.size() == 3 && tokens[0] == "bench" && tokens[1] == "restart")
+        {
+          sv::bench::run_restart(std::stoul(tokens[2]));
+        }
+        // bench tls [handshakes] [megabytes]
+        else if (tokens.size() == 4 && tokens[0] == "bench" && tokens[1] == "tls")
+        {
+          sv::bench::run_tls(std::stoul(tokens[2]), std::stoul(tokens[3]));
+        }
       }
-      // client [target] [port]
-      else if (tokens.size() == 3 && tokens[0] == "client")
+      catch (std::exception& e)
       {
-        on_client(tokens[1], static_cast<unsigned short>(std::stoi(tokens[2])));
-      }
-      // server [port]
-      else if (tokens.size() == 2 && tokens[0] == "server")
-      {
-        on_server(static_cast<unsigned short>(std::stoi(tokens[1])));
+        std::cerr << "exception: " << e.what() << std::endl;
       }
     } while (true);
   }
@@ -61,14 +173,27 @@ private:
     m_client = client_t::make();
     m_client->execute(_target, _port);
   }
-  void on_server(unsigned short _port)
+  void on_server(unsigned short _port, std::string const& _capture = std::string())
   {
     m_server = server_t::make();
+#if defined(SV_NET_HAS_CAPTURE)
+    if (!_capture.empty())
+    {
+      auto log = sv::net::capture::writer::make(_capture);
+      m_server->on_session([log](session_t::ptr const& session) { session->protocol().set_capture(log); });
+    }
+#endif // SV_NET_HAS_CAPTURE
     m_server->execute(_port);
   }
+  void on_broker(unsigned short _port)
+  {
+    m_broker = broker_t::make();
+    m_broker->execute(_port);
+  }
 private:
   server_t::ptr m_server;
   client_t::ptr m_client;
+  broker_t::ptr m_broker;
 };
 
 } // namespace sv::app
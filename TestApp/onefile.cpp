@@ -41,7 +41,7 @@ int main()
 }
 }
 
-#ifndef _WIN32_WINNT
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
   #define _WIN32_WINNT 0x0A00 // Windows 10
 #endif // _WIN32_WINNT
 
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sv/net/capture.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
+
+namespace sv
+{
+namespace replay
+{
+
+#if defined(SV_NET_HAS_CAPTURE)
+
+namespace asio = boost::asio;
+namespace capture = sv::net::capture;
+using clock_type = std::chrono::steady_clock;
+
+////////////////////////////////////////////////////////////////////////////////
+// replay
+//
+// sends what a captured server received to _target:_port again, one
+// basic_tcp_client per captured session (sessions beyond _pool share the
+// clients round-robin). _speed 1 keeps the captured pacing, 10 runs ten
+// times faster, 0 sends as fast as the clients take it.
+////////////////////////////////////////////////////////////////////////////////
+inline void run(std::string const& _path, std::string const& _target, unsigned short _port, double _speed,
+                std::size_t _pool)
+{
+  using client_t = sv::net::engine::basic_tcp_client<sv::net::protocol::basic>;
+  using session_t = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+
+  capture::reader log(_path);
+
+  // every captured session gets its client up front, so connecting does not
+  // distort the pacing.
+  std::unordered_map<sv::id_type, std::size_t> route;
+  capture::reader::entry entry;
+  while (log.next(entry))
+  {
+    if (entry.direction == capture::direction::received && route.count(entry.session) == 0)
+    {
+      auto index = route.size();
+      route.emplace(entry.session, _pool > 0 ? index % _pool : index);
+    }
+  }
+  std::size_t count = 0;
+  for (auto const& e : route)
+  {
+    count = std::max(count, e.second + 1);
+  }
+
+  std::vector<client_t::ptr> clients(count);
+  std::vector<std::atomic<session_t*>> sessions(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    sessions[i] = nullptr;
+    clients[i] = client_t::make();
+    clients[i]->on_session([&sessions, i](session_t::ptr const& session) { sessions[i] = session.get(); });
+    clients[i]->execute(_target, _port);
+  }
+  auto begin = clock_type::now();
+  for (auto& e : sessions)
+  {
+    while (e == nullptr && clock_type::now() - begin < std::chrono::seconds(10))
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (e == nullptr)
+    {
+      std::printf("replay: could not connect to %s:%u\n", _target.c_str(), _port);
+      return;
+    }
+  }
+
+  std::size_t messages = 0;
+  std::size_t bytes = 0;
+  std::uint64_t first = 0;
+  bool has_first = false;
+  log.rewind();
+  begin = clock_type::now();
+  while (log.next(entry))
+  {
+    if (entry.direction != capture::direction::received)
+    {
+      continue;
+    }
+    if (!has_first)
+    {
+      first = entry.time;
+      has_first = true;
+    }
+    if (_speed > 0)
+    {
+      auto offset = std::chrono::nanoseconds(static_cast<std::int64_t>((entry.time - first) / _speed));
+      std::this_thread::sleep_until(begin + offset);
+    }
+
+    auto* session = sessions[route[entry.session]].load();
+    auto packet = sv::net::packet::deserialize(session->id(), entry.data, entry.size);
+    if (packet != nullptr)
+    {
+      session->protocol().send(packet);
+      ++messages;
+      bytes += entry.size;
+    }
+  }
+
+  // everything queued is written before the clients go.
+  for (auto& e : sessions)
+  {
+    auto* session = e.load();
+    std::promise<void> flushed;
+    asio::post(session->socket().get_executor(), [session, &flushed]()
+    {
+      session->protocol().flush([&flushed]() { flushed.set_value(); });
+    });
+    flushed.get_future().wait();
+  }
+  auto elapsed = std::chrono::duration<double>(clock_type::now() - begin).count();
+  std::printf("replayed %zu messages (%.1f MB) over %zu connections in %.3f s: %.0f msg/s\n", messages,
+              bytes / (1024.0 * 1024.0), count, elapsed, elapsed > 0 ? messages / elapsed : 0.0);
+}
+
+#else // SV_NET_HAS_CAPTURE
+
+inline void run(std::string const&, std::string const&, unsigned short, double, std::size_t)
+{
+  std::printf("built without capture support\n");
+}
+
+#endif // SV_NET_HAS_CAPTURE
+
+} // namespace sv::replay
+} // namespace sv
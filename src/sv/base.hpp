@@ -0,0 +1,103 @@
+#ifndef __SV_BASE_HPP__
+#define __SV_BASE_HPP__
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace sv
+{
+
+using id_type = std::uint64_t;
+
+// the id counters must be one per process, also when sv.net is a shared
+// library built with -fvisibility=hidden.
+#if defined(_WIN32)
+#define SV_SHARED_STATE
+#else // _WIN32
+#define SV_SHARED_STATE __attribute__((visibility("default")))
+#endif // _WIN32
+
+// ids carry a shard (node) number in their top sc_id_shard_bits bits so ids
+// from different processes of a cluster never collide. 0 is never handed out.
+constexpr unsigned sc_id_shard_bits = 16;
+constexpr unsigned sc_id_sequence_bits = 64 - sc_id_shard_bits;
+constexpr id_type sc_id_sequence_mask = (id_type(1) << sc_id_sequence_bits) - 1;
+
+namespace detail
+{
+
+SV_SHARED_STATE inline std::atomic<id_type>& id_shard() noexcept
+{
+  static std::atomic<id_type> s_shard_{ 0 };
+  return s_shard_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// id_allocator
+//
+// each thread reserves sc_block ids at a time from the shared counter and
+// hands them out from a thread_local range, so constructing an id_holder
+// touches shared state once per sc_block objects. ids stay unique per T but
+// are only increasing within a thread.
+////////////////////////////////////////////////////////////////////////////////
+template<class T>
+struct SV_SHARED_STATE id_allocator
+{
+  static constexpr id_type sc_block = 1024;
+
+  static id_type next() noexcept
+  {
+    thread_local id_type t_next_ = 0;
+    thread_local id_type t_end_ = 0;
+    if (t_next_ == t_end_)
+    {
+      t_next_ = s_counter_.fetch_add(sc_block, std::memory_order_relaxed);
+      t_end_ = t_next_ + sc_block;
+    }
+    // past 2^48 the sequence wraps inside the shard rather than spilling
+    // into the shard bits; 0 stays reserved.
+    auto sequence = t_next_++ & sc_id_sequence_mask;
+    if (sequence == 0)
+    {
+      return next();
+    }
+    return id_shard().load(std::memory_order_relaxed) | sequence;
+  }
+
+private:
+  static inline std::atomic<id_type> s_counter_{ 1 };
+};
+
+} // namespace sv::detail
+
+// set once at startup, before ids are handed out.
+inline void set_id_shard(std::uint16_t shard) noexcept
+{
+  detail::id_shard().store(id_type(shard) << sc_id_sequence_bits, std::memory_order_relaxed);
+}
+inline std::uint16_t id_shard(id_type id) noexcept
+{
+  return static_cast<std::uint16_t>(id >> sc_id_sequence_bits);
+}
+inline id_type id_sequence(id_type id) noexcept
+{
+  return id & sc_id_sequence_mask;
+}
+
+template<class T>
+struct id_holder
+{
+  id_type id() const noexcept { return id_; }
+protected:
+  id_holder()
+    : id_(detail::id_allocator<T>::next())
+  {}
+
+private:
+  id_type id_;
+};
+
+} // namespace sv
+
+#endif // __SV_BASE_HPP__
@@ -0,0 +1,268 @@
+#ifndef __SV_NET_ADMISSION_HPP__
+#define __SV_NET_ADMISSION_HPP__
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif // __linux__
+
+namespace sv
+{
+namespace net
+{
+namespace admission
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+using clock_type = std::chrono::steady_clock;
+
+////////////////////////////////////////////////////////////////////////////////
+// limits
+//
+// what basic_server::set_limits hands to the acceptor. 0 means unlimited for
+// every count and rate.
+////////////////////////////////////////////////////////////////////////////////
+struct rate
+{
+  double per_second = 0;
+  // tokens a quiet session may save up; 0 allows one second's worth.
+  double burst = 0;
+};
+
+struct limits
+{
+  // open sessions of one acceptor.
+  std::size_t max_connections = 0;
+  // open sessions per remote ip address (ip transports only).
+  std::size_t max_per_address = 0;
+
+  // per session. a session over its rate is not read from until it is back
+  // under, so tcp flow control pushes back on the peer.
+  rate messages;
+  rate bytes;
+
+  // listen queue length, and TCP_DEFER_ACCEPT seconds (linux tcp only): the
+  // kernel only completes the accept once the client has sent data.
+  int backlog = asio::socket_base::max_listen_connections;
+  int defer_accept = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// token_bucket
+////////////////////////////////////////////////////////////////////////////////
+class token_bucket
+{
+public:
+  token_bucket()
+    : m_rate(0)
+    , m_burst(0)
+    , m_tokens(0)
+    , m_last()
+  {
+  }
+  explicit token_bucket(rate const& _rate)
+    : m_rate(_rate.per_second)
+    , m_burst(_rate.burst > 0 ? _rate.burst : _rate.per_second)
+    , m_tokens(m_burst)
+    , m_last(clock_type::now())
+  {
+  }
+  bool enabled() const
+  {
+    return m_rate > 0;
+  }
+  // takes _count tokens, going into debt if need be, and returns how long
+  // the caller has to wait until the debt is paid back.
+  clock_type::duration consume(double _count, clock_type::time_point _now)
+  {
+    auto elapsed = std::chrono::duration<double>(_now - m_last).count();
+    m_last = _now;
+    m_tokens = std::min(m_burst, m_tokens + elapsed * m_rate) - _count;
+    if (m_tokens >= 0)
+    {
+      return clock_type::duration::zero();
+    }
+    return std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(-m_tokens / m_rate));
+  }
+
+private:
+  double m_rate;
+  double m_burst;
+  double m_tokens;
+  clock_type::time_point m_last;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// throttle
+//
+// the message and byte buckets of one session. costs nothing when neither
+// rate is set.
+////////////////////////////////////////////////////////////////////////////////
+class throttle
+{
+public:
+  throttle() = default;
+  throttle(rate const& _messages, rate const& _bytes)
+    : m_messages(_messages)
+    , m_bytes(_bytes)
+  {
+  }
+  bool enabled() const
+  {
+    return m_messages.enabled() || m_bytes.enabled();
+  }
+  clock_type::duration consume(std::size_t _messages, std::size_t _bytes)
+  {
+    auto now = clock_type::now();
+    auto wait = clock_type::duration::zero();
+    if (m_messages.enabled() && _messages > 0)
+    {
+      wait = std::max(wait, m_messages.consume(double(_messages), now));
+    }
+    if (m_bytes.enabled())
+    {
+      wait = std::max(wait, m_bytes.consume(double(_bytes), now));
+    }
+    return wait;
+  }
+
+private:
+  token_bucket m_messages;
+  token_bucket m_bytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// gate
+//
+// counts the open sessions of an acceptor, in total and per address.
+// admit/release are a hash lookup each.
+////////////////////////////////////////////////////////////////////////////////
+struct address_hash
+{
+  std::size_t operator()(asio::ip::address const& _address) const
+  {
+    if (_address.is_v4())
+    {
+      return std::hash<std::uint32_t>()(_address.to_v4().to_uint());
+    }
+    auto bytes = _address.to_v6().to_bytes();
+    std::uint64_t halves[2];
+    std::memcpy(halves, bytes.data(), sizeof(halves));
+    return std::hash<std::uint64_t>()(halves[0] ^ (halves[1] * 0x9E3779B97F4A7C15ull));
+  }
+};
+
+class gate
+{
+public:
+  gate()
+    : m_limits()
+    , m_connections(0)
+  {
+  }
+  explicit gate(limits const& _limits)
+    : m_limits(_limits)
+    , m_connections(0)
+  {
+  }
+  // _address is null for transports without ip addresses.
+  bool admit(asio::ip::address const* _address)
+  {
+    if (m_limits.max_connections != 0 && m_connections >= m_limits.max_connections)
+    {
+      return false;
+    }
+    if (m_limits.max_per_address != 0 && _address != nullptr)
+    {
+      auto& count = m_per_address[*_address];
+      if (count >= m_limits.max_per_address)
+      {
+        return false;
+      }
+      ++count;
+    }
+    ++m_connections;
+    return true;
+  }
+  void release(asio::ip::address const* _address)
+  {
+    --m_connections;
+    if (m_limits.max_per_address != 0 && _address != nullptr)
+    {
+      auto it = m_per_address.find(*_address);
+      if (it != m_per_address.end() && --it->second == 0)
+      {
+        m_per_address.erase(it);
+      }
+    }
+  }
+  std::size_t connections() const
+  {
+    return m_connections;
+  }
+  limits const& get_limits() const
+  {
+    return m_limits;
+  }
+
+private:
+  limits m_limits;
+  std::size_t m_connections;
+  std::unordered_map<asio::ip::address, std::size_t, address_hash> m_per_address;
+};
+
+// the remote ip address of an accepted socket, for gate::admit.
+template<class Endpoint>
+bool address_of(Endpoint const&, asio::ip::address&)
+{
+  return false;
+}
+template<class InternetProtocol>
+bool address_of(asio::ip::basic_endpoint<InternetProtocol> const& _endpoint, asio::ip::address& _address)
+{
+  _address = _endpoint.address();
+  return true;
+}
+
+// applies the listen queue settings. listen() on a listening socket only
+// changes its backlog. acceptors that are not sockets have nothing to tune.
+template<class Acceptor>
+void tune(Acceptor&, limits const&)
+{
+}
+template<class Protocol, class Executor>
+void tune(asio::basic_socket_acceptor<Protocol, Executor>& _acceptor, limits const& _limits)
+{
+  error_code ec;
+  _acceptor.listen(_limits.backlog, ec);
+#if defined(__linux__) && defined(TCP_DEFER_ACCEPT)
+  if (std::is_same<Protocol, asio::ip::tcp>::value && _limits.defer_accept > 0)
+  {
+    int seconds = _limits.defer_accept;
+    ::setsockopt(_acceptor.native_handle(), IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds));
+  }
+#endif // __linux__
+}
+
+} // namespace sv::net::admission
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_ADMISSION_HPP__
@@ -0,0 +1,594 @@
+#ifndef __SV_NET_BALANCE_HPP__
+#define __SV_NET_BALANCE_HPP__
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sv/base.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace balance
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// messages
+//
+// struct packets (schema ids 0xB300..0xB3FF). a call carries one request, as
+// packet::serialize wrote it, with a number the reply repeats; a reply with
+// a nonzero status carries no message and counts as a failure.
+////////////////////////////////////////////////////////////////////////////////
+struct call
+{
+  std::uint64_t id;
+  std::string message;
+};
+struct reply
+{
+  std::uint64_t id;
+  std::uint32_t status;
+  std::string message;
+};
+
+} // namespace sv::net::balance
+} // namespace sv::net
+} // namespace sv
+
+SV_NET_SCHEMA(sv::net::balance::call, 0xB300, &sv::net::balance::call::id, &sv::net::balance::call::message)
+SV_NET_SCHEMA(sv::net::balance::reply, 0xB301, &sv::net::balance::reply::id, &sv::net::balance::reply::status,
+              &sv::net::balance::reply::message)
+
+namespace sv
+{
+namespace net
+{
+namespace balance
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+using packet_t = packet::base::ptr;
+
+////////////////////////////////////////////////////////////////////////////////
+// serve
+//
+// the server side, from an ordinary server's on_session: each call is
+// unwrapped and handed to _handler with a function that answers it, from
+// any thread and at any time; answering nullptr reports a failure. other
+// packets are dropped. takes the session's on_receive.
+////////////////////////////////////////////////////////////////////////////////
+using answer_type = std::function<void(packet_t)>;
+using serve_handler = std::function<void(packet_t, answer_type)>;
+
+template<class Session>
+void serve(std::shared_ptr<Session> const& _session, serve_handler _handler)
+{
+  std::weak_ptr<Session> weak = _session;
+  auto id = _session->id();
+  _session->protocol().on_receive([handler = std::move(_handler), weak, id](packet_t packet)
+  {
+    const char* data;
+    std::size_t size;
+    if (!packet::view_of<call>(*packet, data, size))
+    {
+      return;
+    }
+    packet::struct_view<call> view(data, size);
+    auto number = view.get<&call::id>();
+    auto message = view.get<&call::message>();
+    auto answer = [weak, number](packet_t _response)
+    {
+      auto session = weak.lock();
+      if (session == nullptr)
+      {
+        return;
+      }
+      reply r{ number, _response == nullptr ? 1u : 0u, std::string() };
+      if (_response != nullptr)
+      {
+        r.message = packet::serialize(*_response);
+      }
+      session->protocol().send(packet::struct_packet<reply>::make(packet::flat_buffer(r), session->id()));
+    };
+    if (auto inner = packet::deserialize(id, message.data(), message.size()))
+    {
+      handler(std::move(inner), std::move(answer));
+    }
+    else
+    {
+      answer(nullptr);
+    }
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_balancer
+//
+// a client of a pool of servers, one connection to each, that picks the
+// server per request. least_loaded takes two endpoints at random and sends
+// to the one with the lower latency times outstanding requests plus one;
+// the latency is a peak ewma: a slower response raises it at once, faster
+// ones bring it down over latency_window, and so does time without
+// responses, so a server that was slow is tried again.
+//
+// an endpoint whose failure average (timeouts, failed replies, requests
+// lost with the connection) passes failure_threshold is ejected for
+// ejection; after that one request probes it. a good answer puts it back, a
+// failure ejects it for twice as long, up to max_ejection. at most
+// max_ejected of the pool is out at a time.
+////////////////////////////////////////////////////////////////////////////////
+enum class policy
+{
+  least_loaded,
+  // in turn, for comparison; ejection still applies.
+  round_robin,
+};
+
+struct options
+{
+  using duration = std::chrono::steady_clock::duration;
+
+  balance::policy policy = balance::policy::least_loaded;
+  // a request without a reply by then fails with timed_out.
+  duration timeout = std::chrono::seconds(1);
+  // how fast the latency average forgets a slow response.
+  duration latency_window = std::chrono::milliseconds(500);
+  // weight of the newest outcome in the failure average.
+  double failure_weight = 0.2;
+  double failure_threshold = 0.5;
+  // outcomes seen before an endpoint can be ejected.
+  std::uint32_t minimum_requests = 10;
+  // share of the pool that may be ejected at once, rounded down.
+  double max_ejected = 0.5;
+  duration ejection = std::chrono::seconds(1);
+  duration max_ejection = std::chrono::seconds(30);
+  // before connecting to an endpoint again.
+  duration reconnect = std::chrono::milliseconds(100);
+};
+
+struct endpoint_statistics
+{
+  bool connected = false;
+  bool ejected = false;
+  std::uint32_t outstanding = 0;
+  std::chrono::steady_clock::duration latency{};
+  double failure = 0;
+  std::uint64_t requests = 0;
+  std::uint64_t failures = 0;
+  std::uint64_t ejections = 0;
+};
+
+// called once per request, on the endpoint's io thread; on the caller's when
+// no endpoint can take the request (not_connected).
+using response_handler = std::function<void(error_code const&, packet_t)>;
+
+template<class _Session>
+class basic_balancer
+{
+public:
+  using self = basic_balancer<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using client_type = engine::basic_client<engine::basic_connector<session_type>>;
+  using clock_type = std::chrono::steady_clock;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  explicit basic_balancer(options const& _options = options())
+    : m_options(_options)
+    , m_ejected(0)
+    , m_next_id(1)
+    , m_cursor(0)
+  {
+  }
+  basic_balancer(basic_balancer const&) = delete;
+  basic_balancer& operator=(basic_balancer const&) = delete;
+
+  // before add_endpoint.
+  void set_tuning(tuning::options const& _tuning)
+  {
+    m_tuning = _tuning;
+  }
+  // the arguments of client_type::execute; connects at once. add every
+  // endpoint before the first request.
+  template<class...Args>
+  void add_endpoint(Args&&...args)
+  {
+    m_endpoints.push_back(std::make_unique<endpoint>());
+    auto* e = m_endpoints.back().get();
+    e->client->set_tuning(m_tuning);
+    e->client->set_reconnect(m_options.reconnect);
+    e->client->on_session([this, e](typename session_type::ptr const& session) { on_session(*e, session); });
+    e->client->execute(std::forward<Args>(args)...);
+  }
+  // thread-safe.
+  void request(packet_t _request, response_handler _handler)
+  {
+    bool probe = false;
+    auto* e = choose(probe);
+    std::shared_ptr<session_type> session;
+    auto id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+    if (e != nullptr)
+    {
+      std::lock_guard<std::mutex> lock(e->mutex);
+      session = e->session.lock();
+      if (session != nullptr)
+      {
+        e->calls.emplace(id, pending{ std::move(_handler), clock_type::now(), probe });
+        e->outstanding.fetch_add(1, std::memory_order_relaxed);
+      }
+      else if (probe)
+      {
+        // lost its connection since; the probe waits for the next request.
+        e->until = clock_type::now();
+        e->state = ejected;
+      }
+    }
+    if (session == nullptr)
+    {
+      _handler(asio::error::not_connected, nullptr);
+      return;
+    }
+    session->protocol().send(packet::struct_packet<call>::make(
+      packet::flat_buffer(call{ id, packet::serialize(*_request) }), session->id()));
+  }
+  std::vector<endpoint_statistics> stats() const
+  {
+    std::vector<endpoint_statistics> result;
+    auto now = clock_type::now();
+    for (auto const& e : m_endpoints)
+    {
+      std::lock_guard<std::mutex> lock(e->mutex);
+      endpoint_statistics s;
+      s.connected = e->connected.load(std::memory_order_relaxed);
+      s.ejected = e->state.load(std::memory_order_relaxed) != healthy;
+      s.outstanding = e->outstanding.load(std::memory_order_relaxed);
+      s.latency = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(latency(*e, now)));
+      s.failure = e->failure;
+      s.requests = e->requests;
+      s.failures = e->failures;
+      s.ejections = e->ejections;
+      result.push_back(s);
+    }
+    return result;
+  }
+
+private:
+  enum health : int
+  {
+    healthy,
+    ejected,
+    // ejected, with one request out to see if it is back.
+    probing,
+  };
+  struct pending
+  {
+    response_handler handler;
+    clock_type::time_point sent;
+    bool probe;
+  };
+  struct endpoint
+  {
+    endpoint()
+      : connected(false)
+      , outstanding(0)
+      , latency(0)
+      , stamp(0)
+      , state(healthy)
+      , until()
+      , failure(0)
+      , samples(0)
+      , level(0)
+      , requests(0)
+      , failures(0)
+      , ejections(0)
+      , sweeping(false)
+      , client(client_type::make())
+    {
+    }
+
+    // read by choose() without the lock.
+    std::atomic<bool> connected;
+    std::atomic<std::uint32_t> outstanding;
+    // seconds, as of stamp (clock ticks).
+    std::atomic<double> latency;
+    std::atomic<clock_type::rep> stamp;
+    std::atomic<int> state;
+    std::atomic<clock_type::time_point> until;
+
+    mutable std::mutex mutex;
+    std::weak_ptr<session_type> session;
+    std::unordered_map<std::uint64_t, pending> calls;
+    double failure;
+    std::uint32_t samples;
+    // consecutive ejections, for the backoff.
+    unsigned level;
+    std::uint64_t requests;
+    std::uint64_t failures;
+    std::uint64_t ejections;
+    bool sweeping;
+
+    // destroyed first: its io thread is joined before the rest goes.
+    typename client_type::ptr client;
+  };
+
+  // the latency average of _endpoint, decayed to _now.
+  double latency(endpoint const& _endpoint, clock_type::time_point _now) const
+  {
+    auto value = _endpoint.latency.load(std::memory_order_relaxed);
+    auto elapsed = _now.time_since_epoch().count() - _endpoint.stamp.load(std::memory_order_relaxed);
+    if (elapsed <= 0 || value == 0)
+    {
+      return value;
+    }
+    return value * std::exp(-double(elapsed) / double(m_options.latency_window.count()));
+  }
+  endpoint* choose(bool& _probe)
+  {
+    thread_local std::vector<endpoint*> candidates;
+    thread_local std::minstd_rand random(std::random_device{}());
+
+    auto now = clock_type::now();
+    candidates.clear();
+    for (auto const& e : m_endpoints)
+    {
+      if (!e->connected.load(std::memory_order_relaxed))
+      {
+        continue;
+      }
+      int current = e->state.load(std::memory_order_relaxed);
+      if (current == healthy)
+      {
+        candidates.push_back(e.get());
+      }
+      else if (current == ejected && now >= e->until.load(std::memory_order_relaxed) &&
+               e->state.compare_exchange_strong(current, probing))
+      {
+        _probe = true;
+        return e.get();
+      }
+    }
+    if (candidates.empty())
+    {
+      return nullptr;
+    }
+    if (candidates.size() == 1)
+    {
+      return candidates.front();
+    }
+    if (m_options.policy == policy::round_robin)
+    {
+      return candidates[m_cursor.fetch_add(1, std::memory_order_relaxed) % candidates.size()];
+    }
+    auto a = random() % candidates.size();
+    auto b = random() % (candidates.size() - 1);
+    if (b >= a)
+    {
+      ++b;
+    }
+    auto cost = [this, now](endpoint const& e)
+    {
+      return latency(e, now) * (e.outstanding.load(std::memory_order_relaxed) + 1);
+    };
+    return cost(*candidates[a]) <= cost(*candidates[b]) ? candidates[a] : candidates[b];
+  }
+
+  // the rest runs on the endpoint's io thread.
+  void on_session(endpoint& _endpoint, typename session_type::ptr const& _session)
+  {
+    session_type* raw = _session.get();
+    auto id = _session->id();
+    _session->protocol().on_receive([this, &_endpoint, id](packet_t packet) { on_receive(_endpoint, id, *packet); });
+    _session->protocol().on_close([this, &_endpoint, raw](error_code const&) { on_close(_endpoint, raw); });
+    bool sweeping;
+    {
+      std::lock_guard<std::mutex> lock(_endpoint.mutex);
+      _endpoint.session = _session;
+      sweeping = _endpoint.sweeping;
+      _endpoint.sweeping = true;
+    }
+    _endpoint.connected = true;
+    if (!sweeping)
+    {
+      // one timer per endpoint, on the client's io_context, for as long as
+      // it runs.
+      sweep(_endpoint, std::make_shared<asio::steady_timer>(_session->socket().get_executor()));
+    }
+  }
+  void on_close(endpoint& _endpoint, session_type* _raw)
+  {
+    std::unordered_map<std::uint64_t, pending> lost;
+    {
+      std::lock_guard<std::mutex> lock(_endpoint.mutex);
+      auto current = _endpoint.session.lock();
+      if (current != nullptr && current.get() != _raw)
+      {
+        return;
+      }
+      _endpoint.session.reset();
+      _endpoint.connected = false;
+      lost.swap(_endpoint.calls);
+    }
+    auto now = clock_type::now();
+    for (auto& e : lost)
+    {
+      complete(_endpoint, e.second, now, true);
+      e.second.handler(asio::error::connection_aborted, nullptr);
+    }
+  }
+  void on_receive(endpoint& _endpoint, id_type _id, packet::base& _packet)
+  {
+    const char* data;
+    std::size_t size;
+    if (!packet::view_of<reply>(_packet, data, size))
+    {
+      return;
+    }
+    packet::struct_view<reply> view(data, size);
+    pending found;
+    {
+      std::lock_guard<std::mutex> lock(_endpoint.mutex);
+      auto it = _endpoint.calls.find(view.get<&reply::id>());
+      if (it == _endpoint.calls.end())
+      {
+        // timed out already.
+        return;
+      }
+      found = std::move(it->second);
+      _endpoint.calls.erase(it);
+    }
+    bool failed = view.get<&reply::status>() != 0;
+    packet_t response;
+    if (!failed)
+    {
+      auto message = view.get<&reply::message>();
+      response = packet::deserialize(_id, message.data(), message.size());
+      failed = response == nullptr;
+    }
+    complete(_endpoint, found, clock_type::now(), failed);
+    found.handler(failed ? boost::system::errc::make_error_code(boost::system::errc::io_error) : error_code(),
+                  std::move(response));
+  }
+  void sweep(endpoint& _endpoint, std::shared_ptr<asio::steady_timer> _timer)
+  {
+    std::vector<pending> expired;
+    auto now = clock_type::now();
+    {
+      std::lock_guard<std::mutex> lock(_endpoint.mutex);
+      for (auto it = _endpoint.calls.begin(); it != _endpoint.calls.end();)
+      {
+        if (now - it->second.sent >= m_options.timeout)
+        {
+          expired.push_back(std::move(it->second));
+          it = _endpoint.calls.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+    for (auto& e : expired)
+    {
+      complete(_endpoint, e, now, true);
+      e.handler(asio::error::timed_out, nullptr);
+    }
+    _timer->expires_after(std::max<clock_type::duration>(m_options.timeout / 4, std::chrono::milliseconds(1)));
+    _timer->async_wait([this, &_endpoint, _timer](error_code const& ec)
+    {
+      if (!ec)
+      {
+        sweep(_endpoint, _timer);
+      }
+    });
+  }
+  // any thread: folds one outcome into _endpoint's averages and moves it in
+  // or out of the pool.
+  void complete(endpoint& _endpoint, pending const& _pending, clock_type::time_point _now, bool _failed)
+  {
+    _endpoint.outstanding.fetch_sub(1, std::memory_order_relaxed);
+    double sample = std::chrono::duration<double>(_now - _pending.sent).count();
+
+    std::lock_guard<std::mutex> lock(_endpoint.mutex);
+    // a slower response replaces the average; a faster one is weighed by
+    // the time since the last.
+    auto average = _endpoint.latency.load(std::memory_order_relaxed);
+    if (_endpoint.samples == 0 || sample >= average)
+    {
+      average = sample;
+    }
+    else
+    {
+      auto elapsed = _now.time_since_epoch().count() - _endpoint.stamp.load(std::memory_order_relaxed);
+      auto w = std::exp(-double(std::max<clock_type::rep>(elapsed, 0)) / double(m_options.latency_window.count()));
+      average = average * w + sample * (1 - w);
+    }
+    _endpoint.latency.store(average, std::memory_order_relaxed);
+    _endpoint.stamp.store(_now.time_since_epoch().count(), std::memory_order_relaxed);
+    _endpoint.failure += m_options.failure_weight * ((_failed ? 1.0 : 0.0) - _endpoint.failure);
+    ++_endpoint.samples;
+    ++_endpoint.requests;
+    _endpoint.failures += _failed ? 1 : 0;
+
+    if (_pending.probe)
+    {
+      if (_failed)
+      {
+        eject(_endpoint, _now);
+      }
+      else
+      {
+        _endpoint.level = 0;
+        _endpoint.failure = 0;
+        _endpoint.samples = 0;
+        _endpoint.state = healthy;
+        m_ejected.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    else if (_endpoint.state.load(std::memory_order_relaxed) == healthy &&
+             _endpoint.samples >= m_options.minimum_requests && _endpoint.failure > m_options.failure_threshold)
+    {
+      auto limit = static_cast<std::size_t>(m_options.max_ejected * m_endpoints.size());
+      auto count = m_ejected.load(std::memory_order_relaxed);
+      while (count < limit && !m_ejected.compare_exchange_weak(count, count + 1))
+      {
+      }
+      if (count < limit)
+      {
+        eject(_endpoint, _now);
+      }
+    }
+  }
+  // with _endpoint.mutex held and _endpoint counted in m_ejected.
+  void eject(endpoint& _endpoint, clock_type::time_point _now)
+  {
+    auto period = m_options.ejection * (std::int64_t(1) << std::min(_endpoint.level, 20u));
+    _endpoint.until = _now + std::min<clock_type::duration>(period, m_options.max_ejection);
+    _endpoint.state = ejected;
+    ++_endpoint.level;
+    ++_endpoint.ejections;
+  }
+
+private:
+  options m_options;
+  tuning::options m_tuning;
+  std::atomic<std::size_t> m_ejected;
+  std::atomic<std::uint64_t> m_next_id;
+  std::atomic<std::size_t> m_cursor;
+  // last: every endpoint's io thread is joined before the rest goes.
+  std::vector<std::unique_ptr<endpoint>> m_endpoints;
+};
+
+template<class Proto = protocol::basic>
+using basic_tcp_balancer = basic_balancer<engine::basic_session<Proto, transport::tcp>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Proto = protocol::basic>
+using basic_local_balancer = basic_balancer<engine::basic_session<Proto, transport::local>>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+} // namespace sv::net::balance
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_BALANCE_HPP__
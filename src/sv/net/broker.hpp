@@ -0,0 +1,648 @@
+#ifndef __SV_NET_BROKER_HPP__
+#define __SV_NET_BROKER_HPP__
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sv/base.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace broker
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// messages
+//
+// struct packets (schema ids 0xB000..0xB0FF are the broker's). a topic is any
+// string; a subscription ending in '*' is a prefix and matches every topic
+// starting with what comes before it ("prices/*", or "*" for all). a
+// subscriber receives the publish message as it was sent.
+////////////////////////////////////////////////////////////////////////////////
+struct subscribe
+{
+  std::string topic;
+};
+struct unsubscribe
+{
+  std::string topic;
+};
+struct publish
+{
+  std::string topic;
+  std::string payload;
+};
+
+} // namespace sv::net::broker
+} // namespace sv::net
+} // namespace sv
+
+SV_NET_SCHEMA(sv::net::broker::subscribe, 0xB000, &sv::net::broker::subscribe::topic)
+SV_NET_SCHEMA(sv::net::broker::unsubscribe, 0xB001, &sv::net::broker::unsubscribe::topic)
+SV_NET_SCHEMA(sv::net::broker::publish, 0xB002, &sv::net::broker::publish::topic, &sv::net::broker::publish::payload)
+
+namespace sv
+{
+namespace net
+{
+namespace broker
+{
+
+inline packet::base::ptr make_subscribe(std::string const& _topic, id_type const& _session_id = 0)
+{
+  return packet::struct_packet<subscribe>::make(packet::flat_buffer(subscribe{ _topic }), _session_id);
+}
+inline packet::base::ptr make_unsubscribe(std::string const& _topic, id_type const& _session_id = 0)
+{
+  return packet::struct_packet<unsubscribe>::make(packet::flat_buffer(unsubscribe{ _topic }), _session_id);
+}
+inline packet::base::ptr make_publish(std::string const& _topic, std::string const& _payload,
+                                      id_type const& _session_id = 0)
+{
+  return packet::struct_packet<publish>::make(packet::flat_buffer(publish{ _topic, _payload }), _session_id);
+}
+
+// topic and payload of a publish a subscriber received; they point into
+// _packet. false for anything else.
+inline bool read_publish(packet::base& _packet, std::string_view& _topic, std::string_view& _payload)
+{
+  const char* data;
+  std::size_t size;
+  if (!packet::view_of<publish>(_packet, data, size))
+  {
+    return false;
+  }
+  packet::struct_view<publish> view(data, size);
+  _topic = view.get<&publish::topic>();
+  _payload = view.get<&publish::payload>();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// trie
+//
+// subscriptions in a radix trie over the topic bytes: a chain of single
+// children is one node with a longer label, and a subscribed topic always
+// ends on a node. children are kept sorted by their first byte. matching
+// walks the topic once, visiting the prefix subscribers of every node on the
+// way and the exact subscribers of the last; it does not allocate.
+//
+// subscribers are numbers (the broker's slots). not thread-safe.
+////////////////////////////////////////////////////////////////////////////////
+class trie
+{
+public:
+  using subscriber_id = std::uint32_t;
+
+  trie()
+    : m_nodes(1)
+    , m_size(0)
+  {
+  }
+  // false if _subscriber already has it.
+  bool insert(std::string_view _key, bool _prefix, subscriber_id _subscriber)
+  {
+    std::uint32_t n = 0;
+    std::size_t pos = 0;
+    while (pos < _key.size())
+    {
+      auto child = find_child(n, _key[pos]);
+      if (child == sc_none)
+      {
+        auto leaf = allocate(_key.substr(pos));
+        add_child(n, leaf);
+        n = leaf;
+        break;
+      }
+      auto const& label = m_nodes[child].label;
+      std::size_t common = 1;
+      while (common < label.size() && pos + common < _key.size() && label[common] == _key[pos + common])
+      {
+        ++common;
+      }
+      if (common < label.size())
+      {
+        split(child, common);
+      }
+      n = child;
+      pos += common;
+    }
+
+    auto& list = _prefix ? m_nodes[n].prefix : m_nodes[n].exact;
+    if (std::find(list.begin(), list.end(), _subscriber) != list.end())
+    {
+      return false;
+    }
+    list.push_back(_subscriber);
+    ++m_size;
+    return true;
+  }
+  // false if _subscriber did not have it.
+  bool erase(std::string_view _key, bool _prefix, subscriber_id _subscriber)
+  {
+    std::vector<std::uint32_t> path{ 0 };
+    std::size_t pos = 0;
+    while (pos < _key.size())
+    {
+      auto child = find_child(path.back(), _key[pos]);
+      if (child == sc_none || _key.compare(pos, m_nodes[child].label.size(), m_nodes[child].label) != 0)
+      {
+        return false;
+      }
+      pos += m_nodes[child].label.size();
+      path.push_back(child);
+    }
+
+    auto& list = _prefix ? m_nodes[path.back()].prefix : m_nodes[path.back()].exact;
+    auto it = std::find(list.begin(), list.end(), _subscriber);
+    if (it == list.end())
+    {
+      return false;
+    }
+    *it = list.back();
+    list.pop_back();
+    --m_size;
+
+    // drop the nodes left empty, then merge a node left with one child.
+    while (path.size() > 1 && unused(path.back()) && m_nodes[path.back()].children.empty())
+    {
+      auto n = path.back();
+      path.pop_back();
+      auto& children = m_nodes[path.back()].children;
+      children.erase(std::find(children.begin(), children.end(), n));
+      release(n);
+    }
+    auto n = path.back();
+    if (path.size() > 1 && unused(n) && m_nodes[n].children.size() == 1)
+    {
+      auto child = m_nodes[n].children.front();
+      m_nodes[n].label += m_nodes[child].label;
+      m_nodes[n].children = std::move(m_nodes[child].children);
+      m_nodes[n].exact = std::move(m_nodes[child].exact);
+      m_nodes[n].prefix = std::move(m_nodes[child].prefix);
+      release(child);
+    }
+    return true;
+  }
+  // calls _visit(subscriber_id) for every subscription matching _topic; a
+  // subscriber with several matching subscriptions is visited for each.
+  template<class Visitor>
+  void match(std::string_view _topic, Visitor&& _visit) const
+  {
+    std::uint32_t n = 0;
+    std::size_t pos = 0;
+    while (true)
+    {
+      auto const& node = m_nodes[n];
+      for (auto e : node.prefix)
+      {
+        _visit(e);
+      }
+      if (pos == _topic.size())
+      {
+        for (auto e : node.exact)
+        {
+          _visit(e);
+        }
+        return;
+      }
+      n = find_child(n, _topic[pos]);
+      if (n == sc_none || _topic.compare(pos, m_nodes[n].label.size(), m_nodes[n].label) != 0)
+      {
+        return;
+      }
+      pos += m_nodes[n].label.size();
+    }
+  }
+  // subscriptions.
+  std::size_t size() const
+  {
+    return m_size;
+  }
+  std::size_t nodes() const
+  {
+    return m_nodes.size() - m_free.size();
+  }
+
+private:
+  static constexpr std::uint32_t sc_none = 0xFFFFFFFFu;
+
+  struct node
+  {
+    // the bytes leading here from the parent; empty only at the root.
+    std::string label;
+    std::vector<std::uint32_t> children;
+    std::vector<subscriber_id> exact;
+    std::vector<subscriber_id> prefix;
+  };
+
+  bool unused(std::uint32_t _node) const
+  {
+    return m_nodes[_node].exact.empty() && m_nodes[_node].prefix.empty();
+  }
+  std::uint32_t find_child(std::uint32_t _node, char _byte) const
+  {
+    auto const& children = m_nodes[_node].children;
+    auto it = std::lower_bound(children.begin(), children.end(), _byte,
+                               [this](std::uint32_t child, char byte)
+                               {
+                                 return static_cast<unsigned char>(m_nodes[child].label[0]) <
+                                   static_cast<unsigned char>(byte);
+                               });
+    return (it != children.end() && m_nodes[*it].label[0] == _byte) ? *it : sc_none;
+  }
+  void add_child(std::uint32_t _node, std::uint32_t _child)
+  {
+    auto byte = static_cast<unsigned char>(m_nodes[_child].label[0]);
+    auto& children = m_nodes[_node].children;
+    auto it = std::lower_bound(children.begin(), children.end(), byte,
+                               [this](std::uint32_t child, unsigned char b)
+                               {
+                                 return static_cast<unsigned char>(m_nodes[child].label[0]) < b;
+                               });
+    children.insert(it, _child);
+  }
+  // _node keeps the first _at bytes of its label, a new child the rest and
+  // everything below.
+  void split(std::uint32_t _node, std::size_t _at)
+  {
+    // copied first: allocate may move the nodes.
+    auto tail = allocate(m_nodes[_node].label.substr(_at));
+    auto& head = m_nodes[_node];
+    auto& rest = m_nodes[tail];
+    rest.children = std::move(head.children);
+    rest.exact = std::move(head.exact);
+    rest.prefix = std::move(head.prefix);
+    head.label.resize(_at);
+    head.children.assign(1, tail);
+    head.exact.clear();
+    head.prefix.clear();
+  }
+  std::uint32_t allocate(std::string_view _label)
+  {
+    std::uint32_t n;
+    if (!m_free.empty())
+    {
+      n = m_free.back();
+      m_free.pop_back();
+    }
+    else
+    {
+      n = static_cast<std::uint32_t>(m_nodes.size());
+      m_nodes.emplace_back();
+    }
+    m_nodes[n].label.assign(_label.data(), _label.size());
+    return n;
+  }
+  void release(std::uint32_t _node)
+  {
+    m_nodes[_node] = node();
+    m_free.push_back(_node);
+  }
+
+private:
+  std::vector<node> m_nodes;
+  std::vector<std::uint32_t> m_free;
+  std::size_t m_size;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_broker
+//
+// a basic_server whose sessions subscribe and publish. a publish is
+// serialized once into a packet::encoded_packet shared by every subscriber,
+// and matched under a shared lock, so publishers on different io threads
+// (accept_policy::workers) do not wait for each other.
+//
+// each subscriber has a bounded queue: a publish finding it full is dropped
+// for that subscriber only, so a slow reader neither holds up the others nor
+// grows without bound. the broker takes the server's on_session and each
+// session's on_receive.
+////////////////////////////////////////////////////////////////////////////////
+struct options
+{
+  // messages waiting for a subscriber while its previous batch is written.
+  std::size_t queue_limit = 1024;
+};
+
+struct statistics
+{
+  std::uint64_t published = 0;
+  // copies queued to subscribers, and copies dropped on a full queue.
+  std::uint64_t delivered = 0;
+  std::uint64_t dropped = 0;
+};
+
+template<class _Session>
+class basic_broker
+{
+public:
+  using self = basic_broker<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using server_type = engine::basic_server<engine::basic_acceptor<session_type>>;
+  using packet_t = packet::base::ptr;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  explicit basic_broker(options const& _options = options())
+    : m_options(_options)
+    , m_published(0)
+    , m_delivered(0)
+    , m_dropped(0)
+    , m_server(server_type::make())
+  {
+    m_server->on_session(std::bind(&self::on_session, this, std::placeholders::_1));
+  }
+  basic_broker(basic_broker const&) = delete;
+  basic_broker& operator=(basic_broker const&) = delete;
+
+  // set_options, set_limits, set_accept_policy and set_tuning go here,
+  // before execute.
+  server_type& server()
+  {
+    return *m_server;
+  }
+  // the arguments of server_type::execute.
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    m_server->execute(std::forward<Args>(args)...);
+  }
+  std::size_t subscriptions() const
+  {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_trie.size();
+  }
+  statistics stats() const
+  {
+    statistics s;
+    s.published = m_published.load(std::memory_order_relaxed);
+    s.delivered = m_delivered.load(std::memory_order_relaxed);
+    s.dropped = m_dropped.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  ////////////////////////////////////////////////////////////////////////////
+  // subscriber
+  //
+  // the queue is filled from any publisher's thread and emptied on the
+  // session's executor, one batch at a time: the batch goes to the protocol,
+  // and the next one once flush reports it written.
+  ////////////////////////////////////////////////////////////////////////////
+  class subscriber : public std::enable_shared_from_this<subscriber>
+  {
+  public:
+    using ptr = std::shared_ptr<subscriber>;
+
+    subscriber(typename session_type::ptr const& _session, std::size_t _limit)
+      : m_session(_session)
+      , m_executor(_session->socket().get_executor())
+      , m_limit(_limit)
+      , m_scheduled(false)
+      , m_closed(false)
+    {
+    }
+    // any thread. false if the queue is full.
+    bool push(packet_t const& _packet)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed || m_queue.size() >= m_limit)
+        {
+          return false;
+        }
+        m_queue.push_back(_packet);
+        if (m_scheduled)
+        {
+          return true;
+        }
+        m_scheduled = true;
+      }
+      asio::post(m_executor, std::bind(&subscriber::drain, this->shared_from_this()));
+      return true;
+    }
+    // the connection is gone; what is still queued is dropped.
+    void close()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+      m_queue.clear();
+    }
+
+  private:
+    void drain()
+    {
+      auto session = m_session.lock();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (session == nullptr || m_closed || m_queue.empty())
+        {
+          m_queue.clear();
+          m_scheduled = false;
+          return;
+        }
+        m_batch.swap(m_queue);
+      }
+      auto& protocol = session->protocol();
+      for (auto& e : m_batch)
+      {
+        protocol.send(e);
+      }
+      m_batch.clear();
+
+      // posted behind the sends, which protocol::send posts as well.
+      auto holder = this->shared_from_this();
+      asio::post(m_executor, [holder, session]()
+      {
+        session->protocol().flush(std::bind(&subscriber::drain, holder));
+      });
+    }
+
+  private:
+    std::weak_ptr<session_type> m_session;
+    asio::any_io_executor m_executor;
+    std::size_t m_limit;
+
+    std::mutex m_mutex;
+    std::vector<packet_t> m_queue;
+    std::vector<packet_t> m_batch;
+    bool m_scheduled;
+    bool m_closed;
+  };
+
+  // per connection, only touched on its executor.
+  struct session_state
+  {
+    static constexpr std::uint32_t sc_none = 0xFFFFFFFFu;
+
+    id_type id = 0;
+    std::uint32_t slot = sc_none;
+    std::vector<std::string> topics;
+  };
+
+  static bool is_prefix(std::string_view _topic)
+  {
+    return !_topic.empty() && _topic.back() == '*';
+  }
+  static std::string_view key_of(std::string_view _topic)
+  {
+    return is_prefix(_topic) ? _topic.substr(0, _topic.size() - 1) : _topic;
+  }
+
+  void on_session(typename session_type::ptr const& _session)
+  {
+    auto state = std::make_shared<session_state>();
+    state->id = _session->id();
+    std::weak_ptr<session_type> weak = _session;
+    _session->protocol().on_receive([this, state, weak](packet_t packet) { on_receive(weak, *state, *packet); });
+    _session->protocol().on_close([this, state](error_code const&) { on_closed(*state); });
+  }
+  void on_receive(std::weak_ptr<session_type> const& _session, session_state& _state, packet::base& _packet)
+  {
+    const char* data;
+    std::size_t size;
+    if (packet::view_of<publish>(_packet, data, size))
+    {
+      on_publish(_state, _packet, packet::struct_view<publish>(data, size).get<&publish::topic>());
+    }
+    else if (packet::view_of<subscribe>(_packet, data, size))
+    {
+      on_subscribe(_session, _state, packet::struct_view<subscribe>(data, size).get<&subscribe::topic>());
+    }
+    else if (packet::view_of<unsubscribe>(_packet, data, size))
+    {
+      on_unsubscribe(_state, packet::struct_view<unsubscribe>(data, size).get<&unsubscribe::topic>());
+    }
+  }
+  void on_subscribe(std::weak_ptr<session_type> const& _session, session_state& _state, std::string_view _topic)
+  {
+    auto session = _session.lock();
+    if (session == nullptr)
+    {
+      return;
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (_state.slot == session_state::sc_none)
+    {
+      _state.slot = allocate(std::make_shared<subscriber>(session, m_options.queue_limit));
+    }
+    if (m_trie.insert(key_of(_topic), is_prefix(_topic), _state.slot))
+    {
+      _state.topics.emplace_back(_topic);
+    }
+  }
+  void on_unsubscribe(session_state& _state, std::string_view _topic)
+  {
+    auto it = std::find(_state.topics.begin(), _state.topics.end(), _topic);
+    if (it == _state.topics.end())
+    {
+      return;
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_trie.erase(key_of(_topic), is_prefix(_topic), _state.slot);
+    _state.topics.erase(it);
+  }
+  void on_publish(session_state& _state, packet::base& _packet, std::string_view _topic)
+  {
+    auto bytes = std::make_shared<const std::string>(packet::serialize(_packet));
+    auto message = packet::encoded_packet::make(std::move(bytes), _state.id);
+
+    std::uint64_t delivered = 0;
+    std::uint64_t dropped = 0;
+    {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      m_trie.match(_topic, [&](trie::subscriber_id s)
+      {
+        if (m_subscribers[s]->push(message))
+          ++delivered;
+        else
+          ++dropped;
+      });
+    }
+    m_published.fetch_add(1, std::memory_order_relaxed);
+    m_delivered.fetch_add(delivered, std::memory_order_relaxed);
+    m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+  }
+  void on_closed(session_state& _state)
+  {
+    if (_state.slot == session_state::sc_none)
+    {
+      return;
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (auto const& e : _state.topics)
+    {
+      m_trie.erase(key_of(e), is_prefix(e), _state.slot);
+    }
+    _state.topics.clear();
+    m_subscribers[_state.slot]->close();
+    m_subscribers[_state.slot] = nullptr;
+    m_free.push_back(_state.slot);
+    _state.slot = session_state::sc_none;
+  }
+  // under the unique lock.
+  std::uint32_t allocate(typename subscriber::ptr _subscriber)
+  {
+    if (!m_free.empty())
+    {
+      auto slot = m_free.back();
+      m_free.pop_back();
+      m_subscribers[slot] = std::move(_subscriber);
+      return slot;
+    }
+    m_subscribers.push_back(std::move(_subscriber));
+    return static_cast<std::uint32_t>(m_subscribers.size() - 1);
+  }
+
+private:
+  options m_options;
+
+  mutable std::shared_mutex m_mutex;
+  trie m_trie;
+  std::vector<typename subscriber::ptr> m_subscribers;
+  std::vector<std::uint32_t> m_free;
+
+  std::atomic<std::uint64_t> m_published;
+  std::atomic<std::uint64_t> m_delivered;
+  std::atomic<std::uint64_t> m_dropped;
+
+  // declared last: its io threads are joined before the state above goes.
+  typename server_type::ptr m_server;
+};
+
+template<class Proto = protocol::basic>
+using basic_tcp_broker = basic_broker<engine::basic_session<Proto, transport::tcp>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Proto = protocol::basic>
+using basic_local_broker = basic_broker<engine::basic_session<Proto, transport::local>>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+} // namespace sv::net::broker
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_BROKER_HPP__
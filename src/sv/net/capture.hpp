@@ -0,0 +1,415 @@
+#ifndef __SV_NET_CAPTURE_HPP__
+#define __SV_NET_CAPTURE_HPP__
+#pragma once
+
+#if !defined(_WIN32)
+
+// protocol::base and mux_base take a capture::writer.
+#define SV_NET_HAS_CAPTURE
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+
+#include "sv/base.hpp"
+#include "sv/net/packet.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace capture
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// log layout
+//
+//   [ file_header ][ record_header ][ message ][ record_header ][ message ]...
+//
+// a message is the packet as it goes over the wire, packet::header and body.
+// the file grows in sc_grow steps and is cut to its used size on close; a
+// log that was not closed ends at the first record of size 0.
+////////////////////////////////////////////////////////////////////////////////
+enum class direction : std::uint8_t
+{
+  received = 0,
+  sent = 1,
+};
+
+#pragma pack(push, 1)
+struct file_header
+{
+  static const std::uint32_t sc_magic = 0x50435653; // "SVCP"
+  static const std::uint32_t sc_version = 1;
+
+  std::uint32_t magic;
+  std::uint32_t version;
+  // wall clock at open, ns since the epoch.
+  std::uint64_t started;
+};
+
+struct record_header
+{
+  // ns since the log was opened.
+  std::uint64_t time;
+  std::uint64_t session;
+  std::uint32_t size;
+  std::uint8_t direction;
+  std::uint8_t reserved[3];
+};
+#pragma pack(pop)
+
+namespace detail
+{
+
+inline boost::system::system_error last_error(const char* _where)
+{
+  return boost::system::system_error(error_code(errno, asio::error::get_system_category()), _where);
+}
+
+} // namespace sv::net::capture::detail
+
+////////////////////////////////////////////////////////////////////////////////
+// writer
+//
+// append-only, memory-mapped. an append claims its record with an atomic add
+// and copies the bytes straight into the mapping; the file is mapped into one
+// address range reserved up front, so records never move and only growing
+// the file takes the lock.
+////////////////////////////////////////////////////////////////////////////////
+class writer
+{
+public:
+  using self = writer;
+  using ptr = std::shared_ptr<self>;
+
+  static constexpr std::size_t sc_grow = 64 * 1024 * 1024;
+  // address space reserved for the mapping; the log does not grow past it.
+  static constexpr std::size_t sc_max_size = std::size_t(1) << 36;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  // truncates _path. throws boost::system::system_error.
+  explicit writer(std::string const& _path)
+    : m_fd(::open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    , m_data(nullptr)
+    , m_capacity(0)
+    , m_used(sizeof(file_header))
+    , m_dropped(0)
+    , m_appending(0)
+    , m_closed(false)
+    , m_full(false)
+    , m_begin(std::chrono::steady_clock::now())
+  {
+    if (m_fd >= 0)
+    {
+      void* p = ::mmap(nullptr, sc_max_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      m_data = (p == MAP_FAILED) ? nullptr : static_cast<char*>(p);
+    }
+    if (m_data == nullptr || !grow(sc_grow))
+    {
+      auto error = detail::last_error("capture::writer");
+      if (m_data != nullptr)
+      {
+        ::munmap(m_data, sc_max_size);
+      }
+      if (m_fd >= 0)
+      {
+        ::close(m_fd);
+      }
+      throw error;
+    }
+
+    file_header header{};
+    header.magic = file_header::sc_magic;
+    header.version = file_header::sc_version;
+    header.started = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    std::memcpy(m_data, &header, sizeof(header));
+  }
+  writer(writer const&) = delete;
+  writer& operator=(writer const&) = delete;
+  ~writer()
+  {
+    close();
+  }
+  // a message as it went over the wire, thread-safe.
+  void append(direction _direction, id_type _session, const char* _data, std::size_t _size)
+  {
+    append(_direction, _session, { asio::buffer(_data, _size) });
+  }
+  // the same in parts, as it was read: packet::header, extensions, body.
+  void append(direction _direction, id_type _session, std::initializer_list<asio::const_buffer> _parts)
+  {
+    std::size_t size = 0;
+    for (auto const& e : _parts)
+    {
+      size += e.size();
+    }
+    enter guard(*this);
+    char* record = guard ? reserve(size) : nullptr;
+    if (record == nullptr)
+    {
+      ++m_dropped;
+      return;
+    }
+    char* out = record + sizeof(record_header);
+    for (auto const& e : _parts)
+    {
+      if (e.size() != 0)
+      {
+        std::memcpy(out, e.data(), e.size());
+        out += e.size();
+      }
+    }
+    commit(record, _direction, _session, size);
+  }
+  // cuts the file to the records written, once the appends under way are
+  // done. further appends are dropped.
+  void close()
+  {
+    if (m_closed.exchange(true))
+    {
+      return;
+    }
+    while (m_appending.load() != 0)
+    {
+      std::this_thread::yield();
+    }
+
+    std::lock_guard<std::mutex> lock(m_grow_mutex);
+    if (m_data != nullptr)
+    {
+      ::munmap(m_data, sc_max_size);
+      m_data = nullptr;
+    }
+    if (m_fd >= 0)
+    {
+      // if this fails the tail stays zero-filled, which readers take as the end.
+      int result = ::ftruncate(m_fd, static_cast<off_t>(size()));
+      (void)result;
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+  std::size_t size() const
+  {
+    return std::min(m_used.load(), m_capacity.load());
+  }
+  // records lost because the file could not grow, or after close().
+  std::size_t dropped() const
+  {
+    return m_dropped.load();
+  }
+
+private:
+  // counts the appends close() has to wait for.
+  struct enter
+  {
+    explicit enter(writer& _writer)
+      : r_writer(_writer)
+    {
+      ++r_writer.m_appending;
+    }
+    ~enter()
+    {
+      --r_writer.m_appending;
+    }
+    explicit operator bool() const
+    {
+      return !r_writer.m_closed.load();
+    }
+
+    writer& r_writer;
+  };
+
+  // once growing failed, every later record is dropped: the log ends at the
+  // first record that did not fit.
+  char* reserve(std::size_t _size)
+  {
+    auto offset = m_used.fetch_add(sizeof(record_header) + _size);
+    auto need = offset + sizeof(record_header) + _size;
+    if (need > m_capacity.load(std::memory_order_acquire))
+    {
+      std::lock_guard<std::mutex> lock(m_grow_mutex);
+      if (!m_full && need > m_capacity.load() && !grow(need + sc_grow - need % sc_grow))
+      {
+        m_full = true;
+      }
+      if (need > m_capacity.load())
+      {
+        return nullptr;
+      }
+    }
+    return m_data + offset;
+  }
+  void commit(char* _record, direction _direction, id_type _session, std::size_t _size)
+  {
+    record_header header{};
+    header.time = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_begin).count());
+    header.session = _session;
+    header.size = static_cast<std::uint32_t>(_size);
+    header.direction = static_cast<std::uint8_t>(_direction);
+    std::memcpy(_record, &header, sizeof(header));
+  }
+  // maps the new part of the file after the old one; under m_grow_mutex.
+  bool grow(std::size_t _capacity)
+  {
+    auto capacity = m_capacity.load();
+    if (_capacity > sc_max_size || ::ftruncate(m_fd, static_cast<off_t>(_capacity)) != 0)
+    {
+      return false;
+    }
+    void* p = ::mmap(m_data + capacity, _capacity - capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, m_fd,
+                     static_cast<off_t>(capacity));
+    if (p == MAP_FAILED)
+    {
+      return false;
+    }
+    m_capacity.store(_capacity, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::mutex m_grow_mutex;
+  int m_fd;
+  char* m_data;
+  std::atomic<std::size_t> m_capacity;
+  std::atomic<std::size_t> m_used;
+  std::atomic<std::size_t> m_dropped;
+  std::atomic<std::size_t> m_appending;
+  std::atomic<bool> m_closed;
+  bool m_full;
+  std::chrono::steady_clock::time_point m_begin;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// reader
+////////////////////////////////////////////////////////////////////////////////
+class reader
+{
+public:
+  struct entry
+  {
+    std::uint64_t time;
+    id_type session;
+    capture::direction direction;
+    // packet::deserialize takes these as they are.
+    const char* data;
+    std::size_t size;
+  };
+
+  // throws boost::system::system_error, or std::runtime_error if _path is
+  // not a capture log.
+  explicit reader(std::string const& _path)
+    : m_data(nullptr)
+    , m_size(0)
+    , m_offset(sizeof(file_header))
+  {
+    int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      throw detail::last_error("capture::reader");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+      auto error = detail::last_error("capture::reader");
+      ::close(fd);
+      throw error;
+    }
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size >= sizeof(file_header))
+    {
+      void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      m_data = (p == MAP_FAILED) ? nullptr : static_cast<const char*>(p);
+    }
+    ::close(fd);
+
+    if (m_data == nullptr)
+    {
+      throw std::runtime_error("capture::reader: " + _path + " is not a capture log");
+    }
+    std::memcpy(&m_header, m_data, sizeof(m_header));
+    if (m_header.magic != file_header::sc_magic || m_header.version != file_header::sc_version)
+    {
+      ::munmap(const_cast<char*>(m_data), m_size);
+      throw std::runtime_error("capture::reader: " + _path + " is not a capture log");
+    }
+    ::madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL);
+  }
+  reader(reader const&) = delete;
+  reader& operator=(reader const&) = delete;
+  ~reader()
+  {
+    ::munmap(const_cast<char*>(m_data), m_size);
+  }
+  // false at the end of the log.
+  bool next(entry& _entry)
+  {
+    if (m_offset + sizeof(record_header) > m_size)
+    {
+      return false;
+    }
+    record_header header;
+    std::memcpy(&header, m_data + m_offset, sizeof(header));
+    if (header.size < sizeof(packet::header) || m_offset + sizeof(header) + header.size > m_size)
+    {
+      return false;
+    }
+
+    _entry.time = header.time;
+    _entry.session = header.session;
+    _entry.direction = static_cast<capture::direction>(header.direction);
+    _entry.data = m_data + m_offset + sizeof(header);
+    _entry.size = header.size;
+    m_offset += sizeof(header) + header.size;
+    return true;
+  }
+  void rewind()
+  {
+    m_offset = sizeof(file_header);
+  }
+  // wall clock the log was opened at, ns since the epoch.
+  std::uint64_t started() const
+  {
+    return m_header.started;
+  }
+
+private:
+  const char* m_data;
+  std::size_t m_size;
+  std::size_t m_offset;
+  file_header m_header;
+};
+
+} // namespace sv::net::capture
+} // namespace sv::net
+} // namespace sv
+
+#endif // _WIN32
+
+#endif // __SV_NET_CAPTURE_HPP__
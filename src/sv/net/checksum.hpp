@@ -0,0 +1,293 @@
+#ifndef __SV_NET_CHECKSUM_HPP__
+#define __SV_NET_CHECKSUM_HPP__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SV_NET_CHECKSUM_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif // _MSC_VER
+#include <nmmintrin.h>
+#endif // __x86_64__ || _M_X64
+
+namespace sv
+{
+namespace net
+{
+namespace checksum
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// crc32c
+//
+// CRC-32C (Castagnoli, as in iSCSI and ext4). on x86-64 with SSE4.2 the
+// crc32 instruction runs three streams at once to hide its latency, and
+// the three are joined with precomputed shift tables (Mark Adler's method);
+// elsewhere, slicing by 8.
+////////////////////////////////////////////////////////////////////////////////
+namespace detail
+{
+
+// reflected Castagnoli polynomial.
+static constexpr std::uint32_t sc_polynomial = 0x82f63b78;
+// bytes per stream in the three-way loop, for large and for small inputs.
+static constexpr std::size_t sc_long = 8192;
+static constexpr std::size_t sc_short = 256;
+
+inline std::uint32_t gf2_times(std::uint32_t const* _matrix, std::uint32_t _vector)
+{
+  std::uint32_t sum = 0;
+  while (_vector != 0)
+  {
+    if (_vector & 1)
+    {
+      sum ^= *_matrix;
+    }
+    _vector >>= 1;
+    ++_matrix;
+  }
+  return sum;
+}
+inline void gf2_square(std::uint32_t* _square, std::uint32_t const* _matrix)
+{
+  for (int n = 0; n < 32; ++n)
+  {
+    _square[n] = gf2_times(_matrix, _matrix[n]);
+  }
+}
+
+struct tables
+{
+  // slicing by 8.
+  std::uint32_t bytes[8][256];
+  // the crc of a stream followed by sc_long or sc_short zero bytes.
+  std::uint32_t zeros_long[4][256];
+  std::uint32_t zeros_short[4][256];
+
+  tables()
+  {
+    for (std::uint32_t n = 0; n < 256; ++n)
+    {
+      std::uint32_t crc = n;
+      for (int k = 0; k < 8; ++k)
+      {
+        crc = (crc & 1) ? (crc >> 1) ^ sc_polynomial : crc >> 1;
+      }
+      bytes[0][n] = crc;
+    }
+    for (std::uint32_t n = 0; n < 256; ++n)
+    {
+      std::uint32_t crc = bytes[0][n];
+      for (int k = 1; k < 8; ++k)
+      {
+        crc = bytes[0][crc & 0xff] ^ (crc >> 8);
+        bytes[k][n] = crc;
+      }
+    }
+    zeros(zeros_long, sc_long);
+    zeros(zeros_short, sc_short);
+  }
+  // _length is a power of two.
+  static void zeros(std::uint32_t (&_table)[4][256], std::size_t _length)
+  {
+    std::uint32_t even[32];
+    std::uint32_t odd[32];
+    // one zero bit, then two, then four.
+    odd[0] = sc_polynomial;
+    std::uint32_t row = 1;
+    for (int n = 1; n < 32; ++n)
+    {
+      odd[n] = row;
+      row <<= 1;
+    }
+    gf2_square(even, odd);
+    gf2_square(odd, even);
+    // squaring from one zero byte up to _length of them.
+    std::uint32_t* op = odd;
+    do
+    {
+      gf2_square(even, odd);
+      op = even;
+      _length >>= 1;
+      if (_length == 0)
+      {
+        break;
+      }
+      gf2_square(odd, even);
+      op = odd;
+      _length >>= 1;
+    } while (_length != 0);
+
+    for (std::uint32_t n = 0; n < 256; ++n)
+    {
+      _table[0][n] = gf2_times(op, n);
+      _table[1][n] = gf2_times(op, n << 8);
+      _table[2][n] = gf2_times(op, n << 16);
+      _table[3][n] = gf2_times(op, n << 24);
+    }
+  }
+};
+
+inline tables const& get_tables()
+{
+  static const tables instance;
+  return instance;
+}
+
+inline std::uint32_t shift(std::uint32_t const (&_table)[4][256], std::uint32_t _crc)
+{
+  return _table[0][_crc & 0xff] ^ _table[1][(_crc >> 8) & 0xff] ^ _table[2][(_crc >> 16) & 0xff] ^ _table[3][_crc >> 24];
+}
+
+inline std::uint64_t load64(const unsigned char* _p)
+{
+  std::uint64_t value;
+  std::memcpy(&value, _p, sizeof(value));
+  return value;
+}
+
+// _crc is pre-inverted.
+inline std::uint32_t software(std::uint32_t _crc, const unsigned char* _p, std::size_t _size)
+{
+  auto const& t = get_tables().bytes;
+  while (_size != 0 && (reinterpret_cast<std::uintptr_t>(_p) & 7) != 0)
+  {
+    _crc = t[0][(_crc ^ *_p++) & 0xff] ^ (_crc >> 8);
+    --_size;
+  }
+  while (_size >= 8)
+  {
+    // little-endian words, as the table order expects.
+    std::uint64_t word = 0;
+    for (int k = 7; k >= 0; --k)
+    {
+      word = (word << 8) | _p[k];
+    }
+    word ^= _crc;
+    _crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^ t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff]
+           ^ t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^ t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    _p += 8;
+    _size -= 8;
+  }
+  while (_size != 0)
+  {
+    _crc = t[0][(_crc ^ *_p++) & 0xff] ^ (_crc >> 8);
+    --_size;
+  }
+  return _crc;
+}
+
+#if defined(SV_NET_CHECKSUM_X86)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SV_NET_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else // __GNUC__ || __clang__
+#define SV_NET_TARGET_SSE42
+#endif // __GNUC__ || __clang__
+
+inline bool has_sse42()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else // _MSC_VER
+  return __builtin_cpu_supports("sse4.2");
+#endif // _MSC_VER
+}
+
+// three streams of _block bytes each, joined with _zeros; returns the bytes
+// left over.
+SV_NET_TARGET_SSE42 inline std::size_t hardware_blocks(std::uint64_t& _crc, const unsigned char*& _p, std::size_t _size,
+                                                       std::size_t _block, std::uint32_t const (&_zeros)[4][256])
+{
+  while (_size >= 3 * _block)
+  {
+    std::uint64_t crc1 = 0;
+    std::uint64_t crc2 = 0;
+    const unsigned char* end = _p + _block;
+    do
+    {
+      _crc = _mm_crc32_u64(_crc, load64(_p));
+      crc1 = _mm_crc32_u64(crc1, load64(_p + _block));
+      crc2 = _mm_crc32_u64(crc2, load64(_p + 2 * _block));
+      _p += 8;
+    } while (_p < end);
+    _crc = shift(_zeros, static_cast<std::uint32_t>(_crc)) ^ crc1;
+    _crc = shift(_zeros, static_cast<std::uint32_t>(_crc)) ^ crc2;
+    _p += 2 * _block;
+    _size -= 3 * _block;
+  }
+  return _size;
+}
+
+// _crc is pre-inverted.
+SV_NET_TARGET_SSE42 inline std::uint32_t hardware(std::uint32_t _crc, const unsigned char* _p, std::size_t _size)
+{
+  std::uint64_t crc = _crc;
+  while (_size != 0 && (reinterpret_cast<std::uintptr_t>(_p) & 7) != 0)
+  {
+    crc = _mm_crc32_u8(static_cast<std::uint32_t>(crc), *_p++);
+    --_size;
+  }
+  auto const& t = get_tables();
+  _size = hardware_blocks(crc, _p, _size, sc_long, t.zeros_long);
+  _size = hardware_blocks(crc, _p, _size, sc_short, t.zeros_short);
+  while (_size >= 8)
+  {
+    crc = _mm_crc32_u64(crc, load64(_p));
+    _p += 8;
+    _size -= 8;
+  }
+  while (_size != 0)
+  {
+    crc = _mm_crc32_u8(static_cast<std::uint32_t>(crc), *_p++);
+    --_size;
+  }
+  return static_cast<std::uint32_t>(crc);
+}
+
+#undef SV_NET_TARGET_SSE42
+
+#endif // SV_NET_CHECKSUM_X86
+
+} // namespace sv::net::checksum::detail
+
+// the crc32c instruction is used.
+inline bool hardware()
+{
+#if defined(SV_NET_CHECKSUM_X86)
+  static const bool supported = detail::has_sse42();
+  return supported;
+#else // SV_NET_CHECKSUM_X86
+  return false;
+#endif // SV_NET_CHECKSUM_X86
+}
+
+// crc32c(b, crc32c(a)) is the crc of a followed by b.
+inline std::uint32_t crc32c(const void* _data, std::size_t _size, std::uint32_t _crc = 0)
+{
+  auto p = static_cast<const unsigned char*>(_data);
+#if defined(SV_NET_CHECKSUM_X86)
+  if (hardware())
+  {
+    return ~detail::hardware(~_crc, p, _size);
+  }
+#endif // SV_NET_CHECKSUM_X86
+  return ~detail::software(~_crc, p, _size);
+}
+// the portable implementation, whatever the processor.
+inline std::uint32_t crc32c_software(const void* _data, std::size_t _size, std::uint32_t _crc = 0)
+{
+  return ~detail::software(~_crc, static_cast<const unsigned char*>(_data), _size);
+}
+
+} // namespace sv::net::checksum
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_CHECKSUM_HPP__
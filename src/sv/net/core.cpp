@@ -1,12 +1,114 @@
 #include "sv/net/core.hpp"
+#include "sv/net/engine.hpp"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 namespace sv
 {
 namespace net
 {
 
-node::node() {}
+struct node::impl
+{
+  using server_type = engine::basic_tcp_server<protocol::basic>;
+  using client_type = engine::basic_tcp_client<protocol::basic>;
+  using session_type = engine::basic_session<protocol::basic, transport::tcp>;
+
+  void attach(session_type::ptr const& session)
+  {
+    auto id = session->id();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      sessions_[id] = session;
+    }
+
+    session->protocol().on_receive([this, id](packet_ptr packet)
+                                   {
+                                     if (on_receive_)
+                                     {
+                                       on_receive_(id, packet);
+                                     }
+                                   });
+    session->protocol().on_close([this, id](engine::error_code const&)
+                                 {
+                                   {
+                                     std::lock_guard<std::mutex> lock(mutex_);
+                                     sessions_.erase(id);
+                                   }
+                                   if (on_close_)
+                                   {
+                                     on_close_(id);
+                                   }
+                                 });
+    if (on_session_)
+    {
+      on_session_(id);
+    }
+  }
+  std::shared_ptr<session_type> find(id_type id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(id);
+    return (it == sessions_.end()) ? nullptr : it->second.lock();
+  }
+
+  session_handler on_session_;
+  receive_handler on_receive_;
+  close_handler on_close_;
+
+  std::mutex mutex_;
+  std::unordered_map<id_type, std::weak_ptr<session_type>> sessions_;
+
+  // declared last: their io threads are joined before the handlers go away.
+  std::list<std::unique_ptr<server_type>> servers_;
+  std::list<std::unique_ptr<client_type>> clients_;
+};
+
+node::node()
+  : impl_(new impl())
+{}
 node::~node() {}
 
+void node::on_session(session_handler handler)
+{
+  impl_->on_session_ = std::move(handler);
+}
+void node::on_receive(receive_handler handler)
+{
+  impl_->on_receive_ = std::move(handler);
+}
+void node::on_close(close_handler handler)
+{
+  impl_->on_close_ = std::move(handler);
+}
+
+void node::listen(unsigned short port)
+{
+  auto server = std::make_unique<impl::server_type>();
+  server->on_session(std::bind(&impl::attach, impl_.get(), std::placeholders::_1));
+  server->execute(port);
+  impl_->servers_.push_back(std::move(server));
+}
+void node::connect(std::string const& target, unsigned short port)
+{
+  auto client = std::make_unique<impl::client_type>();
+  client->on_session(std::bind(&impl::attach, impl_.get(), std::placeholders::_1));
+  client->execute(target, port);
+  impl_->clients_.push_back(std::move(client));
+}
+
+bool node::send(id_type session, packet_ptr packet)
+{
+  auto s = impl_->find(session);
+  if (s == nullptr)
+  {
+    return false;
+  }
+  s->protocol().send(std::move(packet));
+  return true;
+}
+
 } // namespace sv::net
-} // namespace sv
\ No newline at end of file
+} // namespace sv
@@ -3,43 +3,63 @@
 #pragma once
 
 #include "sv/net/define.hpp"
+#include "sv/base.hpp"
 
-#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 
 namespace sv
 {
-
-using id_type = std::uint64_t;
-
-template<class T>
-struct id_holder
-{
-  id_type id() const noexcept { return id_; }
-protected:
-  id_holder()
-    : id_(s_id_++)
-  {}
-
-private:
-  id_type id_;
-  static id_type s_id_;
-};
-template<class T>
-id_type id_holder<T>::s_id_ = 0ULL;
-
 namespace net
 {
+namespace packet
+{
+struct base;
+} // namespace sv::net::packet
 
+////////////////////////////////////////////////////////////////////////////////
+// node
+//
+// compiled facade over the engine templates: tcp servers and clients
+// speaking protocol::basic, with sessions addressed by id. everything else
+// lives behind impl in core.cpp, so the class layout stays the same while the
+// engine changes.
+////////////////////////////////////////////////////////////////////////////////
 class SV_NET_API node : public id_holder<node>
 {
-protected:
-  node();
-
 public:
+  using packet_ptr = std::shared_ptr<packet::base>;
+  using session_handler = std::function<void(id_type)>;
+  using receive_handler = std::function<void(id_type, packet_ptr)>;
+  using close_handler = std::function<void(id_type)>;
+
+  node();
   virtual ~node();
+
+  node(node const&) = delete;
+  node& operator=(node const&) = delete;
+
+  // set before listen/connect. all run on the io thread of the session;
+  // once on_close has run, send to its id returns false.
+  void on_session(session_handler handler);
+  void on_receive(receive_handler handler);
+  void on_close(close_handler handler);
+
+  // tcp server on [port].
+  void listen(unsigned short port);
+  // tcp client to [target] [port].
+  void connect(std::string const& target, unsigned short port);
+
+  // thread-safe. false when no session has the id.
+  bool send(id_type session, packet_ptr packet);
+
+private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
 };
 
 } // namespace sv::net
 } // namespace sv
 
-#endif // __SV_NET_CORE_HPP__
\ No newline at end of file
+#endif // __SV_NET_CORE_HPP__
@@ -1,13 +1,25 @@
 #ifndef __SV_NET_DEFINE_HPP__
 #define __SV_NET_DEFINE_HPP__
 
+// SV_NET_STATIC: linking the static library, nothing to export or import.
+// SV_NET_HEADER_ONLY: using the headers without the library at all.
+// SV_NET_EXPORTS: building the shared library.
 #ifndef SV_NET_API
+#if defined(SV_NET_STATIC) || defined(SV_NET_HEADER_ONLY)
+#define SV_NET_API
+#elif defined(_WIN32)
 #ifdef SV_NET_EXPORTS
 #define SV_NET_API __declspec(dllexport)
 #else // SV_NET_EXPORTS
 #define SV_NET_API __declspec(dllimport)
+#ifdef _MSC_VER
 #pragma comment(lib, "sv.net.lib")
+#endif // _MSC_VER
 #endif // SV_NET_EXPORTS
+#else // _WIN32
+// built with -fvisibility=hidden, only SV_NET_API symbols are exported.
+#define SV_NET_API __attribute__((visibility("default")))
+#endif // SV_NET_STATIC
 #endif // SV_NET_API
 
-#endif // __SV_NET_DEFINE_HPP__
\ No newline at end of file
+#endif // __SV_NET_DEFINE_HPP__
@@ -0,0 +1,453 @@
+#ifndef __SV_NET_DURABLE_HPP__
+#define __SV_NET_DURABLE_HPP__
+#pragma once
+
+#include "sv/net/wal.hpp"
+
+#if defined(SV_NET_HAS_WAL)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "sv/base.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace durable
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// messages
+//
+// struct packets (schema ids 0xB100..0xB1FF). an envelope carries one logged
+// message, as packet::serialize wrote it, with the queue it came from and its
+// number there; an ack confirms every message of the queue up to seq.
+////////////////////////////////////////////////////////////////////////////////
+struct envelope
+{
+  std::uint64_t queue;
+  std::uint64_t seq;
+  std::string message;
+};
+struct ack
+{
+  std::uint64_t queue;
+  std::uint64_t seq;
+};
+
+} // namespace sv::net::durable
+} // namespace sv::net
+} // namespace sv
+
+SV_NET_SCHEMA(sv::net::durable::envelope, 0xB100, &sv::net::durable::envelope::queue,
+              &sv::net::durable::envelope::seq, &sv::net::durable::envelope::message)
+SV_NET_SCHEMA(sv::net::durable::ack, 0xB101, &sv::net::durable::ack::queue, &sv::net::durable::ack::seq)
+
+namespace sv
+{
+namespace net
+{
+namespace durable
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+namespace detail
+{
+
+// the queue's name, kept in _directory so it survives restarts: the
+// receiver tells queues apart by it.
+inline std::uint64_t queue_id(std::string const& _directory)
+{
+  auto path = _directory + "/queue";
+  std::uint64_t id = 0;
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    throw wal::detail::last_error("durable::queue_id");
+  }
+  if (::pread(fd, &id, sizeof(id), 0) != sizeof(id) || id == 0)
+  {
+    std::random_device random;
+    while (id == 0)
+    {
+      id = (static_cast<std::uint64_t>(random()) << 32) | random();
+    }
+    if (::pwrite(fd, &id, sizeof(id), 0) != sizeof(id) || ::fsync(fd) != 0)
+    {
+      auto error = wal::detail::last_error("durable::queue_id");
+      ::close(fd);
+      throw error;
+    }
+  }
+  ::close(fd);
+  return id;
+}
+
+} // namespace sv::net::durable::detail
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_sender
+//
+// a basic_client with a durable outbound queue: push() writes the message to
+// a wal::log in the sender's directory and returns; a committer thread syncs
+// whatever came in meanwhile with one fdatasync, and only synced messages
+// are sent. the client reconnects on its own; each new connection starts
+// again after the last acknowledged message, and acknowledged messages are
+// truncated from the log. a sender restarted on the same directory picks up
+// where the last one stopped.
+//
+// delivery is at least once; a receiver drops what it has already seen. the
+// sender takes the client's on_session and each session's on_receive.
+////////////////////////////////////////////////////////////////////////////////
+struct options
+{
+  wal::options log;
+  // messages sent and not acknowledged yet; sending waits beyond this.
+  std::uint64_t window = 4096;
+  // before connecting again.
+  std::chrono::steady_clock::duration reconnect = std::chrono::milliseconds(100);
+};
+
+struct statistics
+{
+  // the numbers of the newest message pushed, on disk and acknowledged.
+  std::uint64_t pushed = 0;
+  std::uint64_t durable = 0;
+  std::uint64_t acknowledged = 0;
+};
+
+template<class _Session>
+class basic_sender
+{
+public:
+  using self = basic_sender<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using client_type = engine::basic_client<engine::basic_connector<session_type>>;
+  using packet_t = packet::base::ptr;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  // throws boost::system::system_error if _directory cannot be used.
+  explicit basic_sender(std::string const& _directory, options const& _options = options())
+    : m_options(_options)
+    , m_log(_directory, _options.log)
+    , m_queue(detail::queue_id(_directory))
+    , m_acked(m_log.first() - 1)
+    , m_next(0)
+    , m_current(nullptr)
+    , m_pump_scheduled(false)
+    , m_stopping(false)
+    , m_client(client_type::make())
+  {
+    m_client->set_reconnect(_options.reconnect);
+    m_client->on_session(std::bind(&self::on_session, this, std::placeholders::_1));
+    m_committer = std::thread(&self::commit_loop, this);
+  }
+  basic_sender(basic_sender const&) = delete;
+  basic_sender& operator=(basic_sender const&) = delete;
+  ~basic_sender()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_commit_mutex);
+      m_stopping = true;
+    }
+    m_commit_cv.notify_one();
+    m_committer.join();
+  }
+
+  // set_options and set_tuning go here, before execute.
+  client_type& client()
+  {
+    return *m_client;
+  }
+  // the arguments of client_type::execute.
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    m_client->execute(std::forward<Args>(args)...);
+  }
+  // thread-safe. returns the message's number in the queue; it is on disk
+  // once stats().durable reaches it, or when commit() returns.
+  std::uint64_t push(packet::base& _packet)
+  {
+    auto size = static_cast<std::size_t>(_packet.get_header().length);
+    auto seq = m_log.append(size, [&_packet, size](char* out) { packet::serialize(_packet, out, size); });
+    {
+      // taken so the committer cannot miss the wake-up between its check
+      // and its wait.
+      std::lock_guard<std::mutex> lock(m_commit_mutex);
+    }
+    m_commit_cv.notify_one();
+    return seq;
+  }
+  // returns once everything pushed so far is on disk.
+  void commit()
+  {
+    m_log.sync();
+  }
+  statistics stats() const
+  {
+    statistics s;
+    s.pushed = m_log.last();
+    s.durable = m_log.synced();
+    s.acknowledged = m_acked.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  // group commit: each sync covers every push that arrived during the last.
+  void commit_loop()
+  {
+    std::unique_lock<std::mutex> lock(m_commit_mutex);
+    while (true)
+    {
+      m_commit_cv.wait(lock, [this]() { return m_stopping || m_log.last() > m_log.synced(); });
+      if (m_stopping)
+      {
+        return;
+      }
+      lock.unlock();
+      try
+      {
+        m_log.sync();
+      }
+      catch (boost::system::system_error const& e)
+      {
+        std::cerr << "durable::commit: " << e.what() << '\n';
+        std::this_thread::sleep_for(m_options.reconnect);
+      }
+      schedule_pump();
+      lock.lock();
+    }
+  }
+  void schedule_pump()
+  {
+    std::shared_ptr<session_type> session;
+    {
+      std::lock_guard<std::mutex> lock(m_session_mutex);
+      session = m_session.lock();
+    }
+    if (session == nullptr || m_pump_scheduled.exchange(true))
+    {
+      return;
+    }
+    asio::post(session->socket().get_executor(), [this, session]()
+    {
+      m_pump_scheduled = false;
+      pump(*session);
+    });
+  }
+
+  // the rest runs on the client's io thread.
+  void on_session(typename session_type::ptr const& _session)
+  {
+    m_current = _session.get();
+    m_next = m_acked.load(std::memory_order_relaxed) + 1;
+
+    session_type* raw = _session.get();
+    _session->protocol().on_receive([this, raw](packet_t packet) { on_receive(*raw, *packet); });
+    _session->protocol().on_close([this, raw](error_code const&)
+    {
+      if (m_current == raw)
+      {
+        m_current = nullptr;
+      }
+    });
+    {
+      std::lock_guard<std::mutex> lock(m_session_mutex);
+      m_session = _session;
+    }
+    pump(*_session);
+  }
+  void on_receive(session_type& _session, packet::base& _packet)
+  {
+    const char* data;
+    std::size_t size;
+    if (!packet::view_of<ack>(_packet, data, size))
+    {
+      return;
+    }
+    packet::struct_view<ack> view(data, size);
+    auto seq = view.get<&ack::seq>();
+    if (view.get<&ack::queue>() != m_queue || seq <= m_acked.load(std::memory_order_relaxed) || seq >= m_next)
+    {
+      return;
+    }
+    m_acked.store(seq, std::memory_order_relaxed);
+    m_log.truncate(seq);
+    // the window moved.
+    pump(_session);
+  }
+  void pump(session_type& _session)
+  {
+    if (&_session != m_current)
+    {
+      return;
+    }
+    auto upto = std::min(m_log.synced(), m_acked.load(std::memory_order_relaxed) + m_options.window);
+    auto& protocol = _session.protocol();
+    auto id = _session.id();
+    m_next = m_log.read(m_next, upto, [this, &protocol, id](std::uint64_t seq, const char* data, std::size_t size)
+    {
+      protocol.send(packet::struct_packet<envelope>::make(packet::flat_buffer(envelope{ m_queue, seq, std::string(data, size) }),
+                                                          id));
+      return true;
+    });
+  }
+
+private:
+  options m_options;
+  wal::log m_log;
+  std::uint64_t m_queue;
+  std::atomic<std::uint64_t> m_acked;
+  // io thread only.
+  std::uint64_t m_next;
+  session_type* m_current;
+
+  std::mutex m_session_mutex;
+  std::weak_ptr<session_type> m_session;
+  std::atomic<bool> m_pump_scheduled;
+
+  std::mutex m_commit_mutex;
+  std::condition_variable m_commit_cv;
+  bool m_stopping;
+  std::thread m_committer;
+
+  // destroyed first: its io thread is joined before the rest goes.
+  typename client_type::ptr m_client;
+};
+
+template<class Proto = protocol::basic>
+using basic_tcp_sender = basic_sender<engine::basic_session<Proto, transport::tcp>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Proto = protocol::basic>
+using basic_local_sender = basic_sender<engine::basic_session<Proto, transport::local>>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+////////////////////////////////////////////////////////////////////////////////
+// receiver
+//
+// the other end, attached to sessions of an ordinary server: an envelope is
+// unwrapped and its message handed on once, however often it arrives; any
+// other packet is handed on as it is. acks are cumulative and go out once
+// per batch of reads, not per message.
+////////////////////////////////////////////////////////////////////////////////
+class receiver
+{
+public:
+  using packet_t = packet::base::ptr;
+  using handler_type = std::function<void(packet_t)>;
+
+  explicit receiver(handler_type _handler)
+    : m_handler(std::move(_handler))
+  {
+  }
+  receiver(receiver const&) = delete;
+  receiver& operator=(receiver const&) = delete;
+
+  // from the server's on_session. takes the session's on_receive; _handler
+  // is called on the session's executor.
+  template<class Session>
+  void attach(std::shared_ptr<Session> const& _session)
+  {
+    auto state = std::make_shared<ack_state>();
+    std::weak_ptr<Session> weak = _session;
+    auto executor = _session->socket().get_executor();
+    auto id = _session->id();
+    _session->protocol().on_receive([this, state, weak, executor, id](packet_t packet)
+    {
+      const char* data;
+      std::size_t size;
+      if (!packet::view_of<envelope>(*packet, data, size))
+      {
+        m_handler(std::move(packet));
+        return;
+      }
+      packet::struct_view<envelope> view(data, size);
+      auto queue = view.get<&envelope::queue>();
+      auto seq = view.get<&envelope::seq>();
+      if (accept(queue, seq))
+      {
+        auto message = view.get<&envelope::message>();
+        if (auto inner = packet::deserialize(id, message.data(), message.size()))
+        {
+          m_handler(std::move(inner));
+        }
+      }
+      state->queue = queue;
+      state->seq = seq;
+      if (state->pending)
+      {
+        return;
+      }
+      state->pending = true;
+      asio::post(executor, [state, weak]()
+      {
+        state->pending = false;
+        if (auto session = weak.lock())
+        {
+          session->protocol().send(
+            packet::struct_packet<ack>::make(packet::flat_buffer(ack{ state->queue, state->seq }), session->id()));
+        }
+      });
+    });
+  }
+
+private:
+  struct ack_state
+  {
+    std::uint64_t queue = 0;
+    std::uint64_t seq = 0;
+    bool pending = false;
+  };
+
+  // false for a message of _queue seen before.
+  bool accept(std::uint64_t _queue, std::uint64_t _seq)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& last = m_delivered[_queue];
+    if (_seq <= last)
+    {
+      return false;
+    }
+    last = _seq;
+    return true;
+  }
+
+private:
+  handler_type m_handler;
+  std::mutex m_mutex;
+  std::unordered_map<std::uint64_t, std::uint64_t> m_delivered;
+};
+
+} // namespace sv::net::durable
+} // namespace sv::net
+} // namespace sv
+
+#endif // SV_NET_HAS_WAL
+
+#endif // __SV_NET_DURABLE_HPP__
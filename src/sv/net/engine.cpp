@@ -0,0 +1,6 @@
+// the one translation unit that defines the instantiations declared extern
+// at the end of engine.hpp.
+#define SV_NET_ENGINE_INSTANTIATION
+#include "sv/net/engine.hpp"
+
+SV_NET_ENGINE_INSTANTIATE_ALL()
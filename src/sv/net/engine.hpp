@@ -0,0 +1,1425 @@
+#ifndef __SV_NET_ENGINE_HPP__
+#define __SV_NET_ENGINE_HPP__
+#pragma once
+
+#include <iostream>
+#include <functional>
+#include <future>
+#include <type_traits>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <thread>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include "sv/base.hpp"
+#include "sv/net/admission.hpp"
+#include "sv/net/define.hpp"
+#include "sv/net/handoff.hpp"
+#include "sv/net/protocol.hpp"
+#include "sv/net/transport.hpp"
+#include "sv/net/tuning.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace engine
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+using namespace std::placeholders;
+using namespace std::literals::chrono_literals;
+
+////////////////////////////////////////////////////////////////////////////////
+// accept_policy
+////////////////////////////////////////////////////////////////////////////////
+struct accept_policy
+{
+  // async_accepts kept outstanding at once.
+  std::size_t pending = 1;
+  // linux tcp/local: on each readiness event accept4 until the backlog is
+  // empty, instead of one connection per completion. pending is then unused.
+  bool drain = false;
+  // io_contexts, one thread each, the accepted sessions run on round-robin.
+  // 0 keeps them on the acceptor's.
+  std::size_t workers = 0;
+  // print every accepted session.
+  bool trace = false;
+  // udp: a peer not heard from for this long loses its session and its
+  // place under admission::limits. zero keeps it as long as the acceptor.
+  std::chrono::steady_clock::duration idle = std::chrono::seconds(60);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// half_close
+//
+// ends the sending side once the queued data is out, so the peer reads the
+// rest and then end of stream; its close then ends the session. transports
+// without a half close are closed.
+////////////////////////////////////////////////////////////////////////////////
+template<class Socket, class = void>
+struct has_lowest_layer : std::false_type {};
+template<class Socket>
+struct has_lowest_layer<Socket, std::void_t<decltype(std::declval<Socket&>().lowest_layer())>> : std::true_type {};
+
+template<class Socket>
+void half_close(Socket& _socket)
+{
+  if constexpr (has_lowest_layer<Socket>::value)
+  {
+    error_code ec;
+    _socket.lowest_layer().shutdown(asio::socket_base::shutdown_send, ec);
+  }
+  else
+  {
+    _socket.close();
+  }
+}
+
+// closes at once; pending operations complete with operation_aborted.
+template<class Socket>
+void close_socket(Socket& _socket)
+{
+  if constexpr (has_lowest_layer<Socket>::value)
+  {
+    error_code ec;
+    _socket.lowest_layer().close(ec);
+  }
+  else
+  {
+    _socket.close();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// io_pool
+////////////////////////////////////////////////////////////////////////////////
+class io_pool
+{
+public:
+  // thread i is pinned to tuning::options::cpus index _first + i.
+  explicit io_pool(std::size_t _size, std::vector<int> const& _cpus = std::vector<int>(), std::size_t _first = 1)
+    : m_next(0)
+  {
+    for (std::size_t i = 0; i < _size; ++i)
+    {
+      m_contexts.push_back(std::make_unique<asio::io_context>(1));
+      m_guards.push_back(asio::make_work_guard(*m_contexts.back()));
+    }
+    for (std::size_t i = 0; i < m_contexts.size(); ++i)
+    {
+      auto* ioc = m_contexts[i].get();
+      m_threads.emplace_back([ioc, _cpus, index = _first + i]()
+                             {
+                               tuning::pin(_cpus, index);
+                               ioc->run();
+                             });
+    }
+  }
+  io_pool(io_pool const&) = delete;
+  io_pool& operator=(io_pool const&) = delete;
+  ~io_pool()
+  {
+    stop();
+  }
+  // not thread-safe; only the acceptor hands out contexts.
+  asio::io_context& next()
+  {
+    return *m_contexts[m_next++ % m_contexts.size()];
+  }
+  // abandons queued handlers, so sessions can be destroyed from any thread.
+  void stop()
+  {
+    m_guards.clear();
+    for (auto& e : m_contexts)
+    {
+      e->stop();
+    }
+    for (auto& e : m_threads)
+    {
+      if (e.joinable())
+        e.join();
+    }
+  }
+
+private:
+  std::vector<std::unique_ptr<asio::io_context>> m_contexts;
+  std::vector<asio::executor_work_guard<asio::io_context::executor_type>> m_guards;
+  std::vector<std::thread> m_threads;
+  std::size_t m_next;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_server
+////////////////////////////////////////////////////////////////////////////////
+template<class _Acceptor>
+struct basic_server
+{
+  using self = basic_server<_Acceptor>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = typename _Acceptor::transport_type;
+  using options_type = typename transport_type::options_type;
+  using session_handler = typename _Acceptor::session_handler;
+  using endpoint_type = typename _Acceptor::endpoint_type;
+  using duration = std::chrono::steady_clock::duration;
+
+  // how long shutdown() and hand_off() wait for the sessions to flush.
+  static constexpr duration sc_drain_deadline = 5s;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  basic_server()
+    : m_ioc()
+    , m_work_guard(m_ioc.get_executor())
+    , m_worker([&]() { m_ioc.run(); })
+    , m_acceptor(nullptr)
+  {
+  }
+  virtual ~basic_server()
+  {
+    // stopped first: the handlers still queued for the sessions must not run
+    // once the acceptor has destroyed them.
+    if (m_workers != nullptr)
+      m_workers->stop();
+
+    m_work_guard.reset();
+    m_ioc.stop();
+
+    if (m_worker.joinable())
+      m_worker.join();
+
+    m_acceptor = nullptr;
+  }
+  // called for every accepted session before it starts reading.
+  void on_session(session_handler _handler)
+  {
+    m_on_session = std::move(_handler);
+  }
+  // applied by the next execute().
+  void set_options(options_type const& _options)
+  {
+    m_options = _options;
+  }
+  // applied by the next execute().
+  void set_limits(admission::limits const& _limits)
+  {
+    m_limits = _limits;
+  }
+  // applied by the next execute(); the worker pool is created once.
+  void set_accept_policy(accept_policy const& _policy)
+  {
+    m_policy = _policy;
+  }
+  // applied by the next execute(), to the listener, every accepted socket
+  // and the io threads.
+  void set_tuning(tuning::options const& _tuning)
+  {
+    m_tuning = _tuning;
+  }
+  // arguments are those of transport_type::make_endpoint:
+  // tcp/tls [port], local [path], inproc [name].
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    start_threads();
+    m_acceptor = _Acceptor::make(m_ioc, transport_type::make_endpoint(std::forward<Args>(args)...), m_on_session, m_options,
+                                 m_limits, m_policy, m_tuning, m_workers.get());
+    m_acceptor->execute();
+  }
+  // after execute(): the endpoint listened on, with tcp port 0 the port the
+  // system picked.
+  endpoint_type local_endpoint() const
+  {
+    if (m_acceptor == nullptr)
+    {
+      throw std::logic_error("basic_server::local_endpoint: not listening");
+    }
+    return m_acceptor->local_endpoint();
+  }
+  // graceful stop: no new connections, and every session is closed once
+  // what it has queued is written. sessions still writing at _deadline are
+  // cut off. true if all of them flushed in time. blocks; not to be called
+  // from a session handler.
+  bool shutdown(duration _deadline = sc_drain_deadline)
+  {
+    if (m_acceptor == nullptr)
+    {
+      return true;
+    }
+    std::promise<bool> flushed;
+    auto acceptor = m_acceptor;
+    asio::post(m_ioc, [&flushed, acceptor, _deadline]()
+    {
+      acceptor->drain(_deadline, [&flushed](bool _flushed) { flushed.set_value(_flushed); });
+    });
+    return flushed.get_future().get();
+  }
+#if !defined(_WIN32)
+  // hot restart, stream transports: passes the listening socket to the
+  // successor waiting in take_over(_path), then shuts down like shutdown().
+  // throws if the successor cannot be reached; the server then keeps
+  // accepting.
+  bool hand_off(std::string const& _path, duration _deadline = sc_drain_deadline)
+  {
+    if (m_acceptor == nullptr)
+    {
+      throw std::logic_error("basic_server::hand_off: not listening");
+    }
+    std::promise<handoff::native_handle_type> listener;
+    auto acceptor = m_acceptor;
+    asio::post(m_ioc, [&listener, acceptor]()
+    {
+      acceptor->stop_accepting();
+      listener.set_value(acceptor->native_listener());
+    });
+    auto handle = listener.get_future().get();
+    try
+    {
+      handoff::send(_path, handle);
+    }
+    catch (...)
+    {
+      asio::post(m_ioc, [acceptor]() { acceptor->execute(); });
+      throw;
+    }
+    return shutdown(_deadline);
+  }
+  // the successor's execute(): blocks until the running server hands its
+  // listening socket over on _path, then accepts on it.
+  void take_over(std::string const& _path)
+  {
+    auto handle = handoff::receive(_path);
+    start_threads();
+    m_acceptor = _Acceptor::make(m_ioc, transport_type::adopt(m_ioc, handle, m_options), m_on_session, m_options,
+                                 m_limits, m_policy, m_tuning, m_workers.get());
+    m_acceptor->execute();
+  }
+#endif // _WIN32
+
+private:
+  void start_threads()
+  {
+    if (!m_tuning.cpus.empty())
+    {
+      asio::post(m_ioc, [cpus = m_tuning.cpus]() { tuning::pin(cpus, 0); });
+    }
+    if (m_policy.workers > 0 && m_workers == nullptr)
+    {
+      m_workers = std::make_unique<io_pool>(m_policy.workers, m_tuning.cpus);
+    }
+  }
+
+private:
+  asio::io_context m_ioc;
+  asio::executor_work_guard<asio::io_context::executor_type> m_work_guard;
+  std::thread m_worker;
+
+  session_handler m_on_session;
+  options_type m_options;
+  admission::limits m_limits;
+  accept_policy m_policy;
+  tuning::options m_tuning;
+  std::unique_ptr<io_pool> m_workers;
+  typename _Acceptor::ptr m_acceptor;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_acceptor
+//
+// sessions over the admission::limits are closed right after the accept; the
+// others release their slot when their protocol reports the close. with an
+// io_pool, sessions are created on (and run on) the pool's io_contexts while
+// accepts, admission and the session depot stay on the acceptor's.
+// stop_accepting, native_listener and drain run on the acceptor's
+// io_context.
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+struct basic_acceptor : public std::enable_shared_from_this<basic_acceptor<_Session>>
+{
+  using self = basic_acceptor<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = typename _Session::transport_type;
+  using endpoint_type = typename transport_type::endpoint_type;
+  using options_type = typename transport_type::options_type;
+  using session_handler = std::function<void(typename _Session::ptr const&)>;
+  using depot_type = std::list<typename _Session::ptr>;
+  using acceptor_type = typename transport_type::acceptor_type;
+  using drain_handler = std::function<void(bool)>;
+
+  // pause before accepting again after a failure such as running out of fds.
+  static constexpr auto sc_retry_delay = 100ms;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+
+  basic_acceptor(asio::io_context& _ioc, endpoint_type const& _endpoint,
+                 session_handler _on_session = nullptr, options_type const& _options = options_type(),
+                 admission::limits const& _limits = admission::limits(),
+                 accept_policy const& _policy = accept_policy(),
+                 tuning::options const& _tuning = tuning::options(), io_pool* _workers = nullptr)
+    : basic_acceptor(_ioc, transport_type::listen(_ioc, _endpoint, _options), std::move(_on_session), _options,
+                     _limits, _policy, _tuning, _workers)
+  {
+  }
+  // accepts on a listener opened elsewhere (transport_type::adopt).
+  basic_acceptor(asio::io_context& _ioc, acceptor_type&& _listener,
+                 session_handler _on_session = nullptr, options_type const& _options = options_type(),
+                 admission::limits const& _limits = admission::limits(),
+                 accept_policy const& _policy = accept_policy(),
+                 tuning::options const& _tuning = tuning::options(), io_pool* _workers = nullptr)
+    : r_ioc(_ioc)
+    , m_acceptor(std::move(_listener))
+    , m_accepting(false)
+    , m_retry_timer(_ioc)
+    , m_failed(0)
+    , m_drain_timer(_ioc)
+    , m_on_session(std::move(_on_session))
+    , m_options(_options)
+    , m_gate(_limits)
+    , m_throttle(_limits.messages, _limits.bytes)
+    , m_policy(_policy)
+    , m_tuning(_tuning)
+    , r_workers(_workers)
+  {
+    using admission::tune;
+    tune(m_acceptor, _limits);
+    using tuning::apply;
+    apply(m_acceptor, m_tuning);
+  }
+  virtual ~basic_acceptor()
+  {
+    if (m_acceptor.is_open())
+    {
+      m_acceptor.close();
+    }
+
+    for (auto* depot : { &m_accept_depot, &m_session_depot })
+    {
+      for (auto& e : *depot)
+      {
+        if (e->socket().is_open())
+        {
+          e->socket().close();
+        }
+      }
+      depot->clear();
+    }
+  }
+  void execute()
+  {
+    m_accepting = true;
+    if (m_policy.drain && can_drain())
+    {
+      do_wait();
+      return;
+    }
+    for (std::size_t i = 0; i < std::max<std::size_t>(m_policy.pending, 1); ++i)
+    {
+      do_accept();
+    }
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_acceptor.local_endpoint();
+  }
+  // open sessions.
+  std::size_t connections() const
+  {
+    return m_gate.connections();
+  }
+  // async_accepts outstanding; on the acceptor's io_context.
+  std::size_t outstanding() const
+  {
+    return m_accept_depot.size();
+  }
+  // the listener stays open; execute() resumes.
+  void stop_accepting()
+  {
+    m_accepting = false;
+    error_code ec;
+    listener().cancel(ec);
+    m_retry_timer.cancel();
+  }
+  auto native_listener()
+  {
+    return listener().native_handle();
+  }
+  // stops accepting for good, then half-closes every session once its
+  // queued packets are written. sessions still writing at _deadline are
+  // closed. _done(true) if all flushed in time.
+  void drain(std::chrono::steady_clock::duration _deadline, drain_handler _done)
+  {
+    stop_accepting();
+    if (m_acceptor.is_open())
+    {
+      m_acceptor.close();
+    }
+    m_on_drained = std::move(_done);
+
+    for (auto& e : m_session_depot)
+    {
+      flush(e);
+    }
+    if (m_unflushed.empty())
+    {
+      on_drained(true);
+      return;
+    }
+    m_drain_timer.expires_after(_deadline);
+    m_drain_timer.async_wait([this](error_code const& ec)
+                             {
+                               if (!ec)
+                                 on_drain_deadline();
+                             });
+  }
+
+private:
+  // half-closes the session once it has written what it has queued.
+  void flush(typename _Session::ptr const& _session)
+  {
+    m_unflushed.insert(_session.get());
+    std::weak_ptr<self> weak = this->shared_from_this();
+    auto* ioc = &r_ioc;
+    // posted, so it is queued behind the packets already sent.
+    asio::post(_session->socket().get_executor(), [weak, ioc, session = _session]()
+    {
+      // the protocol runs the handler, so the session is still alive.
+      auto* s = session.get();
+      s->protocol().flush([weak, ioc, s]()
+      {
+        half_close(s->socket());
+        asio::post(*ioc, [weak, s]()
+        {
+          if (auto acceptor = weak.lock())
+          {
+            acceptor->on_flushed(s);
+          }
+        });
+      });
+    });
+  }
+  decltype(auto) listener()
+  {
+    if constexpr (has_lowest_layer<acceptor_type>::value)
+      return m_acceptor.lowest_layer();
+    else
+      return (m_acceptor);
+  }
+  // also called for sessions that close before they flush.
+  void on_flushed(_Session* _session)
+  {
+    if (m_unflushed.erase(_session) != 0 && m_unflushed.empty())
+    {
+      m_drain_timer.cancel();
+      on_drained(true);
+    }
+  }
+  void on_drain_deadline()
+  {
+    for (auto& e : m_session_depot)
+    {
+      asio::post(e->socket().get_executor(), [session = e]() { session->socket().close(); });
+    }
+    on_drained(false);
+  }
+  void on_drained(bool _flushed)
+  {
+    m_unflushed.clear();
+    auto handler = std::move(m_on_drained);
+    m_on_drained = nullptr;
+    if (handler)
+    {
+      handler(_flushed);
+    }
+  }
+
+  // sessions wait in m_accept_depot until admit moves them over; iterators
+  // stay valid across the splice.
+  typename depot_type::iterator make_session()
+  {
+    auto& ioc = (r_workers != nullptr) ? r_workers->next() : r_ioc;
+    return m_accept_depot.insert(m_accept_depot.end(), _Session::make(ioc));
+  }
+  void do_accept()
+  {
+    auto it = make_session();
+    m_acceptor.async_accept((*it)->socket(),
+                            std::bind(&self::on_accepted, this, _1, it));
+  }
+  void on_accepted(error_code const& ec, typename depot_type::iterator it)
+  {
+    if (!!ec)
+    {
+      m_accept_depot.erase(it);
+      on_accept_error(ec, &self::do_accept);
+      return;
+    }
+
+    if (m_accepting)
+    {
+      do_accept();
+    }
+    admit(it);
+  }
+  // every failed slot waits for the one timer and is resumed when it fires;
+  // rearming the timer per failure would cancel the earlier waits.
+  void on_accept_error(error_code const& ec, void (self::*_resume)())
+  {
+    if (ec == asio::error::operation_aborted)
+    {
+      return;
+    }
+    on_error(ec, "accept");
+    if (m_failed++ != 0)
+    {
+      return;
+    }
+    m_retry_timer.expires_after(sc_retry_delay);
+    m_retry_timer.async_wait([this, _resume](error_code const& ec)
+                             {
+                               auto failed = std::exchange(m_failed, 0);
+                               if (!!ec || !m_accepting)
+                                 return;
+                               for (std::size_t i = 0; i < failed; ++i)
+                                 (this->*_resume)();
+                             });
+  }
+
+  static constexpr bool can_drain()
+  {
+#if defined(__linux__)
+    return is_socket<typename transport_type::socket_type>::value;
+#else // __linux__
+    return false;
+#endif // __linux__
+  }
+  template<class T>
+  struct is_socket : std::false_type {};
+  template<class P, class E>
+  struct is_socket<asio::basic_stream_socket<P, E>> : std::true_type {};
+
+  void do_wait()
+  {
+    if constexpr (can_drain())
+    {
+      m_acceptor.non_blocking(true);
+      m_acceptor.async_wait(asio::socket_base::wait_read,
+                            std::bind(&self::on_readable, this, _1));
+    }
+  }
+  // one readiness event takes the whole backlog.
+  void on_readable(error_code const& ec)
+  {
+    if (!!ec)
+    {
+      on_accept_error(ec, &self::do_wait);
+      return;
+    }
+
+#if defined(__linux__)
+    if constexpr (can_drain())
+    {
+      auto protocol = m_acceptor.local_endpoint().protocol();
+      for (;;)
+      {
+        int fd = ::accept4(m_acceptor.native_handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+          if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+          on_accept_error(error_code(errno, asio::error::get_system_category()), &self::do_wait);
+          return;
+        }
+
+        auto it = make_session();
+        error_code assign_ec;
+        (*it)->socket().assign(protocol, fd, assign_ec);
+        if (!!assign_ec)
+        {
+          ::close(fd);
+          m_accept_depot.erase(it);
+          continue;
+        }
+        admit(it);
+      }
+    }
+#endif // __linux__
+    if (m_accepting)
+    {
+      do_wait();
+    }
+  }
+
+  void admit(typename depot_type::iterator it)
+  {
+    m_session_depot.splice(m_session_depot.end(), m_accept_depot, it);
+    auto session = *it;
+
+    error_code remote_ec;
+    endpoint_type remote;
+    try
+    {
+      remote = session->socket().remote_endpoint();
+    }
+    catch (boost::system::system_error const& e)
+    {
+      remote_ec = e.code();
+    }
+    asio::ip::address address;
+    bool has_address = !remote_ec && admission::address_of(remote, address);
+    if (!!remote_ec || !m_gate.admit(has_address ? &address : nullptr))
+    {
+      session->socket().close();
+      release(it);
+      return;
+    }
+    using tuning::apply;
+    apply(session->socket(), m_tuning);
+
+    if (m_policy.trace)
+    {
+      std::stringstream ss;
+      ss << "accepted from " << remote << "\n";
+      std::cout << ss.str() << std::flush;
+    }
+
+    // the protocol is still running when it reports the close, so the
+    // session is dropped on the next turn.
+    std::weak_ptr<self> weak = this->shared_from_this();
+    auto* ioc = &r_ioc;
+    session->protocol().on_close([weak, ioc, it, has_address, address](error_code const&)
+    {
+      asio::post(*ioc, [weak, it, has_address, address]()
+      {
+        if (auto acceptor = weak.lock())
+        {
+          acceptor->on_closed(it, has_address ? &address : nullptr);
+        }
+      });
+    });
+    if (m_throttle.enabled())
+    {
+      session->protocol().set_throttle(m_throttle);
+    }
+
+    if (m_on_session)
+    {
+      m_on_session(session);
+    }
+    asio::dispatch(session->socket().get_executor(), [session]() { session->execute(); });
+
+    // accepted just before drain() stopped accepting.
+    if (m_on_drained)
+    {
+      flush(session);
+    }
+  }
+  void on_closed(typename depot_type::iterator it, asio::ip::address const* address)
+  {
+    m_gate.release(address);
+    release(it);
+  }
+  // the socket is closed on the session's own io_context; the operations
+  // still pending there complete aborted and let go of the session last.
+  void release(typename depot_type::iterator it)
+  {
+    if (!m_unflushed.empty())
+    {
+      on_flushed(it->get());
+    }
+    auto session = std::move(*it);
+    m_session_depot.erase(it);
+    auto ex = session->socket().get_executor();
+    asio::post(ex, [session = std::move(session)]() { close_socket(session->socket()); });
+  }
+  void on_error(error_code const& ec, const char* where)
+  {
+    std::stringstream ss;
+    ss << where << "::error[" << ec.value() << "]: " << ec.message() << '\n';
+    std::cerr << ss.str() << std::flush;
+  }
+
+private:
+  asio::io_context& r_ioc;
+
+  acceptor_type m_acceptor;
+  bool m_accepting;
+  asio::steady_timer m_retry_timer;
+  // accept slots waiting for m_retry_timer.
+  std::size_t m_failed;
+  depot_type m_accept_depot;
+  depot_type m_session_depot;
+
+  asio::steady_timer m_drain_timer;
+  std::unordered_set<_Session*> m_unflushed;
+  drain_handler m_on_drained;
+
+  session_handler m_on_session;
+  options_type m_options;
+  admission::gate m_gate;
+  admission::throttle m_throttle;
+  accept_policy m_policy;
+  tuning::options m_tuning;
+  io_pool* r_workers;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_client
+////////////////////////////////////////////////////////////////////////////////
+template<class _Connector>
+struct basic_client
+{
+  using self = basic_client<_Connector>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = typename _Connector::transport_type;
+  using options_type = typename transport_type::options_type;
+  using session_handler = typename _Connector::session_handler;
+  using duration = std::chrono::steady_clock::duration;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+public:
+  basic_client()
+    : m_ioc()
+    , m_work_guard(m_ioc.get_executor())
+    , m_worker([&]() { m_ioc.run(); })
+    , m_reconnect(duration::zero())
+    , m_connector(nullptr)
+  {
+  }
+  virtual ~basic_client()
+  {
+    // see ~basic_server.
+    m_work_guard.reset();
+    m_ioc.stop();
+
+    if (m_worker.joinable())
+      m_worker.join();
+
+    m_connector = nullptr;
+  }
+  // called for the connected session before it starts reading.
+  void on_session(session_handler _handler)
+  {
+    m_on_session = std::move(_handler);
+  }
+  // applied by the next execute().
+  void set_options(options_type const& _options)
+  {
+    m_options = _options;
+  }
+  // applied by the next execute(), to the connected socket and the io thread.
+  void set_tuning(tuning::options const& _tuning)
+  {
+    m_tuning = _tuning;
+  }
+  // applied by the next execute(): a failed connect is retried, and a closed
+  // session replaced by a new connection, after _delay. zero (the default)
+  // connects once. on_session is called for every connection.
+  void set_reconnect(duration _delay)
+  {
+    m_reconnect = _delay;
+  }
+  // arguments are those of transport_type::make_endpoint:
+  // tcp/tls [target] [port], local [path], inproc [name].
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    if (!m_tuning.cpus.empty())
+    {
+      asio::post(m_ioc, [cpus = m_tuning.cpus]() { tuning::pin(cpus, 0); });
+    }
+    m_connector = _Connector::make(m_ioc, transport_type::make_endpoint(std::forward<Args>(args)...), m_on_session, m_options,
+                                   m_tuning, m_reconnect);
+
+    m_connector->execute();
+  }
+
+private:
+  asio::io_context m_ioc;
+  asio::executor_work_guard<asio::io_context::executor_type> m_work_guard;
+  std::thread m_worker;
+
+  session_handler m_on_session;
+  options_type m_options;
+  tuning::options m_tuning;
+  duration m_reconnect;
+  typename _Connector::ptr m_connector;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_connector
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+struct basic_connector
+{
+  using self = basic_connector<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = typename _Session::transport_type;
+  using endpoint_type = typename transport_type::endpoint_type;
+  using options_type = typename transport_type::options_type;
+  using session_handler = std::function<void(typename _Session::ptr const&)>;
+  using duration = std::chrono::steady_clock::duration;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+public:
+  basic_connector(asio::io_context& _ioc, endpoint_type const& _endpoint,
+                  session_handler _on_session = nullptr, options_type const& _options = options_type(),
+                  tuning::options const& _tuning = tuning::options(), duration _reconnect = duration::zero())
+    : r_ioc(_ioc)
+    , m_endpoint(_endpoint)
+    , m_session(nullptr)
+    , m_retry_timer(_ioc)
+    , m_on_session(std::move(_on_session))
+    , m_options(_options)
+    , m_tuning(_tuning)
+    , m_reconnect(_reconnect)
+  {
+  }
+  virtual ~basic_connector()
+  {
+    // the pending operations hold the session. inproc and shm park them
+    // outside the io_context, so they are aborted while it is still there.
+    if (m_session != nullptr)
+    {
+      close_socket(m_session->socket());
+    }
+  }
+  void execute()
+  {
+    do_connect();
+  }
+private:
+  void do_connect()
+  {
+    // a session closed for a reconnect lives on in its aborted handlers.
+    m_session = _Session::make(r_ioc);
+
+    std::stringstream ss;
+    ss << "try to connect to [" << m_endpoint << "]\n";
+    std::cout << ss.str() << std::flush;
+
+    using tuning::prepare;
+    prepare(m_session->socket(), m_endpoint, m_tuning);
+    transport_type::connect(m_session->socket(), m_endpoint, m_options,
+                            std::bind(&self::on_connected, this, _1, m_session));
+  }
+  void on_connected(error_code const& ec, typename _Session::ptr session)
+  {
+    if (!!ec)
+    {
+      on_error(ec, "connect");
+      retry();
+      return;
+    }
+
+    std::stringstream ss;
+    ss << "connected to " << session->socket().remote_endpoint() << '(' << session->socket().local_endpoint() << ")\n";
+    std::cout << ss.str();
+
+    using tuning::apply;
+    apply(session->socket(), m_tuning);
+
+    if (m_reconnect > duration::zero())
+    {
+      auto* raw = session.get();
+      session->protocol().on_close([this, raw](error_code const&)
+      {
+        // writes still pending fail now rather than on the next session's turn.
+        close_socket(raw->socket());
+        asio::post(r_ioc, [this]() { retry(); });
+      });
+    }
+    if (m_on_session)
+    {
+      m_on_session(session);
+    }
+    session->execute();
+  }
+  void retry()
+  {
+    if (m_reconnect <= duration::zero())
+    {
+      return;
+    }
+    m_retry_timer.expires_after(m_reconnect);
+    m_retry_timer.async_wait([this](error_code const& ec)
+    {
+      if (!ec)
+      {
+        do_connect();
+      }
+    });
+  }
+  void on_error(error_code const& ec, const char* where)
+  {
+    std::stringstream ss;
+    ss << where << "::error[" << ec.value() << "]: " << ec.message() << '\n';
+    std::cerr << ss.str() << std::flush;
+  }
+
+private:
+  asio::io_context& r_ioc;
+
+  endpoint_type m_endpoint;
+  typename _Session::ptr m_session;
+  asio::steady_timer m_retry_timer;
+
+  session_handler m_on_session;
+  options_type m_options;
+  tuning::options m_tuning;
+  duration m_reconnect;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_session
+////////////////////////////////////////////////////////////////////////////////
+template<class _Protocol, class _Transport = transport::tcp>
+struct basic_session : public id_holder<basic_session<_Protocol, _Transport>>
+{
+  using base = id_holder<basic_session<_Protocol, _Transport>>;
+  using self = basic_session<_Protocol, _Transport>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = _Transport;
+  using socket_type = typename transport_type::socket_type;
+  using protocol_type = typename _Protocol::template rebind<socket_type>;
+
+  // the protocol's owner is set here, before another thread can send on it.
+  template<class...Args>
+  static basic_session::ptr make(Args&&...args)
+  {
+    auto session = std::make_shared<self>(std::forward<Args>(args)...);
+    session->m_protocol->set_owner(session);
+    return session;
+  }
+public:
+  basic_session(asio::io_context& _ioc)
+    : m_socket(_ioc)
+    , m_protocol(protocol_type::make(m_socket, base::id()))
+  {
+  }
+  virtual ~basic_session()
+  {
+    if (m_socket.is_open())
+    {
+      m_socket.close();
+    }
+
+    m_protocol = nullptr;
+  }
+  socket_type& socket()
+  {
+    return m_socket;
+  }
+  const socket_type& socket() const
+  {
+    return m_socket;
+  }
+  protocol_type& protocol()
+  {
+    return *m_protocol;
+  }
+  void execute()
+  {
+    do_read();
+    do_write();
+  }
+private:
+  void do_read()
+  {
+    m_protocol->read();
+  }
+  void do_write()
+  {
+    m_protocol->write();
+  }
+private:
+  socket_type m_socket;
+  typename protocol_type::ptr m_protocol;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_datagram_acceptor
+//
+// one bound udp socket shared by all peers. a peer becomes a session on its
+// first datagram; every later datagram from that endpoint is delivered to it,
+// until it has been silent for accept_policy::idle. the sessions share the
+// socket, so the rest of accept_policy and tuning do not apply.
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+struct basic_datagram_acceptor
+{
+  using self = basic_datagram_acceptor<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = typename _Session::transport_type;
+  using endpoint_type = typename transport_type::endpoint_type;
+  using options_type = typename transport_type::options_type;
+  using session_handler = std::function<void(typename _Session::ptr const&)>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+
+  basic_datagram_acceptor(asio::io_context& _ioc, endpoint_type const& _endpoint,
+                          session_handler _on_session = nullptr, options_type const& _options = options_type(),
+                          admission::limits const& _limits = admission::limits(),
+                          accept_policy const& _policy = accept_policy(),
+                          tuning::options const& = tuning::options(), io_pool* = nullptr)
+    : m_socket(_ioc, _options)
+    , m_sweep_timer(_ioc)
+    , m_on_session(std::move(_on_session))
+    , m_gate(_limits)
+    , m_policy(_policy)
+  {
+    m_socket.bind(_endpoint);
+  }
+  virtual ~basic_datagram_acceptor()
+  {
+    m_socket.close();
+    m_session_depot.clear();
+  }
+  void execute()
+  {
+    m_socket.start(std::bind(&self::on_datagram, this, _1, _2, _3));
+    do_sweep();
+  }
+  // nothing is queued per session; see basic_acceptor::drain.
+  void drain(std::chrono::steady_clock::duration, std::function<void(bool)> _done)
+  {
+    m_socket.close();
+    m_sweep_timer.cancel();
+    _done(true);
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_socket.local_endpoint();
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+  struct entry
+  {
+    typename _Session::ptr session;
+    clock::time_point heard;
+  };
+
+  void on_datagram(endpoint_type const& from, const char* data, std::size_t size)
+  {
+    auto it = m_session_depot.find(from);
+    if (it == m_session_depot.end())
+    {
+      // there is no connection to refuse: a peer over the limits is ignored
+      // until a session expires.
+      auto address = from.address();
+      if (!m_gate.admit(&address))
+      {
+        return;
+      }
+      auto session = _Session::make(m_socket, from);
+
+      if (m_policy.trace)
+      {
+        std::stringstream ss;
+        ss << "accepted from " << from << "\n";
+        std::cout << ss.str() << std::flush;
+      }
+
+      if (m_on_session)
+      {
+        m_on_session(session);
+      }
+      it = m_session_depot.emplace(from, entry{ session, clock::now() }).first;
+    }
+    else
+    {
+      it->second.heard = clock::now();
+    }
+    it->second.session->deliver(data, size);
+  }
+  // every idle / 2, drops the sessions silent for idle or longer.
+  void do_sweep()
+  {
+    if (m_policy.idle <= clock::duration::zero())
+    {
+      return;
+    }
+    m_sweep_timer.expires_after(m_policy.idle / 2);
+    m_sweep_timer.async_wait([this](error_code const& ec)
+    {
+      if (!!ec)
+      {
+        return;
+      }
+      auto expired = clock::now() - m_policy.idle;
+      for (auto it = m_session_depot.begin(); it != m_session_depot.end();)
+      {
+        if (it->second.heard > expired)
+        {
+          ++it;
+          continue;
+        }
+        auto address = it->first.address();
+        m_gate.release(&address);
+        it = m_session_depot.erase(it);
+      }
+      do_sweep();
+    });
+  }
+
+private:
+  typename transport_type::socket_type m_socket;
+  std::unordered_map<endpoint_type, entry, datagram::endpoint_hash> m_session_depot;
+  asio::steady_timer m_sweep_timer;
+
+  session_handler m_on_session;
+  admission::gate m_gate;
+  accept_policy m_policy;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_datagram_connector
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+struct basic_datagram_connector
+{
+  using self = basic_datagram_connector<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = typename _Session::transport_type;
+  using endpoint_type = typename transport_type::endpoint_type;
+  using options_type = typename transport_type::options_type;
+  using session_handler = std::function<void(typename _Session::ptr const&)>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+
+  basic_datagram_connector(asio::io_context& _ioc, endpoint_type const& _endpoint,
+                           session_handler _on_session = nullptr, options_type const& _options = options_type(),
+                           tuning::options const& = tuning::options(),
+                           std::chrono::steady_clock::duration = std::chrono::steady_clock::duration::zero())
+    : m_socket(_ioc, _options)
+    , m_endpoint(_endpoint)
+    , m_session(nullptr)
+    , m_on_session(std::move(_on_session))
+  {
+  }
+  virtual ~basic_datagram_connector()
+  {
+    m_socket.close();
+  }
+  void execute()
+  {
+    // a udp connect only fixes the peer address; it completes immediately.
+    error_code ec;
+    m_socket.connect(m_endpoint, ec);
+    if (!!ec)
+    {
+      on_error(ec, "connect");
+      return;
+    }
+
+    m_session = _Session::make(m_socket, m_endpoint);
+
+    std::stringstream ss;
+    ss << "connected to " << m_endpoint << '(' << m_socket.local_endpoint() << ")\n";
+    std::cout << ss.str();
+
+    if (m_on_session)
+    {
+      m_on_session(m_session);
+    }
+    m_socket.start(std::bind(&self::on_datagram, this, _1, _2, _3));
+  }
+
+private:
+  void on_datagram(endpoint_type const&, const char* data, std::size_t size)
+  {
+    m_session->deliver(data, size);
+  }
+  void on_error(error_code const& ec, const char* where)
+  {
+    std::stringstream ss;
+    ss << where << "::error[" << ec.value() << "]: " << ec.message() << '\n';
+    std::cerr << ss.str() << std::flush;
+  }
+
+private:
+  typename transport_type::socket_type m_socket;
+  endpoint_type m_endpoint;
+  typename _Session::ptr m_session;
+
+  session_handler m_on_session;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_datagram_session
+////////////////////////////////////////////////////////////////////////////////
+template<class _Protocol>
+struct basic_datagram_session : public id_holder<basic_datagram_session<_Protocol>>
+{
+  using base = id_holder<basic_datagram_session<_Protocol>>;
+  using self = basic_datagram_session<_Protocol>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = transport::udp;
+  using socket_type = typename transport_type::socket_type;
+  using endpoint_type = typename transport_type::endpoint_type;
+  using protocol_type = _Protocol;
+
+  template<class...Args>
+  static basic_datagram_session::ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+public:
+  basic_datagram_session(socket_type& _socket, endpoint_type const& _peer)
+    : m_protocol(protocol_type::make(_socket, _peer, base::id()))
+  {
+  }
+  virtual ~basic_datagram_session()
+  {
+    m_protocol = nullptr;
+  }
+  protocol_type& protocol()
+  {
+    return *m_protocol;
+  }
+  endpoint_type const& remote_endpoint() const
+  {
+    return m_protocol->remote_endpoint();
+  }
+  void deliver(const char* data, std::size_t size)
+  {
+    m_protocol->deliver(data, size);
+  }
+private:
+  typename protocol_type::ptr m_protocol;
+};
+
+template<class Proto>
+using basic_tcp_server = basic_server<basic_acceptor<basic_session<Proto, transport::tcp>>>;
+template<class Proto>
+using basic_tcp_client = basic_client<basic_connector<basic_session<Proto, transport::tcp>>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Proto>
+using basic_local_server = basic_server<basic_acceptor<basic_session<Proto, transport::local>>>;
+template<class Proto>
+using basic_local_client = basic_client<basic_connector<basic_session<Proto, transport::local>>>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+template<class Proto>
+using basic_inproc_server = basic_server<basic_acceptor<basic_session<Proto, transport::inproc>>>;
+template<class Proto>
+using basic_inproc_client = basic_client<basic_connector<basic_session<Proto, transport::inproc>>>;
+
+template<class Proto>
+using basic_udp_server = basic_server<basic_datagram_acceptor<basic_datagram_session<Proto>>>;
+template<class Proto>
+using basic_udp_client = basic_client<basic_datagram_connector<basic_datagram_session<Proto>>>;
+
+#if defined(SV_NET_HAS_TLS)
+template<class Proto>
+using basic_tls_server = basic_server<basic_acceptor<basic_session<Proto, transport::tls>>>;
+template<class Proto>
+using basic_tls_client = basic_client<basic_connector<basic_session<Proto, transport::tls>>>;
+#endif // SV_NET_HAS_TLS
+
+#if defined(__linux__)
+template<class Proto>
+using basic_shm_server = basic_server<basic_acceptor<basic_session<Proto, transport::shm>>>;
+template<class Proto>
+using basic_shm_client = basic_client<basic_connector<basic_session<Proto, transport::shm>>>;
+#endif // __linux__
+
+} // namespace sv::net::engine
+} // namespace sv::net
+} // namespace sv
+
+////////////////////////////////////////////////////////////////////////////////
+// explicit instantiations
+//
+// the stream stacks of protocol::basic and protocol::mux_basic are compiled
+// into sv.net (engine.cpp), so consumers link them instead of instantiating
+// asio and the templates in every translation unit. define
+// SV_NET_HEADER_ONLY to use the headers without the library.
+////////////////////////////////////////////////////////////////////////////////
+#define SV_NET_ENGINE_SESSION(_Protocol, _Transport) \
+  sv::net::engine::basic_session<sv::net::protocol::_Protocol<sv::net::packet::base>, sv::net::transport::_Transport>
+
+#define SV_NET_ENGINE_INSTANTIATE(_Prefix, _Protocol, _Transport)                                         \
+  _Prefix template struct SV_NET_API                                                                      \
+    sv::net::protocol::_Protocol<sv::net::packet::base, sv::net::transport::_Transport::socket_type>;     \
+  _Prefix template struct SV_NET_API SV_NET_ENGINE_SESSION(_Protocol, _Transport);                        \
+  _Prefix template struct SV_NET_API sv::net::engine::basic_acceptor<SV_NET_ENGINE_SESSION(_Protocol, _Transport)>;  \
+  _Prefix template struct SV_NET_API sv::net::engine::basic_connector<SV_NET_ENGINE_SESSION(_Protocol, _Transport)>; \
+  _Prefix template struct SV_NET_API                                                                      \
+    sv::net::engine::basic_server<sv::net::engine::basic_acceptor<SV_NET_ENGINE_SESSION(_Protocol, _Transport)>>;   \
+  _Prefix template struct SV_NET_API                                                                      \
+    sv::net::engine::basic_client<sv::net::engine::basic_connector<SV_NET_ENGINE_SESSION(_Protocol, _Transport)>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#define SV_NET_ENGINE_INSTANTIATE_LOCAL(_Prefix)      \
+  SV_NET_ENGINE_INSTANTIATE(_Prefix, base, local)     \
+  SV_NET_ENGINE_INSTANTIATE(_Prefix, mux_base, local)
+#else // BOOST_ASIO_HAS_LOCAL_SOCKETS
+#define SV_NET_ENGINE_INSTANTIATE_LOCAL(_Prefix)
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+#if defined(SV_NET_HAS_TLS)
+#define SV_NET_ENGINE_INSTANTIATE_TLS(_Prefix)        \
+  SV_NET_ENGINE_INSTANTIATE(_Prefix, base, tls)       \
+  SV_NET_ENGINE_INSTANTIATE(_Prefix, mux_base, tls)
+#else // SV_NET_HAS_TLS
+#define SV_NET_ENGINE_INSTANTIATE_TLS(_Prefix)
+#endif // SV_NET_HAS_TLS
+
+#define SV_NET_ENGINE_INSTANTIATE_ALL(_Prefix)        \
+  SV_NET_ENGINE_INSTANTIATE(_Prefix, base, tcp)       \
+  SV_NET_ENGINE_INSTANTIATE(_Prefix, mux_base, tcp)   \
+  SV_NET_ENGINE_INSTANTIATE_LOCAL(_Prefix)            \
+  SV_NET_ENGINE_INSTANTIATE_TLS(_Prefix)
+
+#if !defined(SV_NET_HEADER_ONLY) && !defined(SV_NET_ENGINE_INSTANTIATION)
+SV_NET_ENGINE_INSTANTIATE_ALL(extern)
+#endif // SV_NET_HEADER_ONLY
+
+#endif // __SV_NET_ENGINE_HPP__
\ No newline at end of file
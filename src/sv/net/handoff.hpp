@@ -0,0 +1,144 @@
+#ifndef __SV_NET_HANDOFF_HPP__
+#define __SV_NET_HANDOFF_HPP__
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace sv
+{
+namespace net
+{
+namespace handoff
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// handoff
+//
+// hot restart: the running process passes its listening socket to the one
+// replacing it over a unix socket (SCM_RIGHTS). both hold the same socket,
+// so its listen queue stays open throughout and no connection is refused.
+// the successor waits in receive() first, then the predecessor calls send().
+////////////////////////////////////////////////////////////////////////////////
+#if !defined(_WIN32)
+
+using native_handle_type = int;
+
+namespace detail
+{
+
+inline error_code last_error()
+{
+  return error_code(errno, asio::error::get_system_category());
+}
+
+} // namespace sv::net::handoff::detail
+
+// passes _handle to the successor waiting on _path. the caller keeps its
+// own copy of the socket and should stop accepting on it first.
+inline void send(std::string const& _path, native_handle_type _handle)
+{
+  asio::io_context ioc;
+  asio::local::stream_protocol::socket channel(ioc);
+  channel.connect(asio::local::stream_protocol::endpoint(_path));
+
+  char tag = 'L';
+  iovec iov{ &tag, sizeof(tag) };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(native_handle_type))];
+  std::memset(control, 0, sizeof(control));
+
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  auto* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(native_handle_type));
+  std::memcpy(CMSG_DATA(header), &_handle, sizeof(_handle));
+
+  if (::sendmsg(channel.native_handle(), &message, 0) < 0)
+  {
+    throw boost::system::system_error(detail::last_error(), "handoff::send");
+  }
+
+  // wait for the successor to close the channel, so the caller does not
+  // close its copy before the socket has arrived.
+  error_code ec;
+  asio::read(channel, asio::buffer(&tag, sizeof(tag)), ec);
+}
+
+// blocks until a predecessor sends its listening socket to _path, and
+// returns it.
+inline native_handle_type receive(std::string const& _path)
+{
+  asio::io_context ioc;
+  std::remove(_path.c_str());
+  asio::local::stream_protocol::acceptor acceptor(ioc, asio::local::stream_protocol::endpoint(_path));
+  asio::local::stream_protocol::socket channel(ioc);
+  acceptor.accept(channel);
+  acceptor.close();
+  std::remove(_path.c_str());
+
+  char tag = 0;
+  iovec iov{ &tag, sizeof(tag) };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(native_handle_type))];
+  std::memset(control, 0, sizeof(control));
+
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  int flags = 0;
+#if defined(MSG_CMSG_CLOEXEC)
+  flags = MSG_CMSG_CLOEXEC;
+#endif // MSG_CMSG_CLOEXEC
+  ssize_t received;
+  do
+  {
+    received = ::recvmsg(channel.native_handle(), &message, flags);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0)
+  {
+    throw boost::system::system_error(detail::last_error(), "handoff::receive");
+  }
+
+  auto* header = CMSG_FIRSTHDR(&message);
+  if (received != sizeof(tag) || tag != 'L' || header == nullptr ||
+      header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+  {
+    throw boost::system::system_error(asio::error::invalid_argument, "handoff::receive");
+  }
+  native_handle_type handle;
+  std::memcpy(&handle, CMSG_DATA(header), sizeof(handle));
+  return handle;
+}
+
+#endif // _WIN32
+
+} // namespace sv::net::handoff
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_HANDOFF_HPP__
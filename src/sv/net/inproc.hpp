@@ -0,0 +1,625 @@
+#ifndef __SV_NET_INPROC_HPP__
+#define __SV_NET_INPROC_HPP__
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include <boost/asio.hpp>
+
+namespace sv
+{
+namespace net
+{
+namespace inproc
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// ring
+//
+// single-producer single-consumer byte ring. the writer only moves m_head,
+// the reader only moves m_tail, so the data path takes no lock.
+////////////////////////////////////////////////////////////////////////////////
+class ring
+{
+public:
+  explicit ring(std::size_t _capacity)
+    : m_data(new char[_capacity])
+    , m_capacity(_capacity)
+    , m_head(0)
+    , m_tail(0)
+  {
+  }
+  std::size_t write(const char* _src, std::size_t _size)
+  {
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto tail = m_tail.load(std::memory_order_acquire);
+    auto n = std::min(_size, m_capacity - (head - tail));
+    copy_in(head, _src, n);
+    m_head.store(head + n, std::memory_order_release);
+    return n;
+  }
+  std::size_t read(char* _dst, std::size_t _size)
+  {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+    auto n = std::min(_size, head - tail);
+    copy_out(tail, _dst, n);
+    m_tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+  bool empty() const
+  {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+  }
+  bool full() const
+  {
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire) == m_capacity;
+  }
+
+private:
+  void copy_in(std::size_t _pos, const char* _src, std::size_t _size)
+  {
+    auto offset = _pos % m_capacity;
+    auto first = std::min(_size, m_capacity - offset);
+    std::memcpy(&m_data[offset], _src, first);
+    std::memcpy(&m_data[0], _src + first, _size - first);
+  }
+  void copy_out(std::size_t _pos, char* _dst, std::size_t _size)
+  {
+    auto offset = _pos % m_capacity;
+    auto first = std::min(_size, m_capacity - offset);
+    std::memcpy(_dst, &m_data[offset], first);
+    std::memcpy(_dst + first, &m_data[0], _size - first);
+  }
+
+private:
+  std::unique_ptr<char[]> m_data;
+  std::size_t m_capacity;
+
+  alignas(64) std::atomic<std::size_t> m_head;
+  alignas(64) std::atomic<std::size_t> m_tail;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// channel
+//
+// one connection: a ring per direction plus the parked read/write operation
+// of each side. a side parks only when its ring is empty (read) or full
+// (write); the peer wakes it after moving data.
+////////////////////////////////////////////////////////////////////////////////
+struct channel
+{
+  using waiter = std::function<void(error_code const&)>;
+
+  static const std::size_t sc_ring_size = 256 * 1024;
+
+  struct direction
+  {
+    direction()
+      : data(sc_ring_size)
+      , read_waiting(false)
+      , write_waiting(false)
+      , closed(false)
+    {
+    }
+    ring data;
+    std::atomic<bool> read_waiting;
+    std::atomic<bool> write_waiting;
+    std::atomic<bool> closed;
+    waiter read_waiter;
+    waiter write_waiter;
+  };
+
+  // m_direction[0]: client to server, m_direction[1]: server to client.
+  direction m_direction[2];
+  std::mutex m_mutex;
+
+  void park(std::atomic<bool>& _flag, waiter& _slot, waiter _waiter)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    _slot = std::move(_waiter);
+    _flag.store(true, std::memory_order_seq_cst);
+  }
+  void wake(std::atomic<bool>& _flag, waiter& _slot, error_code const& ec = error_code())
+  {
+    if (!_flag.load(std::memory_order_seq_cst))
+    {
+      return;
+    }
+
+    waiter w;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!_flag.exchange(false))
+      {
+        return;
+      }
+      w = std::move(_slot);
+      _slot = nullptr;
+    }
+    if (w)
+    {
+      w(ec);
+    }
+  }
+};
+
+struct endpoint
+{
+  endpoint() = default;
+  endpoint(std::string const& _name)
+    : name(_name)
+  {
+  }
+  std::string name;
+};
+inline std::ostream& operator<<(std::ostream& os, endpoint const& ep)
+{
+  return os << "inproc://" << ep.name;
+}
+
+class acceptor;
+
+////////////////////////////////////////////////////////////////////////////////
+// stream
+//
+// AsyncReadStream/AsyncWriteStream over a channel, usable with asio::async_read
+// and asio::async_write like a tcp::socket.
+////////////////////////////////////////////////////////////////////////////////
+class stream
+{
+  friend class acceptor;
+
+public:
+  using executor_type = asio::io_context::executor_type;
+  using endpoint_type = endpoint;
+
+  explicit stream(asio::io_context& _ioc)
+    : m_executor(_ioc.get_executor())
+    , m_channel(nullptr)
+    , m_side(0)
+  {
+  }
+  stream(stream const&) = delete;
+  stream& operator=(stream const&) = delete;
+  ~stream()
+  {
+    close();
+  }
+
+  executor_type get_executor() noexcept
+  {
+    return m_executor;
+  }
+  bool is_open() const
+  {
+    return m_channel != nullptr;
+  }
+  void close()
+  {
+    if (m_channel == nullptr)
+    {
+      return;
+    }
+
+    auto channel = std::move(m_channel);
+    auto& out = channel->m_direction[m_side];
+    auto& in = channel->m_direction[1 - m_side];
+    out.closed = true;
+    in.closed = true;
+    // the peer sees eof / broken_pipe, our own parked operations are aborted.
+    channel->wake(out.read_waiting, out.read_waiter);
+    channel->wake(in.write_waiting, in.write_waiter);
+    channel->wake(in.read_waiting, in.read_waiter, asio::error::operation_aborted);
+    channel->wake(out.write_waiting, out.write_waiter, asio::error::operation_aborted);
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_local;
+  }
+  endpoint_type remote_endpoint() const
+  {
+    return m_remote;
+  }
+
+  template<class ConnectHandler>
+  auto async_connect(endpoint_type const& _endpoint, ConnectHandler&& _handler);
+
+  template<class MutableBufferSequence, class ReadHandler>
+  auto async_read_some(MutableBufferSequence const& _buffers, ReadHandler&& _handler)
+  {
+    return asio::async_initiate<ReadHandler, void(error_code, std::size_t)>(
+      [this](auto&& handler, MutableBufferSequence const& buffers)
+      {
+        start_read(buffers, std::move(handler));
+      },
+      _handler, _buffers);
+  }
+  template<class ConstBufferSequence, class WriteHandler>
+  auto async_write_some(ConstBufferSequence const& _buffers, WriteHandler&& _handler)
+  {
+    return asio::async_initiate<WriteHandler, void(error_code, std::size_t)>(
+      [this](auto&& handler, ConstBufferSequence const& buffers)
+      {
+        start_write(buffers, std::move(handler));
+      },
+      _handler, _buffers);
+  }
+
+private:
+  template<class Handler, class...Args>
+  static void complete(executor_type const& _executor, Handler&& _handler, Args...args)
+  {
+    auto ex = asio::get_associated_executor(_handler, _executor);
+    asio::post(ex, [handler = std::forward<Handler>(_handler), args...]() mutable
+                   {
+                     handler(args...);
+                   });
+  }
+
+  // parks an operation. the waiter runs with no error when the peer moved
+  // data, or with operation_aborted when this side is closed.
+  template<class Handler, class Retry>
+  static channel::waiter make_waiter(executor_type const& _executor, Handler&& _handler, Retry _retry)
+  {
+    auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+    auto work = asio::make_work_guard(_executor);
+    return [op, work, _retry](error_code const& ec)
+    {
+      auto ex = work.get_executor();
+      asio::post(ex, [op, ex, ec, _retry]()
+                     {
+                       if (!!ec)
+                       {
+                         (*op)(ec, std::size_t(0));
+                         return;
+                       }
+                       _retry(ex, std::move(*op));
+                     });
+    };
+  }
+
+  template<class MutableBufferSequence, class Handler>
+  void start_read(MutableBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_channel == nullptr)
+    {
+      complete(m_executor, std::move(_handler), error_code(asio::error::bad_descriptor), std::size_t(0));
+      return;
+    }
+    do_read(m_channel, m_side, m_executor, _buffers, std::move(_handler));
+  }
+  template<class MutableBufferSequence, class Handler>
+  static void do_read(std::shared_ptr<channel> const& _channel, int _side, executor_type const& _executor,
+                      MutableBufferSequence const& _buffers, Handler&& _handler)
+  {
+    auto& in = _channel->m_direction[1 - _side];
+
+    std::size_t bytes = 0;
+    for (auto it = asio::buffer_sequence_begin(_buffers); it != asio::buffer_sequence_end(_buffers); ++it)
+    {
+      asio::mutable_buffer b(*it);
+      auto n = in.data.read(static_cast<char*>(b.data()), b.size());
+      bytes += n;
+      if (n < b.size())
+      {
+        break;
+      }
+    }
+    if (bytes > 0 || asio::buffer_size(_buffers) == 0)
+    {
+      _channel->wake(in.write_waiting, in.write_waiter);
+      complete(_executor, std::move(_handler), error_code(), bytes);
+      return;
+    }
+    if (in.closed)
+    {
+      complete(_executor, std::move(_handler), error_code(asio::error::eof), std::size_t(0));
+      return;
+    }
+
+    // ring is empty: park, then look once more so a racing write is not missed.
+    _channel->park(in.read_waiting, in.read_waiter,
+                   make_waiter(_executor, std::move(_handler),
+                               [_channel, _side, _buffers](executor_type const& ex, auto&& handler)
+                               {
+                                 do_read(_channel, _side, ex, _buffers, std::move(handler));
+                               }));
+    if (!in.data.empty() || in.closed)
+    {
+      _channel->wake(in.read_waiting, in.read_waiter);
+    }
+  }
+
+  template<class ConstBufferSequence, class Handler>
+  void start_write(ConstBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_channel == nullptr)
+    {
+      complete(m_executor, std::move(_handler), error_code(asio::error::bad_descriptor), std::size_t(0));
+      return;
+    }
+    do_write(m_channel, m_side, m_executor, _buffers, std::move(_handler));
+  }
+  template<class ConstBufferSequence, class Handler>
+  static void do_write(std::shared_ptr<channel> const& _channel, int _side, executor_type const& _executor,
+                       ConstBufferSequence const& _buffers, Handler&& _handler)
+  {
+    auto& out = _channel->m_direction[_side];
+    if (out.closed)
+    {
+      complete(_executor, std::move(_handler), error_code(asio::error::broken_pipe), std::size_t(0));
+      return;
+    }
+
+    std::size_t bytes = 0;
+    for (auto it = asio::buffer_sequence_begin(_buffers); it != asio::buffer_sequence_end(_buffers); ++it)
+    {
+      asio::const_buffer b(*it);
+      auto n = out.data.write(static_cast<const char*>(b.data()), b.size());
+      bytes += n;
+      if (n < b.size())
+      {
+        break;
+      }
+    }
+    if (bytes > 0 || asio::buffer_size(_buffers) == 0)
+    {
+      _channel->wake(out.read_waiting, out.read_waiter);
+      complete(_executor, std::move(_handler), error_code(), bytes);
+      return;
+    }
+
+    // ring is full: park until the reader drains it.
+    _channel->park(out.write_waiting, out.write_waiter,
+                   make_waiter(_executor, std::move(_handler),
+                               [_channel, _side, _buffers](executor_type const& ex, auto&& handler)
+                               {
+                                 do_write(_channel, _side, ex, _buffers, std::move(handler));
+                               }));
+    if (!out.data.full() || out.closed)
+    {
+      _channel->wake(out.write_waiting, out.write_waiter);
+    }
+  }
+
+  void attach(std::shared_ptr<channel> _channel, int _side, endpoint_type const& _local, endpoint_type const& _remote)
+  {
+    m_channel = std::move(_channel);
+    m_side = _side;
+    m_local = _local;
+    m_remote = _remote;
+  }
+
+private:
+  executor_type m_executor;
+  std::shared_ptr<channel> m_channel;
+  int m_side;
+
+  endpoint_type m_local;
+  endpoint_type m_remote;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// acceptor
+//
+// listens on a process-wide name. connects queue a channel on the listener's
+// backlog; async_accept attaches the server side of the next queued channel.
+////////////////////////////////////////////////////////////////////////////////
+class acceptor
+{
+  struct listener
+  {
+    using accept_op = std::function<void(std::shared_ptr<channel> const&)>;
+
+    std::mutex mutex;
+    bool closed = false;
+    std::deque<std::shared_ptr<channel>> backlog;
+    std::deque<accept_op> pending;
+
+    bool connect(std::shared_ptr<channel> const& _channel)
+    {
+      accept_op op;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed)
+        {
+          return false;
+        }
+        if (pending.empty())
+        {
+          backlog.push_back(_channel);
+          return true;
+        }
+        op = std::move(pending.front());
+        pending.pop_front();
+      }
+      op(_channel);
+      return true;
+    }
+  };
+  using registry_t = std::unordered_map<std::string, std::weak_ptr<listener>>;
+
+public:
+  using executor_type = asio::io_context::executor_type;
+  using endpoint_type = endpoint;
+
+  acceptor(asio::io_context& _ioc, endpoint_type const& _endpoint)
+    : m_executor(_ioc.get_executor())
+    , m_endpoint(_endpoint)
+    , m_listener(std::make_shared<listener>())
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    auto& entry = registry()[m_endpoint.name];
+    if (!entry.expired())
+    {
+      throw boost::system::system_error(asio::error::address_in_use, "inproc::acceptor");
+    }
+    entry = m_listener;
+  }
+  acceptor(acceptor const&) = delete;
+  acceptor& operator=(acceptor const&) = delete;
+  // the registry holds the listener, not the acceptor, so it can move.
+  acceptor(acceptor&& _other) noexcept
+    : m_executor(_other.m_executor)
+    , m_endpoint(std::move(_other.m_endpoint))
+    , m_listener(std::move(_other.m_listener))
+  {
+    _other.m_listener = nullptr;
+  }
+  acceptor& operator=(acceptor&&) = delete;
+  ~acceptor()
+  {
+    close();
+  }
+
+  executor_type get_executor() noexcept
+  {
+    return m_executor;
+  }
+  bool is_open() const
+  {
+    return m_listener != nullptr;
+  }
+  void close()
+  {
+    if (m_listener == nullptr)
+    {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex());
+      registry().erase(m_endpoint.name);
+    }
+
+    std::deque<listener::accept_op> pending;
+    {
+      std::lock_guard<std::mutex> lock(m_listener->mutex);
+      m_listener->closed = true;
+      m_listener->backlog.clear();
+      pending.swap(m_listener->pending);
+    }
+    for (auto& op : pending)
+    {
+      op(nullptr);
+    }
+    m_listener = nullptr;
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_endpoint;
+  }
+
+  template<class AcceptHandler>
+  auto async_accept(stream& _peer, AcceptHandler&& _handler)
+  {
+    return asio::async_initiate<AcceptHandler, void(error_code)>(
+      [this, &_peer](auto&& handler)
+      {
+        start_accept(_peer, std::move(handler));
+      },
+      _handler);
+  }
+
+  static std::shared_ptr<listener> find(std::string const& _name)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    auto it = registry().find(_name);
+    return (it == registry().end()) ? nullptr : it->second.lock();
+  }
+
+private:
+  template<class Handler>
+  void start_accept(stream& _peer, Handler&& _handler)
+  {
+    auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+    auto work = asio::make_work_guard(m_executor);
+    auto endpoint = m_endpoint;
+    listener::accept_op accept = [&_peer, op, work, endpoint](std::shared_ptr<channel> const& ch)
+    {
+      asio::post(work.get_executor(), [&_peer, op, ch, endpoint]()
+                                      {
+                                        if (ch == nullptr)
+                                        {
+                                          (*op)(error_code(asio::error::operation_aborted));
+                                          return;
+                                        }
+                                        _peer.attach(ch, 1, endpoint, endpoint_type(endpoint.name + "#client"));
+                                        (*op)(error_code());
+                                      });
+    };
+
+    std::shared_ptr<channel> ready;
+    {
+      std::lock_guard<std::mutex> lock(m_listener->mutex);
+      if (m_listener->backlog.empty())
+      {
+        m_listener->pending.push_back(std::move(accept));
+        return;
+      }
+      ready = std::move(m_listener->backlog.front());
+      m_listener->backlog.pop_front();
+    }
+    accept(ready);
+  }
+
+  static std::mutex& registry_mutex()
+  {
+    static std::mutex s_mutex;
+    return s_mutex;
+  }
+  static registry_t& registry()
+  {
+    static registry_t s_registry;
+    return s_registry;
+  }
+
+private:
+  executor_type m_executor;
+  endpoint_type m_endpoint;
+  std::shared_ptr<listener> m_listener;
+};
+
+template<class ConnectHandler>
+auto stream::async_connect(endpoint_type const& _endpoint, ConnectHandler&& _handler)
+{
+  return asio::async_initiate<ConnectHandler, void(error_code)>(
+    [this](auto&& handler, endpoint_type const& endpoint)
+    {
+      auto target = acceptor::find(endpoint.name);
+      if (target == nullptr)
+      {
+        complete(m_executor, std::move(handler), error_code(asio::error::connection_refused));
+        return;
+      }
+
+      auto ch = std::make_shared<channel>();
+      attach(ch, 0, endpoint_type(endpoint.name + "#client"), endpoint);
+      if (!target->connect(ch))
+      {
+        m_channel = nullptr;
+        complete(m_executor, std::move(handler), error_code(asio::error::connection_refused));
+        return;
+      }
+      complete(m_executor, std::move(handler), error_code());
+    },
+    _handler, _endpoint);
+}
+
+} // namespace sv::net::inproc
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_INPROC_HPP__
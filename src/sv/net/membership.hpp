@@ -0,0 +1,780 @@
+#ifndef __SV_NET_MEMBERSHIP_HPP__
+#define __SV_NET_MEMBERSHIP_HPP__
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "sv/net/schema.hpp"
+#include "sv/net/udp.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace membership
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+using clock = std::chrono::steady_clock;
+using endpoint_type = asio::ip::udp::endpoint;
+
+enum class state : std::uint8_t
+{
+  alive = 0,
+  suspect = 1,
+  dead = 2,
+};
+
+struct member
+{
+  endpoint_type endpoint;
+  // raised by the member itself to refute a suspicion.
+  std::uint32_t incarnation;
+  membership::state state;
+};
+
+struct options
+{
+  // one member is probed per period.
+  clock::duration period = std::chrono::milliseconds(500);
+  // for the direct ack; after it, indirect_probes others are asked to probe.
+  clock::duration probe_timeout = std::chrono::milliseconds(200);
+  std::size_t indirect_probes = 3;
+  // a suspect is declared dead after suspicion_multiplier * log10(members)
+  // periods, at least suspicion_multiplier.
+  double suspicion_multiplier = 4;
+  // each change is piggybacked retransmit_multiplier * log10(members + 1)
+  // times, rounded up.
+  double retransmit_multiplier = 4;
+  // changes carried by one message, as far as max_datagram allows (about
+  // 60 in 1400 bytes).
+  std::size_t max_piggyback = 64;
+  std::size_t max_datagram = 1400;
+  // full state exchange with one random member, to heal what gossip missed.
+  clock::duration sync_interval = std::chrono::seconds(30);
+  // dead members are remembered this long, so stale gossip cannot revive them.
+  clock::duration dead_retention = std::chrono::seconds(60);
+};
+
+struct statistics
+{
+  std::uint64_t sent = 0;
+  std::uint64_t received = 0;
+  std::uint64_t probes = 0;
+  std::uint64_t indirect_probes = 0;
+  std::uint64_t suspicions = 0;
+  std::uint64_t refutations = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// detector
+//
+// i/o-free SWIM membership for one node:
+//
+// - every period one member, in a shuffled round robin, is pinged. without an
+//   ack by probe_timeout, indirect_probes other members ping it on our behalf
+//   and relay the ack; without any ack by the end of the period it becomes
+//   suspect.
+// - a suspect that does not refute in time, by gossiping itself alive with a
+//   higher incarnation, is declared dead.
+// - changes ride on pings and acks, each a bounded number of times, so the
+//   load per node stays the same however large the cluster grows.
+// - joining, and every sync_interval after, two members exchange their whole
+//   state.
+//
+// the owner feeds received datagrams to receive(), calls on_timer() once
+// next_timeout() has passed, and ships whatever the output handler emits.
+////////////////////////////////////////////////////////////////////////////////
+class detector
+{
+public:
+  using output_handler = std::function<void(endpoint_type const&, std::string)>;
+  using change_handler = std::function<void(member const&)>;
+
+  detector(endpoint_type const& _self, options const& _options, output_handler _output, change_handler _change)
+    : m_self(_self)
+    , m_options(_options)
+    , m_output(std::move(_output))
+    , m_change(std::move(_change))
+    , m_incarnation(0)
+    , m_probe_index(0)
+    , m_probing(false)
+    , m_next_seq(1)
+    , m_period_end()
+    , m_next_sync(clock::time_point::max())
+    , m_random(std::random_device()())
+  {
+  }
+
+  // contacts _seeds, again every period until one answers.
+  void join(std::vector<endpoint_type> const& _seeds, clock::time_point _now)
+  {
+    for (auto const& e : _seeds)
+    {
+      if (e != m_self)
+      {
+        m_seeds.push_back(e);
+      }
+    }
+    enqueue(m_self, m_incarnation, state::alive);
+    m_next_sync = _now;
+    on_timer(_now);
+  }
+  void receive(endpoint_type const& _from, const char* _data, std::size_t _size, clock::time_point _now)
+  {
+    if (_size < sc_header_size)
+    {
+      return;
+    }
+    ++m_stats.received;
+    auto kind = static_cast<std::uint8_t>(_data[0]);
+    auto count = packet::detail::load_le<std::uint16_t>(_data + 2);
+    std::size_t body = 0;
+    switch (kind)
+    {
+    case sc_ping:
+    case sc_ack:
+      body = 4;
+      break;
+    case sc_ping_req:
+      body = 4 + sc_endpoint_size;
+      break;
+    case sc_sync:
+      body = 1;
+      break;
+    default:
+      return;
+    }
+    if (_size < sc_header_size + body + std::size_t(count) * sc_update_size)
+    {
+      return;
+    }
+
+    // the changes first: a sync asking for a reply gets the merged state.
+    // what a sync teaches is gossiped on like any other news, or members that
+    // joined through it would only ever hear of each other by probing.
+    auto updates = _data + sc_header_size + body;
+    for (std::uint16_t i = 0; i < count; ++i, updates += sc_update_size)
+    {
+      apply(decode_endpoint(updates + 5), packet::detail::load_le<std::uint32_t>(updates + 1),
+            static_cast<state>(updates[0]), _now);
+    }
+
+    // a member that reached us before its news did, and one we hold suspect
+    // or dead: the reply tells it first, so that it can refute.
+    auto known = m_members.find(_from);
+    if (known == m_members.end())
+    {
+      if (kind != sc_sync)
+      {
+        apply(_from, 0, state::alive, _now, false);
+      }
+    }
+    else if (known->second.state != state::alive)
+    {
+      enqueue(_from, known->second.incarnation, known->second.state);
+    }
+
+    auto payload = _data + sc_header_size;
+    switch (kind)
+    {
+    case sc_ping:
+      send(_from, sc_ack, std::string(payload, 4));
+      break;
+    case sc_ping_req:
+    {
+      auto seq = m_next_seq++;
+      m_relays[seq] = relay{ _from, packet::detail::load_le<std::uint32_t>(payload), _now + m_options.period };
+      send(decode_endpoint(payload + 4), sc_ping, encode_seq(seq));
+      break;
+    }
+    case sc_ack:
+    {
+      auto seq = packet::detail::load_le<std::uint32_t>(payload);
+      if (m_probing && seq == m_probe.seq)
+      {
+        m_probe.acked = true;
+        break;
+      }
+      auto it = m_relays.find(seq);
+      if (it != m_relays.end())
+      {
+        send(it->second.requester, sc_ack, encode_seq(it->second.seq));
+        m_relays.erase(it);
+      }
+      break;
+    }
+    case sc_sync:
+      // someone answered; joining is done.
+      m_seeds.clear();
+      if (payload[0] != 0)
+      {
+        send_state(_from, false);
+      }
+      break;
+    }
+  }
+  void on_timer(clock::time_point _now)
+  {
+    for (auto it = m_relays.begin(); it != m_relays.end();)
+    {
+      it = (it->second.expiry <= _now) ? m_relays.erase(it) : std::next(it);
+    }
+    for (auto it = m_members.begin(); it != m_members.end();)
+    {
+      auto& e = it->second;
+      if (e.state == state::suspect && e.deadline <= _now)
+      {
+        apply(it->first, e.incarnation, state::dead, _now);
+      }
+      else if (e.state == state::dead && e.deadline <= _now)
+      {
+        it = m_members.erase(it);
+        continue;
+      }
+      ++it;
+    }
+
+    if (m_probing)
+    {
+      if (!m_probe.acked && !m_probe.indirect && m_probe.deadline <= _now)
+      {
+        m_probe.indirect = true;
+        for (auto const& e : pick(m_options.indirect_probes, m_probe.target))
+        {
+          std::string body = encode_seq(m_probe.seq);
+          body.resize(4 + sc_endpoint_size);
+          encode_endpoint(&body[4], m_probe.target);
+          send(e, sc_ping_req, std::move(body));
+          ++m_stats.indirect_probes;
+        }
+      }
+      if (m_period_end <= _now)
+      {
+        m_probing = false;
+        auto it = m_members.find(m_probe.target);
+        if (!m_probe.acked && it != m_members.end() && it->second.state == state::alive)
+        {
+          ++m_stats.suspicions;
+          apply(it->first, it->second.incarnation, state::suspect, _now);
+        }
+      }
+    }
+    if (!m_probing && m_period_end <= _now)
+    {
+      m_period_end = _now + m_options.period;
+      endpoint_type target;
+      if (next_target(target))
+      {
+        m_probing = true;
+        m_probe = probe{ target, m_next_seq++, _now + m_options.probe_timeout, false, false };
+        send(target, sc_ping, encode_seq(m_probe.seq));
+        ++m_stats.probes;
+      }
+    }
+
+    if (m_next_sync <= _now)
+    {
+      if (!m_seeds.empty())
+      {
+        for (auto const& e : m_seeds)
+        {
+          send_state(e, true);
+        }
+        m_next_sync = _now + m_options.period;
+      }
+      else
+      {
+        for (auto const& e : pick(1, m_self))
+        {
+          send_state(e, true);
+        }
+        m_next_sync = _now + m_options.sync_interval;
+      }
+    }
+  }
+  clock::time_point next_timeout() const
+  {
+    auto next = std::min(m_period_end, m_next_sync);
+    if (m_probing && !m_probe.acked && !m_probe.indirect)
+    {
+      next = std::min(next, m_probe.deadline);
+    }
+    for (auto const& e : m_members)
+    {
+      if (e.second.state != state::alive)
+      {
+        next = std::min(next, e.second.deadline);
+      }
+    }
+    return next;
+  }
+  // the others, the dead ones included until dead_retention has passed.
+  std::vector<member> members() const
+  {
+    std::vector<member> result;
+    result.reserve(m_members.size());
+    for (auto const& e : m_members)
+    {
+      result.push_back(member{ e.first, e.second.incarnation, e.second.state });
+    }
+    return result;
+  }
+  std::uint32_t incarnation() const
+  {
+    return m_incarnation;
+  }
+  statistics const& stats() const
+  {
+    return m_stats;
+  }
+
+private:
+  static constexpr std::uint8_t sc_ping = 1;
+  static constexpr std::uint8_t sc_ping_req = 2;
+  static constexpr std::uint8_t sc_ack = 3;
+  static constexpr std::uint8_t sc_sync = 4;
+
+  // kind u8, reserved u8, updates u16, then the body of the kind:
+  //   ping, ack: seq u32
+  //   ping_req: seq u32, target endpoint
+  //   sync: reply wanted u8
+  // and the updates: { state u8, incarnation u32, endpoint } * updates.
+  // an endpoint is an ipv6 address (v4-mapped for ipv4) and a u16 port.
+  static constexpr std::size_t sc_header_size = 4;
+  static constexpr std::size_t sc_endpoint_size = 16 + 2;
+  static constexpr std::size_t sc_update_size = 1 + 4 + sc_endpoint_size;
+
+  struct entry
+  {
+    std::uint32_t incarnation;
+    membership::state state;
+    // suspect: when it is declared dead; dead: when it is forgotten.
+    clock::time_point deadline;
+  };
+  struct broadcast
+  {
+    endpoint_type endpoint;
+    std::uint32_t incarnation;
+    membership::state state;
+    std::size_t transmits;
+  };
+  struct probe
+  {
+    endpoint_type target;
+    std::uint32_t seq;
+    clock::time_point deadline;
+    bool acked;
+    bool indirect;
+  };
+  struct relay
+  {
+    endpoint_type requester;
+    std::uint32_t seq;
+    clock::time_point expiry;
+  };
+
+  static std::string encode_seq(std::uint32_t _seq)
+  {
+    std::string bytes(4, '\0');
+    packet::detail::store_le(&bytes[0], _seq);
+    return bytes;
+  }
+  static void encode_endpoint(char* _out, endpoint_type const& _endpoint)
+  {
+    auto address = _endpoint.address();
+    auto v6 = address.is_v4() ? asio::ip::make_address_v6(asio::ip::v4_mapped, address.to_v4()) : address.to_v6();
+    auto bytes = v6.to_bytes();
+    std::copy(bytes.begin(), bytes.end(), _out);
+    packet::detail::store_le(_out + 16, _endpoint.port());
+  }
+  static endpoint_type decode_endpoint(const char* _in)
+  {
+    asio::ip::address_v6::bytes_type bytes;
+    std::copy(_in, _in + 16, bytes.begin());
+    asio::ip::address_v6 v6(bytes);
+    auto port = packet::detail::load_le<std::uint16_t>(_in + 16);
+    if (v6.is_v4_mapped())
+    {
+      return endpoint_type(asio::ip::make_address_v4(asio::ip::v4_mapped, v6), port);
+    }
+    return endpoint_type(v6, port);
+  }
+
+  double scale() const
+  {
+    return std::log10(double(m_members.size() + 1));
+  }
+  // folds one change into the list, by the SWIM rules: alive needs a higher
+  // incarnation to override, suspect an equal one over alive, dead an equal
+  // one over anything.
+  void apply(endpoint_type const& _endpoint, std::uint32_t _incarnation, membership::state _state, clock::time_point _now,
+             bool _gossip = true)
+  {
+    if (_endpoint == m_self)
+    {
+      if (_state != state::alive && _incarnation >= m_incarnation)
+      {
+        m_incarnation = _incarnation + 1;
+        ++m_stats.refutations;
+        enqueue(m_self, m_incarnation, state::alive);
+      }
+      return;
+    }
+    auto it = m_members.find(_endpoint);
+    if (it == m_members.end())
+    {
+      if (_state == state::dead)
+      {
+        return;
+      }
+      it = m_members.emplace(_endpoint, entry{ _incarnation, state::alive, clock::time_point() }).first;
+      // somewhere in the rest of this round, so it is probed soon.
+      auto at = m_probe_index + m_random() % (m_probe_order.size() - m_probe_index + 1);
+      m_probe_order.insert(m_probe_order.begin() + at, _endpoint);
+      if (_state == state::alive)
+      {
+        changed(it->first, it->second, _state, _now, _gossip);
+        return;
+      }
+    }
+
+    auto& e = it->second;
+    bool overrides = false;
+    switch (_state)
+    {
+    case state::alive:
+      overrides = _incarnation > e.incarnation;
+      break;
+    case state::suspect:
+      overrides = (e.state == state::alive && _incarnation >= e.incarnation) ||
+                  (e.state == state::suspect && _incarnation > e.incarnation);
+      break;
+    case state::dead:
+      overrides = e.state != state::dead && _incarnation >= e.incarnation;
+      break;
+    }
+    if (overrides)
+    {
+      e.incarnation = _incarnation;
+      changed(it->first, e, _state, _now, _gossip);
+    }
+  }
+  void changed(endpoint_type const& _endpoint, entry& _entry, membership::state _state, clock::time_point _now,
+               bool _gossip)
+  {
+    _entry.state = _state;
+    if (_state == state::suspect)
+    {
+      auto periods = m_options.suspicion_multiplier * std::max(1.0, std::log10(double(m_members.size())));
+      _entry.deadline = _now + std::chrono::duration_cast<clock::duration>(m_options.period * periods);
+    }
+    else if (_state == state::dead)
+    {
+      _entry.deadline = _now + m_options.dead_retention;
+    }
+    if (_gossip)
+    {
+      enqueue(_endpoint, _entry.incarnation, _state);
+    }
+    if (m_change)
+    {
+      m_change(member{ _endpoint, _entry.incarnation, _state });
+    }
+  }
+  void enqueue(endpoint_type const& _endpoint, std::uint32_t _incarnation, membership::state _state)
+  {
+    m_broadcasts.erase(std::remove_if(m_broadcasts.begin(), m_broadcasts.end(),
+                                      [&_endpoint](broadcast const& b) { return b.endpoint == _endpoint; }),
+                       m_broadcasts.end());
+    m_broadcasts.push_front(broadcast{ _endpoint, _incarnation, _state, 0 });
+  }
+  static void put_update(std::string& _out, endpoint_type const& _endpoint, std::uint32_t _incarnation,
+                         membership::state _state)
+  {
+    auto at = _out.size();
+    _out.resize(at + sc_update_size);
+    _out[at] = static_cast<char>(_state);
+    packet::detail::store_le(&_out[at + 1], _incarnation);
+    encode_endpoint(&_out[at + 5], _endpoint);
+  }
+  // the changes sent the fewest times go first. the limit follows the size
+  // of the cluster as it is now, which for a node that just joined is more
+  // than when the change was queued.
+  void send(endpoint_type const& _to, std::uint8_t _kind, std::string _body)
+  {
+    auto limit = std::max<std::size_t>(static_cast<std::size_t>(std::ceil(m_options.retransmit_multiplier * scale())), 1);
+    std::string out(sc_header_size, '\0');
+    out[0] = static_cast<char>(_kind);
+    out += _body;
+    std::uint16_t count = 0;
+    for (auto& e : m_broadcasts)
+    {
+      if (count == m_options.max_piggyback || out.size() + sc_update_size > m_options.max_datagram)
+      {
+        break;
+      }
+      put_update(out, e.endpoint, e.incarnation, e.state);
+      ++e.transmits;
+      ++count;
+    }
+    m_broadcasts.erase(std::remove_if(m_broadcasts.begin(), m_broadcasts.end(),
+                                      [limit](broadcast const& b) { return b.transmits >= limit; }),
+                       m_broadcasts.end());
+    std::stable_sort(m_broadcasts.begin(), m_broadcasts.end(),
+                     [](broadcast const& a, broadcast const& b) { return a.transmits < b.transmits; });
+    packet::detail::store_le(&out[2], count);
+    m_output(_to, std::move(out));
+    ++m_stats.sent;
+  }
+  // the whole list, ourselves included, in as many datagrams as it takes;
+  // only the first asks for a reply.
+  void send_state(endpoint_type const& _to, bool _reply)
+  {
+    std::vector<member> all = members();
+    all.push_back(member{ m_self, m_incarnation, state::alive });
+    auto per_datagram = std::max<std::size_t>((m_options.max_datagram - sc_header_size - 1) / sc_update_size, 1);
+    for (std::size_t first = 0; first < all.size(); first += per_datagram)
+    {
+      auto last = std::min(all.size(), first + per_datagram);
+      std::string out(sc_header_size + 1, '\0');
+      out[0] = static_cast<char>(sc_sync);
+      out[sc_header_size] = (_reply && first == 0) ? 1 : 0;
+      packet::detail::store_le(&out[2], static_cast<std::uint16_t>(last - first));
+      for (auto i = first; i < last; ++i)
+      {
+        put_update(out, all[i].endpoint, all[i].incarnation, all[i].state);
+      }
+      m_output(_to, std::move(out));
+      ++m_stats.sent;
+    }
+  }
+  bool next_target(endpoint_type& _target)
+  {
+    for (int round = 0; round < 2; ++round)
+    {
+      while (m_probe_index < m_probe_order.size())
+      {
+        auto const& candidate = m_probe_order[m_probe_index++];
+        auto it = m_members.find(candidate);
+        if (it != m_members.end() && it->second.state != state::dead)
+        {
+          _target = candidate;
+          return true;
+        }
+      }
+      // a new round, in a new order, without the members gone since.
+      m_probe_order.clear();
+      for (auto const& e : m_members)
+      {
+        if (e.second.state != state::dead)
+        {
+          m_probe_order.push_back(e.first);
+        }
+      }
+      std::shuffle(m_probe_order.begin(), m_probe_order.end(), m_random);
+      m_probe_index = 0;
+    }
+    return false;
+  }
+  // up to _count live members other than _except, at random.
+  std::vector<endpoint_type> pick(std::size_t _count, endpoint_type const& _except)
+  {
+    std::vector<endpoint_type> result;
+    for (auto const& e : m_members)
+    {
+      if (e.second.state == state::alive && e.first != _except)
+      {
+        result.push_back(e.first);
+      }
+    }
+    if (result.size() > _count)
+    {
+      // a partial shuffle is enough.
+      for (std::size_t i = 0; i < _count; ++i)
+      {
+        std::swap(result[i], result[i + m_random() % (result.size() - i)]);
+      }
+      result.resize(_count);
+    }
+    return result;
+  }
+
+private:
+  endpoint_type m_self;
+  options m_options;
+  output_handler m_output;
+  change_handler m_change;
+  statistics m_stats;
+  std::uint32_t m_incarnation;
+  std::vector<endpoint_type> m_seeds;
+
+  std::unordered_map<endpoint_type, entry, datagram::endpoint_hash> m_members;
+  std::deque<broadcast> m_broadcasts;
+  std::vector<endpoint_type> m_probe_order;
+  std::size_t m_probe_index;
+
+  bool m_probing;
+  probe m_probe;
+  std::uint32_t m_next_seq;
+  clock::time_point m_period_end;
+  std::unordered_map<std::uint32_t, relay> m_relays;
+  clock::time_point m_next_sync;
+  std::mt19937 m_random;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// cluster
+//
+// a detector on a datagram::socket, on the caller's io_context; many can
+// share one, e.g. a whole test cluster on loopback. bind to the address the
+// others reach this node at. like datagram::socket, destroy it once the
+// io_context has stopped.
+////////////////////////////////////////////////////////////////////////////////
+class cluster
+{
+public:
+  using change_handler = detector::change_handler;
+
+  // throws boost::system::system_error if _bind is taken.
+  cluster(asio::io_context& _ioc, endpoint_type const& _bind, options const& _options = options())
+    : m_socket(_ioc)
+    , m_timer(_ioc)
+    , m_armed(clock::time_point::max())
+    , m_stopped(false)
+  {
+    m_socket.bind(_bind);
+    m_detector = std::make_unique<detector>(
+      m_socket.local_endpoint(), _options,
+      [this](endpoint_type const& to, std::string datagram) { m_socket.send(to, std::move(datagram)); },
+      [this](member const& m) { m_changes.push_back(m); });
+  }
+  cluster(cluster const&) = delete;
+  cluster& operator=(cluster const&) = delete;
+
+  // before start. called on the io thread, for every member that joins or
+  // changes state.
+  void on_change(change_handler _handler)
+  {
+    m_on_change = std::move(_handler);
+  }
+  // thread-safe. without seeds, waits to be contacted.
+  void start(std::vector<endpoint_type> const& _seeds = {})
+  {
+    asio::post(m_socket.get_executor(), [this, _seeds]()
+    {
+      m_socket.start([this](endpoint_type const& from, const char* data, std::size_t size)
+      {
+        run([&](clock::time_point now) { m_detector->receive(from, data, size, now); });
+      });
+      run([&](clock::time_point now) { m_detector->join(_seeds, now); });
+    });
+  }
+  // thread-safe. goes quiet, as if crashed; the others find out by probing.
+  void stop()
+  {
+    asio::post(m_socket.get_executor(), [this]()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopped = true;
+      m_socket.close();
+      m_timer.cancel();
+    });
+  }
+  endpoint_type local() const
+  {
+    return m_socket.local_endpoint();
+  }
+  // thread-safe.
+  std::vector<member> members() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_detector->members();
+  }
+  statistics stats() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_detector->stats();
+  }
+
+private:
+  // on the io thread: one step of the detector, then its changes, outside
+  // the lock.
+  template<class Step>
+  void run(Step&& _step)
+  {
+    std::vector<member> changes;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_stopped)
+      {
+        return;
+      }
+      _step(clock::now());
+      changes.swap(m_changes);
+      arm();
+    }
+    if (m_on_change)
+    {
+      for (auto const& e : changes)
+      {
+        m_on_change(e);
+      }
+    }
+  }
+  // with m_mutex held: the timer for the detector's next step.
+  void arm()
+  {
+    auto next = m_detector->next_timeout();
+    if (next == m_armed)
+    {
+      return;
+    }
+    m_armed = next;
+    m_timer.expires_at(next);
+    m_timer.async_wait([this](error_code const& ec)
+    {
+      if (ec != asio::error::operation_aborted)
+      {
+        on_timer();
+      }
+    });
+  }
+  void on_timer()
+  {
+    run([this](clock::time_point now)
+    {
+      m_armed = clock::time_point::max();
+      m_detector->on_timer(now);
+    });
+  }
+
+private:
+  datagram::socket m_socket;
+  asio::steady_timer m_timer;
+  clock::time_point m_armed;
+  mutable std::mutex m_mutex;
+  bool m_stopped;
+  std::unique_ptr<detector> m_detector;
+  std::vector<member> m_changes;
+  change_handler m_on_change;
+};
+
+} // namespace sv::net::membership
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_MEMBERSHIP_HPP__
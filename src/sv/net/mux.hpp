@@ -0,0 +1,368 @@
+#ifndef __SV_NET_MUX_HPP__
+#define __SV_NET_MUX_HPP__
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace mux
+{
+
+using stream_id = std::uint32_t;
+
+enum class frame_type : std::uint8_t
+{
+  data = 0,
+  window_update = 1,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// frame_header
+//
+// [ stream u32 ][ type u8 ][ flags u8 ][ reserved u16 ][ length u32 ]
+//
+// a message is cut into data frames, the last one flagged sc_end. a
+// window_update carries a u32 credit increment for its stream, or for the
+// whole connection when the stream is sc_connection.
+////////////////////////////////////////////////////////////////////////////////
+struct frame_header
+{
+  static constexpr std::size_t sc_size = 12;
+  static constexpr std::uint8_t sc_end = 0x01;
+  static constexpr stream_id sc_connection = 0xFFFFFFFFu;
+
+  stream_id stream;
+  frame_type type;
+  std::uint8_t flags;
+  std::uint32_t length;
+
+  void write(char* _dst) const
+  {
+    packet::detail::store_le(_dst, stream);
+    _dst[4] = static_cast<char>(type);
+    _dst[5] = static_cast<char>(flags);
+    packet::detail::store_le(_dst + 6, std::uint16_t(0));
+    packet::detail::store_le(_dst + 8, length);
+  }
+  static frame_header read(const char* _src)
+  {
+    frame_header h;
+    h.stream = packet::detail::load_le<stream_id>(_src);
+    h.type = static_cast<frame_type>(_src[4]);
+    h.flags = static_cast<std::uint8_t>(_src[5]);
+    h.length = packet::detail::load_le<std::uint32_t>(_src + 8);
+    return h;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// connection
+//
+// i/o-free multiplexer for one ordered byte stream.
+//
+// send side: each stream queues whole messages. produce() fills a write with
+// frames of at most sc_max_frame bytes, taking streams round-robin within the
+// most urgent priority that has data and credit, so a small message waits for
+// at most one frame of a bulk transfer, not for the transfer itself.
+//
+// flow control: a stream may only have sc_stream_window bytes, and the
+// connection sc_connection_window bytes, sent but not yet processed by the
+// peer. the receiver grants credit back as it reassembles frames, which keeps
+// the socket buffers on both sides shallow and control traffic fast. a stream
+// gives back all it holds when a message ends, so once both sides are done
+// with it it is forgotten.
+//
+// the peer is not trusted: a frame over its limits, data past the credit it
+// was given, credit past sc_max_credit, a message over sc_max_message or a
+// stream past sc_max_streams makes receive() fail, and the connection with it.
+////////////////////////////////////////////////////////////////////////////////
+class connection
+{
+public:
+  using deliver_handler = std::function<void(stream_id, std::string)>;
+
+  static constexpr std::size_t sc_max_frame = 16 * 1024;
+  static constexpr std::uint32_t sc_stream_window = 256 * 1024;
+  static constexpr std::uint32_t sc_connection_window = 1024 * 1024;
+  static constexpr std::uint32_t sc_max_credit = 0x7FFFFFFFu;
+  // as packet::base::sc_max_length.
+  static constexpr std::size_t sc_max_message = 64 * 1024 * 1024;
+  static constexpr std::size_t sc_max_streams = 1024;
+  // 0 is the most urgent.
+  static constexpr std::size_t sc_priorities = 8;
+  static constexpr std::uint8_t sc_default_priority = 4;
+
+  explicit connection(deliver_handler _deliver)
+    : m_deliver(std::move(_deliver))
+    , m_send_credit(sc_connection_window)
+    , m_window(sc_connection_window)
+    , m_received(0)
+  {
+  }
+
+  // a frame header this side can take: a data frame of at most sc_max_frame
+  // bytes on a stream, or a window_update with its u32 credit.
+  static bool valid(frame_header const& _header)
+  {
+    switch (_header.type)
+    {
+    case frame_type::data:
+      return _header.length <= sc_max_frame && _header.stream != frame_header::sc_connection;
+    case frame_type::window_update:
+      return _header.length == 4;
+    }
+    return false;
+  }
+
+  void set_priority(stream_id _stream, std::uint8_t _priority)
+  {
+    auto& s = stream(_stream);
+    auto priority = std::min<std::uint8_t>(_priority, sc_priorities - 1);
+    if (s.active && s.priority != priority)
+    {
+      auto& level = m_active[s.priority];
+      level.erase(std::find(level.begin(), level.end(), _stream));
+      m_active[priority].push_back(_stream);
+    }
+    s.priority = priority;
+    forget(_stream);
+  }
+  void send(stream_id _stream, std::string _message)
+  {
+    auto& s = stream(_stream);
+    s.messages.push_back(std::move(_message));
+    activate(_stream, s);
+  }
+
+  // appends frames to _out until about _budget bytes are queued. returns
+  // false when nothing could be sent.
+  bool produce(std::string& _out, std::size_t _budget)
+  {
+    auto start = _out.size();
+
+    // credit goes out first, the peer may be stalled waiting for it.
+    for (auto& grant : m_grants)
+    {
+      append_header(_out, frame_header{ grant.first, frame_type::window_update, 0, 4 });
+      _out.resize(_out.size() + 4);
+      packet::detail::store_le(&_out[_out.size() - 4], grant.second);
+      // the peer may send that much more once the update is out.
+      if (grant.first == frame_header::sc_connection)
+      {
+        m_window += grant.second;
+      }
+      else if (auto it = m_streams.find(grant.first); it != m_streams.end())
+      {
+        it->second.window += grant.second;
+        forget(grant.first);
+      }
+    }
+    m_grants.clear();
+
+    while (_out.size() - start < _budget && m_send_credit > 0)
+    {
+      auto level = std::find_if(m_active.begin(), m_active.end(),
+                                [](std::deque<stream_id> const& l) { return !l.empty(); });
+      if (level == m_active.end())
+      {
+        break;
+      }
+
+      auto id = level->front();
+      level->pop_front();
+      auto& s = m_streams[id];
+      auto& message = s.messages.front();
+
+      std::size_t length = std::min<std::size_t>({ message.size() - s.offset, sc_max_frame, s.credit, m_send_credit });
+      bool end = (s.offset + length == message.size());
+      append_header(_out, frame_header{ id, frame_type::data, std::uint8_t(end ? frame_header::sc_end : 0),
+                                        static_cast<std::uint32_t>(length) });
+      _out.append(message, s.offset, length);
+      s.credit -= static_cast<std::uint32_t>(length);
+      m_send_credit -= static_cast<std::uint32_t>(length);
+
+      if (end)
+      {
+        s.messages.pop_front();
+        s.offset = 0;
+      }
+      else
+      {
+        s.offset += length;
+      }
+
+      s.active = false;
+      activate(id, s);
+    }
+
+    return _out.size() > start;
+  }
+
+  // one complete frame from the peer, whose header passed valid(). false if
+  // the peer broke the protocol; the connection cannot go on.
+  bool receive(frame_header const& _header, const char* _payload)
+  {
+    if (_header.type == frame_type::window_update)
+    {
+      return grant(_header.stream, packet::detail::load_le<std::uint32_t>(_payload));
+    }
+
+    if (m_streams.count(_header.stream) == 0 && m_streams.size() >= sc_max_streams)
+    {
+      return false;
+    }
+    auto& s = stream(_header.stream);
+    if (_header.length > s.window || _header.length > m_window
+        || s.partial.size() + _header.length > sc_max_message)
+    {
+      return false;
+    }
+    s.window -= _header.length;
+    m_window -= _header.length;
+    s.partial.append(_payload, _header.length);
+    s.received += _header.length;
+    m_received += _header.length;
+
+    // credit is handed back in halves of the window to keep updates rare,
+    // and all of it when the message ends.
+    bool end = (_header.flags & frame_header::sc_end) != 0;
+    if (s.received >= sc_stream_window / 2 || (end && s.received > 0))
+    {
+      m_grants.emplace_back(_header.stream, s.received);
+      s.received = 0;
+    }
+    if (m_received >= sc_connection_window / 2)
+    {
+      m_grants.emplace_back(frame_header::sc_connection, m_received);
+      m_received = 0;
+    }
+
+    if (end)
+    {
+      std::string message;
+      message.swap(s.partial);
+      m_deliver(_header.stream, std::move(message));
+    }
+    return true;
+  }
+
+  // messages not completely framed yet, including those out of credit.
+  bool queued() const
+  {
+    return std::any_of(m_streams.begin(), m_streams.end(),
+                       [](std::pair<const stream_id, stream_state> const& e) { return !e.second.messages.empty(); });
+  }
+  // streams with state kept: sending, receiving or owed credit.
+  std::size_t streams() const
+  {
+    return m_streams.size();
+  }
+  bool pending() const
+  {
+    return !m_grants.empty() ||
+      (m_send_credit > 0 && std::any_of(m_active.begin(), m_active.end(),
+                                        [](std::deque<stream_id> const& l) { return !l.empty(); }));
+  }
+
+private:
+  struct stream_state
+  {
+    std::deque<std::string> messages;
+    std::size_t offset = 0;
+    std::uint32_t credit = sc_stream_window;
+    std::uint8_t priority = sc_default_priority;
+    bool active = false;
+
+    std::string partial;
+    // what the peer may still send, and what it sent since the last grant.
+    std::uint32_t window = sc_stream_window;
+    std::uint32_t received = 0;
+
+    // nothing to send, receive or give back: the same as a new stream.
+    bool idle() const
+    {
+      return messages.empty() && !active && partial.empty() && credit == sc_stream_window
+             && window == sc_stream_window && received == 0 && priority == sc_default_priority;
+    }
+  };
+
+  stream_state& stream(stream_id _stream)
+  {
+    return m_streams[_stream];
+  }
+  void forget(stream_id _stream)
+  {
+    auto it = m_streams.find(_stream);
+    if (it != m_streams.end() && it->second.idle())
+    {
+      m_streams.erase(it);
+    }
+  }
+  // a stream is scheduled while it has data and credit.
+  void activate(stream_id _id, stream_state& _stream)
+  {
+    if (!_stream.active && !_stream.messages.empty() && _stream.credit > 0)
+    {
+      _stream.active = true;
+      m_active[_stream.priority].push_back(_id);
+    }
+  }
+  // credit the peer gives back; more than sc_max_credit outstanding is an
+  // error, as is credit for a stream this side never sent on.
+  bool grant(stream_id _stream, std::uint32_t _credit)
+  {
+    if (_stream == frame_header::sc_connection)
+    {
+      if (_credit > sc_max_credit - m_send_credit)
+      {
+        return false;
+      }
+      m_send_credit += _credit;
+      return true;
+    }
+    auto it = m_streams.find(_stream);
+    if (it == m_streams.end() || _credit > sc_max_credit - it->second.credit)
+    {
+      return false;
+    }
+    auto& s = it->second;
+    s.credit += _credit;
+    activate(_stream, s);
+    forget(_stream);
+    return true;
+  }
+  static void append_header(std::string& _out, frame_header const& _header)
+  {
+    _out.resize(_out.size() + frame_header::sc_size);
+    _header.write(&_out[_out.size() - frame_header::sc_size]);
+  }
+
+private:
+  deliver_handler m_deliver;
+  std::unordered_map<stream_id, stream_state> m_streams;
+  std::array<std::deque<stream_id>, sc_priorities> m_active;
+  std::uint32_t m_send_credit;
+
+  std::vector<std::pair<stream_id, std::uint32_t>> m_grants;
+  // as stream_state::window and received, for the whole connection.
+  std::uint32_t m_window;
+  std::uint32_t m_received;
+};
+
+} // namespace sv::net::mux
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_MUX_HPP__
@@ -0,0 +1,758 @@
+#ifndef __SV_NET_PACKET_HPP__
+#define __SV_NET_PACKET_HPP__
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "sv/base.hpp"
+#include "sv/net/checksum.hpp"
+#include "sv/net/define.hpp"
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace packet
+{
+
+enum type : std::uint32_t
+{
+  empty_body_type = 0,
+  string_body_type,
+  binary_body_type,
+
+  // struct bodies use struct_body_type + schema<T>::id.
+  struct_body_type = 0x100,
+};
+
+#pragma pack(push)
+#pragma pack(1)
+struct header
+{
+  std::uint32_t tag;
+  std::uint32_t version;
+  std::uint32_t type;
+  std::uint64_t length;
+};
+// follows the header when the version has base::sc_traced set, and counts in
+// its length: the trace-id, parent-id and flags of a W3C traceparent. a
+// crc32c of the body (std::uint32_t) comes next when sc_checksummed is set.
+struct trace_context
+{
+  static const std::uint8_t sc_sampled = 0x01;
+
+  std::uint64_t trace_high;
+  std::uint64_t trace_low;
+  std::uint64_t span;
+  std::uint8_t flags;
+};
+#pragma pack(pop)
+
+template<class Body>
+struct basic;
+
+struct SV_NET_API base : public id_holder<base>
+{
+  using self = base;
+  using ptr = std::shared_ptr<self>;
+
+  static const std::uint32_t sc_tag = 0x12538253;
+  static const std::uint32_t sc_header_size = sizeof(header);
+  static const std::uint32_t sc_traced = 0x10000;
+  static const std::uint32_t sc_checksummed = 0x20000;
+  // the high half of version holds flags; only these are known.
+  static const std::uint32_t sc_flags = 0xffff0000;
+  static const std::uint32_t sc_known_flags = sc_traced | sc_checksummed;
+  // the largest whole message, header included, a peer may announce.
+  static const std::uint64_t sc_max_length = 64 * 1024 * 1024;
+
+  template<class Derived, class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::dynamic_pointer_cast<self>(std::make_shared<Derived>(std::forward<Args>(args)...));
+  }
+
+  virtual void read_header(std::istream&) = 0;
+  virtual void read_body(std::istream&) = 0;
+
+  virtual void write_header(std::ostream&) = 0;
+  virtual void write_body(std::ostream&) = 0;
+
+  virtual std::size_t get_body_size() const = 0;
+
+  // the whole message as it goes over the wire, if the packet already holds
+  // it (encoded_packet); protocols then write these bytes as they are.
+  virtual const std::string* encoded() const
+  {
+    return nullptr;
+  }
+  // the get_body_size() bytes of the body as they go over the wire, if the
+  // packet keeps them that way (struct bodies, encoded_packet).
+  virtual const char* body_data() const
+  {
+    return nullptr;
+  }
+  // where a received body can be read to in place of read_body; nullptr if
+  // the body has to be parsed.
+  virtual char* body_buffer()
+  {
+    return nullptr;
+  }
+
+  header get_header() const
+  {
+    return m_header;
+  }
+
+  bool traced() const
+  {
+    return (m_header.version & sc_traced) != 0;
+  }
+  trace_context const& get_trace() const
+  {
+    return m_trace;
+  }
+  // before the packet is sent; see trace::tracer::start.
+  void set_trace(trace_context const& _trace)
+  {
+    if (!traced())
+    {
+      m_header.version |= sc_traced;
+      m_header.length += sizeof(trace_context);
+    }
+    m_trace = _trace;
+  }
+  bool checksummed() const
+  {
+    return (m_header.version & sc_checksummed) != 0;
+  }
+  // the crc32c of the body as received.
+  std::uint32_t get_checksum() const
+  {
+    return m_checksum;
+  }
+  // _body, the get_body_size() bytes received, matches the checksum if the
+  // packet has one.
+  bool verify(const char* _body) const
+  {
+    return !checksummed() || checksum::crc32c(_body, get_body_size()) == m_checksum;
+  }
+  // before the packet is sent. the body's crc32c is computed as the packet is
+  // written and checked by the receiver, which drops the session on a mismatch.
+  void set_checksum()
+  {
+    if (!checksummed())
+    {
+      m_header.version |= sc_checksummed;
+      m_header.length += sizeof(std::uint32_t);
+    }
+  }
+  // bytes between the header and the body.
+  std::size_t get_extension_size() const
+  {
+    return extension_size(m_header);
+  }
+  static std::size_t extension_size(header const& _header)
+  {
+    return ((_header.version & sc_traced) != 0 ? sizeof(trace_context) : 0)
+           + ((_header.version & sc_checksummed) != 0 ? sizeof(std::uint32_t) : 0);
+  }
+  // the tag matches, no unknown flag is set, and the length has room for the
+  // extensions but is at most sc_max_length. checked before anything is
+  // allocated for the body: the length comes from the peer.
+  static bool valid(header const& _header)
+  {
+    return _header.tag == sc_tag && (_header.version & sc_flags & ~sc_known_flags) == 0
+           && _header.length >= sc_header_size + extension_size(_header) && _header.length <= sc_max_length;
+  }
+  void read_extension(std::istream& is)
+  {
+    if (traced())
+    {
+      is.read(reinterpret_cast<char*>(&m_trace), sizeof(trace_context));
+    }
+    if (checksummed())
+    {
+      is.read(reinterpret_cast<char*>(&m_checksum), sizeof(m_checksum));
+    }
+  }
+  void write_extension(std::ostream& os)
+  {
+    if (traced())
+    {
+      os.write(reinterpret_cast<const char*>(&m_trace), sizeof(trace_context));
+    }
+    if (checksummed())
+    {
+      auto crc = body_checksum();
+      os.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    }
+  }
+
+protected:
+  // the crc32c of the body as it will be written.
+  virtual std::uint32_t body_checksum()
+  {
+    return m_checksum;
+  }
+
+  base(id_type const& _session_id)
+    : m_trace()
+    , m_checksum(0)
+    , m_session_id(_session_id)
+  {
+    m_header.tag = sc_tag;
+    m_header.version = 1;
+    m_header.type = empty_body_type;
+    m_header.length = sc_header_size;
+  }
+  base(id_type const& _session_id, header const& _header)
+    : m_header(_header)
+    , m_trace()
+    , m_checksum(0)
+    , m_session_id(_session_id)
+  {
+  }
+
+protected:
+  header m_header;
+  trace_context m_trace;
+  std::uint32_t m_checksum;
+  id_type m_session_id;
+};
+
+namespace detail
+{
+// write-only streambuf that keeps the crc32c of what goes through it.
+struct checksum_sink : public std::streambuf
+{
+  std::uint32_t crc = 0;
+
+protected:
+  std::streamsize xsputn(const char* _data, std::streamsize _size) override
+  {
+    crc = checksum::crc32c(_data, static_cast<std::size_t>(_size), crc);
+    return _size;
+  }
+  int_type overflow(int_type _c) override
+  {
+    if (!traits_type::eq_int_type(_c, traits_type::eof()))
+    {
+      char c = traits_type::to_char_type(_c);
+      crc = checksum::crc32c(&c, 1, crc);
+    }
+    return traits_type::not_eof(_c);
+  }
+};
+} // namespace sv::net::packet::detail
+
+template<class Body>
+struct basic : public base
+{
+  using body_type = Body;
+
+  using self = basic<body_type>;
+  using ptr = std::shared_ptr<base>;
+  using value_type = typename Body::value_type;
+  using base_ptr = typename base::ptr;
+
+  template<class...Args>
+  static base_ptr make(Args&&...args)
+  {
+    return base::make<self>(std::forward<Args>(args)...);
+  }
+
+  basic(value_type const& v, id_type const& _session_id)
+    : base(_session_id)
+    , m_value(v)
+  {
+    m_header.type = Body::body_type;
+    m_body_size = Body::get_body_size(m_value);
+    m_header.length += m_body_size;
+  }
+  basic(id_type const& _session_id)
+    : base(_session_id)
+    , m_body_size(0)
+  {
+  }
+  basic(id_type const& _session_id, header const& _header)
+    : base(_session_id, _header)
+    , m_body_size(std::size_t(_header.length - sc_header_size - get_extension_size()))
+  {
+  }
+  virtual void read_header(std::istream& is) override
+  {
+    Body::read_header(is, m_header);
+  }
+  virtual void read_body(std::istream& is) override
+  {
+    Body::read(is, m_value, m_body_size);
+  }
+
+  virtual void write_header(std::ostream& os) override
+  {
+    Body::write_header(os, m_header);
+    write_extension(os);
+  }
+  virtual void write_body(std::ostream& os) override
+  {
+    Body::write(os, m_value);
+  }
+
+  virtual std::size_t get_body_size() const override
+  {
+    return m_body_size;
+  }
+  virtual const char* body_data() const override
+  {
+    if constexpr (std::is_same<value_type, flat_buffer>::value)
+      return m_value.data();
+    else
+      return nullptr;
+  }
+  virtual char* body_buffer() override
+  {
+    if constexpr (std::is_same<value_type, flat_buffer>::value)
+    {
+      m_value.bytes().resize(m_body_size);
+      return &m_value.bytes()[0];
+    }
+    else
+    {
+      return nullptr;
+    }
+  }
+
+  value_type const& get_value() const
+  {
+    return m_value;
+  }
+
+protected:
+  virtual std::uint32_t body_checksum() override
+  {
+    detail::checksum_sink sink;
+    std::ostream os(&sink);
+    Body::write(os, m_value);
+    return sink.crc;
+  }
+
+private:
+  value_type m_value;
+
+  std::size_t m_body_size;
+};
+
+namespace v1
+{
+struct void_t {};
+struct empty_body
+{
+  using value_type = void_t;
+
+  static const std::uint32_t body_type = empty_body_type;
+
+  static void read_header(std::istream& is, header& pkt)
+  {
+    is.read(reinterpret_cast<char*>(&pkt), sizeof(header));
+  }
+  static void write_header(std::ostream& os, header const& pkt)
+  {
+    os.write(reinterpret_cast<const char*>(&pkt), sizeof(header));
+  }
+  static void read(std::istream& is, value_type& value, std::size_t length)
+  {
+  }
+  static void write(std::ostream& os, value_type const& value)
+  {
+  }
+  static std::size_t get_body_size(value_type const& _value)
+  {
+    return 0;
+  }
+};
+struct string_body
+{
+  using value_type = std::string;
+
+  static const std::uint32_t body_type = string_body_type;
+
+  static void read_header(std::istream& is, header& pkt)
+  {
+    is.read(reinterpret_cast<char*>(&pkt), sizeof(header));
+  }
+  static void write_header(std::ostream& os, header const& pkt)
+  {
+    os.write(reinterpret_cast<const char*>(&pkt), sizeof(header));
+  }
+  static void read(std::istream& is, value_type& value, std::size_t length)
+  {
+    value.resize(length);
+    is.read(&value[0], length);
+  }
+  static void write(std::ostream& os, value_type const& value)
+  {
+    os.write(value.c_str(), value.length());
+  }
+  static std::size_t get_body_size(value_type const& _value)
+  {
+    return std::size_t(_value.length());
+  }
+};
+struct binary_body
+{
+  using value_type = std::string;
+
+  static const std::uint32_t body_type = binary_body_type;
+
+  static void read_header(std::istream& is, header& pkt)
+  {
+    is.read(reinterpret_cast<char*>(&pkt), sizeof(header));
+  }
+  static void write_header(std::ostream& os, header const& pkt)
+  {
+    os.write(reinterpret_cast<const char*>(&pkt), sizeof(header));
+  }
+  // the body goes to a new file in the temp directory, which value names
+  // and the receiver removes. the bytes are consumed even if it cannot be
+  // opened.
+  static void read(std::istream& is, value_type& value, std::size_t length)
+  {
+    value = spool_path();
+    std::ofstream file(value, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    std::vector<char> buffer(std::min<std::size_t>(length, 4096), 0x00);
+    while (length > 0 && is)
+    {
+      auto to_read = std::min(length, buffer.size());
+      is.read(&buffer[0], to_read);
+      auto got = static_cast<std::size_t>(is.gcount());
+      if (file.good())
+      {
+        file.write(&buffer[0], got);
+      }
+      length -= got;
+    }
+  }
+  static void write(std::ostream& os, value_type const& value)
+  {
+    std::ifstream file(value, std::ios::in | std::ios::binary);
+    if (!file.good())
+    {
+      return;
+    }
+
+    std::vector<char> buffer(4096, 0x00);
+    while (file)
+    {
+      file.read(&buffer[0], buffer.size());
+      os.write(&buffer[0], file.gcount());
+    }
+  }
+  static std::size_t get_body_size(value_type const& _value)
+  {
+    std::fstream file(_value, std::ios::in | std::ios::binary);
+    if (!file.good())
+    {
+      return std::size_t(0);
+    }
+    file.seekg(0, std::ios::end);
+    return std::size_t(file.tellg());
+  }
+
+private:
+  static std::string spool_path()
+  {
+    std::random_device random;
+    std::uint64_t name = (std::uint64_t(random()) << 32) | random();
+    std::ostringstream ss;
+    ss << "sv.net.binary." << std::hex << name;
+    std::error_code ec;
+    return (std::filesystem::temp_directory_path(ec) / ss.str()).string();
+  }
+};
+template<class T = void>
+struct struct_body
+{
+  using value_type = flat_buffer;
+
+  static const std::uint32_t body_type = struct_body_type + schema<T>::id;
+  static_assert(schema<T>::id <= 0xffffffff - struct_body_type, "schema id out of range");
+
+  static void read_header(std::istream& is, header& pkt)
+  {
+    is.read(reinterpret_cast<char*>(&pkt), sizeof(header));
+  }
+  static void write_header(std::ostream& os, header const& pkt)
+  {
+    os.write(reinterpret_cast<const char*>(&pkt), sizeof(header));
+  }
+  static void read(std::istream& is, value_type& value, std::size_t length)
+  {
+    value.bytes().resize(length);
+    is.read(&value.bytes()[0], length);
+  }
+  static void write(std::ostream& os, value_type const& value)
+  {
+    os.write(value.data(), value.size());
+  }
+  static std::size_t get_body_size(value_type const& _value)
+  {
+    return _value.size();
+  }
+};
+} // namespace sv::net::packet::v1
+
+namespace latest
+{
+using empty_body = v1::empty_body;
+using string_body = v1::string_body;
+using binary_body = v1::binary_body;
+template<class T = void>
+using struct_body = v1::struct_body<T>;
+} // namespace sv::net::packet::latest
+
+using empty_packet = basic<latest::empty_body>;
+using string_packet = basic<latest::string_body>;
+using binary_packet = basic<latest::binary_body>;
+template<class T = void>
+using struct_packet = basic<latest::struct_body<T>>;
+
+////////////////////////////////////////////////////////////////////////////////
+// encoded_packet
+//
+// a message serialized once and shared, for sending the same bytes to many
+// sessions (broker fan-out): no session serializes it again, and base writes
+// it straight from the shared buffer. only for sending.
+////////////////////////////////////////////////////////////////////////////////
+struct encoded_packet : public base
+{
+  using self = encoded_packet;
+  using bytes_ptr = std::shared_ptr<const std::string>;
+  using base_ptr = typename base::ptr;
+
+  template<class...Args>
+  static base_ptr make(Args&&...args)
+  {
+    return base::make<self>(std::forward<Args>(args)...);
+  }
+
+  // _bytes is a whole message, as returned by serialize().
+  encoded_packet(bytes_ptr _bytes, id_type const& _session_id)
+    : base(_session_id, header_of(*_bytes))
+    , m_bytes(std::move(_bytes))
+  {
+    if (traced())
+    {
+      std::memcpy(&m_trace, m_bytes->data() + sizeof(header), sizeof(trace_context));
+    }
+    if (checksummed())
+    {
+      std::memcpy(&m_checksum, m_bytes->data() + sizeof(header) + get_extension_size() - sizeof(m_checksum),
+                  sizeof(m_checksum));
+    }
+  }
+  virtual void read_header(std::istream&) override
+  {
+  }
+  virtual void read_body(std::istream&) override
+  {
+  }
+  virtual void write_header(std::ostream& os) override
+  {
+    os.write(m_bytes->data(), sizeof(header) + get_extension_size());
+  }
+  virtual void write_body(std::ostream& os) override
+  {
+    auto offset = sizeof(header) + get_extension_size();
+    os.write(m_bytes->data() + offset, m_bytes->size() - offset);
+  }
+  virtual std::size_t get_body_size() const override
+  {
+    return m_bytes->size() - sizeof(header) - get_extension_size();
+  }
+  virtual const char* body_data() const override
+  {
+    return m_bytes->data() + sizeof(header) + get_extension_size();
+  }
+  virtual const std::string* encoded() const override
+  {
+    return m_bytes.get();
+  }
+
+private:
+  static header header_of(std::string const& _bytes)
+  {
+    header h;
+    std::memcpy(&h, _bytes.data(), sizeof(header));
+    return h;
+  }
+
+private:
+  bytes_ptr m_bytes;
+};
+
+template<class T>
+bool is_struct_of(header const& _header)
+{
+  return _header.type == struct_body_type + schema_id<T>();
+}
+// the T in a struct packet, received or built; false if it is something else
+// or not a valid T. _data and _size point into _packet.
+template<class T>
+bool view_of(base& _packet, const char*& _data, std::size_t& _size)
+{
+  if (!is_struct_of<T>(_packet.get_header()))
+  {
+    return false;
+  }
+  auto* data = _packet.body_data();
+  if (data == nullptr || !struct_view<T>(data, _packet.get_body_size()).valid())
+  {
+    return false;
+  }
+  _data = data;
+  _size = _packet.get_body_size();
+  return true;
+}
+
+// creates the packet matching a received header, ready for read_body.
+inline base::ptr from_header(id_type const& _session_id, header const& _header)
+{
+  if (_header.type == string_body_type)
+  {
+    return string_packet::make(_session_id, _header);
+  }
+  else if (_header.type == binary_body_type)
+  {
+    return binary_packet::make(_session_id, _header);
+  }
+  else if (_header.type >= struct_body_type)
+  {
+    return struct_packet<>::make(_session_id, _header);
+  }
+  return empty_packet::make(_session_id, _header);
+}
+
+namespace detail
+{
+// read-only streambuf over bytes owned by someone else.
+struct memory_buffer : public std::streambuf
+{
+  memory_buffer(const char* _data, std::size_t _size)
+  {
+    reset(_data, _size);
+  }
+  void reset(const char* _data, std::size_t _size)
+  {
+    auto p = const_cast<char*>(_data);
+    setg(p, p, p + _size);
+  }
+};
+// write-only streambuf over bytes owned by someone else; stops at the end.
+struct memory_sink : public std::streambuf
+{
+  memory_sink(char* _data, std::size_t _size)
+  {
+    reset(_data, _size);
+  }
+  void reset(char* _data, std::size_t _size)
+  {
+    setp(_data, _data + _size);
+  }
+  std::size_t written() const
+  {
+    return static_cast<std::size_t>(pptr() - pbase());
+  }
+};
+// the thread's one stream over _data, so that parsing and serializing a
+// message constructs no iostream. valid until the next call on the thread.
+inline std::istream& reader(const char* _data, std::size_t _size)
+{
+  thread_local memory_buffer buffer(nullptr, 0);
+  thread_local std::istream is(&buffer);
+  buffer.reset(_data, _size);
+  is.clear();
+  return is;
+}
+inline std::ostream& writer(char* _data, std::size_t _size)
+{
+  thread_local memory_sink sink(nullptr, 0);
+  thread_local std::ostream os(&sink);
+  sink.reset(_data, _size);
+  os.clear();
+  return os;
+}
+} // namespace sv::net::packet::detail
+
+// header and body as one contiguous message.
+inline std::string serialize(base& _packet)
+{
+  if (auto* bytes = _packet.encoded())
+  {
+    return *bytes;
+  }
+  std::ostringstream os;
+  _packet.write_header(os);
+  _packet.write_body(os);
+  return os.str();
+}
+// the same into _out, which has room for get_header().length bytes. returns
+// the bytes written.
+inline std::size_t serialize(base& _packet, char* _out, std::size_t _size)
+{
+  if (auto* bytes = _packet.encoded())
+  {
+    auto size = std::min(bytes->size(), _size);
+    std::memcpy(_out, bytes->data(), size);
+    return size;
+  }
+  auto& os = detail::writer(_out, _size);
+  _packet.write_header(os);
+  _packet.write_body(os);
+  return static_cast<detail::memory_sink*>(os.rdbuf())->written();
+}
+// parses exactly one message; nullptr if the bytes are not a whole packet.
+inline base::ptr deserialize(id_type const& _session_id, const char* _data, std::size_t _size)
+{
+  if (_size < sizeof(header))
+  {
+    return nullptr;
+  }
+
+  header h;
+  std::memcpy(&h, _data, sizeof(header));
+  if (!base::valid(h) || h.length != _size)
+  {
+    return nullptr;
+  }
+
+  auto packet = from_header(_session_id, h);
+  auto& is = detail::reader(_data + sizeof(header), _size - sizeof(header));
+  packet->read_extension(is);
+  if (!packet->verify(_data + sizeof(header) + packet->get_extension_size()))
+  {
+    return nullptr;
+  }
+  packet->read_body(is);
+  return packet;
+}
+
+} // namespace sv::net::packet
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_PACKET_HPP__
\ No newline at end of file
@@ -0,0 +1,1278 @@
+#ifndef __SV_NET_PROTOCOL_HPP__
+#define __SV_NET_PROTOCOL_HPP__
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <memory>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#include "sv/base.hpp"
+#include "sv/net/admission.hpp"
+#include "sv/net/capture.hpp"
+#include "sv/net/mux.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/reliable.hpp"
+#include "sv/net/trace.hpp"
+#include "sv/net/udp.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace protocol
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+using tcp = asio::ip::tcp;
+
+using namespace std::placeholders;
+using namespace std::literals::chrono_literals;
+
+namespace detail
+{
+
+// per-thread free lists of I/O buffers in power-of-two sizes from 256 bytes
+// to 64 KiB; larger ones are allocated for the one read or write.
+class pool
+{
+public:
+  static constexpr std::size_t sc_smallest = 256;
+  static constexpr std::size_t sc_classes = 9;
+  static constexpr std::size_t sc_kept = 16;
+
+  // _size is raised to the size of the buffer returned.
+  static char* take(std::size_t& _size)
+  {
+    auto n = class_of(_size);
+    if (n == sc_classes)
+    {
+      return new char[_size];
+    }
+    _size = sc_smallest << n;
+    auto* p = instance();
+    if (p != nullptr && !p->m_free[n].empty())
+    {
+      auto* data = p->m_free[n].back();
+      p->m_free[n].pop_back();
+      return data;
+    }
+    return new char[_size];
+  }
+  static void give(char* _data, std::size_t _size)
+  {
+    auto n = class_of(_size);
+    auto* p = n < sc_classes ? instance() : nullptr;
+    if (p != nullptr && p->m_free[n].size() < sc_kept)
+    {
+      p->m_free[n].push_back(_data);
+      return;
+    }
+    delete[] _data;
+  }
+
+  pool()
+  {
+    for (auto& e : m_free)
+    {
+      e.reserve(sc_kept);
+    }
+  }
+  ~pool()
+  {
+    // sessions destroyed later in the thread's exit free their buffers.
+    gone() = true;
+    for (auto& e : m_free)
+    {
+      for (auto* data : e)
+      {
+        delete[] data;
+      }
+    }
+  }
+
+private:
+  static std::size_t class_of(std::size_t _size)
+  {
+    std::size_t n = 0;
+    while (n < sc_classes && (sc_smallest << n) < _size)
+    {
+      ++n;
+    }
+    return n;
+  }
+  static bool& gone()
+  {
+    thread_local bool value = false;
+    return value;
+  }
+  static pool* instance()
+  {
+    if (gone())
+    {
+      return nullptr;
+    }
+    thread_local pool value;
+    return &value;
+  }
+
+private:
+  std::vector<char*> m_free[sc_classes];
+};
+
+// bytes borrowed from the thread's pool for one read or write; an idle
+// session holds none.
+class buffer
+{
+public:
+  buffer()
+    : m_data(nullptr)
+    , m_size(0)
+  {
+  }
+  buffer(buffer const&) = delete;
+  buffer& operator=(buffer const&) = delete;
+  ~buffer()
+  {
+    release();
+  }
+  char* data() const
+  {
+    return m_data;
+  }
+  // room for at least _size bytes; what the buffer held is lost.
+  void reserve(std::size_t _size)
+  {
+    if (_size <= m_size)
+    {
+      return;
+    }
+    release();
+    m_size = _size;
+    m_data = pool::take(m_size);
+  }
+  void release()
+  {
+    if (m_data != nullptr)
+    {
+      pool::give(m_data, m_size);
+      m_data = nullptr;
+      m_size = 0;
+    }
+  }
+
+private:
+  char* m_data;
+  std::size_t m_size;
+};
+
+// a queue that allocates nothing until used and gives its memory back when
+// it drains, unlike std::deque, which allocates a block when constructed.
+template<class T>
+class fifo
+{
+public:
+  static constexpr std::size_t sc_kept = 4;
+  static constexpr std::size_t sc_compact = 32;
+
+  bool empty() const
+  {
+    return m_head == m_items.size();
+  }
+  std::size_t size() const
+  {
+    return m_items.size() - m_head;
+  }
+  T& front()
+  {
+    return m_items[m_head];
+  }
+  void push_back(T _value)
+  {
+    m_items.push_back(std::move(_value));
+  }
+  void pop_front()
+  {
+    m_items[m_head++] = T();
+    if (m_head == m_items.size())
+    {
+      m_head = 0;
+      m_items.clear();
+      if (m_items.capacity() > sc_kept)
+      {
+        m_items.shrink_to_fit();
+      }
+    }
+    else if (m_head >= sc_compact && m_head * 2 >= m_items.size())
+    {
+      m_items.erase(m_items.begin(), m_items.begin() + std::ptrdiff_t(m_head));
+      m_head = 0;
+    }
+  }
+
+private:
+  std::vector<T> m_items;
+  std::size_t m_head = 0;
+};
+
+} // namespace sv::net::protocol::detail
+
+template<class Packet, class Socket = tcp::socket>
+struct base
+{
+  using packet_type = Packet;
+  using packet_t = typename packet_type::ptr;
+  using socket_type = Socket;
+  using self = base<Packet, Socket>;
+  using ptr = std::shared_ptr<self>;
+  using handler_type = std::function<void(packet_t)>;
+  using close_handler = std::function<void(error_code const&)>;
+  using flush_handler = std::function<void()>;
+
+  // the same protocol over another stream type (see engine::basic_session).
+  template<class S>
+  using rebind = base<Packet, S>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  base(socket_type& _socket, id_type _session_id)
+    : r_socket(_socket)
+    , m_header()
+    , m_writing(false)
+    , m_session_id(_session_id)
+  {
+  }
+  virtual ~base()
+  {
+  }
+  // set by the session that owns the socket. every pending operation holds
+  // it, so the session outlives the handlers still queued for it.
+  void set_owner(std::weak_ptr<void> _owner)
+  {
+    m_owner = std::move(_owner);
+  }
+  void read()
+  {
+    do_read();
+  }
+  void write()
+  {
+    do_write();
+  }
+  // thread-safe. the packet is queued and written on the socket's executor.
+  void send(packet_t packet)
+  {
+    auto queued = m_tracing && trace::sampled(*packet) ? trace::clock::now() : trace::clock::time_point();
+    asio::post(r_socket.get_executor(),
+               [this, owner = m_owner.lock(), packet, queued]()
+               {
+                 if (queued != trace::clock::time_point())
+                 {
+                   m_tracing->writes.push_back({ packet.get(), queued, queued });
+                 }
+                 m_write_depot.push_back(packet);
+                 if (!m_writing)
+                 {
+                   do_write();
+                 }
+               });
+  }
+  // set before the session executes. received packets are handed to it on
+  // the socket's executor; without a handler they are kept for try_receive.
+  void on_receive(handler_type _handler)
+  {
+    m_handler = std::move(_handler);
+  }
+  bool try_receive(packet_t& packet)
+  {
+    std::lock_guard<std::mutex> lock(m_read_mutex);
+    if (m_read_depot.empty())
+    {
+      return false;
+    }
+    packet = m_read_depot.front();
+    m_read_depot.pop_front();
+    return true;
+  }
+  // set before the session executes. called once, on the socket's executor,
+  // when reading stops because the peer closed or the socket failed. every
+  // handler set runs, in order: the acceptor's and on_session's.
+  void on_close(close_handler _handler)
+  {
+    m_on_close.push_back(std::move(_handler));
+  }
+  // set before the session executes. reading pauses while the session is
+  // over its message or byte rate.
+  void set_throttle(admission::throttle const& _throttle)
+  {
+    if (!_throttle.enabled())
+    {
+      m_throttling.reset();
+      return;
+    }
+    m_throttling.reset(new throttling{ _throttle, asio::steady_timer(r_socket.get_executor()) });
+  }
+#if defined(SV_NET_HAS_CAPTURE)
+  // set before the session executes. every packet read, and every packet as
+  // it is written, is appended to _log; the log may be shared by sessions.
+  void set_capture(capture::writer::ptr _log)
+  {
+    m_capture = std::move(_log);
+  }
+#endif // SV_NET_HAS_CAPTURE
+  // set before the session executes. sampled packets (see trace::tracer)
+  // record their send and receive spans to _tracer; it may be shared.
+  void set_tracer(trace::tracer::ptr _tracer)
+  {
+    if (!_tracer)
+    {
+      m_tracing.reset();
+      return;
+    }
+    m_tracing.reset(new tracing{ std::move(_tracer), {}, {} });
+  }
+  // on the socket's executor. _handler runs once every packet sent so far
+  // is written, or writing has failed; at once if nothing is queued.
+  void flush(flush_handler _handler)
+  {
+    m_on_flushed.push_back(std::move(_handler));
+    if (!m_writing)
+    {
+      on_flushed();
+    }
+  }
+private:
+  // _handler, holding the owner until it has run.
+  template<class Handler>
+  auto hold(Handler&& _handler)
+  {
+    return [owner = m_owner.lock(), handler = std::forward<Handler>(_handler)](auto&&...args) mutable
+    {
+      handler(std::forward<decltype(args)>(args)...);
+    };
+  }
+  void do_read()
+  {
+    do_read_header();
+  }
+  void do_read_header()
+  {
+    asio::async_read(r_socket,
+                     asio::buffer(&m_header, sizeof(m_header)),
+                     hold(std::bind(&self::on_read_header, this, _1, _2)));
+  }
+  void on_read_header(error_code const& ec, std::size_t bytes)
+  {
+    if (!!ec)
+    {
+      on_error(ec, "read_header");
+      on_closed(ec);
+      return;
+    }
+
+    // not a header: the stream lost its framing and nothing after it can be
+    // trusted, so the session ends as on a read error.
+    if (!packet_type::valid(m_header))
+    {
+      on_corrupted("read_header");
+      return;
+    }
+    packet_t packet = packet::from_header(m_session_id, m_header);
+    if (m_tracing && packet->traced())
+    {
+      m_tracing->arrived = trace::clock::now();
+    }
+
+    do_read_body(packet);
+  }
+  void do_read_body(packet_t packet)
+  {
+    // extensions and body, into a buffer borrowed until they are parsed.
+    auto size = std::size_t(m_header.length - packet_type::sc_header_size);
+    if (size == 0)
+    {
+      on_read_body(error_code(), 0, packet, false);
+      return;
+    }
+    // a body the packet keeps as it is (struct bodies) is read straight into
+    // it; only the extensions go through the buffer.
+    auto extension = packet->get_extension_size();
+    if (char* body = packet->body_buffer())
+    {
+      m_read_buffer.reserve(extension);
+      std::array<asio::mutable_buffer, 2> buffers{ { asio::buffer(m_read_buffer.data(), extension),
+                                                     asio::buffer(body, size - extension) } };
+      asio::async_read(r_socket, buffers, hold(std::bind(&self::on_read_body, this, _1, _2, packet, true)));
+      return;
+    }
+    m_read_buffer.reserve(size);
+    asio::async_read(r_socket,
+                     asio::buffer(m_read_buffer.data(), size),
+                     hold(std::bind(&self::on_read_body, this, _1, _2, packet, false)));
+  }
+  void on_read_body(error_code const& ec, std::size_t bytes, packet_t packet, bool _in_place)
+  {
+    if (!!ec)
+    {
+      m_read_buffer.release();
+      on_error(ec, "read_body");
+      on_closed(ec);
+      return;
+    }
+
+    auto extension = packet->get_extension_size();
+    const char* data = m_read_buffer.data();
+    const char* body = _in_place ? packet->body_data() : data + extension;
+    auto& is = packet::detail::reader(data, _in_place ? extension : bytes);
+    packet->read_extension(is);
+    if (!packet->verify(body))
+    {
+      m_read_buffer.release();
+      on_corrupted("read_body");
+      return;
+    }
+    if (!_in_place)
+    {
+      packet->read_body(is);
+    }
+#if defined(SV_NET_HAS_CAPTURE)
+    if (m_capture)
+    {
+      m_capture->append(capture::direction::received, m_session_id,
+                        { asio::buffer(&m_header, packet_type::sc_header_size), asio::buffer(data, extension),
+                          asio::buffer(body, bytes - extension) });
+    }
+#endif // SV_NET_HAS_CAPTURE
+    m_read_buffer.release();
+    auto read = m_tracing && trace::sampled(*packet) ? trace::clock::now() : trace::clock::time_point();
+    if (m_handler)
+    {
+      auto dispatched = read != trace::clock::time_point() ? trace::clock::now() : read;
+      m_handler(packet);
+      if (read != trace::clock::time_point())
+      {
+        m_tracing->tracer->received(packet->get_trace(), m_session_id, m_tracing->arrived, read, dispatched,
+                                    trace::clock::now());
+      }
+    }
+    else
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_read_mutex);
+        m_read_depot.push_back(packet);
+      }
+      if (read != trace::clock::time_point())
+      {
+        m_tracing->tracer->received(packet->get_trace(), m_session_id, m_tracing->arrived, read, read, read);
+      }
+    }
+
+    if (m_throttling)
+    {
+      auto wait = m_throttling->throttle.consume(1, packet_type::sc_header_size + packet->get_body_size());
+      if (wait > wait.zero())
+      {
+        m_throttling->timer.expires_after(wait);
+        m_throttling->timer.async_wait(hold(std::bind(&self::on_throttled, this, _1)));
+        return;
+      }
+    }
+    do_read();
+  }
+  void on_throttled(error_code const& ec)
+  {
+    if (!ec)
+    {
+      do_read();
+    }
+  }
+  void on_corrupted(const char* where)
+  {
+    auto ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+    on_error(ec, where);
+    on_closed(ec);
+  }
+  void on_closed(error_code const& ec)
+  {
+    auto handlers = std::move(m_on_close);
+    m_on_close.clear();
+    for (auto& e : handlers)
+    {
+      e(ec);
+    }
+  }
+  void on_flushed()
+  {
+    if (m_on_flushed.empty())
+    {
+      return;
+    }
+    auto handlers = std::move(m_on_flushed);
+    m_on_flushed.clear();
+    for (auto& e : handlers)
+    {
+      e();
+    }
+  }
+  void do_write()
+  {
+    if (m_write_depot.empty())
+    {
+      m_writing = false;
+      m_write_buffer.release();
+      on_flushed();
+      return;
+    }
+
+    packet_t packet = m_write_depot.front();
+    m_write_depot.pop_front();
+    m_writing = true;
+
+    do_write_packet(packet);
+  }
+  void do_write_packet(packet_t packet)
+  {
+    if (m_tracing && !m_tracing->writes.empty() && m_tracing->writes.front().packet == packet.get())
+    {
+      m_tracing->writes.front().written = trace::clock::now();
+    }
+    // shared with other sessions (packet::encoded_packet): written in place.
+    if (auto* bytes = packet->encoded())
+    {
+      capture_sent(bytes->data(), bytes->size());
+      asio::async_write(r_socket,
+                        asio::buffer(*bytes),
+                        hold(std::bind(&self::on_write_packet, this, _1, _2, packet)));
+      return;
+    }
+    // header and body go out in one write, from a buffer kept while packets
+    // are queued.
+    auto size = std::size_t(packet->get_header().length);
+    m_write_buffer.reserve(size);
+    size = packet::serialize(*packet, m_write_buffer.data(), size);
+    capture_sent(m_write_buffer.data(), size);
+    asio::async_write(r_socket,
+                      asio::buffer(m_write_buffer.data(), size),
+                      hold(std::bind(&self::on_write_packet, this, _1, _2, packet)));
+  }
+  // the bytes that go out, not the packet serialized again.
+  void capture_sent(const char* _data, std::size_t _size)
+  {
+#if defined(SV_NET_HAS_CAPTURE)
+    if (m_capture)
+    {
+      m_capture->append(capture::direction::sent, m_session_id, _data, _size);
+    }
+#endif // SV_NET_HAS_CAPTURE
+  }
+  void on_write_packet(error_code const& ec, std::size_t bytes, packet_t packet)
+  {
+    if (!!ec)
+    {
+      m_writing = false;
+      m_write_buffer.release();
+      on_error(ec, "write");
+      on_flushed();
+      return;
+    }
+    if (m_tracing && !m_tracing->writes.empty() && m_tracing->writes.front().packet == packet.get())
+    {
+      auto span = m_tracing->writes.front();
+      m_tracing->writes.pop_front();
+      m_tracing->tracer->sent(packet->get_trace(), m_session_id, span.queued, span.written, trace::clock::now());
+    }
+
+    do_write();
+  }
+  void on_error(error_code const& ec, const char* where)
+  {
+    std::stringstream ss;
+    ss << where << "::error[" << ec.value() << "]: " << ec.message() << '\n';
+    std::cerr << ss.str() << std::flush;
+  }
+
+private:
+  // sampled packets queued or being written, in the order of m_write_depot.
+  struct traced_write
+  {
+    const packet_type* packet;
+    trace::clock::time_point queued;
+    trace::clock::time_point written;
+  };
+  // what only throttled or traced sessions need, allocated when set.
+  struct throttling
+  {
+    admission::throttle throttle;
+    asio::steady_timer timer;
+  };
+  struct tracing
+  {
+    trace::tracer::ptr tracer;
+    detail::fifo<traced_write> writes;
+    trace::clock::time_point arrived;
+  };
+
+  socket_type& r_socket;
+  // the header being read; extensions and body go to m_read_buffer.
+  packet::header m_header;
+  detail::buffer m_read_buffer;
+  detail::buffer m_write_buffer;
+
+  detail::fifo<packet_t> m_write_depot;
+  detail::fifo<packet_t> m_read_depot;
+  std::mutex m_read_mutex;
+  bool m_writing;
+
+  handler_type m_handler;
+  std::vector<close_handler> m_on_close;
+  std::vector<flush_handler> m_on_flushed;
+#if defined(SV_NET_HAS_CAPTURE)
+  capture::writer::ptr m_capture;
+#endif // SV_NET_HAS_CAPTURE
+
+  std::unique_ptr<throttling> m_throttling;
+  std::unique_ptr<tracing> m_tracing;
+  std::weak_ptr<void> m_owner;
+  id_type m_session_id;
+};
+
+using basic = base<packet::base>;
+
+////////////////////////////////////////////////////////////////////////////////
+// mux_base
+//
+// base with logical streams multiplexed over the one connection (see
+// mux::connection). send(packet) uses stream 0; a bulk transfer on its own
+// stream no longer holds up the messages of the others.
+////////////////////////////////////////////////////////////////////////////////
+template<class Packet, class Socket = tcp::socket>
+struct mux_base
+{
+  using packet_type = Packet;
+  using packet_t = typename packet_type::ptr;
+  using socket_type = Socket;
+  using self = mux_base<Packet, Socket>;
+  using ptr = std::shared_ptr<self>;
+  using handler_type = std::function<void(packet_t)>;
+  using stream_handler_type = std::function<void(mux::stream_id, packet_t)>;
+  using close_handler = std::function<void(error_code const&)>;
+  using flush_handler = std::function<void()>;
+
+  // bytes handed to one async_write, the most a new message waits behind.
+  static constexpr std::size_t sc_write_budget = 64 * 1024;
+
+  template<class S>
+  using rebind = mux_base<Packet, S>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  mux_base(socket_type& _socket, id_type _session_id)
+    : r_socket(_socket)
+    , m_connection(std::bind(&self::on_message, this, _1, _2))
+    , m_writing(false)
+    , m_throttle_timer(_socket.get_executor())
+    , m_received(0)
+    , m_corrupted(false)
+    , m_session_id(_session_id)
+  {
+  }
+  virtual ~mux_base()
+  {
+  }
+  // see base::set_owner.
+  void set_owner(std::weak_ptr<void> _owner)
+  {
+    m_owner = std::move(_owner);
+  }
+  void read()
+  {
+    do_read_header();
+  }
+  void write()
+  {
+    do_write();
+  }
+  // thread-safe. the packet is serialized on the calling thread, so a large
+  // body does not stall the socket's executor.
+  void send(packet_t packet, mux::stream_id stream = 0)
+  {
+    auto message = std::make_shared<std::string>(packet::serialize(*packet));
+#if defined(SV_NET_HAS_CAPTURE)
+    if (m_capture)
+    {
+      m_capture->append(capture::direction::sent, m_session_id, message->data(), message->size());
+    }
+#endif // SV_NET_HAS_CAPTURE
+    asio::post(r_socket.get_executor(),
+               [this, owner = m_owner.lock(), message, stream]()
+               {
+                 m_connection.send(stream, std::move(*message));
+                 if (!m_writing)
+                 {
+                   do_write();
+                 }
+               });
+  }
+  // thread-safe. 0 is the most urgent, streams start at mux::connection::sc_default_priority.
+  void set_priority(mux::stream_id stream, std::uint8_t priority)
+  {
+    asio::post(r_socket.get_executor(),
+               [this, owner = m_owner.lock(), stream, priority]()
+               {
+                 m_connection.set_priority(stream, priority);
+               });
+  }
+  void on_receive(handler_type _handler)
+  {
+    m_handler = std::move(_handler);
+  }
+  // like on_receive, with the stream the packet arrived on.
+  void on_stream_receive(stream_handler_type _handler)
+  {
+    m_stream_handler = std::move(_handler);
+  }
+  bool try_receive(packet_t& packet)
+  {
+    std::lock_guard<std::mutex> lock(m_read_mutex);
+    if (m_read_depot.empty())
+    {
+      return false;
+    }
+    packet = m_read_depot.front();
+    m_read_depot.pop_front();
+    return true;
+  }
+  // see base::on_close.
+  void on_close(close_handler _handler)
+  {
+    m_on_close.push_back(std::move(_handler));
+  }
+  // see base::set_throttle; bytes count whole frames.
+  void set_throttle(admission::throttle const& _throttle)
+  {
+    m_throttle = _throttle;
+  }
+#if defined(SV_NET_HAS_CAPTURE)
+  // see base::set_capture. sent packets are logged when send() is called.
+  void set_capture(capture::writer::ptr _log)
+  {
+    m_capture = std::move(_log);
+  }
+#endif // SV_NET_HAS_CAPTURE
+  // see base::flush. messages held back by the peer's flow control are not
+  // written yet.
+  void flush(flush_handler _handler)
+  {
+    m_on_flushed.push_back(std::move(_handler));
+    if (!m_writing && !m_connection.queued())
+    {
+      on_flushed();
+    }
+  }
+private:
+  // see base::hold.
+  template<class Handler>
+  auto hold(Handler&& _handler)
+  {
+    return [owner = m_owner.lock(), handler = std::forward<Handler>(_handler)](auto&&...args) mutable
+    {
+      handler(std::forward<decltype(args)>(args)...);
+    };
+  }
+  void do_read_header()
+  {
+    asio::async_read(r_socket,
+                     asio::buffer(m_header),
+                     hold(std::bind(&self::on_read_header, this, _1, _2)));
+  }
+  void on_read_header(error_code const& ec, std::size_t bytes)
+  {
+    if (!!ec)
+    {
+      on_error(ec, "read_header");
+      on_closed(ec);
+      return;
+    }
+
+    // checked before the payload is allocated: the length comes from the peer.
+    auto header = mux::frame_header::read(m_header.data());
+    if (!mux::connection::valid(header))
+    {
+      on_corrupted("read_header");
+      return;
+    }
+    m_payload.resize(header.length);
+    asio::async_read(r_socket,
+                     asio::buffer(m_payload),
+                     hold(std::bind(&self::on_read_payload, this, _1, _2, header)));
+  }
+  void on_read_payload(error_code const& ec, std::size_t bytes, mux::frame_header header)
+  {
+    if (!!ec)
+    {
+      on_error(ec, "read_payload");
+      on_closed(ec);
+      return;
+    }
+
+    m_received = 0;
+    if (!m_connection.receive(header, m_payload.data()) || m_corrupted)
+    {
+      on_corrupted("read_payload");
+      return;
+    }
+    // credit granted back, or received, may have something to send.
+    if (!m_writing)
+    {
+      do_write();
+    }
+
+    if (m_throttle.enabled())
+    {
+      auto wait = m_throttle.consume(m_received, mux::frame_header::sc_size + m_payload.size());
+      if (wait > wait.zero())
+      {
+        m_throttle_timer.expires_after(wait);
+        m_throttle_timer.async_wait(hold(std::bind(&self::on_throttled, this, _1)));
+        return;
+      }
+    }
+    do_read_header();
+  }
+  void on_throttled(error_code const& ec)
+  {
+    if (!ec)
+    {
+      do_read_header();
+    }
+  }
+  // see base::on_corrupted; here the peer also broke flow control.
+  void on_corrupted(const char* where)
+  {
+    auto ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+    on_error(ec, where);
+    on_closed(ec);
+  }
+  void on_closed(error_code const& ec)
+  {
+    auto handlers = std::move(m_on_close);
+    m_on_close.clear();
+    for (auto& e : handlers)
+    {
+      e(ec);
+    }
+  }
+  void on_flushed()
+  {
+    if (m_on_flushed.empty())
+    {
+      return;
+    }
+    auto handlers = std::move(m_on_flushed);
+    m_on_flushed.clear();
+    for (auto& e : handlers)
+    {
+      e();
+    }
+  }
+  void on_message(mux::stream_id stream, std::string message)
+  {
+#if defined(SV_NET_HAS_CAPTURE)
+    if (m_capture)
+    {
+      m_capture->append(capture::direction::received, m_session_id, message.data(), message.size());
+    }
+#endif // SV_NET_HAS_CAPTURE
+    // the frames were sound but what they carried is not; as base does with
+    // a bad packet, the session ends once the payload is done.
+    packet_t packet = packet::deserialize(m_session_id, message.data(), message.size());
+    if (packet == nullptr || m_corrupted)
+    {
+      m_corrupted = true;
+      return;
+    }
+    ++m_received;
+
+    if (m_stream_handler)
+    {
+      m_stream_handler(stream, packet);
+    }
+    else if (m_handler)
+    {
+      m_handler(packet);
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(m_read_mutex);
+      m_read_depot.push_back(packet);
+    }
+  }
+  void do_write()
+  {
+    m_write_buffer.clear();
+    if (!m_connection.produce(m_write_buffer, sc_write_budget))
+    {
+      m_writing = false;
+      if (!m_on_flushed.empty() && !m_connection.queued())
+      {
+        on_flushed();
+      }
+      return;
+    }
+
+    m_writing = true;
+    asio::async_write(r_socket,
+                      asio::buffer(m_write_buffer),
+                      hold(std::bind(&self::on_write, this, _1, _2)));
+  }
+  void on_write(error_code const& ec, std::size_t bytes)
+  {
+    if (!!ec)
+    {
+      m_writing = false;
+      on_error(ec, "write");
+      on_flushed();
+      return;
+    }
+
+    do_write();
+  }
+  void on_error(error_code const& ec, const char* where)
+  {
+    std::stringstream ss;
+    ss << where << "::error[" << ec.value() << "]: " << ec.message() << '\n';
+    std::cerr << ss.str() << std::flush;
+  }
+
+private:
+  socket_type& r_socket;
+  mux::connection m_connection;
+  std::array<char, mux::frame_header::sc_size> m_header;
+  std::vector<char> m_payload;
+  std::string m_write_buffer;
+  bool m_writing;
+
+  admission::throttle m_throttle;
+  asio::steady_timer m_throttle_timer;
+  std::size_t m_received;
+  // a message in the last payload was not a packet.
+  bool m_corrupted;
+
+  std::deque<packet_t> m_read_depot;
+  std::mutex m_read_mutex;
+
+  handler_type m_handler;
+  stream_handler_type m_stream_handler;
+  std::vector<close_handler> m_on_close;
+  std::vector<flush_handler> m_on_flushed;
+#if defined(SV_NET_HAS_CAPTURE)
+  capture::writer::ptr m_capture;
+#endif // SV_NET_HAS_CAPTURE
+  std::weak_ptr<void> m_owner;
+  id_type m_session_id;
+};
+
+using mux_basic = mux_base<packet::base>;
+
+////////////////////////////////////////////////////////////////////////////////
+// datagram_base
+//
+// the same send/receive interface as base, one packet per datagram. there is
+// no retransmission or ordering: lost or malformed datagrams are dropped.
+////////////////////////////////////////////////////////////////////////////////
+template<class Packet>
+struct datagram_base
+{
+  using packet_type = Packet;
+  using packet_t = typename packet_type::ptr;
+  using socket_type = sv::net::datagram::socket;
+  using endpoint_type = socket_type::endpoint_type;
+  using self = datagram_base<Packet>;
+  using ptr = std::shared_ptr<self>;
+  using handler_type = std::function<void(packet_t)>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  datagram_base(socket_type& _socket, endpoint_type const& _peer, id_type _session_id)
+    : r_socket(_socket)
+    , m_peer(_peer)
+    , m_session_id(_session_id)
+  {
+  }
+  virtual ~datagram_base()
+  {
+  }
+  // thread-safe.
+  void send(packet_t packet)
+  {
+    r_socket.send(m_peer, packet::serialize(*packet));
+  }
+  void on_receive(handler_type _handler)
+  {
+    m_handler = std::move(_handler);
+  }
+  bool try_receive(packet_t& packet)
+  {
+    std::lock_guard<std::mutex> lock(m_read_mutex);
+    if (m_read_depot.empty())
+    {
+      return false;
+    }
+    packet = m_read_depot.front();
+    m_read_depot.pop_front();
+    return true;
+  }
+  // called by the node with one whole datagram.
+  void deliver(const char* data, std::size_t size)
+  {
+    packet_t packet = packet::deserialize(m_session_id, data, size);
+    if (packet == nullptr)
+    {
+      return;
+    }
+
+    if (m_handler)
+    {
+      m_handler(packet);
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(m_read_mutex);
+      m_read_depot.push_back(packet);
+    }
+  }
+  endpoint_type const& remote_endpoint() const
+  {
+    return m_peer;
+  }
+
+private:
+  socket_type& r_socket;
+  endpoint_type m_peer;
+
+  std::deque<packet_t> m_read_depot;
+  std::mutex m_read_mutex;
+
+  handler_type m_handler;
+  id_type m_session_id;
+};
+
+using datagram_basic = datagram_base<packet::base>;
+
+////////////////////////////////////////////////////////////////////////////////
+// reliable_base
+//
+// datagram_base with reliable::connection in between: messages are
+// acknowledged, retransmitted and, per stream, delivered in order. streams
+// default to reliable::mode::ordered; send(packet) uses stream 0.
+//
+// every call into the connection runs on the socket's executor, so send is
+// posted there and deliver is already called from there.
+////////////////////////////////////////////////////////////////////////////////
+template<class Packet>
+struct reliable_base : public std::enable_shared_from_this<reliable_base<Packet>>
+{
+  using packet_type = Packet;
+  using packet_t = typename packet_type::ptr;
+  using socket_type = sv::net::datagram::socket;
+  using endpoint_type = socket_type::endpoint_type;
+  using self = reliable_base<Packet>;
+  using ptr = std::shared_ptr<self>;
+  using handler_type = std::function<void(packet_t)>;
+  using clock = reliable::clock;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  reliable_base(socket_type& _socket, endpoint_type const& _peer, id_type _session_id)
+    : r_socket(_socket)
+    , m_peer(_peer)
+    , m_connection(std::bind(&self::output, this, std::placeholders::_1),
+                   std::bind(&self::on_message, this, std::placeholders::_1, std::placeholders::_2))
+    , m_timer(_socket.get_executor())
+    , m_armed(clock::time_point::max())
+    , m_session_id(_session_id)
+  {
+  }
+  virtual ~reliable_base()
+  {
+  }
+  // thread-safe.
+  void send(packet_t packet, std::uint16_t stream = 0)
+  {
+    auto holder = this->shared_from_this();
+    asio::post(r_socket.get_executor(), [this, holder, packet, stream]()
+    {
+      m_connection.send(stream, packet::serialize(*packet), clock::now());
+      arm_timer();
+    });
+  }
+  // set before the first message on the stream, on both ends.
+  void set_mode(std::uint16_t stream, reliable::mode mode)
+  {
+    auto holder = this->shared_from_this();
+    asio::post(r_socket.get_executor(), [this, holder, stream, mode]()
+    {
+      m_connection.set_mode(stream, mode);
+    });
+  }
+  // drop and delay outgoing datagrams, to exercise recovery over loopback.
+  void set_impairment(reliable::impairment const& impairment)
+  {
+    m_impairment = impairment;
+  }
+  void on_receive(handler_type _handler)
+  {
+    m_handler = std::move(_handler);
+  }
+  bool try_receive(packet_t& packet)
+  {
+    std::lock_guard<std::mutex> lock(m_read_mutex);
+    if (m_read_depot.empty())
+    {
+      return false;
+    }
+    packet = m_read_depot.front();
+    m_read_depot.pop_front();
+    return true;
+  }
+  // called by the node with one whole datagram.
+  void deliver(const char* data, std::size_t size)
+  {
+    m_connection.receive(data, size, clock::now());
+    arm_timer();
+  }
+  endpoint_type const& remote_endpoint() const
+  {
+    return m_peer;
+  }
+  reliable::statistics const& stats() const
+  {
+    return m_connection.stats();
+  }
+
+private:
+  void output(std::string datagram)
+  {
+    if (m_impairment.loss > 0.0 && m_random_loss(m_random) < m_impairment.loss)
+    {
+      return;
+    }
+
+    auto delay = m_impairment.delay;
+    if (m_impairment.jitter > clock::duration::zero())
+    {
+      std::uniform_int_distribution<clock::rep> jitter(0, m_impairment.jitter.count());
+      delay += clock::duration(jitter(m_random));
+    }
+    if (delay <= clock::duration::zero())
+    {
+      r_socket.send(m_peer, std::move(datagram));
+      return;
+    }
+
+    auto timer = std::make_shared<asio::steady_timer>(r_socket.get_executor(), delay);
+    std::weak_ptr<self> weak = this->shared_from_this();
+    timer->async_wait([weak, timer, datagram](error_code const& ec)
+    {
+      auto holder = weak.lock();
+      if (!ec && holder)
+      {
+        holder->r_socket.send(holder->m_peer, datagram);
+      }
+    });
+  }
+  void on_message(std::uint16_t, std::string message)
+  {
+    packet_t packet = packet::deserialize(m_session_id, message.data(), message.size());
+    if (packet == nullptr)
+    {
+      return;
+    }
+
+    if (m_handler)
+    {
+      m_handler(packet);
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(m_read_mutex);
+      m_read_depot.push_back(packet);
+    }
+  }
+
+  void arm_timer()
+  {
+    auto deadline = m_connection.next_timeout();
+    if (deadline >= m_armed)
+    {
+      return;
+    }
+    m_armed = deadline;
+    m_timer.expires_at(deadline);
+    std::weak_ptr<self> weak = this->shared_from_this();
+    m_timer.async_wait([weak](error_code const& ec)
+    {
+      auto holder = weak.lock();
+      if (!ec && holder)
+      {
+        holder->on_timer();
+      }
+    });
+  }
+  void on_timer()
+  {
+    m_armed = clock::time_point::max();
+    m_connection.on_timer(clock::now());
+    arm_timer();
+  }
+
+private:
+  socket_type& r_socket;
+  endpoint_type m_peer;
+  reliable::connection m_connection;
+  reliable::impairment m_impairment;
+  std::minstd_rand m_random;
+  std::uniform_real_distribution<double> m_random_loss;
+
+  asio::steady_timer m_timer;
+  clock::time_point m_armed;
+
+  std::deque<packet_t> m_read_depot;
+  std::mutex m_read_mutex;
+
+  handler_type m_handler;
+  id_type m_session_id;
+};
+
+using reliable_basic = reliable_base<packet::base>;
+
+} // namespace sv::net::protocol
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_PROTOCOL_HPP__
\ No newline at end of file
@@ -0,0 +1,560 @@
+#ifndef __SV_NET_PROXY_HPP__
+#define __SV_NET_PROXY_HPP__
+#pragma once
+
+#if defined(__linux__)
+
+// splice(2) moves the bodies.
+#define SV_NET_HAS_PROXY
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+
+#include "sv/net/packet.hpp"
+#include "sv/net/transport.hpp"
+#include "sv/net/tuning.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace proxy
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+struct options
+{
+  // bytes a pipe holds between the read from one socket and the write to the
+  // other (F_SETPIPE_SZ; the kernel may give less).
+  int pipe_size = 1024 * 1024;
+  // bytes moved for one packet before the other links get a turn.
+  std::size_t budget = 4 * 1024 * 1024;
+};
+
+struct statistics
+{
+  // client connections accepted.
+  std::uint64_t links = 0;
+  std::uint64_t packets = 0;
+  std::uint64_t bytes = 0;
+};
+
+// the backend for a packet, by its header alone; out of range closes the
+// link. the default is header.type modulo the number of backends.
+using route_handler = std::function<std::size_t(packet::header const&)>;
+
+namespace detail
+{
+
+class pipe
+{
+public:
+  explicit pipe(int _size)
+  {
+    if (::pipe2(m_fds, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      throw boost::system::system_error(error_code(errno, asio::error::get_system_category()), "proxy::pipe");
+    }
+    // best effort; without it the pipe holds 64 KiB.
+    ::fcntl(m_fds[1], F_SETPIPE_SZ, _size);
+    m_size = static_cast<std::size_t>(std::max(::fcntl(m_fds[1], F_GETPIPE_SZ), 4096));
+  }
+  pipe(pipe const&) = delete;
+  pipe& operator=(pipe const&) = delete;
+  ~pipe()
+  {
+    ::close(m_fds[0]);
+    ::close(m_fds[1]);
+  }
+  int out() const
+  {
+    return m_fds[0];
+  }
+  int in() const
+  {
+    return m_fds[1];
+  }
+  std::size_t size() const
+  {
+    return m_size;
+  }
+
+private:
+  int m_fds[2];
+  std::size_t m_size;
+};
+
+} // namespace sv::net::proxy::detail
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_relay
+//
+// a forwarding hop that never decodes a packet: it reads the packet::header,
+// picks the backend from it, writes the header on and moves the body from
+// one socket to the other with splice(2) through a pipe, so the payload does
+// not enter user space. each client connection (a link) gets its own
+// connection to every backend it sends to, made on first use; replies from
+// the backends are relayed back the same way, a whole packet at a time, so
+// packets from several backends do not interleave. a link closes as a
+// whole when any of its sockets fails or ends.
+//
+// stream transports with native sockets: tcp and local.
+////////////////////////////////////////////////////////////////////////////////
+template<class _Transport>
+class basic_relay
+{
+public:
+  using self = basic_relay<_Transport>;
+  using ptr = std::shared_ptr<self>;
+  using transport_type = _Transport;
+  using socket_type = typename transport_type::socket_type;
+  using acceptor_type = typename transport_type::acceptor_type;
+  using endpoint_type = typename transport_type::endpoint_type;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  explicit basic_relay(options const& _options = options())
+    : m_ioc()
+    , m_work_guard(m_ioc.get_executor())
+    , m_worker([&]() { m_ioc.run(); })
+    , m_options(_options)
+    , m_acceptor(m_ioc)
+    , m_links(0)
+    , m_packets(0)
+    , m_bytes(0)
+  {
+  }
+  basic_relay(basic_relay const&) = delete;
+  basic_relay& operator=(basic_relay const&) = delete;
+  ~basic_relay()
+  {
+    // the links go with the handlers that hold them.
+    m_work_guard.reset();
+    m_ioc.stop();
+
+    if (m_worker.joinable())
+      m_worker.join();
+  }
+  // before execute. arguments are those of transport_type::make_endpoint
+  // for a client: tcp [target] [port], local [path].
+  template<class...Args>
+  void add_backend(Args&&...args)
+  {
+    m_backends.push_back(transport_type::make_endpoint(std::forward<Args>(args)...));
+  }
+  // before execute.
+  void set_route(route_handler _route)
+  {
+    m_route = std::move(_route);
+  }
+  // before execute; applied to the listener and to every socket.
+  void set_tuning(tuning::options const& _tuning)
+  {
+    m_tuning = _tuning;
+  }
+  // arguments are those of transport_type::make_endpoint for a server:
+  // tcp [port], local [path].
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    if (m_backends.empty())
+    {
+      throw std::logic_error("proxy::basic_relay::execute: no backends");
+    }
+    m_acceptor = transport_type::listen(m_ioc, transport_type::make_endpoint(std::forward<Args>(args)...),
+                                        typename transport_type::options_type());
+    using tuning::apply;
+    apply(m_acceptor, m_tuning);
+    asio::post(m_ioc, [this]() { do_accept(); });
+  }
+  // after execute(): with tcp port 0, the port the system picked.
+  endpoint_type local_endpoint() const
+  {
+    return m_acceptor.local_endpoint();
+  }
+  statistics stats() const
+  {
+    statistics s;
+    s.links = m_links.load(std::memory_order_relaxed);
+    s.packets = m_packets.load(std::memory_order_relaxed);
+    s.bytes = m_bytes.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  ////////////////////////////////////////////////////////////////////////////
+  // link
+  //
+  // a client connection and its backend connections, all on the relay's io
+  // thread. a sink is a socket packets are written to; one pump holds it
+  // from a packet's header to the end of its body, the others queue.
+  ////////////////////////////////////////////////////////////////////////////
+  struct sink
+  {
+    explicit sink(typename socket_type::executor_type const& _executor)
+      : socket(_executor)
+    {
+    }
+
+    socket_type socket;
+    bool busy = false;
+    std::deque<std::function<void()>> waiting;
+  };
+
+  struct pump
+  {
+    pump(socket_type& _source, int _pipe_size)
+      : source(_source)
+      , pipe(_pipe_size)
+    {
+    }
+
+    socket_type& source;
+    detail::pipe pipe;
+    packet::header header;
+    std::size_t header_read = 0;
+    std::uint64_t remaining = 0;
+    std::size_t in_pipe = 0;
+    sink* target = nullptr;
+  };
+
+  class link : public std::enable_shared_from_this<link>
+  {
+  public:
+    link(basic_relay& _relay, asio::io_context& _ioc)
+      : r_relay(_relay)
+      , m_client(_ioc.get_executor())
+      , m_backends(_relay.m_backends.size())
+      , m_reverse(_relay.m_backends.size())
+      , m_closed(false)
+    {
+    }
+    socket_type& client()
+    {
+      return m_client.socket;
+    }
+    void start()
+    {
+      prepare(m_client.socket);
+      m_forward = std::make_unique<pump>(m_client.socket, r_relay.m_options.pipe_size);
+      read_header(*m_forward);
+    }
+
+  private:
+    void prepare(socket_type& _socket)
+    {
+      error_code ec;
+      _socket.non_blocking(true, ec);
+      using tuning::apply;
+      apply(_socket, r_relay.m_tuning);
+    }
+    void read_header(pump& _pump)
+    {
+      if (m_closed)
+      {
+        return;
+      }
+      auto* header = reinterpret_cast<char*>(&_pump.header);
+      while (_pump.header_read < sizeof(packet::header))
+      {
+        auto n = ::recv(_pump.source.native_handle(), header + _pump.header_read,
+                        sizeof(packet::header) - _pump.header_read, 0);
+        if (n > 0)
+        {
+          _pump.header_read += static_cast<std::size_t>(n);
+          continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+          wait(_pump.source, socket_type::wait_read, [this, &_pump]() { read_header(_pump); });
+          return;
+        }
+        // end of stream between packets is the normal way out.
+        close(n == 0 ? nullptr : "read", errno);
+        return;
+      }
+      if (!packet::base::valid(_pump.header))
+      {
+        close("header", EPROTO);
+        return;
+      }
+      _pump.remaining = _pump.header.length - sizeof(packet::header);
+
+      if (&_pump != m_forward.get())
+      {
+        acquire(_pump, m_client);
+        return;
+      }
+      auto route = r_relay.m_route ? r_relay.m_route(_pump.header)
+                                   : static_cast<std::size_t>(_pump.header.type) % m_backends.size();
+      if (route >= m_backends.size())
+      {
+        close("route", EHOSTUNREACH);
+        return;
+      }
+      backend(route, [this, &_pump, route]() { acquire(_pump, *m_backends[route]); });
+    }
+    // _ready runs once backend _index is connected.
+    void backend(std::size_t _index, std::function<void()> _ready)
+    {
+      if (m_backends[_index] != nullptr)
+      {
+        _ready();
+        return;
+      }
+      auto& s = *(m_backends[_index] = std::make_unique<sink>(m_client.socket.get_executor()));
+      // held by the connect; the packet waits like for any busy sink.
+      s.busy = true;
+      s.waiting.push_back(std::move(_ready));
+      auto holder = this->shared_from_this();
+      typename transport_type::options_type options;
+      transport_type::connect(s.socket, r_relay.m_backends[_index], options, [this, holder, &s, _index](error_code const& ec)
+      {
+        if (m_closed)
+        {
+          return;
+        }
+        if (!!ec)
+        {
+          close("connect", ec.value());
+          return;
+        }
+        prepare(s.socket);
+        m_reverse[_index] = std::make_unique<pump>(s.socket, r_relay.m_options.pipe_size);
+        read_header(*m_reverse[_index]);
+        release(s);
+      });
+    }
+    void acquire(pump& _pump, sink& _sink)
+    {
+      if (_sink.busy)
+      {
+        _sink.waiting.push_back([this, &_pump, &_sink]() { acquire(_pump, _sink); });
+        return;
+      }
+      _sink.busy = true;
+      _pump.target = &_sink;
+      auto holder = this->shared_from_this();
+      asio::async_write(_sink.socket, asio::buffer(&_pump.header, sizeof(packet::header)),
+                        [this, holder, &_pump](error_code const& ec, std::size_t)
+                        {
+                          if (m_closed)
+                          {
+                            return;
+                          }
+                          if (!!ec)
+                          {
+                            close("write", ec.value());
+                            return;
+                          }
+                          transfer(_pump);
+                        });
+    }
+    void release(sink& _sink)
+    {
+      _sink.busy = false;
+      if (!_sink.waiting.empty())
+      {
+        auto next = std::move(_sink.waiting.front());
+        _sink.waiting.pop_front();
+        next();
+      }
+    }
+    // the body: source -> pipe -> sink, until it is all through.
+    void transfer(pump& _pump)
+    {
+      if (m_closed)
+      {
+        return;
+      }
+      auto& target = _pump.target->socket;
+      auto budget = r_relay.m_options.budget;
+      while (_pump.remaining > 0 || _pump.in_pipe > 0)
+      {
+        if (budget == 0)
+        {
+          auto holder = this->shared_from_this();
+          asio::post(target.get_executor(), [this, holder, &_pump]() { transfer(_pump); });
+          return;
+        }
+        // the pipe is filled as far as the source allows before it is
+        // drained, so each splice moves as much as it can.
+        if (_pump.remaining > 0 && _pump.in_pipe < _pump.pipe.size())
+        {
+          auto want = static_cast<std::size_t>(std::min<std::uint64_t>(_pump.remaining, _pump.pipe.size() - _pump.in_pipe));
+          auto n = ::splice(_pump.source.native_handle(), nullptr, _pump.pipe.in(), nullptr, want,
+                            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+          if (n > 0)
+          {
+            _pump.remaining -= static_cast<std::uint64_t>(n);
+            _pump.in_pipe += static_cast<std::size_t>(n);
+            r_relay.m_bytes.fetch_add(static_cast<std::uint64_t>(n), std::memory_order_relaxed);
+            continue;
+          }
+          if (n == 0)
+          {
+            // the end of stream inside a packet counts as an error.
+            close("splice", EPIPE);
+            return;
+          }
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+          {
+            close("splice", errno);
+            return;
+          }
+          if (_pump.in_pipe == 0)
+          {
+            wait(_pump.source, socket_type::wait_read, [this, &_pump]() { transfer(_pump); });
+            return;
+          }
+        }
+        auto more = (_pump.remaining > 0) ? SPLICE_F_MORE : 0;
+        auto n = ::splice(_pump.pipe.out(), nullptr, target.native_handle(), nullptr, _pump.in_pipe,
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK | more);
+        if (n > 0)
+        {
+          _pump.in_pipe -= static_cast<std::size_t>(n);
+          budget -= std::min(budget, static_cast<std::size_t>(n));
+          continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+          wait(target, socket_type::wait_write, [this, &_pump]() { transfer(_pump); });
+          return;
+        }
+        close("splice", errno);
+        return;
+      }
+      r_relay.m_packets.fetch_add(1, std::memory_order_relaxed);
+      _pump.header_read = 0;
+      release(*_pump.target);
+      read_header(_pump);
+    }
+    template<class Handler>
+    void wait(socket_type& _socket, typename socket_type::wait_type _what, Handler&& _handler)
+    {
+      auto holder = this->shared_from_this();
+      _socket.async_wait(_what, [this, holder, handler = std::forward<Handler>(_handler)](error_code const& ec)
+      {
+        if (m_closed)
+        {
+          return;
+        }
+        if (!!ec)
+        {
+          close("wait", ec.value());
+          return;
+        }
+        handler();
+      });
+    }
+    // _where is null for a plain end of stream.
+    void close(const char* _where, int _error = 0)
+    {
+      if (m_closed)
+      {
+        return;
+      }
+      m_closed = true;
+      if (_where != nullptr)
+      {
+        std::stringstream ss;
+        ss << "proxy::" << _where << "::error[" << _error << "]: " << std::strerror(_error) << '\n';
+        std::cerr << ss.str() << std::flush;
+      }
+      error_code ec;
+      m_client.socket.close(ec);
+      for (auto& e : m_backends)
+      {
+        if (e != nullptr)
+        {
+          e->socket.close(ec);
+          e->waiting.clear();
+        }
+      }
+      m_client.waiting.clear();
+    }
+
+  private:
+    basic_relay& r_relay;
+    sink m_client;
+    std::vector<std::unique_ptr<sink>> m_backends;
+    std::unique_ptr<pump> m_forward;
+    std::vector<std::unique_ptr<pump>> m_reverse;
+    bool m_closed;
+  };
+
+  void do_accept()
+  {
+    auto next = std::make_shared<link>(*this, m_ioc);
+    m_acceptor.async_accept(next->client(), [this, next](error_code const& ec)
+    {
+      if (!!ec)
+      {
+        if (ec == asio::error::operation_aborted)
+        {
+          return;
+        }
+        std::stringstream ss;
+        ss << "proxy::accept::error[" << ec.value() << "]: " << ec.message() << '\n';
+        std::cerr << ss.str() << std::flush;
+      }
+      else
+      {
+        ++m_links;
+        next->start();
+      }
+      do_accept();
+    });
+  }
+
+private:
+  asio::io_context m_ioc;
+  asio::executor_work_guard<asio::io_context::executor_type> m_work_guard;
+  std::thread m_worker;
+
+  options m_options;
+  tuning::options m_tuning;
+  std::vector<endpoint_type> m_backends;
+  route_handler m_route;
+  acceptor_type m_acceptor;
+
+  std::atomic<std::uint64_t> m_links;
+  std::atomic<std::uint64_t> m_packets;
+  std::atomic<std::uint64_t> m_bytes;
+};
+
+using tcp_relay = basic_relay<transport::tcp>;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+using local_relay = basic_relay<transport::local>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+} // namespace sv::net::proxy
+} // namespace sv::net
+} // namespace sv
+
+#endif // __linux__
+
+#endif // __SV_NET_PROXY_HPP__
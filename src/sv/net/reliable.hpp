@@ -0,0 +1,532 @@
+#ifndef __SV_NET_RELIABLE_HPP__
+#define __SV_NET_RELIABLE_HPP__
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace reliable
+{
+
+using clock = std::chrono::steady_clock;
+
+enum class mode : std::uint8_t
+{
+  // retransmitted, delivered in send order within the stream.
+  ordered = 0,
+  // retransmitted, delivered as soon as it arrives.
+  unordered = 1,
+  // sent once, never acknowledged.
+  unreliable = 2,
+};
+
+// loss/delay injection applied to outgoing datagrams, for loopback tests.
+struct impairment
+{
+  double loss = 0.0;
+  clock::duration delay = clock::duration::zero();
+  clock::duration jitter = clock::duration::zero();
+};
+
+struct statistics
+{
+  std::uint64_t sent = 0;
+  std::uint64_t retransmitted = 0;
+  std::uint64_t received = 0;
+  std::uint64_t duplicates = 0;
+  std::uint64_t acks_sent = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// connection
+//
+// i/o-free reliability state machine for one peer, in the spirit of SCTP:
+//
+// - every reliable message gets a connection-wide TSN; ordered streams also
+//   number their messages (SSN) so the receiver can restore order per stream,
+//   which keeps one lost message from blocking the other streams.
+// - the receiver acknowledges the cumulative TSN plus SACK ranges above it.
+// - the sender retransmits on three missing reports (fast retransmit) or on
+//   RTO expiry, and paces new data with a NewReno style congestion window.
+//
+// the owner feeds received datagrams to receive(), calls on_timer() once
+// next_timeout() has passed, and ships whatever the output handler emits.
+////////////////////////////////////////////////////////////////////////////////
+class connection
+{
+public:
+  using output_handler = std::function<void(std::string)>;
+  using deliver_handler = std::function<void(std::uint16_t, std::string)>;
+
+  static constexpr std::size_t sc_mss = 1200;
+  static constexpr std::size_t sc_initial_window = 10 * sc_mss;
+  static constexpr std::size_t sc_max_sack_blocks = 16;
+  static constexpr int sc_dupack_threshold = 3;
+
+  connection(output_handler _output, deliver_handler _deliver)
+    : m_output(std::move(_output))
+    , m_deliver(std::move(_deliver))
+    , m_next_tsn(0)
+    , m_next_stamp(0)
+    , m_cwnd(sc_initial_window)
+    , m_ssthresh(~std::size_t(0))
+    , m_flight(0)
+    , m_in_recovery(false)
+    , m_recovery_point(0)
+    , m_srtt(clock::duration::zero())
+    , m_rttvar(clock::duration::zero())
+    , m_rto(std::chrono::milliseconds(200))
+    , m_rto_deadline(clock::time_point::max())
+    , m_cumulative(0)
+    , m_ack_pending(0)
+    , m_ack_deadline(clock::time_point::max())
+  {
+  }
+
+  void set_mode(std::uint16_t _stream, mode _mode)
+  {
+    m_modes[_stream] = _mode;
+  }
+  mode get_mode(std::uint16_t _stream) const
+  {
+    auto it = m_modes.find(_stream);
+    return (it == m_modes.end()) ? mode::ordered : it->second;
+  }
+
+  void send(std::uint16_t _stream, std::string const& _message, clock::time_point _now)
+  {
+    auto m = get_mode(_stream);
+    if (m == mode::unreliable)
+    {
+      m_output(encode_data(m, _stream, 0, 0, _message));
+      ++m_stats.sent;
+      return;
+    }
+
+    std::uint64_t ssn = (m == mode::ordered) ? m_send_ssn[_stream]++ : 0;
+    m_pending.push_back(encode_data(m, _stream, m_next_tsn++, ssn, _message));
+    flush(_now);
+  }
+
+  void receive(const char* _data, std::size_t _size, clock::time_point _now)
+  {
+    if (_size < sc_data_header_size && _size < sc_ack_header_size)
+    {
+      return;
+    }
+    auto kind = static_cast<std::uint8_t>(_data[0]);
+    if (kind == sc_kind_data && _size >= sc_data_header_size)
+    {
+      on_data(_data, _size, _now);
+    }
+    else if (kind == sc_kind_ack && _size >= sc_ack_header_size)
+    {
+      on_ack(_data, _size, _now);
+    }
+  }
+
+  clock::time_point next_timeout() const
+  {
+    return std::min(m_ack_deadline, m_rto_deadline);
+  }
+
+  void on_timer(clock::time_point _now)
+  {
+    if (m_ack_deadline <= _now)
+    {
+      send_ack();
+    }
+
+    if (m_rto_deadline > _now)
+    {
+      return;
+    }
+
+    // retransmission timeout: everything in flight is presumed lost, back
+    // off and resend it from a one segment window.
+    m_ssthresh = std::max(m_flight / 2, 2 * sc_mss);
+    m_cwnd = sc_mss;
+    m_in_recovery = false;
+    m_rto = std::min<clock::duration>(m_rto * 2, std::chrono::seconds(2));
+    m_rto_deadline = clock::time_point::max();
+    for (auto& entry : m_outstanding)
+    {
+      mark_lost(entry.first, entry.second);
+    }
+    flush(_now);
+  }
+
+  statistics const& stats() const
+  {
+    return m_stats;
+  }
+  std::size_t in_flight() const
+  {
+    return m_flight;
+  }
+  std::size_t window() const
+  {
+    return m_cwnd;
+  }
+
+private:
+  static constexpr std::uint8_t sc_kind_data = 1;
+  static constexpr std::uint8_t sc_kind_ack = 2;
+
+  // data: kind u8, mode u8, stream u16, tsn u64, ssn u64, payload
+  static constexpr std::size_t sc_data_header_size = 1 + 1 + 2 + 8 + 8;
+  // ack: kind u8, reserved u8, blocks u16, cumulative u64, { begin u64, end u64 } * blocks
+  static constexpr std::size_t sc_ack_header_size = 1 + 1 + 2 + 8;
+
+  struct segment
+  {
+    std::string bytes;
+    // transmission order, across retransmissions.
+    std::uint64_t stamp;
+    clock::time_point sent;
+    int transmissions;
+    int missing_reports;
+    bool lost;
+  };
+
+  static std::string encode_data(mode _mode, std::uint16_t _stream, std::uint64_t _tsn,
+                                 std::uint64_t _ssn, std::string const& _message)
+  {
+    std::string bytes(sc_data_header_size + _message.size(), '\0');
+    bytes[0] = static_cast<char>(sc_kind_data);
+    bytes[1] = static_cast<char>(_mode);
+    packet::detail::store_le(&bytes[2], _stream);
+    packet::detail::store_le(&bytes[4], _tsn);
+    packet::detail::store_le(&bytes[12], _ssn);
+    std::copy(_message.begin(), _message.end(), bytes.begin() + sc_data_header_size);
+    return bytes;
+  }
+  static std::uint64_t tsn_of(std::string const& _bytes)
+  {
+    return packet::detail::load_le<std::uint64_t>(&_bytes[4]);
+  }
+
+  bool window_open(std::size_t _size) const
+  {
+    return m_flight == 0 || m_flight + _size <= m_cwnd;
+  }
+  void flush(clock::time_point _now)
+  {
+    // lost segments go first, they hold up delivery at the peer.
+    while (!m_lost.empty())
+    {
+      auto& s = m_outstanding[*m_lost.begin()];
+      if (!window_open(s.bytes.size()))
+      {
+        return;
+      }
+      m_lost.erase(m_lost.begin());
+      s.lost = false;
+      s.missing_reports = 0;
+      s.transmissions++;
+      transmit(s, _now);
+      ++m_stats.retransmitted;
+    }
+
+    while (!m_pending.empty() && window_open(m_pending.front().size()))
+    {
+      auto bytes = std::move(m_pending.front());
+      m_pending.pop_front();
+
+      auto tsn = tsn_of(bytes);
+      auto& s = m_outstanding.emplace(tsn, segment{ std::move(bytes), 0, _now, 1, 0, false }).first->second;
+      transmit(s, _now);
+      ++m_stats.sent;
+    }
+  }
+  void transmit(segment& _segment, clock::time_point _now)
+  {
+    _segment.stamp = m_next_stamp++;
+    _segment.sent = _now;
+    m_flight += _segment.bytes.size();
+    m_output(_segment.bytes);
+    if (m_rto_deadline == clock::time_point::max())
+    {
+      m_rto_deadline = _now + m_rto;
+    }
+  }
+  void mark_lost(std::uint64_t _tsn, segment& _segment)
+  {
+    if (!_segment.lost)
+    {
+      _segment.lost = true;
+      m_flight -= _segment.bytes.size();
+      m_lost.insert(_tsn);
+    }
+  }
+
+  void on_data(const char* _data, std::size_t _size, clock::time_point _now)
+  {
+    auto m = static_cast<mode>(_data[1]);
+    auto stream = packet::detail::load_le<std::uint16_t>(_data + 2);
+    auto tsn = packet::detail::load_le<std::uint64_t>(_data + 4);
+    auto ssn = packet::detail::load_le<std::uint64_t>(_data + 12);
+    std::string message(_data + sc_data_header_size, _size - sc_data_header_size);
+
+    if (m == mode::unreliable)
+    {
+      ++m_stats.received;
+      m_deliver(stream, std::move(message));
+      return;
+    }
+
+    bool in_order = (tsn == m_cumulative);
+    bool duplicate = (tsn < m_cumulative) || (m_above.count(tsn) > 0);
+    if (duplicate)
+    {
+      ++m_stats.duplicates;
+      send_ack();
+      return;
+    }
+
+    m_above.insert(tsn);
+    while (!m_above.empty() && *m_above.begin() == m_cumulative)
+    {
+      m_above.erase(m_above.begin());
+      ++m_cumulative;
+    }
+    ++m_stats.received;
+
+    if (m == mode::unordered)
+    {
+      m_deliver(stream, std::move(message));
+    }
+    else
+    {
+      auto& next = m_recv_ssn[stream];
+      auto& held = m_reorder[stream];
+      if (ssn == next)
+      {
+        m_deliver(stream, std::move(message));
+        ++next;
+        for (auto it = held.find(next); it != held.end(); it = held.find(next))
+        {
+          m_deliver(stream, std::move(it->second));
+          held.erase(it);
+          ++next;
+        }
+      }
+      else if (ssn > next)
+      {
+        held.emplace(ssn, std::move(message));
+      }
+    }
+
+    // ack every second segment, and at once when something is missing.
+    if (!in_order || !m_above.empty() || ++m_ack_pending >= 2)
+    {
+      send_ack();
+    }
+    else if (m_ack_deadline == clock::time_point::max())
+    {
+      m_ack_deadline = _now + std::chrono::milliseconds(5);
+    }
+  }
+
+  void send_ack()
+  {
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> blocks;
+    for (auto it = m_above.begin(); it != m_above.end() && blocks.size() < sc_max_sack_blocks; ++it)
+    {
+      if (!blocks.empty() && blocks.back().second == *it)
+      {
+        blocks.back().second++;
+      }
+      else
+      {
+        blocks.emplace_back(*it, *it + 1);
+      }
+    }
+
+    std::string bytes(sc_ack_header_size + blocks.size() * 16, '\0');
+    bytes[0] = static_cast<char>(sc_kind_ack);
+    packet::detail::store_le(&bytes[2], static_cast<std::uint16_t>(blocks.size()));
+    packet::detail::store_le(&bytes[4], m_cumulative);
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+    {
+      packet::detail::store_le(&bytes[sc_ack_header_size + i * 16], blocks[i].first);
+      packet::detail::store_le(&bytes[sc_ack_header_size + i * 16 + 8], blocks[i].second);
+    }
+
+    m_ack_pending = 0;
+    m_ack_deadline = clock::time_point::max();
+    ++m_stats.acks_sent;
+    m_output(std::move(bytes));
+  }
+
+  void on_ack(const char* _data, std::size_t _size, clock::time_point _now)
+  {
+    auto count = packet::detail::load_le<std::uint16_t>(_data + 2);
+    auto cumulative = packet::detail::load_le<std::uint64_t>(_data + 4);
+    if (_size < sc_ack_header_size + std::size_t(count) * 16)
+    {
+      return;
+    }
+
+    std::size_t acked = 0;
+    std::uint64_t reported = cumulative;
+    std::uint64_t latest = 0;
+    bool any = false;
+    clock::duration sample = clock::duration::max();
+    auto consume = [&](std::map<std::uint64_t, segment>::iterator it)
+    {
+      auto& s = it->second;
+      if (s.transmissions == 1)
+      {
+        sample = _now - s.sent;
+      }
+      if (s.lost)
+      {
+        m_lost.erase(it->first);
+      }
+      else
+      {
+        m_flight -= s.bytes.size();
+      }
+      latest = std::max(latest, s.stamp);
+      any = true;
+      acked += s.bytes.size();
+      return m_outstanding.erase(it);
+    };
+
+    for (auto it = m_outstanding.begin(); it != m_outstanding.end() && it->first < cumulative;)
+    {
+      it = consume(it);
+    }
+    for (std::uint16_t i = 0; i < count; ++i)
+    {
+      auto begin = packet::detail::load_le<std::uint64_t>(_data + sc_ack_header_size + i * 16);
+      auto end = packet::detail::load_le<std::uint64_t>(_data + sc_ack_header_size + i * 16 + 8);
+      for (auto it = m_outstanding.lower_bound(begin); it != m_outstanding.end() && it->first < end;)
+      {
+        it = consume(it);
+      }
+      reported = std::max(reported, end);
+    }
+    if (!any)
+    {
+      return;
+    }
+
+    if (sample != clock::duration::max())
+    {
+      update_rtt(sample);
+    }
+    grow_window(acked, cumulative);
+    m_rto_deadline = (m_flight > 0) ? _now + m_rto : clock::time_point::max();
+
+    // the ack describes every TSN below the highest reported one, so an
+    // unacknowledged segment there that was transmitted before a newly
+    // acknowledged one was skipped by the peer.
+    for (auto it = m_outstanding.begin(); it != m_outstanding.end() && it->first < reported; ++it)
+    {
+      auto& entry = *it;
+      auto& s = entry.second;
+      if (!s.lost && s.stamp < latest && ++s.missing_reports >= sc_dupack_threshold)
+      {
+        if (!m_in_recovery)
+        {
+          m_in_recovery = true;
+          m_recovery_point = m_next_tsn;
+          m_ssthresh = std::max(m_cwnd / 2, 2 * sc_mss);
+          m_cwnd = m_ssthresh;
+        }
+        mark_lost(entry.first, s);
+      }
+    }
+
+    flush(_now);
+  }
+
+  void update_rtt(clock::duration _sample)
+  {
+    // RFC 6298, with a floor suited to datacenter and loopback round trips.
+    if (m_srtt == clock::duration::zero())
+    {
+      m_srtt = _sample;
+      m_rttvar = _sample / 2;
+    }
+    else
+    {
+      auto delta = (m_srtt > _sample) ? (m_srtt - _sample) : (_sample - m_srtt);
+      m_rttvar = (3 * m_rttvar + delta) / 4;
+      m_srtt = (7 * m_srtt + _sample) / 8;
+    }
+    m_rto = std::max<clock::duration>(m_srtt + 4 * m_rttvar, std::chrono::milliseconds(10));
+  }
+  void grow_window(std::size_t _acked, std::uint64_t _cumulative)
+  {
+    if (m_in_recovery)
+    {
+      if (_cumulative >= m_recovery_point)
+      {
+        m_in_recovery = false;
+      }
+      return;
+    }
+    if (m_cwnd < m_ssthresh)
+    {
+      m_cwnd += _acked;
+    }
+    else
+    {
+      m_cwnd += std::max<std::size_t>(1, sc_mss * _acked / m_cwnd);
+    }
+  }
+
+private:
+  output_handler m_output;
+  deliver_handler m_deliver;
+  std::unordered_map<std::uint16_t, mode> m_modes;
+  statistics m_stats;
+
+  // sender
+  std::uint64_t m_next_tsn;
+  std::uint64_t m_next_stamp;
+  std::unordered_map<std::uint16_t, std::uint64_t> m_send_ssn;
+  std::deque<std::string> m_pending;
+  std::map<std::uint64_t, segment> m_outstanding;
+  std::set<std::uint64_t> m_lost;
+  std::size_t m_cwnd;
+  std::size_t m_ssthresh;
+  std::size_t m_flight;
+  bool m_in_recovery;
+  std::uint64_t m_recovery_point;
+  clock::duration m_srtt;
+  clock::duration m_rttvar;
+  clock::duration m_rto;
+  clock::time_point m_rto_deadline;
+
+  // receiver
+  std::uint64_t m_cumulative;
+  std::set<std::uint64_t> m_above;
+  std::unordered_map<std::uint16_t, std::uint64_t> m_recv_ssn;
+  std::unordered_map<std::uint16_t, std::map<std::uint64_t, std::string>> m_reorder;
+  int m_ack_pending;
+  clock::time_point m_ack_deadline;
+};
+
+} // namespace sv::net::reliable
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_RELIABLE_HPP__
@@ -0,0 +1,710 @@
+#ifndef __SV_NET_RESUME_HPP__
+#define __SV_NET_RESUME_HPP__
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "sv/base.hpp"
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
+#include "sv/net/schema.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace resume
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// messages
+//
+// struct packets (schema ids 0xB200..0xB2FF). a connection starts with a
+// hello each way: the client names the session it had (0 for a new one) and
+// the server answers with the session it gets; both say how many messages
+// of it they have received. after that, every message travels in a frame
+// with its number and a cumulative ack for the other direction; an ack on
+// its own is sent only when there is no frame to carry it.
+////////////////////////////////////////////////////////////////////////////////
+struct hello
+{
+  std::uint64_t session;
+  std::uint64_t received;
+};
+struct frame
+{
+  std::uint64_t seq;
+  std::uint64_t ack;
+  std::string message;
+};
+struct ack
+{
+  std::uint64_t seq;
+};
+
+} // namespace sv::net::resume
+} // namespace sv::net
+} // namespace sv
+
+SV_NET_SCHEMA(sv::net::resume::hello, 0xB200, &sv::net::resume::hello::session, &sv::net::resume::hello::received)
+SV_NET_SCHEMA(sv::net::resume::frame, 0xB201, &sv::net::resume::frame::seq, &sv::net::resume::frame::ack,
+              &sv::net::resume::frame::message)
+SV_NET_SCHEMA(sv::net::resume::ack, 0xB202, &sv::net::resume::ack::seq)
+
+namespace sv
+{
+namespace net
+{
+namespace resume
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+struct options
+{
+  // messages kept for resending until the peer acknowledges them. past
+  // this the oldest are let go, and a resume that would need them starts a
+  // new session instead.
+  std::size_t retransmit_limit = 4096;
+  // how long the server keeps a session after its connection is lost.
+  std::chrono::steady_clock::duration linger = std::chrono::seconds(30);
+  // client: before connecting again.
+  std::chrono::steady_clock::duration reconnect = std::chrono::milliseconds(100);
+};
+
+struct statistics
+{
+  std::uint64_t sent = 0;
+  // messages sent again after a resume.
+  std::uint64_t resent = 0;
+  std::uint64_t received = 0;
+  std::uint64_t duplicates = 0;
+  // connections that took the session over after the first.
+  std::uint64_t resumed = 0;
+  // messages let go unacknowledged because the buffer was full.
+  std::uint64_t overflowed = 0;
+};
+
+template<class _Session>
+class basic_server;
+template<class _Session>
+class basic_client;
+
+////////////////////////////////////////////////////////////////////////////////
+// channel
+//
+// the logical session: outlives the connections it is carried over. sent
+// messages are numbered and kept until acknowledged; on a new connection the
+// peer says what it has and only the rest is sent again. received messages
+// are delivered once, in order.
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+class channel : public std::enable_shared_from_this<channel<_Session>>
+{
+public:
+  using self = channel<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using packet_t = packet::base::ptr;
+  using handler_type = std::function<void(packet_t)>;
+  using close_handler = std::function<void()>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  channel(id_type _id, options const& _options)
+    : m_id(_id)
+    , m_options(_options)
+    , m_sent(0)
+    , m_received(0)
+    , m_acked(0)
+    , m_lost(0)
+    , m_ack_pending(false)
+    , m_current(nullptr)
+  {
+  }
+  channel(channel const&) = delete;
+  channel& operator=(channel const&) = delete;
+
+  // set before the first connection. called on the connection's executor.
+  void on_receive(handler_type _handler)
+  {
+    m_handler = std::move(_handler);
+  }
+  // server: the session was not resumed within options::linger and is gone.
+  // client: the server no longer had it; the channel starts over under a
+  // new id, and messages it had not acknowledged are dropped.
+  void on_close(close_handler _handler)
+  {
+    m_on_close = std::move(_handler);
+  }
+  // thread-safe. written at once if connected, otherwise on resume.
+  void send(packet_t _packet)
+  {
+    auto message = std::make_shared<const std::string>(packet::serialize(*_packet));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_unacked.push_back(pending{ ++m_sent, std::move(message) });
+    ++m_stats.sent;
+    if (m_unacked.size() > m_options.retransmit_limit)
+    {
+      m_lost = m_unacked.front().seq;
+      m_unacked.pop_front();
+      ++m_stats.overflowed;
+    }
+    if (auto session = m_session.lock())
+    {
+      write(*session, m_unacked.back());
+    }
+  }
+  id_type id() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_id;
+  }
+  bool connected() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_session.expired();
+  }
+  statistics stats() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+  }
+
+private:
+  friend class basic_server<_Session>;
+  friend class basic_client<_Session>;
+
+  struct pending
+  {
+    std::uint64_t seq;
+    std::shared_ptr<const std::string> message;
+  };
+
+  // carries the channel over _session from here on: _hello goes first, then
+  // whatever the peer has not got (it has _received). false if some of that
+  // was let go; the channel is then not attached.
+  bool attach(std::shared_ptr<session_type> const& _session, std::uint64_t _received, packet_t _hello)
+  {
+    std::shared_ptr<session_type> previous;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (_received < m_lost)
+      {
+        return false;
+      }
+      trim(_received);
+      previous = m_session.lock();
+      if (m_attached)
+      {
+        ++m_stats.resumed;
+      }
+      m_attached = true;
+      m_session = _session;
+      m_current = _session.get();
+      if (_hello != nullptr)
+      {
+        _session->protocol().send(std::move(_hello));
+      }
+      for (auto const& e : m_unacked)
+      {
+        write(*_session, e);
+        ++m_stats.resent;
+      }
+    }
+    // the old connection may be half-open; it is of no use any more.
+    if (previous != nullptr && previous != _session)
+    {
+      asio::post(previous->socket().get_executor(), [previous]() { engine::close_socket(previous->socket()); });
+    }
+    return true;
+  }
+  // true if _session was carrying the channel.
+  bool detach(session_type* _session)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_current != _session)
+    {
+      return false;
+    }
+    m_session.reset();
+    m_current = nullptr;
+    m_detached = std::chrono::steady_clock::now();
+    return true;
+  }
+  // client: the server handed out _id for a new session.
+  void reset(id_type _id)
+  {
+    close_handler handler;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      bool known = m_id != 0;
+      m_id = _id;
+      if (!known)
+      {
+        return;
+      }
+      m_unacked.clear();
+      m_sent = 0;
+      m_received = 0;
+      m_acked = 0;
+      m_lost = 0;
+      handler = m_on_close;
+    }
+    if (handler)
+    {
+      handler();
+    }
+  }
+  // server: gone after options::linger without a connection.
+  bool expired(std::chrono::steady_clock::time_point _now) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_current == nullptr && _now - m_detached >= m_options.linger;
+  }
+  void closed()
+  {
+    if (m_on_close)
+    {
+      m_on_close();
+    }
+  }
+  std::uint64_t received() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_received;
+  }
+
+  // on the executor of _session: the resume message in a received packet,
+  // if it is one.
+  bool dispatch(session_type& _session, packet::base& _packet)
+  {
+    const char* data;
+    std::size_t size;
+    if (packet::view_of<frame>(_packet, data, size))
+    {
+      on_frame(_session, packet::struct_view<frame>(data, size));
+      return true;
+    }
+    if (packet::view_of<ack>(_packet, data, size))
+    {
+      on_ack(_session, packet::struct_view<ack>(data, size).template get<&ack::seq>());
+      return true;
+    }
+    return false;
+  }
+  void on_frame(session_type& _session, packet::struct_view<frame> const& _frame)
+  {
+    packet_t message;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_current != &_session)
+      {
+        return;
+      }
+      trim(_frame.get<&frame::ack>());
+      auto seq = _frame.get<&frame::seq>();
+      if (seq != m_received + 1)
+      {
+        // already delivered before the connection was lost.
+        ++m_stats.duplicates;
+        return;
+      }
+      m_received = seq;
+      ++m_stats.received;
+      auto bytes = _frame.get<&frame::message>();
+      message = packet::deserialize(m_id, bytes.data(), bytes.size());
+      schedule_ack(_session);
+    }
+    if (message != nullptr && m_handler)
+    {
+      m_handler(std::move(message));
+    }
+  }
+  void on_ack(session_type& _session, std::uint64_t _seq)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_current == &_session)
+    {
+      trim(_seq);
+    }
+  }
+
+  // the rest under m_mutex.
+  void write(session_type& _session, pending const& _pending)
+  {
+    m_acked = m_received;
+    _session.protocol().send(
+      packet::struct_packet<frame>::make(packet::flat_buffer(frame{ _pending.seq, m_received, *_pending.message }),
+                                         _session.id()));
+  }
+  void trim(std::uint64_t _acked)
+  {
+    while (!m_unacked.empty() && m_unacked.front().seq <= _acked)
+    {
+      m_unacked.pop_front();
+    }
+  }
+  // once per batch of reads; a frame sent meanwhile carried the ack already.
+  void schedule_ack(session_type& _session)
+  {
+    if (m_ack_pending)
+    {
+      return;
+    }
+    m_ack_pending = true;
+    auto holder = this->shared_from_this();
+    session_type* session = &_session;
+    asio::post(_session.socket().get_executor(), [holder, session]()
+    {
+      std::lock_guard<std::mutex> lock(holder->m_mutex);
+      holder->m_ack_pending = false;
+      if (holder->m_current != session || holder->m_acked >= holder->m_received)
+      {
+        return;
+      }
+      holder->m_acked = holder->m_received;
+      session->protocol().send(
+        packet::struct_packet<ack>::make(packet::flat_buffer(ack{ holder->m_received }), session->id()));
+    });
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  id_type m_id;
+  options m_options;
+  handler_type m_handler;
+  close_handler m_on_close;
+
+  std::deque<pending> m_unacked;
+  // the last numbers sent, received, and acknowledged to the peer; the last
+  // let go unacknowledged.
+  std::uint64_t m_sent;
+  std::uint64_t m_received;
+  std::uint64_t m_acked;
+  std::uint64_t m_lost;
+  bool m_ack_pending;
+
+  std::weak_ptr<session_type> m_session;
+  session_type* m_current;
+  bool m_attached = false;
+  std::chrono::steady_clock::time_point m_detached;
+  statistics m_stats;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_server
+//
+// a basic_server whose connections carry channels. a client coming back
+// with the id of a channel still kept gets it back, and the old connection
+// is closed if it was still open; otherwise, and for a new client, a channel
+// is made and handed to on_channel. channels without a connection for
+// options::linger are dropped when the next connection comes in.
+//
+// the server takes the engine server's on_session and each session's
+// on_receive.
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+class basic_server
+{
+public:
+  using self = basic_server<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using server_type = engine::basic_server<engine::basic_acceptor<session_type>>;
+  using channel_type = resume::channel<session_type>;
+  using channel_handler = std::function<void(typename channel_type::ptr const&)>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  explicit basic_server(options const& _options = options())
+    : m_options(_options)
+    , m_random(std::random_device()())
+    , m_server(server_type::make())
+  {
+    m_server->on_session(std::bind(&self::on_session, this, std::placeholders::_1));
+  }
+  basic_server(basic_server const&) = delete;
+  basic_server& operator=(basic_server const&) = delete;
+
+  // called for a new channel, not when it resumes; set its on_receive here.
+  void on_channel(channel_handler _handler)
+  {
+    m_on_channel = std::move(_handler);
+  }
+  // set_options, set_limits, set_accept_policy and set_tuning go here,
+  // before execute.
+  server_type& server()
+  {
+    return *m_server;
+  }
+  // the arguments of server_type::execute.
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    m_server->execute(std::forward<Args>(args)...);
+  }
+  std::size_t channels() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_channels.size();
+  }
+
+private:
+  // per connection, only touched on its executor.
+  struct connection
+  {
+    typename channel_type::ptr channel;
+  };
+
+  void on_session(typename session_type::ptr const& _session)
+  {
+    sweep();
+    auto state = std::make_shared<connection>();
+    session_type* raw = _session.get();
+    std::weak_ptr<session_type> weak = _session;
+    _session->protocol().on_receive([this, state, raw, weak](packet::base::ptr packet)
+    {
+      if (state->channel != nullptr && state->channel->dispatch(*raw, *packet))
+      {
+        return;
+      }
+      const char* data;
+      std::size_t size;
+      if (packet::view_of<hello>(*packet, data, size))
+      {
+        if (auto session = weak.lock())
+        {
+          on_hello(session, *state, packet::struct_view<hello>(data, size));
+        }
+      }
+    });
+    _session->protocol().on_close([this, state, raw](error_code const&) { release(*state, raw); });
+  }
+  void on_hello(typename session_type::ptr const& _session, connection& _state, packet::struct_view<hello> const& _hello)
+  {
+    // a second hello starts over on this connection.
+    release(_state, _session.get());
+
+    auto received = _hello.get<&hello::received>();
+    auto channel = find(_hello.get<&hello::session>());
+    if (channel == nullptr ||
+        !channel->attach(_session, received, make_hello(*_session, channel->id(), channel->received())))
+    {
+      channel = create();
+      if (m_on_channel)
+      {
+        m_on_channel(channel);
+      }
+      channel->attach(_session, 0, make_hello(*_session, channel->id(), 0));
+    }
+    _state.channel = std::move(channel);
+  }
+  void release(connection& _state, session_type* _session)
+  {
+    if (_state.channel != nullptr && _state.channel->detach(_session))
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_detached.push_back(_state.channel);
+    }
+    _state.channel = nullptr;
+  }
+
+  typename channel_type::ptr find(id_type _id)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_channels.find(_id);
+    return (it != m_channels.end()) ? it->second : nullptr;
+  }
+  typename channel_type::ptr create()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    id_type id = 0;
+    while (id == 0 || m_channels.count(id) != 0)
+    {
+      id = m_random();
+    }
+    auto channel = channel_type::make(id, m_options);
+    m_channels.emplace(id, channel);
+    return channel;
+  }
+  // channels are detached in linger order, so only the front needs looking
+  // at. one detached again since it was queued is looked at again later.
+  void sweep()
+  {
+    std::vector<typename channel_type::ptr> closed;
+    {
+      auto now = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> lock(m_mutex);
+      while (!m_detached.empty())
+      {
+        auto channel = m_detached.front().lock();
+        if (channel != nullptr && !channel->expired(now))
+        {
+          break;
+        }
+        m_detached.pop_front();
+        if (channel != nullptr && m_channels.erase(channel->id()) != 0)
+        {
+          closed.push_back(std::move(channel));
+        }
+      }
+    }
+    for (auto& e : closed)
+    {
+      e->closed();
+    }
+  }
+  static packet::base::ptr make_hello(session_type& _session, id_type _id, std::uint64_t _received)
+  {
+    return packet::struct_packet<hello>::make(packet::flat_buffer(hello{ _id, _received }), _session.id());
+  }
+
+private:
+  options m_options;
+  channel_handler m_on_channel;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<id_type, typename channel_type::ptr> m_channels;
+  std::deque<std::weak_ptr<channel_type>> m_detached;
+  std::mt19937_64 m_random;
+
+  // destroyed first: its io threads are joined before the rest goes.
+  typename server_type::ptr m_server;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_client
+//
+// a basic_client that reconnects by itself and resumes its channel on every
+// new connection. messages sent while disconnected wait in the channel.
+//
+// the client takes the engine client's on_session and each session's
+// on_receive.
+////////////////////////////////////////////////////////////////////////////////
+template<class _Session>
+class basic_client
+{
+public:
+  using self = basic_client<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using client_type = engine::basic_client<engine::basic_connector<session_type>>;
+  using channel_type = resume::channel<session_type>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  explicit basic_client(options const& _options = options())
+    : m_channel(channel_type::make(0, _options))
+    , m_client(client_type::make())
+  {
+    m_client->set_reconnect(_options.reconnect);
+    m_client->on_session(std::bind(&self::on_session, this, std::placeholders::_1));
+  }
+  basic_client(basic_client const&) = delete;
+  basic_client& operator=(basic_client const&) = delete;
+
+  // set its on_receive and on_close before execute.
+  channel_type& channel()
+  {
+    return *m_channel;
+  }
+  // set_options and set_tuning go here, before execute.
+  client_type& client()
+  {
+    return *m_client;
+  }
+  // the arguments of client_type::execute.
+  template<class...Args>
+  void execute(Args&&...args)
+  {
+    m_client->execute(std::forward<Args>(args)...);
+  }
+
+private:
+  void on_session(typename session_type::ptr const& _session)
+  {
+    session_type* raw = _session.get();
+    std::weak_ptr<session_type> weak = _session;
+    _session->protocol().on_receive([this, raw, weak](packet::base::ptr packet)
+    {
+      if (m_channel->dispatch(*raw, *packet))
+      {
+        return;
+      }
+      const char* data;
+      std::size_t size;
+      if (packet::view_of<hello>(*packet, data, size))
+      {
+        if (auto session = weak.lock())
+        {
+          on_hello(session, packet::struct_view<hello>(data, size));
+        }
+      }
+    });
+    _session->protocol().on_close([this, raw](error_code const&) { m_channel->detach(raw); });
+    send_hello(*_session, m_channel->id());
+  }
+  void on_hello(typename session_type::ptr const& _session, packet::struct_view<hello> const& _hello)
+  {
+    auto id = _hello.get<&hello::session>();
+    if (id != m_channel->id())
+    {
+      m_channel->reset(id);
+    }
+    if (!m_channel->attach(_session, _hello.get<&hello::received>(), nullptr))
+    {
+      // the server is missing messages no longer kept here: a new session.
+      m_channel->reset(0);
+      send_hello(*_session, 0);
+    }
+  }
+  void send_hello(session_type& _session, id_type _id)
+  {
+    _session.protocol().send(
+      packet::struct_packet<hello>::make(packet::flat_buffer(hello{ _id, m_channel->received() }), _session.id()));
+  }
+
+private:
+  typename channel_type::ptr m_channel;
+
+  // destroyed first: its io thread is joined before the rest goes.
+  typename client_type::ptr m_client;
+};
+
+template<class Proto = protocol::basic>
+using basic_tcp_server = basic_server<engine::basic_session<Proto, transport::tcp>>;
+template<class Proto = protocol::basic>
+using basic_tcp_client = basic_client<engine::basic_session<Proto, transport::tcp>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Proto = protocol::basic>
+using basic_local_server = basic_server<engine::basic_session<Proto, transport::local>>;
+template<class Proto = protocol::basic>
+using basic_local_client = basic_client<engine::basic_session<Proto, transport::local>>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+} // namespace sv::net::resume
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_RESUME_HPP__
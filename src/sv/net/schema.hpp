@@ -0,0 +1,410 @@
+#ifndef __SV_NET_SCHEMA_HPP__
+#define __SV_NET_SCHEMA_HPP__
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+
+namespace sv
+{
+namespace net
+{
+namespace packet
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// schema
+//
+// compile-time field list of a message struct. specialize it with
+// SV_NET_SCHEMA at global namespace scope:
+//
+//   struct position { std::int32_t x; std::int32_t y; std::string name; };
+//   SV_NET_SCHEMA(position, 1, &position::x, &position::y, &position::name)
+//
+// the struct is encoded into a flat little-endian layout:
+//
+//   [ fixed table ][ variable data ]
+//
+// scalar fields (arithmetic, enum) live in the fixed table at their natural
+// alignment. std::string fields occupy an { offset, size } slot in the table
+// and their bytes are appended to the variable data. every field offset is a
+// compile-time constant, so struct_view reads any field in O(1) straight out
+// of the receive buffer without deserializing the message.
+//
+// id 0 is reserved for schema<void>, the untyped body used on receive. an id
+// belongs to one type: encoding or viewing a second type with the same id
+// throws std::logic_error (see schema_id).
+////////////////////////////////////////////////////////////////////////////////
+template<class T>
+struct schema;
+
+template<>
+struct schema<void>
+{
+  using type = void;
+  static constexpr std::uint32_t id = 0;
+  static constexpr auto fields = std::make_tuple();
+};
+
+#define SV_NET_SCHEMA(Type, Id, ...)                                    \
+  template<>                                                            \
+  struct sv::net::packet::schema<Type>                                  \
+  {                                                                     \
+    using type = Type;                                                  \
+    static constexpr std::uint32_t id = (Id);                           \
+    static_assert(id != 0, "schema id 0 is reserved for schema<void>"); \
+    static constexpr auto fields = std::make_tuple(__VA_ARGS__);        \
+  };
+
+namespace detail
+{
+
+template<class M>
+struct member_traits;
+template<class C, class F>
+struct member_traits<F C::*>
+{
+  using class_type = C;
+  using field_type = F;
+};
+
+inline constexpr bool is_little_endian()
+{
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+  return __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__;
+#else
+  return true;
+#endif
+}
+
+template<class U>
+U byteswap(U value)
+{
+  char bytes[sizeof(U)];
+  std::memcpy(bytes, &value, sizeof(U));
+  for (std::size_t i = 0; i < sizeof(U) / 2; ++i)
+  {
+    std::swap(bytes[i], bytes[sizeof(U) - 1 - i]);
+  }
+  std::memcpy(&value, bytes, sizeof(U));
+  return value;
+}
+
+template<class U>
+void store_le(char* dst, U value)
+{
+  if (!is_little_endian())
+  {
+    value = byteswap(value);
+  }
+  std::memcpy(dst, &value, sizeof(U));
+}
+template<class U>
+U load_le(const char* src)
+{
+  U value;
+  std::memcpy(&value, src, sizeof(U));
+  if (!is_little_endian())
+  {
+    value = byteswap(value);
+  }
+  return value;
+}
+
+// how a field type is laid out in the fixed table.
+template<class F, class = void>
+struct field_traits
+{
+  static_assert(sizeof(F) == 0, "unsupported schema field type");
+};
+template<class F>
+struct field_traits<F, std::enable_if_t<std::is_arithmetic<F>::value || std::is_enum<F>::value>>
+{
+  using view_type = F;
+
+  static constexpr std::size_t size = sizeof(F);
+  static constexpr std::size_t align = sizeof(F);
+  static constexpr bool is_variable = false;
+};
+template<>
+struct field_traits<std::string>
+{
+  using view_type = std::string_view;
+
+  // { std::uint32_t offset, std::uint32_t size }
+  static constexpr std::size_t size = 2 * sizeof(std::uint32_t);
+  static constexpr std::size_t align = sizeof(std::uint32_t);
+  static constexpr bool is_variable = true;
+};
+
+inline constexpr std::size_t align_up(std::size_t value, std::size_t align)
+{
+  return (value + align - 1) / align * align;
+}
+
+template<class T, std::size_t I>
+using field_t = typename member_traits<
+  std::decay_t<decltype(std::get<I>(schema<T>::fields))>>::field_type;
+
+template<class T>
+constexpr std::size_t field_count()
+{
+  return std::tuple_size<std::decay_t<decltype(schema<T>::fields)>>::value;
+}
+
+template<class T, std::size_t I>
+constexpr std::size_t field_offset()
+{
+  if constexpr (I == 0)
+  {
+    return 0;
+  }
+  else
+  {
+    constexpr std::size_t prev_end =
+      field_offset<T, I - 1>() + field_traits<field_t<T, I - 1>>::size;
+    return align_up(prev_end, field_traits<field_t<T, I>>::align);
+  }
+}
+
+template<class T>
+constexpr std::size_t table_size()
+{
+  constexpr std::size_t n = field_count<T>();
+  if constexpr (n == 0)
+  {
+    return 0;
+  }
+  else
+  {
+    return align_up(field_offset<T, n - 1>() + field_traits<field_t<T, n - 1>>::size, 8);
+  }
+}
+
+template<class T, auto Member, std::size_t I = 0>
+constexpr std::size_t index_of()
+{
+  static_assert(I < field_count<T>(), "member is not part of the schema");
+  if constexpr (std::is_same<decltype(Member),
+                             std::decay_t<decltype(std::get<I>(schema<T>::fields))>>::value)
+  {
+    if constexpr (std::get<I>(schema<T>::fields) == Member)
+    {
+      return I;
+    }
+    else
+    {
+      return index_of<T, Member, I + 1>();
+    }
+  }
+  else
+  {
+    return index_of<T, Member, I + 1>();
+  }
+}
+
+// the first type each id was used with.
+inline std::uint32_t claim_schema_id(std::uint32_t _id, std::type_info const& _type)
+{
+  static std::mutex mutex;
+  static std::unordered_map<std::uint32_t, std::type_index> claimed;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = claimed.emplace(_id, std::type_index(_type)).first;
+  if (it->second != std::type_index(_type))
+  {
+    throw std::logic_error("schema id " + std::to_string(_id) + " is used by both " + it->second.name() + " and "
+                           + _type.name());
+  }
+  return _id;
+}
+
+} // namespace sv::net::packet::detail
+
+// schema<T>::id, checked on first use against the ids of other types.
+template<class T>
+std::uint32_t schema_id()
+{
+  static const std::uint32_t id = detail::claim_schema_id(schema<T>::id, typeid(T));
+  return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// struct_view
+//
+// read-only accessor over an encoded message. it does not own the bytes: it
+// may point into a flat_buffer or directly into the receive buffer.
+////////////////////////////////////////////////////////////////////////////////
+template<class T>
+struct struct_view
+{
+  using self = struct_view<T>;
+  using schema_type = schema<T>;
+
+  static constexpr std::size_t sc_table_size = detail::table_size<T>();
+
+  struct_view(const char* _data, std::size_t _size)
+    : m_data(_data)
+    , m_size(_size)
+  {
+  }
+
+  // checks that the fixed table and every variable slot are in range.
+  // call it once on untrusted input before using the accessors.
+  bool valid() const
+  {
+    if (m_data == nullptr || m_size < sc_table_size)
+    {
+      return false;
+    }
+    return valid_slots(std::make_index_sequence<detail::field_count<T>()>());
+  }
+
+  template<std::size_t I>
+  typename detail::field_traits<detail::field_t<T, I>>::view_type at() const
+  {
+    using field_type = detail::field_t<T, I>;
+    constexpr std::size_t offset = detail::field_offset<T, I>();
+
+    if constexpr (detail::field_traits<field_type>::is_variable)
+    {
+      auto data_offset = detail::load_le<std::uint32_t>(m_data + offset);
+      auto data_size = detail::load_le<std::uint32_t>(m_data + offset + sizeof(std::uint32_t));
+      return std::string_view(m_data + data_offset, data_size);
+    }
+    else if constexpr (std::is_enum<field_type>::value)
+    {
+      using underlying = std::underlying_type_t<field_type>;
+      return static_cast<field_type>(detail::load_le<underlying>(m_data + offset));
+    }
+    else
+    {
+      return detail::load_le<field_type>(m_data + offset);
+    }
+  }
+  template<auto Member>
+  auto get() const
+  {
+    return at<detail::index_of<T, Member>()>();
+  }
+
+  const char* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+
+private:
+  template<std::size_t...I>
+  bool valid_slots(std::index_sequence<I...>) const
+  {
+    return (valid_slot<I>() && ...);
+  }
+  template<std::size_t I>
+  bool valid_slot() const
+  {
+    if constexpr (detail::field_traits<detail::field_t<T, I>>::is_variable)
+    {
+      constexpr std::size_t offset = detail::field_offset<T, I>();
+      std::uint64_t data_offset = detail::load_le<std::uint32_t>(m_data + offset);
+      std::uint64_t data_size = detail::load_le<std::uint32_t>(m_data + offset + sizeof(std::uint32_t));
+      return data_offset + data_size <= m_size;
+    }
+    else
+    {
+      return true;
+    }
+  }
+
+private:
+  const char* m_data;
+  std::size_t m_size;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// flat_buffer
+//
+// owning storage of an encoded message. it is the value_type of every
+// struct_body, so a received struct packet can be viewed as any schema.
+////////////////////////////////////////////////////////////////////////////////
+struct flat_buffer
+{
+  flat_buffer() = default;
+
+  template<class T, class = decltype(schema<T>::id)>
+  flat_buffer(T const& _value)
+  {
+    schema_id<T>();
+    encode(_value, std::make_index_sequence<detail::field_count<T>()>());
+  }
+
+  template<class T>
+  struct_view<T> view() const
+  {
+    return struct_view<T>(m_bytes.data(), m_bytes.size());
+  }
+
+  const char* data() const { return m_bytes.data(); }
+  std::size_t size() const { return m_bytes.size(); }
+
+  std::string& bytes() { return m_bytes; }
+  std::string const& bytes() const { return m_bytes; }
+
+private:
+  template<class T, std::size_t...I>
+  void encode(T const& _value, std::index_sequence<I...>)
+  {
+    std::size_t total = detail::table_size<T>();
+    ((total += variable_size(_value.*std::get<I>(schema<T>::fields))), ...);
+
+    m_bytes.assign(total, '\0');
+    std::size_t tail = detail::table_size<T>();
+    (encode_field<T, I>(_value.*std::get<I>(schema<T>::fields), tail), ...);
+  }
+
+  template<class F>
+  static std::size_t variable_size(F const&)
+  {
+    return 0;
+  }
+  static std::size_t variable_size(std::string const& _value)
+  {
+    return _value.size();
+  }
+
+  template<class T, std::size_t I, class F>
+  void encode_field(F const& _value, std::size_t& _tail)
+  {
+    char* dst = &m_bytes[detail::field_offset<T, I>()];
+    if constexpr (detail::field_traits<F>::is_variable)
+    {
+      detail::store_le(dst, static_cast<std::uint32_t>(_tail));
+      detail::store_le(dst + sizeof(std::uint32_t), static_cast<std::uint32_t>(_value.size()));
+      std::memcpy(&m_bytes[_tail], _value.data(), _value.size());
+      _tail += _value.size();
+    }
+    else if constexpr (std::is_enum<F>::value)
+    {
+      detail::store_le(dst, static_cast<std::underlying_type_t<F>>(_value));
+    }
+    else
+    {
+      detail::store_le(dst, _value);
+    }
+  }
+
+private:
+  std::string m_bytes;
+};
+
+} // namespace sv::net::packet
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_SCHEMA_HPP__
@@ -0,0 +1,476 @@
+#ifndef __SV_NET_SHARD_HPP__
+#define __SV_NET_SHARD_HPP__
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "sv/net/engine.hpp"
+#include "sv/net/packet.hpp"
+#include "sv/net/protocol.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace shard
+{
+
+using error_code = boost::system::error_code;
+using packet_t = packet::base::ptr;
+
+// fnv-1a, finished with the murmur3 mix so that similar keys land far apart
+// on the ring. the same on every platform and build.
+inline std::uint64_t hash(std::string_view _key)
+{
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  for (auto c : _key)
+  {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_ring
+//
+// a consistent-hash ring: each node stands at virtual_nodes points, and a
+// key belongs to the first point at or after its hash. adding a node takes
+// over only the keys in front of its own points, and removing one hands
+// them to the next points; the rest stay where they were. find() is a
+// binary search and does not allocate. not thread-safe; basic_router
+// swaps whole copies.
+////////////////////////////////////////////////////////////////////////////////
+template<class T>
+class basic_ring
+{
+public:
+  explicit basic_ring(std::size_t _virtual_nodes = 160)
+    : m_virtual_nodes(std::max<std::size_t>(_virtual_nodes, 1))
+  {
+  }
+
+  // false if _name is on the ring already.
+  bool add(std::string const& _name, T _value)
+  {
+    if (index_of(_name) != npos)
+    {
+      return false;
+    }
+    auto slot = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.push_back({ _name, std::move(_value) });
+
+    std::vector<point> added;
+    added.reserve(m_virtual_nodes);
+    for (std::size_t i = 0; i < m_virtual_nodes; ++i)
+    {
+      added.push_back({ hash(_name + '#' + std::to_string(i)), slot });
+    }
+    std::sort(added.begin(), added.end(), [this](point const& a, point const& b) { return before(a, b); });
+    auto middle = m_points.insert(m_points.end(), added.begin(), added.end());
+    std::inplace_merge(m_points.begin(), middle, m_points.end(),
+                       [this](point const& a, point const& b) { return before(a, b); });
+    return true;
+  }
+  bool remove(std::string const& _name)
+  {
+    auto slot = index_of(_name);
+    if (slot == npos)
+    {
+      return false;
+    }
+    // the last node moves into the freed slot.
+    auto last = static_cast<std::uint32_t>(m_nodes.size() - 1);
+    m_points.erase(std::remove_if(m_points.begin(), m_points.end(), [slot](point const& p) { return p.slot == slot; }),
+                   m_points.end());
+    if (slot != last)
+    {
+      for (auto& e : m_points)
+      {
+        if (e.slot == last)
+        {
+          e.slot = slot;
+        }
+      }
+      m_nodes[slot] = std::move(m_nodes[last]);
+    }
+    m_nodes.pop_back();
+    return true;
+  }
+  // nullptr on an empty ring.
+  T const* find(std::uint64_t _hash) const
+  {
+    auto node = find_node(_hash);
+    return node == nullptr ? nullptr : &node->second;
+  }
+  T const* find(std::string_view _key) const
+  {
+    return find(hash(_key));
+  }
+  // the name of the node _key belongs to; empty on an empty ring.
+  std::string const& locate(std::string_view _key) const
+  {
+    static const std::string sc_none;
+    auto node = find_node(hash(_key));
+    return node == nullptr ? sc_none : node->first;
+  }
+  T const* get(std::string const& _name) const
+  {
+    auto slot = index_of(_name);
+    return slot == npos ? nullptr : &m_nodes[slot].second;
+  }
+  std::size_t size() const
+  {
+    return m_nodes.size();
+  }
+  template<class Visitor>
+  void for_each(Visitor&& _visit) const
+  {
+    for (auto const& e : m_nodes)
+    {
+      _visit(e.first, e.second);
+    }
+  }
+
+private:
+  static constexpr std::uint32_t npos = ~std::uint32_t(0);
+
+  struct point
+  {
+    std::uint64_t hash;
+    std::uint32_t slot;
+  };
+
+  // points of equal hash are ordered by node name, so that the ring does
+  // not depend on the order nodes were added in.
+  bool before(point const& _a, point const& _b) const
+  {
+    if (_a.hash != _b.hash)
+    {
+      return _a.hash < _b.hash;
+    }
+    return m_nodes[_a.slot].first < m_nodes[_b.slot].first;
+  }
+  std::pair<std::string, T> const* find_node(std::uint64_t _hash) const
+  {
+    if (m_points.empty())
+    {
+      return nullptr;
+    }
+    auto it = std::lower_bound(m_points.begin(), m_points.end(), _hash,
+                               [](point const& p, std::uint64_t h) { return p.hash < h; });
+    if (it == m_points.end())
+    {
+      it = m_points.begin();
+    }
+    return &m_nodes[it->slot];
+  }
+  std::uint32_t index_of(std::string const& _name) const
+  {
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      if (m_nodes[i].first == _name)
+      {
+        return static_cast<std::uint32_t>(i);
+      }
+    }
+    return npos;
+  }
+
+private:
+  std::size_t m_virtual_nodes;
+  std::vector<std::pair<std::string, T>> m_nodes;
+  std::vector<point> m_points;
+};
+
+using ring = basic_ring<std::string>;
+
+////////////////////////////////////////////////////////////////////////////////
+// basic_router
+//
+// sends each message to the node its key belongs to on a basic_ring, over
+// a pool of connections per node that are opened when the node is added and
+// reconnect on their own. all messages of a key take the same connection,
+// so they arrive in order while it stays up; when it is down the next one
+// of the node is used. nodes can be added and removed while sending: the
+// ring is copied, changed and swapped in. a node goes on the ring once it
+// has a connection up, and a removed one is closed by a later add_node or
+// remove_node once no send is using it.
+////////////////////////////////////////////////////////////////////////////////
+struct options
+{
+  std::size_t virtual_nodes = 160;
+  // connections per node.
+  std::size_t connections = 2;
+  // before connecting to a node again.
+  std::chrono::steady_clock::duration reconnect = std::chrono::milliseconds(100);
+};
+
+struct node_statistics
+{
+  std::string name;
+  std::size_t connected = 0;
+  std::uint64_t sent = 0;
+};
+
+template<class _Session>
+class basic_router
+{
+public:
+  using self = basic_router<_Session>;
+  using ptr = std::shared_ptr<self>;
+  using session_type = _Session;
+  using client_type = engine::basic_client<engine::basic_connector<session_type>>;
+  using receive_handler = std::function<void(packet_t)>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  explicit basic_router(options const& _options = options())
+    : m_options(_options)
+    , m_ring(std::make_shared<ring_type>(_options.virtual_nodes))
+  {
+  }
+  basic_router(basic_router const&) = delete;
+  basic_router& operator=(basic_router const&) = delete;
+  ~basic_router()
+  {
+    // the nodes' io threads are joined, outside the lock their on_session
+    // takes, before the handlers go.
+    std::shared_ptr<ring_type const> ring;
+    std::vector<std::shared_ptr<node>> closing;
+    {
+      std::lock_guard<std::mutex> lock(m_update_mutex);
+      ring = std::move(m_ring);
+      closing.swap(m_retired);
+      closing.insert(closing.end(), m_joining.begin(), m_joining.end());
+      m_joining.clear();
+    }
+  }
+
+  // before add_node. packets from every node, on that connection's io
+  // thread.
+  void on_receive(receive_handler _handler)
+  {
+    m_on_receive = std::move(_handler);
+  }
+  // before add_node.
+  void set_tuning(tuning::options const& _tuning)
+  {
+    m_tuning = _tuning;
+  }
+  // thread-safe. _name places the node on the ring, the rest are the
+  // arguments of client_type::execute. the node connects at once and goes
+  // on the ring with its first connection. false if _name is taken.
+  template<class...Args>
+  bool add_node(std::string const& _name, Args&&...args)
+  {
+    auto added = std::make_shared<node>();
+    added->name = _name;
+    added->connections.resize(std::max<std::size_t>(m_options.connections, 1));
+    for (auto& e : added->connections)
+    {
+      e = std::make_unique<connection>();
+      e->owner = added.get();
+      auto* raw = e.get();
+      e->client->set_tuning(m_tuning);
+      e->client->set_reconnect(m_options.reconnect);
+      e->client->on_session([this, raw](typename session_type::ptr const& session) { on_session(*raw, session); });
+    }
+
+    std::vector<std::shared_ptr<node>> closing;
+    std::lock_guard<std::mutex> lock(m_update_mutex);
+    collect(closing);
+    auto taken = [&_name](std::shared_ptr<node> const& e) { return e->name == _name; };
+    if (m_ring->get(_name) != nullptr || std::any_of(m_joining.begin(), m_joining.end(), taken))
+    {
+      return false;
+    }
+    m_joining.push_back(added);
+    for (auto& e : added->connections)
+    {
+      e->client->execute(args...);
+    }
+    return true;
+  }
+  // thread-safe. the node's keys move to the nodes that follow its points.
+  bool remove_node(std::string const& _name)
+  {
+    std::vector<std::shared_ptr<node>> closing;
+    std::lock_guard<std::mutex> lock(m_update_mutex);
+    collect(closing);
+    auto joining = std::find_if(m_joining.begin(), m_joining.end(),
+                                [&_name](std::shared_ptr<node> const& e) { return e->name == _name; });
+    if (joining != m_joining.end())
+    {
+      m_retired.push_back(std::move(*joining));
+      m_joining.erase(joining);
+      return true;
+    }
+    auto removed = m_ring->get(_name);
+    if (removed == nullptr)
+    {
+      return false;
+    }
+    m_retired.push_back(*removed);
+    auto next = std::make_shared<ring_type>(*m_ring);
+    next->remove(_name);
+    std::atomic_store(&m_ring, std::shared_ptr<ring_type const>(std::move(next)));
+    return true;
+  }
+  // thread-safe. false when the key's node has no connection up; the
+  // message is not sent to another node.
+  bool send(std::string_view _key, packet_t _packet)
+  {
+    auto current = std::atomic_load(&m_ring);
+    auto h = hash(_key);
+    auto found = current->find(h);
+    if (found == nullptr)
+    {
+      return false;
+    }
+    auto& connections = (*found)->connections;
+    // another mix of the hash, so a key's connection does not follow from
+    // its place on the ring.
+    auto first = static_cast<std::size_t>((h * 0x9e3779b97f4a7c15ull) >> 32) % connections.size();
+    for (std::size_t i = 0; i < connections.size(); ++i)
+    {
+      auto& c = *connections[(first + i) % connections.size()];
+      std::shared_ptr<session_type> session;
+      {
+        std::lock_guard<std::mutex> lock(c.mutex);
+        session = c.session.lock();
+      }
+      if (session != nullptr)
+      {
+        session->protocol().send(std::move(_packet));
+        (*found)->sent.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+  // the node _key belongs to; empty without nodes.
+  std::string locate(std::string_view _key) const
+  {
+    return std::atomic_load(&m_ring)->locate(_key);
+  }
+  std::vector<node_statistics> stats() const
+  {
+    std::vector<node_statistics> result;
+    std::atomic_load(&m_ring)->for_each([&result](std::string const& name, std::shared_ptr<node> const& n)
+    {
+      node_statistics s;
+      s.name = name;
+      for (auto const& c : n->connections)
+      {
+        std::lock_guard<std::mutex> lock(c->mutex);
+        s.connected += c->session.expired() ? 0 : 1;
+      }
+      s.sent = n->sent.load(std::memory_order_relaxed);
+      result.push_back(std::move(s));
+    });
+    return result;
+  }
+
+private:
+  struct node;
+  struct connection
+  {
+    connection()
+      : client(client_type::make())
+    {
+    }
+
+    node* owner = nullptr;
+    std::mutex mutex;
+    std::weak_ptr<session_type> session;
+    // destroyed first: its io thread is joined before the rest goes.
+    typename client_type::ptr client;
+  };
+  struct node
+  {
+    std::string name;
+    std::atomic<std::uint64_t> sent{ 0 };
+    std::vector<std::unique_ptr<connection>> connections;
+  };
+  using ring_type = basic_ring<std::shared_ptr<node>>;
+
+  // with m_update_mutex held: hands over the removed nodes no send holds
+  // any more, to be closed once the lock is released. not on a node's own
+  // io thread, as closing one joins it.
+  void collect(std::vector<std::shared_ptr<node>>& _closing)
+  {
+    auto held = std::partition(m_retired.begin(), m_retired.end(),
+                               [](std::shared_ptr<node> const& e) { return e.use_count() > 1; });
+    std::move(held, m_retired.end(), std::back_inserter(_closing));
+    m_retired.erase(held, m_retired.end());
+  }
+  // on the connection's io thread.
+  void on_session(connection& _connection, typename session_type::ptr const& _session)
+  {
+    if (m_on_receive)
+    {
+      _session->protocol().on_receive(m_on_receive);
+    }
+    {
+      std::lock_guard<std::mutex> lock(_connection.mutex);
+      _connection.session = _session;
+    }
+    // the first connection of a new node puts it on the ring.
+    std::lock_guard<std::mutex> lock(m_update_mutex);
+    auto joining = std::find_if(m_joining.begin(), m_joining.end(),
+                                [&_connection](std::shared_ptr<node> const& e) { return e.get() == _connection.owner; });
+    if (joining == m_joining.end())
+    {
+      return;
+    }
+    auto next = std::make_shared<ring_type>(*m_ring);
+    next->add((*joining)->name, *joining);
+    m_joining.erase(joining);
+    std::atomic_store(&m_ring, std::shared_ptr<ring_type const>(std::move(next)));
+  }
+
+private:
+  options m_options;
+  tuning::options m_tuning;
+  receive_handler m_on_receive;
+  std::mutex m_update_mutex;
+  // added and not connected yet.
+  std::vector<std::shared_ptr<node>> m_joining;
+  // removed nodes, until no send holds them.
+  std::vector<std::shared_ptr<node>> m_retired;
+  std::shared_ptr<ring_type const> m_ring;
+};
+
+template<class Proto = protocol::basic>
+using basic_tcp_router = basic_router<engine::basic_session<Proto, transport::tcp>>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Proto = protocol::basic>
+using basic_local_router = basic_router<engine::basic_session<Proto, transport::local>>;
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+} // namespace sv::net::shard
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_SHARD_HPP__
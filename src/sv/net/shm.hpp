@@ -0,0 +1,630 @@
+#ifndef __SV_NET_SHM_HPP__
+#define __SV_NET_SHM_HPP__
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+
+namespace sv
+{
+namespace net
+{
+namespace shm
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// region layout
+//
+//   [ header ][ ring 0 data ][ ring 1 data ]
+//
+// ring 0 carries client to server, ring 1 server to client. the region is a
+// memfd created by the server and passed to the client, together with four
+// eventfds, over the unix socket the client connected to (SCM_RIGHTS).
+////////////////////////////////////////////////////////////////////////////////
+struct control
+{
+  alignas(64) std::atomic<std::uint64_t> head;
+  alignas(64) std::atomic<std::uint64_t> tail;
+  // set by the side that parked on the ring; cleared by the side that wakes it.
+  alignas(64) std::atomic<std::uint32_t> read_waiting;
+  std::atomic<std::uint32_t> write_waiting;
+};
+
+struct header
+{
+  static const std::uint32_t sc_magic = 0x53564d52; // "SVMR"
+
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint64_t capacity;
+  std::atomic<std::uint32_t> closed;
+  control ring[2];
+};
+
+// eventfd slots: [side * 2 + 0] wakes that side's reader, [side * 2 + 1] its writer.
+enum : int
+{
+  sc_eventfd_count = 4,
+};
+
+inline std::size_t region_size(std::uint64_t _capacity)
+{
+  return sizeof(header) + 2 * _capacity;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// stream
+//
+// AsyncReadStream/AsyncWriteStream over a shared memory ring pair. an empty
+// (or full) ring is first polled for a short, adaptive spin budget; only then
+// does the operation park on its eventfd, so a busy peer is never woken via
+// a syscall.
+////////////////////////////////////////////////////////////////////////////////
+class stream
+{
+  friend class acceptor;
+
+public:
+  using executor_type = asio::local::stream_protocol::socket::executor_type;
+  using endpoint_type = asio::local::stream_protocol::endpoint;
+
+  static const std::uint64_t sc_ring_size = 1024 * 1024;
+  static const int sc_min_spin = 16;
+  static const int sc_max_spin = 4 * 1024;
+
+  explicit stream(asio::io_context& _ioc)
+    : m_control(_ioc)
+    , m_read_event(_ioc)
+    , m_write_event(_ioc)
+    , m_header(nullptr)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_side(0)
+    , m_peer_read_fd(-1)
+    , m_peer_write_fd(-1)
+    , m_spin(sc_min_spin)
+    , m_read_value(0)
+    , m_write_value(0)
+  {
+  }
+  stream(stream const&) = delete;
+  stream& operator=(stream const&) = delete;
+  ~stream()
+  {
+    close();
+  }
+
+  executor_type get_executor() noexcept
+  {
+    return m_control.get_executor();
+  }
+  bool is_open() const
+  {
+    return m_control.is_open();
+  }
+  void close()
+  {
+    if (m_header != nullptr)
+    {
+      m_header->closed.store(1, std::memory_order_seq_cst);
+      signal(m_peer_read_fd);
+      signal(m_peer_write_fd);
+    }
+
+    error_code ignored;
+    m_read_event.close(ignored);
+    m_write_event.close(ignored);
+    m_control.close(ignored);
+    unmap();
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_control.local_endpoint();
+  }
+  endpoint_type remote_endpoint() const
+  {
+    return m_control.remote_endpoint();
+  }
+
+  template<class ConnectHandler>
+  auto async_connect(endpoint_type const& _endpoint, ConnectHandler&& _handler)
+  {
+    return asio::async_initiate<ConnectHandler, void(error_code)>(
+      [this](auto&& handler, endpoint_type const& endpoint)
+      {
+        auto op = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+        m_control.async_connect(endpoint, [this, op](error_code const& ec)
+        {
+          if (!!ec)
+          {
+            (*op)(ec);
+            return;
+          }
+          m_control.async_wait(asio::socket_base::wait_read, [this, op](error_code const& ec)
+          {
+            (*op)(!!ec ? ec : receive_region());
+          });
+        });
+      },
+      _handler, _endpoint);
+  }
+
+  template<class MutableBufferSequence, class ReadHandler>
+  auto async_read_some(MutableBufferSequence const& _buffers, ReadHandler&& _handler)
+  {
+    return asio::async_initiate<ReadHandler, void(error_code, std::size_t)>(
+      [this](auto&& handler, MutableBufferSequence const& buffers)
+      {
+        start_read(buffers, std::move(handler));
+      },
+      _handler, _buffers);
+  }
+  template<class ConstBufferSequence, class WriteHandler>
+  auto async_write_some(ConstBufferSequence const& _buffers, WriteHandler&& _handler)
+  {
+    return asio::async_initiate<WriteHandler, void(error_code, std::size_t)>(
+      [this](auto&& handler, ConstBufferSequence const& buffers)
+      {
+        start_write(buffers, std::move(handler));
+      },
+      _handler, _buffers);
+  }
+
+private:
+  control& in() { return m_header->ring[1 - m_side]; }
+  control& out() { return m_header->ring[m_side]; }
+  char* in_data() { return m_data + (1 - m_side) * m_header->capacity; }
+  char* out_data() { return m_data + m_side * m_header->capacity; }
+
+  template<class Handler, class...Args>
+  void complete(Handler&& _handler, Args...args)
+  {
+    auto ex = asio::get_associated_executor(_handler, get_executor());
+    asio::post(ex, [handler = std::forward<Handler>(_handler), args...]() mutable
+                   {
+                     handler(args...);
+                   });
+  }
+
+  template<class BufferSequence, class Transfer>
+  std::size_t spin(BufferSequence const& _buffers, Transfer _transfer)
+  {
+    for (int i = 0; i < m_spin; ++i)
+    {
+      auto bytes = _transfer(_buffers);
+      if (bytes > 0)
+      {
+        m_spin = std::min(m_spin * 2, int(sc_max_spin));
+        return bytes;
+      }
+      if (m_header->closed.load(std::memory_order_acquire))
+      {
+        break;
+      }
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+    m_spin = std::max(m_spin / 2, int(sc_min_spin));
+    return 0;
+  }
+
+  template<class MutableBufferSequence>
+  std::size_t read_ring(MutableBufferSequence const& _buffers)
+  {
+    auto& ctl = in();
+    auto capacity = m_header->capacity;
+    auto tail = ctl.tail.load(std::memory_order_relaxed);
+    auto head = ctl.head.load(std::memory_order_acquire);
+
+    std::size_t bytes = 0;
+    for (auto it = asio::buffer_sequence_begin(_buffers); it != asio::buffer_sequence_end(_buffers) && tail != head; ++it)
+    {
+      asio::mutable_buffer b(*it);
+      auto n = std::min<std::uint64_t>(b.size(), head - tail);
+      auto offset = tail % capacity;
+      auto first = std::min<std::uint64_t>(n, capacity - offset);
+      std::memcpy(b.data(), in_data() + offset, first);
+      std::memcpy(static_cast<char*>(b.data()) + first, in_data(), n - first);
+      tail += n;
+      bytes += n;
+    }
+    if (bytes > 0)
+    {
+      ctl.tail.store(tail, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ctl.write_waiting.load(std::memory_order_relaxed) && ctl.write_waiting.exchange(0))
+      {
+        signal(m_peer_write_fd);
+      }
+    }
+    return bytes;
+  }
+  template<class ConstBufferSequence>
+  std::size_t write_ring(ConstBufferSequence const& _buffers)
+  {
+    auto& ctl = out();
+    auto capacity = m_header->capacity;
+    auto head = ctl.head.load(std::memory_order_relaxed);
+    auto tail = ctl.tail.load(std::memory_order_acquire);
+
+    std::size_t bytes = 0;
+    for (auto it = asio::buffer_sequence_begin(_buffers); it != asio::buffer_sequence_end(_buffers) && head - tail < capacity; ++it)
+    {
+      asio::const_buffer b(*it);
+      auto n = std::min<std::uint64_t>(b.size(), capacity - (head - tail));
+      auto offset = head % capacity;
+      auto first = std::min<std::uint64_t>(n, capacity - offset);
+      std::memcpy(out_data() + offset, b.data(), first);
+      std::memcpy(out_data(), static_cast<const char*>(b.data()) + first, n - first);
+      head += n;
+      bytes += n;
+    }
+    if (bytes > 0)
+    {
+      ctl.head.store(head, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ctl.read_waiting.load(std::memory_order_relaxed) && ctl.read_waiting.exchange(0))
+      {
+        signal(m_peer_read_fd);
+      }
+    }
+    return bytes;
+  }
+
+  template<class MutableBufferSequence, class Handler>
+  void start_read(MutableBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_header == nullptr)
+    {
+      complete(std::move(_handler), error_code(asio::error::bad_descriptor), std::size_t(0));
+      return;
+    }
+
+    auto reader = [this](MutableBufferSequence const& b) { return read_ring(b); };
+    auto bytes = reader(_buffers);
+    if (bytes == 0 && asio::buffer_size(_buffers) > 0)
+    {
+      bytes = spin(_buffers, reader);
+    }
+    if (bytes > 0 || asio::buffer_size(_buffers) == 0)
+    {
+      complete(std::move(_handler), error_code(), bytes);
+      return;
+    }
+    if (m_header->closed.load(std::memory_order_acquire))
+    {
+      complete(std::move(_handler), error_code(asio::error::eof), std::size_t(0));
+      return;
+    }
+
+    // park: publish the flag, then look once more so a racing write is not missed.
+    auto& ctl = in();
+    ctl.read_waiting.store(1, std::memory_order_seq_cst);
+    if (ctl.head.load(std::memory_order_seq_cst) != ctl.tail.load(std::memory_order_relaxed)
+        || m_header->closed.load(std::memory_order_seq_cst))
+    {
+      ctl.read_waiting.store(0, std::memory_order_relaxed);
+      auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+      asio::post(get_executor(), [this, _buffers, op]() { start_read(_buffers, std::move(*op)); });
+      return;
+    }
+
+    auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+    m_read_event.async_read_some(asio::buffer(&m_read_value, sizeof(m_read_value)),
+                                 [this, _buffers, op](error_code const& ec, std::size_t)
+                                 {
+                                   if (!!ec)
+                                   {
+                                     (*op)(ec, std::size_t(0));
+                                     return;
+                                   }
+                                   start_read(_buffers, std::move(*op));
+                                 });
+  }
+
+  template<class ConstBufferSequence, class Handler>
+  void start_write(ConstBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_header == nullptr)
+    {
+      complete(std::move(_handler), error_code(asio::error::bad_descriptor), std::size_t(0));
+      return;
+    }
+    if (m_header->closed.load(std::memory_order_acquire))
+    {
+      complete(std::move(_handler), error_code(asio::error::broken_pipe), std::size_t(0));
+      return;
+    }
+
+    auto writer = [this](ConstBufferSequence const& b) { return write_ring(b); };
+    auto bytes = writer(_buffers);
+    if (bytes == 0 && asio::buffer_size(_buffers) > 0)
+    {
+      bytes = spin(_buffers, writer);
+    }
+    if (bytes > 0 || asio::buffer_size(_buffers) == 0)
+    {
+      complete(std::move(_handler), error_code(), bytes);
+      return;
+    }
+
+    auto& ctl = out();
+    ctl.write_waiting.store(1, std::memory_order_seq_cst);
+    if (ctl.head.load(std::memory_order_relaxed) - ctl.tail.load(std::memory_order_seq_cst) < m_header->capacity
+        || m_header->closed.load(std::memory_order_seq_cst))
+    {
+      ctl.write_waiting.store(0, std::memory_order_relaxed);
+      auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+      asio::post(get_executor(), [this, _buffers, op]() { start_write(_buffers, std::move(*op)); });
+      return;
+    }
+
+    auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+    m_write_event.async_read_some(asio::buffer(&m_write_value, sizeof(m_write_value)),
+                                  [this, _buffers, op](error_code const& ec, std::size_t)
+                                  {
+                                    if (!!ec)
+                                    {
+                                      (*op)(ec, std::size_t(0));
+                                      return;
+                                    }
+                                    start_write(_buffers, std::move(*op));
+                                  });
+  }
+
+  static void signal(int _fd)
+  {
+    if (_fd >= 0)
+    {
+      ::eventfd_write(_fd, 1);
+    }
+  }
+
+  // server side: create the region and the eventfds, hand them to the client.
+  error_code create_region()
+  {
+    int fds[1 + sc_eventfd_count] = { -1, -1, -1, -1, -1 };
+    auto fail = [&fds]()
+    {
+      error_code ec(errno, asio::error::get_system_category());
+      for (auto fd : fds)
+      {
+        if (fd >= 0) ::close(fd);
+      }
+      return ec;
+    };
+
+    fds[0] = ::memfd_create("sv.net.shm", MFD_CLOEXEC);
+    if (fds[0] < 0 || ::ftruncate(fds[0], region_size(sc_ring_size)) != 0)
+    {
+      return fail();
+    }
+    for (int i = 1; i <= sc_eventfd_count; ++i)
+    {
+      fds[i] = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (fds[i] < 0)
+      {
+        return fail();
+      }
+    }
+    if (!map(fds[0], region_size(sc_ring_size)))
+    {
+      return fail();
+    }
+
+    new (m_header) header();
+    m_header->magic = header::sc_magic;
+    m_header->version = 1;
+    m_header->capacity = sc_ring_size;
+    m_header->closed = 0;
+    for (auto& ctl : m_header->ring)
+    {
+      ctl.head = 0;
+      ctl.tail = 0;
+      ctl.read_waiting = 0;
+      ctl.write_waiting = 0;
+    }
+
+    char tag = 's';
+    iovec iov{ &tag, 1 };
+    char cmsg_buffer[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg_buffer;
+    msg.msg_controllen = sizeof(cmsg_buffer);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (::sendmsg(m_control.native_handle(), &msg, MSG_NOSIGNAL) != 1)
+    {
+      unmap();
+      return fail();
+    }
+
+    ::close(fds[0]);
+    attach(1, fds + 1);
+    return error_code();
+  }
+  // client side: receive the region and the eventfds from the server.
+  error_code receive_region()
+  {
+    int fds[1 + sc_eventfd_count] = { -1, -1, -1, -1, -1 };
+    char tag = 0;
+    iovec iov{ &tag, 1 };
+    char cmsg_buffer[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg_buffer;
+    msg.msg_controllen = sizeof(cmsg_buffer);
+    if (::recvmsg(m_control.native_handle(), &msg, MSG_CMSG_CLOEXEC) != 1)
+    {
+      return error_code(errno, asio::error::get_system_category());
+    }
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+    {
+      return error_code(asio::error::invalid_argument);
+    }
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    struct stat st{};
+    bool ok = (::fstat(fds[0], &st) == 0)
+           && (std::size_t(st.st_size) >= sizeof(header))
+           && map(fds[0], std::size_t(st.st_size))
+           && (m_header->magic == header::sc_magic)
+           && (region_size(m_header->capacity) <= std::size_t(st.st_size));
+    ::close(fds[0]);
+    if (!ok)
+    {
+      unmap();
+      for (int i = 1; i <= sc_eventfd_count; ++i)
+      {
+        ::close(fds[i]);
+      }
+      return error_code(asio::error::invalid_argument);
+    }
+
+    attach(0, fds + 1);
+    return error_code();
+  }
+
+  bool map(int _fd, std::size_t _size)
+  {
+    void* p = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED)
+    {
+      return false;
+    }
+    m_header = static_cast<header*>(p);
+    m_data = static_cast<char*>(p) + sizeof(header);
+    m_size = _size;
+    return true;
+  }
+  void unmap()
+  {
+    if (m_header != nullptr)
+    {
+      ::munmap(m_header, m_size);
+      m_header = nullptr;
+      m_data = nullptr;
+    }
+    for (auto* fd : { &m_peer_read_fd, &m_peer_write_fd })
+    {
+      if (*fd >= 0)
+      {
+        ::close(*fd);
+        *fd = -1;
+      }
+    }
+  }
+  void attach(int _side, const int* _eventfds)
+  {
+    m_side = _side;
+    m_read_event.assign(_eventfds[_side * 2 + 0]);
+    m_write_event.assign(_eventfds[_side * 2 + 1]);
+    m_peer_read_fd = _eventfds[(1 - _side) * 2 + 0];
+    m_peer_write_fd = _eventfds[(1 - _side) * 2 + 1];
+  }
+
+private:
+  // stays connected for the lifetime of the stream; it only carries the handshake.
+  asio::local::stream_protocol::socket m_control;
+  asio::posix::stream_descriptor m_read_event;
+  asio::posix::stream_descriptor m_write_event;
+
+  header* m_header;
+  char* m_data;
+  std::size_t m_size;
+  int m_side;
+
+  int m_peer_read_fd;
+  int m_peer_write_fd;
+
+  int m_spin;
+  std::uint64_t m_read_value;
+  std::uint64_t m_write_value;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// acceptor
+//
+// listens on a unix socket path; every accepted connection gets its own region.
+////////////////////////////////////////////////////////////////////////////////
+class acceptor
+{
+public:
+  using executor_type = asio::local::stream_protocol::acceptor::executor_type;
+  using endpoint_type = stream::endpoint_type;
+
+  acceptor(asio::io_context& _ioc, endpoint_type const& _endpoint)
+    : m_acceptor(_ioc, _endpoint)
+  {
+  }
+
+  executor_type get_executor() noexcept
+  {
+    return m_acceptor.get_executor();
+  }
+  bool is_open() const
+  {
+    return m_acceptor.is_open();
+  }
+  void close()
+  {
+    m_acceptor.close();
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_acceptor.local_endpoint();
+  }
+
+  template<class AcceptHandler>
+  auto async_accept(stream& _peer, AcceptHandler&& _handler)
+  {
+    return asio::async_initiate<AcceptHandler, void(error_code)>(
+      [this, &_peer](auto&& handler)
+      {
+        auto op = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+        m_acceptor.async_accept(_peer.m_control, [&_peer, op](error_code const& ec)
+        {
+          (*op)(!!ec ? ec : _peer.create_region());
+        });
+      },
+      _handler);
+  }
+
+private:
+  asio::local::stream_protocol::acceptor m_acceptor;
+};
+
+} // namespace sv::net::shm
+} // namespace sv::net
+} // namespace sv
+
+#endif // __linux__
+
+#endif // __SV_NET_SHM_HPP__
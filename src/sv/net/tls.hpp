@@ -0,0 +1,801 @@
+#ifndef __SV_NET_TLS_HPP__
+#define __SV_NET_TLS_HPP__
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "sv/net/admission.hpp"
+#include "sv/net/tuning.hpp"
+
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/kdf.h>
+#endif // OPENSSL_VERSION_NUMBER
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+#if !defined(TCP_ULP)
+#define TCP_ULP 31
+#endif // TCP_ULP
+#if !defined(SOL_TLS)
+#define SOL_TLS 282
+#endif // SOL_TLS
+#endif // __linux__
+
+namespace sv
+{
+namespace net
+{
+namespace tls
+{
+
+namespace asio = boost::asio;
+namespace ssl = boost::asio::ssl;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// config
+//
+// pem text wins over the matching *_file. clients check the server
+// certificate, against ca (or ca_file) or else the system's trusted roots,
+// and its name against server_name or else the address connected to. a ca
+// makes servers require client certificates.
+////////////////////////////////////////////////////////////////////////////////
+struct config
+{
+  std::string certificate_chain;
+  std::string certificate_chain_file;
+  std::string private_key;
+  std::string private_key_file;
+  std::string ca;
+  std::string ca_file;
+
+  // client: sni and the name the server certificate must carry.
+  std::string server_name;
+  // client: false accepts any server certificate, for tests only.
+  bool verify_server = true;
+
+  // server: issue session tickets. client: keep the tickets it is given and
+  // offer them on the next connect to the same endpoint.
+  bool resumption = true;
+  int tickets = 2;
+
+  // linux: after a tls 1.3 aes-gcm handshake, hand the send keys to the
+  // kernel (TCP_ULP "tls"), so writes are encrypted without a copy through
+  // openssl. falls back to openssl when the kernel refuses.
+  bool kernel_tls = false;
+
+  // server: a connection that has not finished its handshake by then is
+  // closed, and what waits on it fails with timed_out. zero waits forever.
+  std::chrono::milliseconds handshake_timeout = std::chrono::seconds(10);
+};
+
+class stream;
+
+////////////////////////////////////////////////////////////////////////////////
+// context
+//
+// one ssl context shared by every stream of a server or client, plus the
+// client-side session cache keyed by endpoint.
+////////////////////////////////////////////////////////////////////////////////
+class context
+{
+  friend class stream;
+
+public:
+  using self = context;
+  using ptr = std::shared_ptr<self>;
+
+  static ptr make(config const& _config)
+  {
+    return std::make_shared<self>(_config);
+  }
+
+  explicit context(config const& _config)
+    : m_config(_config)
+    , m_ssl(ssl::context::tls)
+  {
+    m_ssl.set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3 |
+                      ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1 | ssl::context::single_dh_use);
+
+    if (!m_config.certificate_chain.empty())
+      m_ssl.use_certificate_chain(asio::buffer(m_config.certificate_chain));
+    else if (!m_config.certificate_chain_file.empty())
+      m_ssl.use_certificate_chain_file(m_config.certificate_chain_file);
+
+    if (!m_config.private_key.empty())
+      m_ssl.use_private_key(asio::buffer(m_config.private_key), ssl::context::pem);
+    else if (!m_config.private_key_file.empty())
+      m_ssl.use_private_key_file(m_config.private_key_file, ssl::context::pem);
+
+    if (!m_config.ca.empty())
+      m_ssl.add_certificate_authority(asio::buffer(m_config.ca));
+    else if (!m_config.ca_file.empty())
+      m_ssl.load_verify_file(m_config.ca_file);
+    else if (m_config.verify_server)
+      m_ssl.set_default_verify_paths();
+
+    auto* handle = m_ssl.native_handle();
+    static const unsigned char sc_session_context[] = "sv.net";
+    SSL_CTX_set_session_id_context(handle, sc_session_context, sizeof(sc_session_context) - 1);
+    // servers resume from tickets alone and clients keep their sessions in
+    // m_sessions, so openssl's internal store stays empty.
+    SSL_CTX_set_session_cache_mode(handle, SSL_SESS_CACHE_BOTH | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    if (m_config.resumption)
+    {
+      SSL_CTX_set_num_tickets(handle, static_cast<std::size_t>(m_config.tickets));
+      SSL_CTX_sess_set_new_cb(handle, &self::on_new_session);
+    }
+    else
+    {
+      SSL_CTX_set_num_tickets(handle, 0);
+      SSL_CTX_set_options(handle, SSL_OP_NO_TICKET);
+    }
+    if (m_config.kernel_tls)
+    {
+      SSL_CTX_set_keylog_callback(handle, &self::on_keylog);
+      SSL_CTX_set_msg_callback(handle, &self::on_message);
+    }
+  }
+  context(context const&) = delete;
+  context& operator=(context const&) = delete;
+  ~context()
+  {
+    for (auto& e : m_sessions)
+    {
+      SSL_SESSION_free(e.second);
+    }
+  }
+
+  config const& get_config() const
+  {
+    return m_config;
+  }
+  ssl::context& native()
+  {
+    return m_ssl;
+  }
+  // forgets the cached client sessions; the next connects do full handshakes.
+  void clear_sessions()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& e : m_sessions)
+    {
+      SSL_SESSION_free(e.second);
+    }
+    m_sessions.clear();
+  }
+
+private:
+  // per-SSL state the openssl callbacks reach through ex data.
+  struct state
+  {
+    context* owner = nullptr;
+    std::string key;
+    std::vector<unsigned char> tx_secret;
+    std::uint64_t tickets_sent = 0;
+  };
+
+  static int state_index()
+  {
+    static const int s_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return s_index;
+  }
+  static state* get_state(SSL const* _ssl)
+  {
+    return static_cast<state*>(SSL_get_ex_data(_ssl, state_index()));
+  }
+
+  void resume(std::string const& _key, SSL* _ssl)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(_key);
+    if (it != m_sessions.end() && SSL_SESSION_is_resumable(it->second))
+    {
+      SSL_set_session(_ssl, it->second);
+    }
+  }
+
+  // client: called for every ticket received, the latest one per endpoint is
+  // kept. the cache holds a copy because openssl marks the connection's own
+  // session unresumable when it is freed without a close_notify.
+  static int on_new_session(SSL* _ssl, SSL_SESSION* _session)
+  {
+    auto* s = get_state(_ssl);
+    if (SSL_is_server(_ssl) || s == nullptr || s->key.empty())
+    {
+      return 0;
+    }
+
+    auto* copy = SSL_SESSION_dup(_session);
+    if (copy == nullptr)
+    {
+      return 0;
+    }
+    std::lock_guard<std::mutex> lock(s->owner->m_mutex);
+    auto& slot = s->owner->m_sessions[s->key];
+    if (slot != nullptr)
+    {
+      SSL_SESSION_free(slot);
+    }
+    slot = copy;
+    return 0;
+  }
+  // the only way to the tls 1.3 traffic secrets kernel tls needs.
+  static void on_keylog(SSL const* _ssl, const char* _line)
+  {
+    auto* s = get_state(_ssl);
+    if (s == nullptr)
+    {
+      return;
+    }
+
+    const char* label = SSL_is_server(_ssl) ? "SERVER_TRAFFIC_SECRET_0 " : "CLIENT_TRAFFIC_SECRET_0 ";
+    auto label_size = std::strlen(label);
+    if (std::strncmp(_line, label, label_size) != 0)
+    {
+      return;
+    }
+    // LABEL <client random> <secret>, both hex.
+    const char* hex = std::strchr(_line + label_size, ' ');
+    if (hex == nullptr)
+    {
+      return;
+    }
+    ++hex;
+    auto nibble = [](char c) { return (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10; };
+    s->tx_secret.clear();
+    for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2)
+    {
+      s->tx_secret.push_back(static_cast<unsigned char>((nibble(hex[0]) << 4) | nibble(hex[1])));
+    }
+  }
+  // every NewSessionTicket goes out in its own record under the application
+  // key, so their count is the send sequence number the kernel starts from.
+  static void on_message(int _write, int, int _content_type, const void* _data, std::size_t _size, SSL* _ssl, void*)
+  {
+    auto* s = get_state(_ssl);
+    if (s != nullptr && _write && _content_type == SSL3_RT_HANDSHAKE && _size > 0 &&
+        static_cast<const unsigned char*>(_data)[0] == SSL3_MT_NEWSESSION_TICKET)
+    {
+      ++s->tickets_sent;
+    }
+  }
+
+private:
+  config m_config;
+  ssl::context m_ssl;
+
+  std::mutex m_mutex;
+  std::unordered_map<std::string, SSL_SESSION*> m_sessions;
+};
+
+struct options
+{
+  std::shared_ptr<tls::context> context;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// stream
+//
+// AsyncReadStream/AsyncWriteStream over an ssl stream on a tcp socket. the
+// ssl stream is created by async_connect (client) or start_handshake
+// (server); reads and writes issued while the server handshake is still
+// running wait for it, so an acceptor never blocks on a slow handshake.
+////////////////////////////////////////////////////////////////////////////////
+class stream
+{
+  friend class acceptor;
+
+public:
+  using socket_type = asio::ip::tcp::socket;
+  using ssl_stream_type = ssl::stream<socket_type&>;
+  using executor_type = socket_type::executor_type;
+  using endpoint_type = asio::ip::tcp::endpoint;
+  using lowest_layer_type = socket_type;
+
+  explicit stream(asio::io_context& _ioc)
+    : m_socket(_ioc)
+    , m_ssl(nullptr)
+    , m_ready(false)
+    , m_kernel_tls(false)
+    , m_timed_out(false)
+  {
+  }
+  stream(stream const&) = delete;
+  stream& operator=(stream const&) = delete;
+  ~stream()
+  {
+    close();
+    if (m_ssl != nullptr)
+    {
+      SSL_set_ex_data(m_ssl->native_handle(), context::state_index(), nullptr);
+    }
+  }
+
+  executor_type get_executor() noexcept
+  {
+    return m_socket.get_executor();
+  }
+  lowest_layer_type& lowest_layer()
+  {
+    return m_socket;
+  }
+  bool is_open() const
+  {
+    return m_socket.is_open();
+  }
+  void close()
+  {
+    error_code ignored;
+    m_socket.close(ignored);
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_socket.local_endpoint();
+  }
+  endpoint_type remote_endpoint() const
+  {
+    return m_socket.remote_endpoint();
+  }
+  SSL* native_handle()
+  {
+    return (m_ssl != nullptr) ? m_ssl->native_handle() : nullptr;
+  }
+  // true once the handshake resumed a cached session instead of a full one.
+  bool resumed() const
+  {
+    return m_ssl != nullptr && SSL_session_reused(const_cast<ssl_stream_type&>(*m_ssl).native_handle()) == 1;
+  }
+  // true once writes are encrypted by the kernel.
+  bool kernel_tls() const
+  {
+    return m_kernel_tls;
+  }
+
+  template<class ConnectHandler>
+  auto async_connect(endpoint_type const& _endpoint, context::ptr const& _context, ConnectHandler&& _handler)
+  {
+    return asio::async_initiate<ConnectHandler, void(error_code)>(
+      [this](auto&& handler, endpoint_type const& endpoint, context::ptr const& ctx)
+      {
+        auto op = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+        if (ctx == nullptr)
+        {
+          asio::post(get_executor(), [op]() { (*op)(error_code(asio::error::invalid_argument)); });
+          return;
+        }
+        m_socket.async_connect(endpoint, [this, op, endpoint, ctx](error_code const& ec)
+        {
+          if (!!ec)
+          {
+            (*op)(ec);
+            return;
+          }
+          auto const& name = ctx->get_config().server_name;
+          std::stringstream key;
+          key << name << '@' << endpoint;
+          attach(ctx, ssl::stream_base::client, key.str());
+
+          auto* handle = m_ssl->native_handle();
+          if (!name.empty())
+          {
+            SSL_set_tlsext_host_name(handle, name.c_str());
+          }
+          if (ctx->get_config().verify_server)
+          {
+            auto host = name.empty() ? endpoint.address().to_string() : name;
+            m_ssl->set_verify_callback(ssl::host_name_verification(host));
+          }
+          if (ctx->get_config().resumption)
+          {
+            ctx->resume(m_state.key, handle);
+          }
+          m_ssl->async_handshake(ssl::stream_base::client, [this, op](error_code const& ec)
+          {
+            on_handshake(ec);
+            (*op)(ec);
+          });
+        });
+      },
+      _handler, _endpoint, _context);
+  }
+
+  template<class MutableBufferSequence, class ReadHandler>
+  auto async_read_some(MutableBufferSequence const& _buffers, ReadHandler&& _handler)
+  {
+    return asio::async_initiate<ReadHandler, void(error_code, std::size_t)>(
+      [this](auto&& handler, MutableBufferSequence const& buffers)
+      {
+        start_read(buffers, std::move(handler));
+      },
+      _handler, _buffers);
+  }
+  template<class ConstBufferSequence, class WriteHandler>
+  auto async_write_some(ConstBufferSequence const& _buffers, WriteHandler&& _handler)
+  {
+    return asio::async_initiate<WriteHandler, void(error_code, std::size_t)>(
+      [this](auto&& handler, ConstBufferSequence const& buffers)
+      {
+        start_write(buffers, std::move(handler));
+      },
+      _handler, _buffers);
+  }
+
+private:
+  using waiter = std::function<void(error_code const&)>;
+
+  void attach(context::ptr const& _context, ssl::stream_base::handshake_type _type, std::string _key)
+  {
+    m_context = _context;
+    m_ssl = std::make_unique<ssl_stream_type>(m_socket, _context->native());
+    m_state.owner = _context.get();
+    m_state.key = std::move(_key);
+    SSL_set_ex_data(m_ssl->native_handle(), context::state_index(), &m_state);
+
+    auto const& config = _context->get_config();
+    if (_type == ssl::stream_base::client)
+    {
+      m_ssl->set_verify_mode(config.verify_server ? ssl::verify_peer : ssl::verify_none);
+    }
+    else if (config.ca.empty() && config.ca_file.empty())
+    {
+      m_ssl->set_verify_mode(ssl::verify_none);
+    }
+    else
+    {
+      m_ssl->set_verify_mode(ssl::verify_peer | ssl::verify_fail_if_no_peer_cert);
+    }
+  }
+  // server side, called by the acceptor once the tcp connection is up.
+  void start_handshake(context::ptr const& _context)
+  {
+    attach(_context, ssl::stream_base::server, std::string());
+    auto timeout = _context->get_config().handshake_timeout;
+    if (timeout.count() > 0)
+    {
+      // the handler holds the timer weakly: once the stream has let it go,
+      // the stream may be gone as well.
+      m_deadline = std::make_shared<asio::steady_timer>(get_executor(), timeout);
+      std::weak_ptr<asio::steady_timer> deadline = m_deadline;
+      m_deadline->async_wait([this, deadline](error_code const& ec)
+      {
+        if (!!ec || deadline.expired())
+        {
+          return;
+        }
+        m_timed_out = true;
+        close();
+      });
+    }
+    m_ssl->async_handshake(ssl::stream_base::server, [this](error_code const& ec)
+    {
+      on_handshake(m_timed_out ? error_code(asio::error::timed_out) : ec);
+    });
+  }
+  void on_handshake(error_code const& ec)
+  {
+    if (m_deadline != nullptr)
+    {
+      m_deadline->cancel();
+      m_deadline = nullptr;
+    }
+    m_error = ec;
+    m_ready = !ec;
+    if (m_ready && m_context->get_config().kernel_tls)
+    {
+      m_kernel_tls = enable_kernel_tls();
+    }
+
+    std::vector<waiter> waiting;
+    waiting.swap(m_waiting);
+    for (auto& e : waiting)
+    {
+      e(ec);
+    }
+  }
+
+  template<class MutableBufferSequence, class Handler>
+  void start_read(MutableBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_ready)
+    {
+      m_ssl->async_read_some(_buffers, std::move(_handler));
+      return;
+    }
+    auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+    wait([this, _buffers, op](error_code const& ec)
+    {
+      if (!!ec)
+      {
+        (*op)(ec, std::size_t(0));
+        return;
+      }
+      m_ssl->async_read_some(_buffers, std::move(*op));
+    });
+  }
+  template<class ConstBufferSequence, class Handler>
+  void start_write(ConstBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_ready)
+    {
+      write_some(_buffers, std::move(_handler));
+      return;
+    }
+    auto op = std::make_shared<std::decay_t<Handler>>(std::move(_handler));
+    wait([this, _buffers, op](error_code const& ec)
+    {
+      if (!!ec)
+      {
+        (*op)(ec, std::size_t(0));
+        return;
+      }
+      write_some(_buffers, std::move(*op));
+    });
+  }
+  template<class ConstBufferSequence, class Handler>
+  void write_some(ConstBufferSequence const& _buffers, Handler&& _handler)
+  {
+    if (m_kernel_tls)
+    {
+      m_socket.async_write_some(_buffers, std::move(_handler));
+    }
+    else
+    {
+      m_ssl->async_write_some(_buffers, std::move(_handler));
+    }
+  }
+  // parks an operation until the handshake finishes; fails it right away
+  // when there is no handshake to wait for.
+  void wait(waiter _waiter)
+  {
+    if (m_ssl == nullptr || !!m_error)
+    {
+      auto ec = !!m_error ? m_error : error_code(asio::error::not_connected);
+      asio::post(get_executor(), [_waiter, ec]() { _waiter(ec); });
+      return;
+    }
+    m_waiting.push_back(std::move(_waiter));
+  }
+
+#if defined(__linux__) && defined(TLS_1_3_VERSION) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+  // tls 1.3 HKDF-Expand-Label(secret, label, "", size).
+  static bool expand_label(std::vector<unsigned char> const& _secret, const EVP_MD* _md,
+                           const char* _label, unsigned char* _out, std::size_t _size)
+  {
+    std::vector<unsigned char> info;
+    info.push_back(static_cast<unsigned char>(_size >> 8));
+    info.push_back(static_cast<unsigned char>(_size));
+    std::string label = std::string("tls13 ") + _label;
+    info.push_back(static_cast<unsigned char>(label.size()));
+    info.insert(info.end(), label.begin(), label.end());
+    info.push_back(0);
+
+    auto* kdf = EVP_KDF_fetch(nullptr, "HKDF", nullptr);
+    if (kdf == nullptr)
+    {
+      return false;
+    }
+    auto* kctx = EVP_KDF_CTX_new(kdf);
+    EVP_KDF_free(kdf);
+    if (kctx == nullptr)
+    {
+      return false;
+    }
+
+    int mode = EVP_KDF_HKDF_MODE_EXPAND_ONLY;
+    OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode),
+      OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, const_cast<char*>(EVP_MD_get0_name(_md)), 0),
+      OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, const_cast<unsigned char*>(_secret.data()), _secret.size()),
+      OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, info.data(), info.size()),
+      OSSL_PARAM_construct_end(),
+    };
+    bool ok = EVP_KDF_derive(kctx, _out, _size, params) == 1;
+    EVP_KDF_CTX_free(kctx);
+    return ok;
+  }
+  template<class CryptoInfo>
+  bool install_kernel_key(CryptoInfo& _info, unsigned short _cipher, const EVP_MD* _md)
+  {
+    unsigned char iv[12];
+    _info.info.version = TLS_1_3_VERSION;
+    _info.info.cipher_type = _cipher;
+    if (!expand_label(m_state.tx_secret, _md, "key", _info.key, sizeof(_info.key)) ||
+        !expand_label(m_state.tx_secret, _md, "iv", iv, sizeof(iv)))
+    {
+      return false;
+    }
+    // the 12 byte nonce base splits into a 4 byte salt and an 8 byte iv.
+    std::memcpy(_info.salt, iv, sizeof(_info.salt));
+    std::memcpy(_info.iv, iv + sizeof(_info.salt), sizeof(_info.iv));
+    auto seq = SSL_is_server(m_ssl->native_handle()) ? m_state.tickets_sent : 0;
+    for (int i = 7; i >= 0; --i, seq >>= 8)
+    {
+      _info.rec_seq[i] = static_cast<unsigned char>(seq);
+    }
+
+    int fd = m_socket.native_handle();
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0)
+    {
+      return false;
+    }
+    return setsockopt(fd, SOL_TLS, TLS_TX, &_info, sizeof(_info)) == 0;
+  }
+  // only the send direction moves to the kernel: received records may still
+  // carry tickets and key updates openssl has to see. the socket keeps working
+  // through openssl whenever this returns false.
+  bool enable_kernel_tls()
+  {
+    auto* handle = m_ssl->native_handle();
+    if (SSL_version(handle) != TLS1_3_VERSION || m_state.tx_secret.empty())
+    {
+      return false;
+    }
+
+    bool ok = false;
+    switch (SSL_CIPHER_get_id(SSL_get_current_cipher(handle)))
+    {
+    case TLS1_3_CK_AES_128_GCM_SHA256:
+      {
+        tls12_crypto_info_aes_gcm_128 info;
+        std::memset(&info, 0, sizeof(info));
+        ok = install_kernel_key(info, TLS_CIPHER_AES_GCM_128, EVP_sha256());
+        std::memset(&info, 0, sizeof(info));
+      }
+      break;
+    case TLS1_3_CK_AES_256_GCM_SHA384:
+      {
+        tls12_crypto_info_aes_gcm_256 info;
+        std::memset(&info, 0, sizeof(info));
+        ok = install_kernel_key(info, TLS_CIPHER_AES_GCM_256, EVP_sha384());
+        std::memset(&info, 0, sizeof(info));
+      }
+      break;
+    default:
+      break;
+    }
+    std::fill(m_state.tx_secret.begin(), m_state.tx_secret.end(), 0);
+    return ok;
+  }
+#else // __linux__
+  bool enable_kernel_tls()
+  {
+    return false;
+  }
+#endif // __linux__
+
+private:
+  socket_type m_socket;
+  context::ptr m_context;
+  std::unique_ptr<ssl_stream_type> m_ssl;
+  context::state m_state;
+
+  bool m_ready;
+  bool m_kernel_tls;
+  std::shared_ptr<asio::steady_timer> m_deadline;
+  bool m_timed_out;
+  error_code m_error;
+  std::vector<waiter> m_waiting;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// acceptor
+//
+// completes as soon as the tcp connection is accepted; the server handshake
+// then runs on the stream.
+////////////////////////////////////////////////////////////////////////////////
+class acceptor
+{
+public:
+  using executor_type = asio::ip::tcp::acceptor::executor_type;
+  using endpoint_type = stream::endpoint_type;
+
+  acceptor(asio::io_context& _ioc, endpoint_type const& _endpoint, context::ptr _context)
+    : acceptor(asio::ip::tcp::acceptor(_ioc, _endpoint), std::move(_context))
+  {
+  }
+  // takes over a listening tcp socket.
+  acceptor(asio::ip::tcp::acceptor&& _listener, context::ptr _context)
+    : m_acceptor(std::move(_listener))
+    , m_context(std::move(_context))
+  {
+    if (m_context == nullptr)
+    {
+      throw std::invalid_argument("tls::acceptor: options carry no context");
+    }
+  }
+
+  executor_type get_executor() noexcept
+  {
+    return m_acceptor.get_executor();
+  }
+  bool is_open() const
+  {
+    return m_acceptor.is_open();
+  }
+  void close()
+  {
+    m_acceptor.close();
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_acceptor.local_endpoint();
+  }
+
+  asio::ip::tcp::acceptor& lowest_layer()
+  {
+    return m_acceptor;
+  }
+
+  template<class AcceptHandler>
+  auto async_accept(stream& _peer, AcceptHandler&& _handler)
+  {
+    return asio::async_initiate<AcceptHandler, void(error_code)>(
+      [this, &_peer](auto&& handler)
+      {
+        auto op = std::make_shared<std::decay_t<decltype(handler)>>(std::move(handler));
+        auto ctx = m_context;
+        m_acceptor.async_accept(_peer.m_socket, [&_peer, op, ctx](error_code const& ec)
+        {
+          if (!ec)
+          {
+            _peer.start_handshake(ctx);
+          }
+          (*op)(ec);
+        });
+      },
+      _handler);
+  }
+
+private:
+  asio::ip::tcp::acceptor m_acceptor;
+  context::ptr m_context;
+};
+
+// found by admission::tune callers through adl.
+inline void tune(acceptor& _acceptor, admission::limits const& _limits)
+{
+  admission::tune(_acceptor.lowest_layer(), _limits);
+}
+// found by tuning::apply callers through adl.
+inline void apply(stream& _stream, tuning::options const& _options)
+{
+  tuning::apply(_stream.lowest_layer(), _options);
+}
+inline void prepare(stream& _stream, stream::endpoint_type const& _endpoint, tuning::options const& _options)
+{
+  tuning::prepare(_stream.lowest_layer(), _endpoint, _options);
+}
+inline void apply(acceptor& _acceptor, tuning::options const& _options)
+{
+  tuning::apply(_acceptor.lowest_layer(), _options);
+}
+
+} // namespace sv::net::tls
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_TLS_HPP__
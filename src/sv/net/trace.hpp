@@ -0,0 +1,260 @@
+#ifndef __SV_NET_TRACE_HPP__
+#define __SV_NET_TRACE_HPP__
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#else // _WIN32
+#include <unistd.h>
+#endif // _WIN32
+
+#include <boost/system/system_error.hpp>
+
+#include "sv/base.hpp"
+#include "sv/net/packet.hpp"
+
+namespace sv
+{
+namespace net
+{
+namespace trace
+{
+
+using clock = std::chrono::steady_clock;
+using context = packet::trace_context;
+
+namespace detail
+{
+
+inline std::mt19937_64& generator()
+{
+  thread_local std::mt19937_64 engine(std::random_device{}() ^ std::uint64_t(clock::now().time_since_epoch().count()));
+  return engine;
+}
+// never 0, which W3C reserves for "no id".
+inline std::uint64_t make_id()
+{
+  std::uint64_t id = 0;
+  while (id == 0)
+  {
+    id = generator()();
+  }
+  return id;
+}
+
+} // namespace sv::net::trace::detail
+
+// the packet carries a context that asks for its spans to be recorded.
+inline bool sampled(packet::base const& _packet)
+{
+  return _packet.traced() && (_packet.get_trace().flags & context::sc_sampled) != 0;
+}
+// a new span in _parent's trace.
+inline context child(context const& _parent)
+{
+  context result = _parent;
+  result.span = detail::make_id();
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// tracer
+//
+// decides which new traces are sampled and writes the spans protocols record
+// for them to a file in the Trace Event Format (chrome://tracing, Perfetto):
+// one complete event per span, one per phase inside it, session ids as
+// threads. time stamps are wall clock, so files of several processes line
+// up. packets that are not sampled carry no context and cost a branch.
+////////////////////////////////////////////////////////////////////////////////
+class tracer
+{
+public:
+  using self = tracer;
+  using ptr = std::shared_ptr<self>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  // _rate of new traces are sampled, 0 to 1. truncates _path; throws
+  // boost::system::system_error.
+  tracer(std::string const& _path, double _rate = 1.0)
+    : m_file(std::fopen(_path.c_str(), "wb"))
+    , m_threshold(threshold_of(_rate))
+    , m_always(_rate >= 1.0)
+    , m_offset(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+               - std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()))
+#if defined(_WIN32)
+    , m_pid(static_cast<unsigned>(::_getpid()))
+#else // _WIN32
+    , m_pid(static_cast<unsigned>(::getpid()))
+#endif // _WIN32
+    , m_spans(0)
+  {
+    if (m_file == nullptr)
+    {
+      throw boost::system::system_error(boost::system::error_code(errno, boost::system::generic_category()),
+                                        "trace::tracer");
+    }
+    std::fputs("[", m_file);
+  }
+  tracer(tracer const&) = delete;
+  tracer& operator=(tracer const&) = delete;
+  ~tracer()
+  {
+    close();
+  }
+  // thread-safe. makes _packet the root of a new trace if it is sampled;
+  // false leaves it untouched.
+  bool start(packet::base& _packet)
+  {
+    if (!m_always && (m_threshold == 0 || detail::generator()() >= m_threshold))
+    {
+      return false;
+    }
+    context trace;
+    trace.trace_high = detail::make_id();
+    trace.trace_low = detail::make_id();
+    trace.span = detail::make_id();
+    trace.flags = context::sc_sampled;
+    _packet.set_trace(trace);
+    return true;
+  }
+  // _packet, a reply or a message sent on because of _cause, continues
+  // _cause's trace if it has one.
+  static void follow(packet::base& _packet, packet::base const& _cause)
+  {
+    if (_cause.traced())
+    {
+      _packet.set_trace(child(_cause.get_trace()));
+    }
+  }
+  // thread-safe. a sampled packet sent: queued by send(), handed to the
+  // socket, written.
+  void sent(context const& _trace, id_type _session, clock::time_point _queued, clock::time_point _written,
+            clock::time_point _completed)
+  {
+    char ids[128];
+    format_ids(ids, sizeof(ids), _trace, _trace.span, 0);
+    char text[1024];
+    std::size_t size = 0;
+    size += event(text + size, sizeof(text) - size, _session, "send", ids, _queued, _completed);
+    size += event(text + size, sizeof(text) - size, _session, "queue", ids, _queued, _written);
+    size += event(text + size, sizeof(text) - size, _session, "write", ids, _written, _completed);
+    append(text, size);
+  }
+  // thread-safe. a sampled packet received: its header arrived, the whole
+  // packet was read, the handler was called and returned. without a handler
+  // the last two are the time it was read.
+  void received(context const& _trace, id_type _session, clock::time_point _arrived, clock::time_point _read,
+                clock::time_point _dispatched, clock::time_point _handled)
+  {
+    char ids[128];
+    format_ids(ids, sizeof(ids), _trace, detail::make_id(), _trace.span);
+    char text[1280];
+    std::size_t size = 0;
+    size += event(text + size, sizeof(text) - size, _session, "receive", ids, _arrived, _handled);
+    size += event(text + size, sizeof(text) - size, _session, "read", ids, _arrived, _read);
+    size += event(text + size, sizeof(text) - size, _session, "dispatch", ids, _read, _dispatched);
+    size += event(text + size, sizeof(text) - size, _session, "handler", ids, _dispatched, _handled);
+    append(text, size);
+  }
+  // ends the file; later spans are dropped.
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file != nullptr)
+    {
+      std::fputs("\n]\n", m_file);
+      std::fclose(m_file);
+      m_file = nullptr;
+    }
+  }
+  std::size_t spans() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_spans;
+  }
+
+private:
+  static std::uint64_t threshold_of(double _rate)
+  {
+    if (!(_rate > 0.0))
+    {
+      return 0;
+    }
+    if (_rate >= 1.0)
+    {
+      return UINT64_MAX;
+    }
+    return static_cast<std::uint64_t>(_rate * 18446744073709551616.0);
+  }
+  static void format_ids(char* _out, std::size_t _size, context const& _trace, std::uint64_t _span,
+                         std::uint64_t _parent)
+  {
+    if (_parent == 0)
+    {
+      std::snprintf(_out, _size, "\"trace\":\"%016" PRIx64 "%016" PRIx64 "\",\"span\":\"%016" PRIx64 "\"",
+                    _trace.trace_high, _trace.trace_low, _span);
+      return;
+    }
+    std::snprintf(_out, _size,
+                  "\"trace\":\"%016" PRIx64 "%016" PRIx64 "\",\"span\":\"%016" PRIx64 "\",\"parent\":\"%016" PRIx64 "\"",
+                  _trace.trace_high, _trace.trace_low, _span, _parent);
+  }
+  // a complete event into _out, times in microseconds since the epoch; each
+  // event starts with the separator before it. returns the bytes written.
+  std::size_t event(char* _out, std::size_t _size, id_type _session, const char* _name, const char* _ids,
+                    clock::time_point _begin, clock::time_point _end) const
+  {
+    // in integers: a double holds epoch microseconds only to a quarter.
+    auto begin = static_cast<std::uint64_t>(
+      (std::chrono::duration_cast<std::chrono::nanoseconds>(_begin.time_since_epoch()) + m_offset).count());
+    auto duration = static_cast<std::uint64_t>(
+      std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(_end - _begin).count(), 0));
+    int size = std::snprintf(_out, _size,
+                             ",\n{\"name\":\"%s\",\"cat\":\"sv.net\",\"ph\":\"X\",\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64
+                             ".%03u,\"pid\":%u,\"tid\":%" PRIu64 ",\"args\":{%s}}",
+                             _name, begin / 1000, unsigned(begin % 1000), duration / 1000, unsigned(duration % 1000),
+                             m_pid, std::uint64_t(_session), _ids);
+    return size < 0 ? 0 : std::min(static_cast<std::size_t>(size), _size - 1);
+  }
+  void append(const char* _text, std::size_t _size)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file != nullptr)
+    {
+      // the first event of the file has no separator.
+      auto skip = m_spans == 0 ? std::size_t(2) : std::size_t(0);
+      std::fwrite(_text + skip, 1, _size - skip, m_file);
+      ++m_spans;
+    }
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::FILE* m_file;
+  std::uint64_t m_threshold;
+  bool m_always;
+  std::chrono::nanoseconds m_offset;
+  unsigned m_pid;
+  std::size_t m_spans;
+};
+
+} // namespace sv::net::trace
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_TRACE_HPP__
@@ -0,0 +1,224 @@
+#ifndef __SV_NET_TRANSPORT_HPP__
+#define __SV_NET_TRANSPORT_HPP__
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#include "sv/net/inproc.hpp"
+#include "sv/net/shm.hpp"
+#include "sv/net/udp.hpp"
+#if defined(SV_NET_HAS_TLS)
+#include "sv/net/tls.hpp"
+#endif // SV_NET_HAS_TLS
+
+namespace sv
+{
+namespace net
+{
+namespace transport
+{
+
+namespace asio = boost::asio;
+
+////////////////////////////////////////////////////////////////////////////////
+// transports
+//
+// a transport tells the node templates which socket, acceptor and endpoint
+// types to use, how to build an endpoint from the arguments given to
+// basic_server::execute / basic_client::execute, how to open a listener and
+// how to connect. adopt wraps a listening socket handed over by another
+// process (basic_server::take_over). options_type is what basic_server/basic_client::set_options
+// accepts; listen and connect get it.
+////////////////////////////////////////////////////////////////////////////////
+struct no_options {};
+
+struct tcp
+{
+  using protocol_type = asio::ip::tcp;
+  using socket_type = protocol_type::socket;
+  using acceptor_type = protocol_type::acceptor;
+  using endpoint_type = protocol_type::endpoint;
+  using options_type = no_options;
+
+  // server: [port]
+  static endpoint_type make_endpoint(unsigned short _port)
+  {
+    return endpoint_type(asio::ip::address(), _port);
+  }
+  // client: [target] [port]
+  static endpoint_type make_endpoint(std::string const& _target, unsigned short _port)
+  {
+    return endpoint_type(asio::ip::make_address(_target), _port);
+  }
+  static acceptor_type listen(asio::io_context& _ioc, endpoint_type const& _endpoint, options_type const&)
+  {
+    return acceptor_type(_ioc, _endpoint);
+  }
+  static acceptor_type adopt(asio::io_context& _ioc, acceptor_type::native_handle_type _handle, options_type const&)
+  {
+    // the address family is only known once the socket is there to ask.
+    acceptor_type acceptor(_ioc, protocol_type::v4(), _handle);
+    auto protocol = acceptor.local_endpoint().protocol();
+    if (protocol != protocol_type::v4())
+    {
+      acceptor.release();
+      acceptor.assign(protocol, _handle);
+    }
+    return acceptor;
+  }
+  template<class ConnectHandler>
+  static void connect(socket_type& _socket, endpoint_type const& _endpoint, options_type const&, ConnectHandler&& _handler)
+  {
+    _socket.async_connect(_endpoint, std::forward<ConnectHandler>(_handler));
+  }
+};
+
+struct udp
+{
+  using protocol_type = asio::ip::udp;
+  using socket_type = net::datagram::socket;
+  using endpoint_type = protocol_type::endpoint;
+  using options_type = net::datagram::options;
+
+  // server: [port]
+  static endpoint_type make_endpoint(unsigned short _port)
+  {
+    return endpoint_type(asio::ip::address(), _port);
+  }
+  // client: [target] [port]
+  static endpoint_type make_endpoint(std::string const& _target, unsigned short _port)
+  {
+    return endpoint_type(asio::ip::make_address(_target), _port);
+  }
+};
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+struct local
+{
+  using protocol_type = asio::local::stream_protocol;
+  using socket_type = protocol_type::socket;
+  using acceptor_type = protocol_type::acceptor;
+  using endpoint_type = protocol_type::endpoint;
+  using options_type = no_options;
+
+  // server, client: [path]
+  static endpoint_type make_endpoint(std::string const& _path)
+  {
+    return endpoint_type(_path);
+  }
+  static acceptor_type listen(asio::io_context& _ioc, endpoint_type const& _endpoint, options_type const&)
+  {
+    // a stale socket file from a previous run would make bind() fail.
+    std::remove(_endpoint.path().c_str());
+    return acceptor_type(_ioc, _endpoint);
+  }
+  static acceptor_type adopt(asio::io_context& _ioc, acceptor_type::native_handle_type _handle, options_type const&)
+  {
+    return acceptor_type(_ioc, protocol_type(), _handle);
+  }
+  template<class ConnectHandler>
+  static void connect(socket_type& _socket, endpoint_type const& _endpoint, options_type const&, ConnectHandler&& _handler)
+  {
+    _socket.async_connect(_endpoint, std::forward<ConnectHandler>(_handler));
+  }
+};
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+struct inproc
+{
+  using socket_type = net::inproc::stream;
+  using acceptor_type = net::inproc::acceptor;
+  using endpoint_type = net::inproc::endpoint;
+  using options_type = no_options;
+
+  // server, client: [name]
+  static endpoint_type make_endpoint(std::string const& _name)
+  {
+    return endpoint_type(_name);
+  }
+  static acceptor_type listen(asio::io_context& _ioc, endpoint_type const& _endpoint, options_type const&)
+  {
+    return acceptor_type(_ioc, _endpoint);
+  }
+  template<class ConnectHandler>
+  static void connect(socket_type& _socket, endpoint_type const& _endpoint, options_type const&, ConnectHandler&& _handler)
+  {
+    _socket.async_connect(_endpoint, std::forward<ConnectHandler>(_handler));
+  }
+};
+
+#if defined(SV_NET_HAS_TLS)
+struct tls
+{
+  using protocol_type = asio::ip::tcp;
+  using socket_type = net::tls::stream;
+  using acceptor_type = net::tls::acceptor;
+  using endpoint_type = protocol_type::endpoint;
+  using options_type = net::tls::options;
+
+  // server: [port]
+  static endpoint_type make_endpoint(unsigned short _port)
+  {
+    return endpoint_type(asio::ip::address(), _port);
+  }
+  // client: [target] [port]
+  static endpoint_type make_endpoint(std::string const& _target, unsigned short _port)
+  {
+    return endpoint_type(asio::ip::make_address(_target), _port);
+  }
+  // throws std::invalid_argument without options::context.
+  static acceptor_type listen(asio::io_context& _ioc, endpoint_type const& _endpoint, options_type const& _options)
+  {
+    return acceptor_type(_ioc, _endpoint, _options.context);
+  }
+  static acceptor_type adopt(asio::io_context& _ioc, tcp::acceptor_type::native_handle_type _handle, options_type const& _options)
+  {
+    return acceptor_type(tcp::adopt(_ioc, _handle, tcp::options_type()), _options.context);
+  }
+  template<class ConnectHandler>
+  static void connect(socket_type& _socket, endpoint_type const& _endpoint, options_type const& _options, ConnectHandler&& _handler)
+  {
+    _socket.async_connect(_endpoint, _options.context, std::forward<ConnectHandler>(_handler));
+  }
+};
+#endif // SV_NET_HAS_TLS
+
+#if defined(__linux__)
+struct shm
+{
+  using socket_type = net::shm::stream;
+  using acceptor_type = net::shm::acceptor;
+  using endpoint_type = net::shm::stream::endpoint_type;
+  using options_type = no_options;
+
+  // server, client: [path] of the unix socket used for the handshake.
+  static endpoint_type make_endpoint(std::string const& _path)
+  {
+    return endpoint_type(_path);
+  }
+  static acceptor_type listen(asio::io_context& _ioc, endpoint_type const& _endpoint, options_type const&)
+  {
+    std::remove(_endpoint.path().c_str());
+    return acceptor_type(_ioc, _endpoint);
+  }
+  template<class ConnectHandler>
+  static void connect(socket_type& _socket, endpoint_type const& _endpoint, options_type const&, ConnectHandler&& _handler)
+  {
+    _socket.async_connect(_endpoint, std::forward<ConnectHandler>(_handler));
+  }
+};
+#endif // __linux__
+
+} // namespace sv::net::transport
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_TRANSPORT_HPP__
@@ -0,0 +1,223 @@
+#ifndef __SV_NET_TUNING_HPP__
+#define __SV_NET_TUNING_HPP__
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#endif // __linux__
+
+namespace sv
+{
+namespace net
+{
+namespace tuning
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// options
+//
+// what basic_server/basic_client::set_tuning applies to every accepted or
+// connected socket, and to their io threads. 0 leaves the kernel default.
+// options the platform or transport lacks are skipped, and a refused option
+// (SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN) is ignored.
+////////////////////////////////////////////////////////////////////////////////
+struct keepalive
+{
+  bool enabled = false;
+  // seconds idle before the first probe, between probes, and probes
+  // unanswered before the connection is dropped (linux).
+  int idle = 0;
+  int interval = 0;
+  int count = 0;
+};
+
+struct options
+{
+  // tcp: send small messages at once instead of waiting for the ack of the
+  // previous one (Nagle), which costs up to 40 ms against a delayed ack.
+  bool no_delay = true;
+
+  // SO_SNDBUF/SO_RCVBUF bytes. a listener's buffers are inherited by the
+  // sockets it accepts, so a receive buffer over 64 KiB gets its window
+  // scale from the handshake.
+  int send_buffer = 0;
+  int receive_buffer = 0;
+
+  // linux tcp. quick_ack turns delayed acks off right after the accept or
+  // connect; the kernel may return to delayed acks later on.
+  bool quick_ack = false;
+  // microseconds a blocking read busy-polls the device queue (SO_BUSY_POLL).
+  int busy_poll = 0;
+  // unsent bytes the socket holds before it stops being writable
+  // (TCP_NOTSENT_LOWAT); keeps queued data in the protocol, where newer
+  // messages can still overtake it.
+  int notsent_lowat = 0;
+
+  tuning::keepalive keepalive;
+
+  // io thread i runs on cpus[i % size]: the server's or client's own thread
+  // is 0, the accept_policy workers 1..n. empty leaves the threads unpinned.
+  std::vector<int> cpus;
+};
+
+namespace detail
+{
+
+template<class Socket>
+void set(Socket& _socket, int _level, int _name, int _value)
+{
+  ::setsockopt(_socket.native_handle(), _level, _name, reinterpret_cast<const char*>(&_value), sizeof(_value));
+}
+
+template<class Socket>
+void apply_buffers(Socket& _socket, options const& _options)
+{
+  error_code ec;
+  if (_options.send_buffer > 0)
+  {
+    _socket.set_option(asio::socket_base::send_buffer_size(_options.send_buffer), ec);
+  }
+  if (_options.receive_buffer > 0)
+  {
+    _socket.set_option(asio::socket_base::receive_buffer_size(_options.receive_buffer), ec);
+  }
+}
+
+} // namespace sv::net::tuning::detail
+
+// sockets that are not asio sockets (inproc, shm) have nothing to apply.
+template<class Socket>
+void apply(Socket&, options const&)
+{
+}
+template<class Protocol, class Executor>
+void apply(asio::basic_stream_socket<Protocol, Executor>& _socket, options const& _options)
+{
+  if (!_socket.is_open())
+  {
+    return;
+  }
+  detail::apply_buffers(_socket, _options);
+
+  error_code ec;
+  if (_options.keepalive.enabled)
+  {
+    _socket.set_option(asio::socket_base::keep_alive(true), ec);
+  }
+  if constexpr (std::is_same<Protocol, asio::ip::tcp>::value)
+  {
+    _socket.set_option(asio::ip::tcp::no_delay(_options.no_delay), ec);
+#if defined(__linux__)
+    if (_options.quick_ack)
+    {
+      detail::set(_socket, IPPROTO_TCP, TCP_QUICKACK, 1);
+    }
+    if (_options.notsent_lowat > 0)
+    {
+      detail::set(_socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, _options.notsent_lowat);
+    }
+    if (_options.keepalive.enabled)
+    {
+      if (_options.keepalive.idle > 0)
+        detail::set(_socket, IPPROTO_TCP, TCP_KEEPIDLE, _options.keepalive.idle);
+      if (_options.keepalive.interval > 0)
+        detail::set(_socket, IPPROTO_TCP, TCP_KEEPINTVL, _options.keepalive.interval);
+      if (_options.keepalive.count > 0)
+        detail::set(_socket, IPPROTO_TCP, TCP_KEEPCNT, _options.keepalive.count);
+    }
+#endif // __linux__
+  }
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+  if (_options.busy_poll > 0)
+  {
+    detail::set(_socket, SOL_SOCKET, SO_BUSY_POLL, _options.busy_poll);
+  }
+#endif // __linux__
+}
+// before a connect: opens the socket so the buffer sizes are set ahead of
+// the handshake, where the receive buffer decides the window scale. apply
+// does the rest once connected.
+template<class Socket, class Endpoint>
+void prepare(Socket&, Endpoint const&, options const&)
+{
+}
+template<class Protocol, class Executor>
+void prepare(asio::basic_stream_socket<Protocol, Executor>& _socket, typename Protocol::endpoint const& _endpoint,
+             options const& _options)
+{
+  if (_options.send_buffer <= 0 && _options.receive_buffer <= 0)
+  {
+    return;
+  }
+  error_code ec;
+  if (!_socket.is_open())
+  {
+    _socket.open(_endpoint.protocol(), ec);
+  }
+  if (!ec)
+  {
+    detail::apply_buffers(_socket, _options);
+  }
+}
+// only the buffer sizes matter on a listener; the rest is per connection.
+template<class Protocol, class Executor>
+void apply(asio::basic_socket_acceptor<Protocol, Executor>& _acceptor, options const& _options)
+{
+  if (_acceptor.is_open())
+  {
+    detail::apply_buffers(_acceptor, _options);
+  }
+}
+
+// pins the calling thread to _cpus[_index % size]; false if it could not,
+// or if that cpu is not a valid index.
+inline bool pin(std::vector<int> const& _cpus, std::size_t _index)
+{
+  if (_cpus.empty())
+  {
+    return false;
+  }
+  int cpu = _cpus[_index % _cpus.size()];
+#if defined(__linux__)
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+  {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+  if (cpu < 0 || cpu >= int(sizeof(DWORD_PTR) * 8))
+  {
+    return false;
+  }
+  return ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+} // namespace sv::net::tuning
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_TUNING_HPP__
@@ -0,0 +1,482 @@
+#ifndef __SV_NET_UDP_HPP__
+#define __SV_NET_UDP_HPP__
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+  #define _WIN32_WINNT 0x0A00 // for Windows 10
+#endif // _WIN32_WINNT
+
+#include <boost/asio.hpp>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif // UDP_SEGMENT
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif // UDP_GRO
+#endif // __linux__
+
+namespace sv
+{
+namespace net
+{
+namespace datagram
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+using udp = asio::ip::udp;
+
+// udp::endpoint has no std::hash in every boost version we build against.
+struct endpoint_hash
+{
+  std::size_t operator()(udp::endpoint const& _endpoint) const
+  {
+    std::size_t seed = std::hash<unsigned short>()(_endpoint.port());
+    auto combine = [&seed](std::size_t value)
+    {
+      seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+    };
+    auto address = _endpoint.address();
+    if (address.is_v4())
+    {
+      combine(address.to_v4().to_uint());
+    }
+    else
+    {
+      for (auto byte : address.to_v6().to_bytes())
+      {
+        combine(byte);
+      }
+    }
+    return seed;
+  }
+};
+
+struct options
+{
+  // datagrams moved per recvmmsg / sendmmsg call.
+  std::size_t batch = 32;
+  // largest datagram accepted on receive.
+  std::size_t max_datagram = 65507;
+  // coalesce equal-sized datagrams to one peer into a single UDP_SEGMENT send.
+  bool gso = false;
+  // let the kernel coalesce received datagrams (UDP_GRO); split here.
+  bool gro = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// socket
+//
+// udp socket with batched I/O. on readiness the receive side drains up to
+// options::batch datagrams per recvmmsg call; sends queued during one turn of
+// the io_context are flushed together with sendmmsg. other platforms fall
+// back to one async_receive_from / send_to per datagram.
+////////////////////////////////////////////////////////////////////////////////
+class socket
+{
+public:
+  using endpoint_type = udp::endpoint;
+  using receive_handler = std::function<void(endpoint_type const&, const char*, std::size_t)>;
+
+  socket(asio::io_context& _ioc, options const& _options = options())
+    : m_socket(_ioc)
+    , m_options(_options)
+    , m_connected(false)
+    , m_flushing(false)
+  {
+  }
+  socket(socket const&) = delete;
+  socket& operator=(socket const&) = delete;
+  ~socket()
+  {
+    close();
+  }
+
+  void bind(endpoint_type const& _endpoint)
+  {
+    m_socket.open(_endpoint.protocol());
+    m_socket.set_option(udp::socket::reuse_address(true));
+    m_socket.bind(_endpoint);
+    configure();
+  }
+  void connect(endpoint_type const& _endpoint, error_code& ec)
+  {
+    m_socket.open(_endpoint.protocol(), ec);
+    if (!ec)
+    {
+      m_socket.connect(_endpoint, ec);
+    }
+    if (!!ec)
+    {
+      return;
+    }
+    m_remote = _endpoint;
+    m_connected = true;
+    configure();
+  }
+  void close()
+  {
+    error_code ignored;
+    m_socket.close(ignored);
+  }
+  bool is_open() const
+  {
+    return m_socket.is_open();
+  }
+  endpoint_type local_endpoint() const
+  {
+    return m_socket.local_endpoint();
+  }
+  udp::socket::executor_type get_executor()
+  {
+    return m_socket.get_executor();
+  }
+
+  void start(receive_handler _handler)
+  {
+    m_handler = std::move(_handler);
+    do_receive();
+  }
+  // thread-safe. _to is ignored on a connected socket.
+  void send(endpoint_type const& _to, std::string _datagram)
+  {
+    asio::post(m_socket.get_executor(),
+               [this, _to, datagram = std::move(_datagram)]() mutable
+               {
+                 m_send_depot.push_back(outgoing{ _to, std::move(datagram) });
+                 if (!m_flushing)
+                 {
+                   // flush on the next turn so sends issued together share one syscall.
+                   m_flushing = true;
+                   asio::post(m_socket.get_executor(), std::bind(&socket::do_flush, this));
+                 }
+               });
+  }
+
+private:
+  struct outgoing
+  {
+    endpoint_type to;
+    std::string data;
+  };
+
+  void configure()
+  {
+    m_socket.non_blocking(true);
+#if defined(__linux__)
+    if (m_options.gro)
+    {
+      int on = 1;
+      if (::setsockopt(m_socket.native_handle(), IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) != 0)
+      {
+        m_options.gro = false;
+      }
+    }
+    auto slot = m_options.gro ? std::size_t(65535) : m_options.max_datagram;
+    m_receive_buffer.resize(m_options.batch * slot);
+    m_receive_names.resize(m_options.batch);
+    m_receive_iovecs.resize(m_options.batch);
+    m_receive_controls.resize(m_options.batch * CMSG_SPACE(sizeof(int)));
+    m_receive_messages.resize(m_options.batch);
+    for (std::size_t i = 0; i < m_options.batch; ++i)
+    {
+      m_receive_iovecs[i].iov_base = &m_receive_buffer[i * slot];
+      m_receive_iovecs[i].iov_len = slot;
+    }
+#else // __linux__
+    m_receive_buffer.resize(m_options.max_datagram);
+#endif // __linux__
+  }
+
+#if defined(__linux__)
+  void do_receive()
+  {
+    m_socket.async_wait(udp::socket::wait_read,
+                        [this](error_code const& ec)
+                        {
+                          if (!!ec)
+                          {
+                            on_error(ec, "receive");
+                            return;
+                          }
+                          on_readable();
+                        });
+  }
+  void on_readable()
+  {
+    // bounded drain so one busy socket cannot starve the io_context.
+    for (int round = 0; round < 4; ++round)
+    {
+      for (std::size_t i = 0; i < m_options.batch; ++i)
+      {
+        auto& hdr = m_receive_messages[i].msg_hdr;
+        hdr = msghdr{};
+        hdr.msg_name = &m_receive_names[i];
+        hdr.msg_namelen = sizeof(sockaddr_storage);
+        hdr.msg_iov = &m_receive_iovecs[i];
+        hdr.msg_iovlen = 1;
+        if (m_options.gro)
+        {
+          hdr.msg_control = &m_receive_controls[i * CMSG_SPACE(sizeof(int))];
+          hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+        }
+      }
+
+      int n = ::recvmmsg(m_socket.native_handle(), m_receive_messages.data(),
+                         static_cast<unsigned int>(m_options.batch), MSG_DONTWAIT, nullptr);
+      if (n <= 0)
+      {
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+          on_error(error_code(errno, asio::error::get_system_category()), "recvmmsg");
+        }
+        break;
+      }
+      for (int i = 0; i < n; ++i)
+      {
+        dispatch(m_receive_messages[i]);
+      }
+      if (std::size_t(n) < m_options.batch)
+      {
+        break;
+      }
+    }
+
+    if (m_socket.is_open())
+    {
+      do_receive();
+    }
+  }
+  void dispatch(mmsghdr const& _message)
+  {
+    auto const& hdr = _message.msg_hdr;
+
+    endpoint_type from;
+    if (m_connected)
+    {
+      from = m_remote;
+    }
+    else
+    {
+      std::memcpy(from.data(), hdr.msg_name, hdr.msg_namelen);
+      from.resize(hdr.msg_namelen);
+    }
+
+    std::size_t segment = _message.msg_len;
+    for (auto cmsg = CMSG_FIRSTHDR(const_cast<msghdr*>(&hdr)); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+      {
+        int size = 0;
+        std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+        if (size > 0)
+        {
+          segment = std::size_t(size);
+        }
+      }
+    }
+
+    auto data = static_cast<const char*>(hdr.msg_iov->iov_base);
+    for (std::size_t offset = 0; offset < _message.msg_len; offset += segment)
+    {
+      m_handler(from, data + offset, std::min<std::size_t>(segment, _message.msg_len - offset));
+    }
+  }
+  void do_flush()
+  {
+    while (!m_send_depot.empty())
+    {
+      std::vector<mmsghdr> messages;
+      std::vector<iovec> iovecs;
+      std::vector<std::size_t> counts;
+      std::vector<char> controls;
+      build_batch(messages, iovecs, counts, controls);
+
+      int n = ::sendmmsg(m_socket.native_handle(), messages.data(),
+                         static_cast<unsigned int>(messages.size()), MSG_DONTWAIT);
+      if (n < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          m_socket.async_wait(udp::socket::wait_write,
+                              [this](error_code const& ec)
+                              {
+                                if (!!ec)
+                                {
+                                  m_flushing = false;
+                                  on_error(ec, "send");
+                                  return;
+                                }
+                                do_flush();
+                              });
+          return;
+        }
+
+        // datagrams are lossy by contract: report, drop the failing one, go on.
+        on_error(error_code(errno, asio::error::get_system_category()), "sendmmsg");
+        n = 1;
+      }
+      for (int i = 0; i < n; ++i)
+      {
+        for (std::size_t k = 0; k < counts[i]; ++k)
+        {
+          m_send_depot.pop_front();
+        }
+      }
+    }
+    m_flushing = false;
+  }
+  void build_batch(std::vector<mmsghdr>& _messages, std::vector<iovec>& _iovecs,
+                   std::vector<std::size_t>& _counts, std::vector<char>& _controls)
+  {
+    // at most 64 segments per UDP_SEGMENT send, all but the last of equal size.
+    const std::size_t max_segments = m_options.gso ? 64 : 1;
+
+    std::size_t total = std::min(m_send_depot.size(), m_options.batch * max_segments);
+    _iovecs.resize(total);
+    _controls.assign(m_options.batch * CMSG_SPACE(sizeof(std::uint16_t)), 0);
+
+    std::size_t i = 0;
+    while (i < total && _messages.size() < m_options.batch)
+    {
+      auto const& first = m_send_depot[i];
+      std::size_t count = 1;
+      std::size_t bytes = first.data.size();
+      while (count < max_segments && i + count < total)
+      {
+        auto const& next = m_send_depot[i + count];
+        auto const& prev = m_send_depot[i + count - 1];
+        if (next.to != first.to || prev.data.size() != first.data.size()
+            || next.data.size() > first.data.size() || bytes + next.data.size() > 65507)
+        {
+          break;
+        }
+        bytes += next.data.size();
+        ++count;
+      }
+
+      mmsghdr message{};
+      auto& hdr = message.msg_hdr;
+      if (!m_connected)
+      {
+        hdr.msg_name = const_cast<void*>(static_cast<const void*>(first.to.data()));
+        hdr.msg_namelen = static_cast<socklen_t>(first.to.size());
+      }
+      for (std::size_t k = 0; k < count; ++k)
+      {
+        auto& d = m_send_depot[i + k].data;
+        _iovecs[i + k].iov_base = const_cast<char*>(d.data());
+        _iovecs[i + k].iov_len = d.size();
+      }
+      hdr.msg_iov = &_iovecs[i];
+      hdr.msg_iovlen = count;
+      if (count > 1)
+      {
+        auto control = &_controls[_messages.size() * CMSG_SPACE(sizeof(std::uint16_t))];
+        hdr.msg_control = control;
+        hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+        auto cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+        auto size = static_cast<std::uint16_t>(first.data.size());
+        std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+      }
+
+      _messages.push_back(message);
+      _counts.push_back(count);
+      i += count;
+    }
+  }
+#else // __linux__
+  void do_receive()
+  {
+    m_socket.async_receive_from(asio::buffer(m_receive_buffer), m_from,
+                                [this](error_code const& ec, std::size_t bytes)
+                                {
+                                  if (!!ec)
+                                  {
+                                    on_error(ec, "receive");
+                                    return;
+                                  }
+                                  m_handler(m_from, m_receive_buffer.data(), bytes);
+                                  do_receive();
+                                });
+  }
+  void do_flush()
+  {
+    while (!m_send_depot.empty())
+    {
+      auto& front = m_send_depot.front();
+      error_code ec;
+      if (m_connected)
+      {
+        m_socket.send(asio::buffer(front.data), 0, ec);
+      }
+      else
+      {
+        m_socket.send_to(asio::buffer(front.data), front.to, 0, ec);
+      }
+      if (ec == asio::error::would_block)
+      {
+        m_socket.async_wait(udp::socket::wait_write, std::bind(&socket::do_flush, this));
+        return;
+      }
+      if (!!ec)
+      {
+        on_error(ec, "send");
+      }
+      m_send_depot.pop_front();
+    }
+    m_flushing = false;
+  }
+#endif // __linux__
+
+  void on_error(error_code const& ec, const char* where)
+  {
+    std::stringstream ss;
+    ss << where << "::error[" << ec.value() << "]: " << ec.message() << '\n';
+    std::cerr << ss.str() << std::flush;
+  }
+
+private:
+  udp::socket m_socket;
+  options m_options;
+  bool m_connected;
+  endpoint_type m_remote;
+
+  receive_handler m_handler;
+  std::vector<char> m_receive_buffer;
+#if defined(__linux__)
+  std::vector<sockaddr_storage> m_receive_names;
+  std::vector<iovec> m_receive_iovecs;
+  std::vector<char> m_receive_controls;
+  std::vector<mmsghdr> m_receive_messages;
+#else // __linux__
+  endpoint_type m_from;
+#endif // __linux__
+
+  std::deque<outgoing> m_send_depot;
+  bool m_flushing;
+};
+
+} // namespace sv::net::datagram
+} // namespace sv::net
+} // namespace sv
+
+#endif // __SV_NET_UDP_HPP__
@@ -0,0 +1,580 @@
+#ifndef __SV_NET_WAL_HPP__
+#define __SV_NET_WAL_HPP__
+#pragma once
+
+#if !defined(_WIN32)
+
+// durable::basic_sender is built on wal::log.
+#define SV_NET_HAS_WAL
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+
+namespace sv
+{
+namespace net
+{
+namespace wal
+{
+
+namespace asio = boost::asio;
+using error_code = boost::system::error_code;
+
+////////////////////////////////////////////////////////////////////////////////
+// log layout
+//
+// a directory of segment files named after their first record, each
+// preallocated, memory-mapped and filled in turn:
+//
+//   [ segment_header ][ record_header ][ data ][ record_header ][ data ]...
+//
+// records are numbered from 1 across segments. a segment ends at the first
+// record that is torn, out of sequence or fails its checksum, which is also
+// where a log reopened after a crash continues.
+////////////////////////////////////////////////////////////////////////////////
+struct options
+{
+  // bytes per segment; a larger record gets a segment of its own.
+  std::size_t segment_size = 64 * 1024 * 1024;
+};
+
+#pragma pack(push, 1)
+struct segment_header
+{
+  static const std::uint32_t sc_magic = 0x4C575653; // "SVWL"
+  static const std::uint32_t sc_version = 1;
+
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint64_t first;
+};
+
+struct record_header
+{
+  std::uint32_t size;
+  std::uint32_t checksum;
+  std::uint64_t seq;
+};
+#pragma pack(pop)
+
+namespace detail
+{
+
+inline boost::system::system_error last_error(const char* _where)
+{
+  return boost::system::system_error(error_code(errno, asio::error::get_system_category()), _where);
+}
+
+// FNV-1a over the record number and the data, so a record copied from
+// elsewhere in the log does not check out either.
+inline std::uint32_t checksum(std::uint64_t _seq, const char* _data, std::size_t _size)
+{
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < sizeof(_seq); ++i)
+  {
+    hash = (hash ^ static_cast<std::uint8_t>(_seq >> (8 * i))) * 16777619u;
+  }
+  for (std::size_t i = 0; i < _size; ++i)
+  {
+    hash = (hash ^ static_cast<std::uint8_t>(_data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+inline std::string segment_name(std::uint64_t _first)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.wal", static_cast<unsigned long long>(_first));
+  return name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// segment
+////////////////////////////////////////////////////////////////////////////////
+class segment
+{
+public:
+  using ptr = std::shared_ptr<segment>;
+
+  // creates _path with room for _capacity bytes.
+  segment(std::string const& _path, std::uint64_t _first, std::size_t _capacity)
+    : m_path(_path)
+    , m_fd(::open(_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644))
+    , m_data(nullptr)
+    , m_capacity(_capacity)
+    , m_used(sizeof(segment_header))
+    , m_first(_first)
+    , m_last(_first - 1)
+  {
+    // allocated up front: a full disk fails here, not as SIGBUS on a write.
+    int allocated = (m_fd < 0) ? -1 : ::posix_fallocate(m_fd, 0, static_cast<off_t>(_capacity));
+    if (allocated > 0)
+    {
+      // posix_fallocate returns its error rather than setting errno.
+      errno = allocated;
+    }
+    if (allocated != 0 || !map())
+    {
+      auto error = last_error("wal::segment");
+      close();
+      ::unlink(_path.c_str());
+      throw error;
+    }
+    segment_header header{};
+    header.magic = segment_header::sc_magic;
+    header.version = segment_header::sc_version;
+    header.first = _first;
+    std::memcpy(m_data, &header, sizeof(header));
+  }
+  // opens an existing segment and finds its end. throws if it is not one.
+  explicit segment(std::string const& _path)
+    : m_path(_path)
+    , m_fd(::open(_path.c_str(), O_RDWR | O_CLOEXEC))
+    , m_data(nullptr)
+    , m_capacity(0)
+    , m_used(sizeof(segment_header))
+    , m_first(0)
+    , m_last(0)
+  {
+    struct stat st;
+    if (m_fd < 0 || ::fstat(m_fd, &st) != 0)
+    {
+      auto error = last_error("wal::segment");
+      close();
+      throw error;
+    }
+    m_capacity = static_cast<std::size_t>(st.st_size);
+
+    segment_header header{};
+    if (m_capacity < sizeof(header) || !map() ||
+        (std::memcpy(&header, m_data, sizeof(header)), header.magic != segment_header::sc_magic) ||
+        header.version != segment_header::sc_version || header.first == 0)
+    {
+      close();
+      throw boost::system::system_error(asio::error::invalid_argument, "wal::segment: " + _path);
+    }
+    m_first = header.first;
+    m_last = m_first - 1;
+    recover();
+  }
+  segment(segment const&) = delete;
+  segment& operator=(segment const&) = delete;
+  ~segment()
+  {
+    close();
+  }
+
+  bool fits(std::size_t _size) const
+  {
+    return m_used + sizeof(record_header) + _size <= m_capacity;
+  }
+  // the caller checked fits() and holds the log's lock.
+  template<class Writer>
+  void append(std::uint64_t _seq, std::size_t _size, Writer&& _write)
+  {
+    char* record = m_data + m_used;
+    char* data = record + sizeof(record_header);
+    _write(data);
+    record_header header{ static_cast<std::uint32_t>(_size), checksum(_seq, data, _size), _seq };
+    std::memcpy(record, &header, sizeof(header));
+    m_used += sizeof(header) + _size;
+    m_last.store(_seq, std::memory_order_release);
+  }
+  // the record at _offset; the offset of the next one.
+  std::size_t at(std::size_t _offset, record_header& _header, const char*& _data) const
+  {
+    std::memcpy(&_header, m_data + _offset, sizeof(_header));
+    _data = m_data + _offset + sizeof(_header);
+    return _offset + sizeof(_header) + _header.size;
+  }
+  bool sync()
+  {
+    return ::fdatasync(m_fd) == 0;
+  }
+  void remove()
+  {
+    ::unlink(m_path.c_str());
+  }
+
+  std::uint64_t first() const
+  {
+    return m_first;
+  }
+  // m_first - 1 while empty.
+  std::uint64_t last() const
+  {
+    return m_last.load(std::memory_order_acquire);
+  }
+
+private:
+  bool map()
+  {
+    void* p = ::mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    m_data = (p == MAP_FAILED) ? nullptr : static_cast<char*>(p);
+    return m_data != nullptr;
+  }
+  void recover()
+  {
+    auto expected = m_first;
+    while (m_used + sizeof(record_header) <= m_capacity)
+    {
+      record_header header;
+      std::memcpy(&header, m_data + m_used, sizeof(header));
+      if (header.size == 0 || header.seq != expected || m_used + sizeof(header) + header.size > m_capacity ||
+          header.checksum != checksum(header.seq, m_data + m_used + sizeof(header), header.size))
+      {
+        break;
+      }
+      m_used += sizeof(header) + header.size;
+      m_last = expected++;
+    }
+    // a torn record is cleared, so it cannot pass for one later.
+    if (m_used + sizeof(record_header) <= m_capacity)
+    {
+      std::memset(m_data + m_used, 0, sizeof(record_header));
+    }
+  }
+  void close()
+  {
+    if (m_data != nullptr)
+    {
+      ::munmap(m_data, m_capacity);
+      m_data = nullptr;
+    }
+    if (m_fd >= 0)
+    {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+private:
+  std::string m_path;
+  int m_fd;
+  char* m_data;
+  std::size_t m_capacity;
+  std::size_t m_used;
+  std::uint64_t m_first;
+  std::atomic<std::uint64_t> m_last;
+};
+
+} // namespace sv::net::wal::detail
+
+////////////////////////////////////////////////////////////////////////////////
+// log
+//
+// append() only copies into the mapping. sync() makes everything appended
+// before it durable with one fdatasync shared by every caller waiting at the
+// time (group commit), so its cost is spread over however many records came
+// in meanwhile. truncate() deletes segments once all their records are done
+// with; the newest segment stays, it carries the numbering on.
+//
+// append, sync and truncate are thread-safe; read is for one reader.
+////////////////////////////////////////////////////////////////////////////////
+class log
+{
+public:
+  using self = log;
+  using ptr = std::shared_ptr<self>;
+
+  template<class...Args>
+  static ptr make(Args&&...args)
+  {
+    return std::make_shared<self>(std::forward<Args>(args)...);
+  }
+  // creates _directory if needed and recovers what is there. throws
+  // boost::system::system_error.
+  explicit log(std::string const& _directory, options const& _options = options())
+    : m_directory(_directory)
+    , m_options(_options)
+    , m_last(0)
+    , m_synced(0)
+    , m_truncated(0)
+    , m_syncing(false)
+    , m_read_offset(0)
+    , m_read_seq(0)
+  {
+    if (::mkdir(_directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+      throw detail::last_error("wal::log");
+    }
+    m_truncated_fd = ::open((_directory + "/truncated").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_truncated_fd < 0)
+    {
+      throw detail::last_error("wal::log");
+    }
+    std::uint64_t truncated = 0;
+    if (::pread(m_truncated_fd, &truncated, sizeof(truncated), 0) == sizeof(truncated))
+    {
+      m_truncated = truncated;
+    }
+    open_segments();
+    m_synced = m_last.load();
+  }
+  log(log const&) = delete;
+  log& operator=(log const&) = delete;
+  ~log()
+  {
+    ::close(m_truncated_fd);
+  }
+
+  // copies _size bytes into the log; returns the record's number.
+  std::uint64_t append(const char* _data, std::size_t _size)
+  {
+    return append(_size, [_data, _size](char* out) { std::memcpy(out, _data, _size); });
+  }
+  // _write(char* out) fills the _size bytes of the record in place.
+  template<class Writer>
+  std::uint64_t append(std::size_t _size, Writer&& _write)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto seq = m_last.load(std::memory_order_relaxed) + 1;
+    if (m_segments.empty() || !m_segments.back()->fits(_size))
+    {
+      roll(seq, _size);
+    }
+    m_segments.back()->append(seq, _size, std::forward<Writer>(_write));
+    m_last.store(seq, std::memory_order_release);
+    return seq;
+  }
+  // returns once every record appended before the call is on disk.
+  void sync()
+  {
+    auto target = last();
+    std::unique_lock<std::mutex> lock(m_sync_mutex);
+    while (m_synced.load(std::memory_order_acquire) < target)
+    {
+      if (m_syncing)
+      {
+        m_synced_cv.wait(lock);
+        continue;
+      }
+      m_syncing = true;
+      lock.unlock();
+
+      detail::segment::ptr active;
+      std::uint64_t upto;
+      {
+        std::lock_guard<std::mutex> segments(m_mutex);
+        active = m_segments.back();
+        upto = m_last.load(std::memory_order_relaxed);
+      }
+      // older segments were synced when they filled up.
+      bool synced = active->sync();
+
+      lock.lock();
+      m_syncing = false;
+      if (synced && upto > m_synced.load(std::memory_order_relaxed))
+      {
+        m_synced.store(upto, std::memory_order_release);
+      }
+      m_synced_cv.notify_all();
+      if (!synced)
+      {
+        throw detail::last_error("wal::log::sync");
+      }
+    }
+  }
+  // records up to _seq are done with.
+  void truncate(std::uint64_t _seq)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (_seq <= m_truncated)
+    {
+      return;
+    }
+    m_truncated = std::min(_seq, m_last.load(std::memory_order_relaxed));
+    while (m_segments.size() > 1 && m_segments.front()->last() <= m_truncated)
+    {
+      m_segments.front()->remove();
+      m_segments.erase(m_segments.begin());
+    }
+    // not synced: after a crash, at worst records already done with are
+    // read again.
+    auto result = ::pwrite(m_truncated_fd, &m_truncated, sizeof(m_truncated), 0);
+    (void)result;
+  }
+  // calls _visit(seq, data, size) for the records from _from through _to
+  // until it returns false; returns the number of the next record to read.
+  template<class Visitor>
+  std::uint64_t read(std::uint64_t _from, std::uint64_t _to, Visitor&& _visit)
+  {
+    _from = std::max(_from, first());
+    _to = std::min(_to, last());
+    auto seq = _from;
+    while (seq <= _to)
+    {
+      if (m_reader == nullptr || m_read_seq != seq || seq > m_reader->last())
+      {
+        if (!seek(seq))
+        {
+          break;
+        }
+      }
+      auto& segment = *m_reader;
+      auto end = std::min(_to, segment.last());
+      bool more = true;
+      while (seq <= end && more)
+      {
+        record_header header;
+        const char* data;
+        m_read_offset = segment.at(m_read_offset, header, data);
+        more = _visit(seq, data, static_cast<std::size_t>(header.size));
+        m_read_seq = ++seq;
+      }
+      if (!more)
+      {
+        break;
+      }
+    }
+    return seq;
+  }
+
+  // the oldest record not truncated, last() + 1 if there is none.
+  std::uint64_t first() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto first = m_segments.empty() ? 1 : m_segments.front()->first();
+    return std::max(first, m_truncated + 1);
+  }
+  // the newest record appended, 0 before the first.
+  std::uint64_t last() const
+  {
+    return m_last.load(std::memory_order_acquire);
+  }
+  // the newest record known to be on disk.
+  std::uint64_t synced() const
+  {
+    return m_synced.load(std::memory_order_acquire);
+  }
+
+private:
+  void open_segments()
+  {
+    auto* dir = ::opendir(m_directory.c_str());
+    if (dir == nullptr)
+    {
+      throw detail::last_error("wal::log");
+    }
+    std::vector<std::string> names;
+    while (auto* entry = ::readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if (name.size() == 20 && name.compare(16, 4, ".wal") == 0)
+      {
+        names.push_back(name);
+      }
+    }
+    ::closedir(dir);
+    // fixed-width hex: sorted by name is sorted by first record.
+    std::sort(names.begin(), names.end());
+
+    for (auto const& e : names)
+    {
+      auto segment = std::make_shared<detail::segment>(m_directory + "/" + e);
+      // a segment that does not continue the numbering was never written
+      // after a crash; it and any after it are dropped.
+      if (!m_segments.empty() && segment->first() != m_segments.back()->last() + 1)
+      {
+        segment->remove();
+        continue;
+      }
+      m_segments.push_back(std::move(segment));
+    }
+    if (!m_segments.empty())
+    {
+      m_last = m_segments.back()->last();
+    }
+    else if (m_truncated > 0)
+    {
+      m_last = m_truncated;
+    }
+  }
+  // under m_mutex. the full segment is synced before the next is started.
+  void roll(std::uint64_t _first, std::size_t _size)
+  {
+    if (!m_segments.empty() && !m_segments.back()->sync())
+    {
+      throw detail::last_error("wal::log::roll");
+    }
+    auto capacity = std::max(m_options.segment_size, sizeof(segment_header) + sizeof(record_header) + _size);
+    m_segments.push_back(std::make_shared<detail::segment>(m_directory + "/" + detail::segment_name(_first), _first,
+                                                           capacity));
+    // the new file's name is durable before anything in it is.
+    auto dir = ::open(m_directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dir >= 0)
+    {
+      ::fsync(dir);
+      ::close(dir);
+    }
+  }
+  // points the reader at _seq; false if the log no longer has it.
+  bool seek(std::uint64_t _seq)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = std::upper_bound(m_segments.begin(), m_segments.end(), _seq,
+                                 [](std::uint64_t seq, detail::segment::ptr const& s) { return seq < s->first(); });
+      if (it == m_segments.begin())
+      {
+        return false;
+      }
+      m_reader = *(it - 1);
+    }
+    m_read_offset = sizeof(segment_header);
+    m_read_seq = m_reader->first();
+    while (m_read_seq < _seq)
+    {
+      record_header header;
+      const char* data;
+      m_read_offset = m_reader->at(m_read_offset, header, data);
+      ++m_read_seq;
+    }
+    return true;
+  }
+
+private:
+  std::string m_directory;
+  options m_options;
+
+  mutable std::mutex m_mutex;
+  std::vector<detail::segment::ptr> m_segments;
+  std::atomic<std::uint64_t> m_last;
+
+  std::mutex m_sync_mutex;
+  std::condition_variable m_synced_cv;
+  std::atomic<std::uint64_t> m_synced;
+  std::uint64_t m_truncated;
+  int m_truncated_fd;
+  bool m_syncing;
+
+  // where read() left off.
+  detail::segment::ptr m_reader;
+  std::size_t m_read_offset;
+  std::uint64_t m_read_seq;
+};
+
+} // namespace sv::net::wal
+} // namespace sv::net
+} // namespace sv
+
+#endif // _WIN32
+
+#endif // __SV_NET_WAL_HPP__
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+namespace asio = boost::asio;
+using namespace std::chrono_literals;
+
+using session_type = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+using acceptor_type = sv::net::engine::basic_acceptor<session_type>;
+
+namespace
+{
+
+std::size_t outstanding(asio::io_context& _ioc, acceptor_type& _acceptor)
+{
+  std::promise<std::size_t> result;
+  asio::post(_ioc, [&]() { result.set_value(_acceptor.outstanding()); });
+  return result.get_future().get();
+}
+
+// takes every free fd until it is destroyed.
+struct fd_hog
+{
+  fd_hog()
+  {
+    ::getrlimit(RLIMIT_NOFILE, &m_limit);
+    auto lowered = m_limit;
+    lowered.rlim_cur = std::min<rlim_t>(m_limit.rlim_cur, 1024);
+    ::setrlimit(RLIMIT_NOFILE, &lowered);
+    for (int fd; (fd = ::dup(STDERR_FILENO)) >= 0;)
+    {
+      m_fds.push_back(fd);
+    }
+  }
+  ~fd_hog()
+  {
+    for (int fd : m_fds)
+    {
+      ::close(fd);
+    }
+    ::setrlimit(RLIMIT_NOFILE, &m_limit);
+  }
+
+  rlimit m_limit;
+  std::vector<int> m_fds;
+};
+
+} // namespace
+
+// accepts failing with EMFILE on every pending slot wait for the retry
+// timer together; once fds are free again all of them are back.
+void fd_exhaustion()
+{
+  constexpr std::size_t sc_pending = 4;
+
+  std::atomic<int> accepted{ 0 };
+  asio::io_context ioc;
+  auto work = asio::make_work_guard(ioc);
+  std::thread runner([&]() { ioc.run(); });
+
+  sv::net::engine::accept_policy policy;
+  policy.pending = sc_pending;
+  policy.trace = false;
+  auto acceptor = acceptor_type::make(ioc, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0),
+                                      [&](session_type::ptr const&) { ++accepted; },
+                                      sv::net::transport::tcp::options_type(), sv::net::admission::limits(), policy);
+  asio::post(ioc, [&]() { acceptor->execute(); });
+  SV_CHECK(sv::test::wait_until([&]() { return outstanding(ioc, *acceptor) == sc_pending; }));
+  asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), acceptor->local_endpoint().port());
+
+  asio::io_context peer_ioc;
+  std::vector<std::unique_ptr<asio::ip::tcp::socket>> peers;
+  for (std::size_t i = 0; i < sc_pending; ++i)
+  {
+    peers.push_back(std::make_unique<asio::ip::tcp::socket>(peer_ioc, asio::ip::tcp::v4()));
+  }
+  {
+    fd_hog hog;
+    SV_CHECK(!hog.m_fds.empty());
+    // the kernel completes the handshakes; the acceptor cannot take them.
+    for (auto& e : peers)
+    {
+      e->connect(endpoint);
+    }
+    std::this_thread::sleep_for(350ms);
+    SV_CHECK(accepted == 0);
+  }
+
+  SV_CHECK(sv::test::wait_until([&]() { return accepted == int(sc_pending); }));
+  SV_CHECK(sv::test::wait_until([&]() { return outstanding(ioc, *acceptor) == sc_pending; }));
+
+  // as basic_server does: stopped before the acceptor goes.
+  peers.clear();
+  work.reset();
+  ioc.stop();
+  runner.join();
+  acceptor = nullptr;
+}
+
+int main()
+{
+  sv::test::run("fd_exhaustion", fd_exhaustion);
+  return sv::test::result();
+}
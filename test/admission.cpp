@@ -0,0 +1,215 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+namespace asio = boost::asio;
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using udp_server = engine::basic_udp_server<protocol::datagram_basic>;
+using udp_client = engine::basic_udp_client<protocol::datagram_basic>;
+
+// a connected udp client and its session.
+struct udp_peer
+{
+  udp_peer(unsigned short _port)
+    : client(udp_client::make())
+  {
+    std::promise<engine::basic_datagram_session<protocol::datagram_basic>::ptr> connected;
+    client->on_session([&](auto const& _session) { connected.set_value(_session); });
+    client->execute(std::string("127.0.0.1"), _port);
+    session = connected.get_future().get();
+  }
+  void send()
+  {
+    session->protocol().send(packet::string_packet::make(std::string("hello"), 0));
+  }
+
+  udp_client::ptr client;
+  engine::basic_datagram_session<protocol::datagram_basic>::ptr session;
+};
+
+} // namespace
+
+// the total and the per-address counts each turn sessions away at their
+// limit, and take them again once one is released. transports without an
+// address only count towards the total.
+void gate_limits()
+{
+  admission::limits limits;
+  limits.max_connections = 3;
+  limits.max_per_address = 2;
+  admission::gate gate(limits);
+  auto a = asio::ip::make_address("10.0.0.1");
+  auto b = asio::ip::make_address("::1");
+  auto c = asio::ip::make_address("10.0.0.3");
+
+  SV_CHECK(gate.admit(&a));
+  SV_CHECK(gate.admit(&a));
+  SV_CHECK(!gate.admit(&a));
+  SV_CHECK(gate.admit(&b));
+  SV_CHECK(!gate.admit(&c));
+  SV_CHECK(gate.connections() == 3);
+
+  gate.release(&a);
+  SV_CHECK(gate.admit(&b));
+  SV_CHECK(!gate.admit(&b));
+  SV_CHECK(!gate.admit(&c));
+  gate.release(&b);
+  gate.release(&b);
+  SV_CHECK(gate.admit(&c));
+  SV_CHECK(gate.admit(nullptr));
+  SV_CHECK(!gate.admit(nullptr));
+  SV_CHECK(gate.connections() == 3);
+
+  admission::gate open;
+  for (int i = 0; i < 1000; ++i)
+    SV_CHECK(open.admit(&a));
+}
+
+// a bucket lets its burst through at once, then one token per 1 / rate;
+// what it owes it has to wait for.
+void token_bucket()
+{
+  admission::rate rate;
+  rate.per_second = 10;
+  rate.burst = 5;
+  admission::token_bucket bucket(rate);
+  SV_CHECK(bucket.enabled());
+  SV_CHECK(!admission::token_bucket().enabled());
+
+  auto now = admission::clock_type::now();
+  SV_CHECK(bucket.consume(5, now) == admission::clock_type::duration::zero());
+  auto wait = std::chrono::duration<double>(bucket.consume(1, now)).count();
+  SV_CHECK(wait > 0.09 && wait < 0.11);
+  // a second later 10 tokens came in, capped at the burst, less the one owed.
+  SV_CHECK(bucket.consume(4, now + 1s) == admission::clock_type::duration::zero());
+  wait = std::chrono::duration<double>(bucket.consume(2, now + 1s)).count();
+  SV_CHECK(wait > 0.09 && wait < 0.11);
+
+  admission::throttle none;
+  SV_CHECK(!none.enabled());
+  SV_CHECK(none.consume(1000, 1 << 20) == admission::clock_type::duration::zero());
+}
+
+// a server at max_connections closes the next connection; once a session
+// ends its place is taken again.
+void connection_limit()
+{
+  std::atomic<int> sessions{ 0 };
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  admission::limits limits;
+  limits.max_connections = 1;
+  server->set_limits(limits);
+  server->on_session([&](auto const&) { ++sessions; });
+  server->execute(0);
+  asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), server->local_endpoint().port());
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket first(ioc), second(ioc), third(ioc);
+  first.connect(endpoint);
+  SV_CHECK(sv::test::wait_until([&]() { return sessions == 1; }));
+  second.connect(endpoint);
+  char byte;
+  boost::system::error_code ec;
+  second.read_some(asio::buffer(&byte, 1), ec);
+  SV_CHECK(ec == asio::error::eof || ec == asio::error::connection_reset);
+  SV_CHECK(sessions == 1);
+
+  first.close();
+  std::this_thread::sleep_for(100ms);
+  third.connect(endpoint);
+  SV_CHECK(sv::test::wait_until([&]() { return sessions == 2; }));
+  SV_CHECK(server->shutdown(1s));
+}
+
+// 60 messages sent at once to a session limited to 100 a second with a
+// burst of 10 take half a second to be read.
+void message_rate()
+{
+  std::atomic<int> received{ 0 };
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  admission::limits limits;
+  limits.messages.per_second = 100;
+  limits.messages.burst = 10;
+  server->set_limits(limits);
+  server->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr const&) { ++received; });
+  });
+  server->execute(0);
+
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session) { connected.set_value(session); });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+  auto session = connected.get_future().get();
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < 60; ++i)
+  {
+    session->protocol().send(packet::string_packet::make(std::string("m"), 0));
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return received == 60; }));
+  SV_CHECK(std::chrono::steady_clock::now() - begin > 400ms);
+  SV_CHECK(server->shutdown(1s));
+}
+
+// one udp session allowed: a second peer is ignored while the first one
+// talks, and admitted once the first has been silent for the idle time.
+void udp_idle_expiry()
+{
+  std::atomic<int> sessions{ 0 };
+  std::atomic<int> received{ 0 };
+  auto server = udp_server::make();
+  admission::limits limits;
+  limits.max_connections = 1;
+  server->set_limits(limits);
+  engine::accept_policy policy;
+  policy.idle = 300ms;
+  server->set_accept_policy(policy);
+  server->on_session([&](auto const& session)
+  {
+    ++sessions;
+    session->protocol().on_receive([&](packet::base::ptr const&) { ++received; });
+  });
+  server->execute(0);
+
+  udp_peer first(server->local_endpoint().port());
+  udp_peer second(server->local_endpoint().port());
+  first.send();
+  SV_CHECK(sv::test::wait_until([&]() { return received == 1; }));
+  // kept alive by its traffic, the first holds the only place.
+  for (int i = 0; i < 6; ++i)
+  {
+    second.send();
+    first.send();
+    std::this_thread::sleep_for(100ms);
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return received == 7; }));
+  SV_CHECK(sessions == 1);
+
+  std::this_thread::sleep_for(600ms);
+  second.send();
+  SV_CHECK(sv::test::wait_until([&]() { return received == 8; }));
+  SV_CHECK(sessions == 2);
+  SV_CHECK(server->shutdown(1s));
+}
+
+int main()
+{
+  sv::test::run("gate_limits", gate_limits);
+  sv::test::run("token_bucket", token_bucket);
+  sv::test::run("connection_limit", connection_limit);
+  sv::test::run("message_rate", message_rate);
+  sv::test::run("udp_idle_expiry", udp_idle_expiry);
+  return sv::test::result();
+}
@@ -0,0 +1,227 @@
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "sv/net/balance.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using balancer_type = balance::basic_tcp_balancer<>;
+
+enum class mode
+{
+  answer,
+  slow,
+  fail,
+  silent,
+};
+
+// a server answering calls with the request itself, according to its mode.
+struct backend
+{
+  backend()
+    : m_mode(mode::answer)
+    , m_calls(0)
+    , m_server(engine::basic_tcp_server<protocol::basic>::make())
+  {
+    engine::accept_policy policy;
+    policy.trace = false;
+    m_server->set_accept_policy(policy);
+    m_server->on_session([this](auto const& session)
+    {
+      auto executor = session->socket().get_executor();
+      balance::serve(session, [this, executor](packet::base::ptr request, balance::answer_type answer)
+      {
+        ++m_calls;
+        switch (m_mode.load())
+        {
+        case mode::answer:
+          answer(request);
+          break;
+        case mode::slow:
+        {
+          auto timer = std::make_shared<boost::asio::steady_timer>(executor, 20ms);
+          timer->async_wait([timer, request, answer](boost::system::error_code const&) { answer(request); });
+          break;
+        }
+        case mode::fail:
+          answer(nullptr);
+          break;
+        case mode::silent:
+          break;
+        }
+      });
+    });
+    m_server->execute(0);
+  }
+  ~backend()
+  {
+    m_server->shutdown(1s);
+  }
+
+  unsigned short port() const
+  {
+    return m_server->local_endpoint().port();
+  }
+
+  std::atomic<mode> m_mode;
+  std::atomic<int> m_calls;
+  engine::basic_tcp_server<protocol::basic>::ptr m_server;
+};
+
+struct outcome
+{
+  boost::system::error_code error;
+  std::string value;
+};
+
+// one request, waited for.
+outcome call(balancer_type& _balancer, std::string const& _value)
+{
+  auto done = std::make_shared<std::promise<outcome>>();
+  _balancer.request(packet::string_packet::make(_value, 0), [done](boost::system::error_code const& ec, packet::base::ptr response)
+  {
+    outcome o{ ec, std::string() };
+    if (response != nullptr)
+      o.value = static_cast<packet::string_packet&>(*response).get_value();
+    done->set_value(o);
+  });
+  auto result = done->get_future();
+  if (result.wait_for(10s) != std::future_status::ready)
+    return outcome{ boost::asio::error::would_block, std::string() };
+  return result.get();
+}
+
+bool connected(balancer_type const& _balancer)
+{
+  for (auto const& e : _balancer.stats())
+  {
+    if (!e.connected)
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+// round robin takes the endpoints in turn.
+void round_robin()
+{
+  constexpr int sc_count = 100;
+  backend a;
+  backend b;
+  balance::options options;
+  options.policy = balance::policy::round_robin;
+  balancer_type balancer(options);
+  balancer.add_endpoint(std::string("127.0.0.1"), a.port());
+  balancer.add_endpoint(std::string("127.0.0.1"), b.port());
+  SV_CHECK(sv::test::wait_until([&]() { return connected(balancer); }));
+
+  for (int i = 0; i < sc_count; ++i)
+  {
+    auto o = call(balancer, std::to_string(i));
+    SV_CHECK(!o.error && o.value == std::to_string(i));
+  }
+  SV_CHECK(a.m_calls == sc_count / 2 && b.m_calls == sc_count / 2);
+  auto stats = balancer.stats();
+  SV_CHECK(stats[0].requests == sc_count / 2 && stats[0].failures == 0);
+  SV_CHECK(stats[0].outstanding == 0 && stats[1].outstanding == 0);
+}
+
+// least loaded sends little to an endpoint once it has answered slowly.
+void least_loaded()
+{
+  constexpr int sc_count = 200;
+  backend fast;
+  backend slow;
+  slow.m_mode = mode::slow;
+  balancer_type balancer;
+  balancer.add_endpoint(std::string("127.0.0.1"), fast.port());
+  balancer.add_endpoint(std::string("127.0.0.1"), slow.port());
+  SV_CHECK(sv::test::wait_until([&]() { return connected(balancer); }));
+
+  for (int i = 0; i < sc_count; ++i)
+  {
+    SV_CHECK(!call(balancer, std::to_string(i)).error);
+  }
+  SV_CHECK(fast.m_calls + slow.m_calls == sc_count);
+  SV_CHECK(slow.m_calls < sc_count / 10);
+  auto stats = balancer.stats();
+  SV_CHECK(stats[1].latency > stats[0].latency);
+}
+
+// an endpoint that keeps failing is ejected and the rest of the pool takes
+// its requests; once ejection runs out one probe puts it back.
+void ejection()
+{
+  constexpr int sc_count = 40;
+  backend failing;
+  backend good;
+  failing.m_mode = mode::fail;
+  balance::options options;
+  options.policy = balance::policy::round_robin;
+  options.minimum_requests = 4;
+  options.ejection = 300ms;
+  balancer_type balancer(options);
+  balancer.add_endpoint(std::string("127.0.0.1"), failing.port());
+  balancer.add_endpoint(std::string("127.0.0.1"), good.port());
+  SV_CHECK(sv::test::wait_until([&]() { return connected(balancer); }));
+
+  int failed = 0;
+  for (int i = 0; i < sc_count; ++i)
+  {
+    failed += !!call(balancer, std::to_string(i)).error;
+  }
+  // 0.2, 0.36, 0.49, 0.59: out after the fourth failure.
+  SV_CHECK(failed == 4);
+  SV_CHECK(failing.m_calls == 4);
+  auto stats = balancer.stats();
+  SV_CHECK(stats[0].ejected && stats[0].ejections == 1 && stats[0].failures == 4);
+  SV_CHECK(!stats[1].ejected);
+
+  failing.m_mode = mode::answer;
+  std::this_thread::sleep_for(350ms);
+  SV_CHECK(!call(balancer, "probe").error);
+  SV_CHECK(failing.m_calls == 5);
+  SV_CHECK(!balancer.stats()[0].ejected);
+}
+
+// a request without a reply fails with timed_out; with nothing connected it
+// fails at once with not_connected.
+void timeout_and_unreachable()
+{
+  backend silent;
+  silent.m_mode = mode::silent;
+  balance::options options;
+  options.timeout = 100ms;
+  balancer_type balancer(options);
+  balancer.add_endpoint(std::string("127.0.0.1"), silent.port());
+  SV_CHECK(sv::test::wait_until([&]() { return connected(balancer); }));
+  SV_CHECK(call(balancer, "lost").error == boost::asio::error::timed_out);
+  SV_CHECK(balancer.stats()[0].outstanding == 0);
+
+  unsigned short port;
+  {
+    backend gone;
+    port = gone.port();
+  }
+  balancer_type nowhere;
+  nowhere.add_endpoint(std::string("127.0.0.1"), port);
+  SV_CHECK(call(nowhere, "lost").error == boost::asio::error::not_connected);
+}
+
+int main()
+{
+  sv::test::run("round_robin", round_robin);
+  sv::test::run("least_loaded", least_loaded);
+  sv::test::run("ejection", ejection);
+  sv::test::run("timeout_and_unreachable", timeout_and_unreachable);
+  return sv::test::result();
+}
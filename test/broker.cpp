@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sv/net/broker.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+std::vector<broker::trie::subscriber_id> matches(broker::trie const& _trie, std::string const& _topic)
+{
+  std::vector<broker::trie::subscriber_id> result;
+  _trie.match(_topic, [&](broker::trie::subscriber_id s) { result.push_back(s); });
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+using ids = std::vector<broker::trie::subscriber_id>;
+
+// a client of the broker and the publishes it has received, as
+// "topic=payload".
+struct peer
+{
+  explicit peer(unsigned short _port)
+    : client(engine::basic_tcp_client<protocol::basic>::make())
+  {
+    std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+    client->on_session([&](auto const& _session)
+    {
+      _session->protocol().on_receive([this](packet::base::ptr packet)
+      {
+        std::string_view topic, payload;
+        if (broker::read_publish(*packet, topic, payload))
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          received.push_back(std::string(topic) + "=" + std::string(payload));
+        }
+      });
+      connected.set_value(_session);
+    });
+    client->execute(std::string("127.0.0.1"), _port);
+    session = connected.get_future().get();
+  }
+  void send(packet::base::ptr const& _packet)
+  {
+    session->protocol().send(_packet);
+  }
+  std::vector<std::string> got()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return received;
+  }
+
+  // before the client, whose thread uses them until it is gone.
+  std::mutex mutex;
+  std::vector<std::string> received;
+  engine::basic_tcp_client<protocol::basic>::ptr client;
+  engine::basic_session<protocol::basic, transport::tcp>::ptr session;
+};
+
+} // namespace
+
+// exact and prefix subscriptions match as documented, through node splits;
+// erasing them all merges the trie back to its root.
+void trie_matching()
+{
+  broker::trie trie;
+  SV_CHECK(trie.insert("prices/eur", false, 1));
+  SV_CHECK(trie.insert("prices/", true, 2));
+  SV_CHECK(trie.insert("prices/usd", false, 3));
+  SV_CHECK(trie.insert("", true, 4));
+  SV_CHECK(trie.insert("pr", false, 5));
+  SV_CHECK(!trie.insert("prices/eur", false, 1));
+  SV_CHECK(trie.insert("prices/eur", true, 1));
+  SV_CHECK(trie.size() == 6);
+
+  SV_CHECK(matches(trie, "prices/eur") == (ids{ 1, 1, 2, 4 }));
+  SV_CHECK(matches(trie, "prices/eur/x") == (ids{ 1, 2, 4 }));
+  SV_CHECK(matches(trie, "prices/usd") == (ids{ 2, 3, 4 }));
+  SV_CHECK(matches(trie, "prices/") == (ids{ 2, 4 }));
+  SV_CHECK(matches(trie, "pr") == (ids{ 4, 5 }));
+  SV_CHECK(matches(trie, "p") == (ids{ 4 }));
+  SV_CHECK(matches(trie, "news") == (ids{ 4 }));
+
+  SV_CHECK(!trie.erase("prices/gbp", false, 1));
+  SV_CHECK(!trie.erase("prices/eur", false, 2));
+  SV_CHECK(trie.erase("prices/eur", false, 1));
+  SV_CHECK(trie.erase("prices/eur", true, 1));
+  SV_CHECK(trie.erase("pr", false, 5));
+  SV_CHECK(matches(trie, "prices/eur") == (ids{ 2, 4 }));
+  SV_CHECK(trie.erase("prices/usd", false, 3));
+  SV_CHECK(trie.erase("prices/", true, 2));
+  SV_CHECK(trie.erase("", true, 4));
+  SV_CHECK(trie.size() == 0);
+  SV_CHECK(trie.nodes() == 1);
+  SV_CHECK(matches(trie, "prices/eur").empty());
+}
+
+// publishes reach the exact and the prefix subscribers of their topic only;
+// unsubscribing, or going away, ends a subscription.
+void publish_subscribe()
+{
+  auto hub = broker::basic_tcp_broker<>::make();
+  hub->execute(0);
+  auto port = hub->server().local_endpoint().port();
+
+  peer exact(port), prefix(port), publisher(port);
+  exact.send(broker::make_subscribe("prices/eur"));
+  prefix.send(broker::make_subscribe("prices/*"));
+  SV_CHECK(sv::test::wait_until([&]() { return hub->subscriptions() == 2; }));
+
+  publisher.send(broker::make_publish("prices/eur", "1.08"));
+  publisher.send(broker::make_publish("prices/usd", "1.00"));
+  publisher.send(broker::make_publish("news", "none"));
+  SV_CHECK(sv::test::wait_until([&]() { return hub->stats().published == 3; }));
+  SV_CHECK(sv::test::wait_until([&]() { return prefix.got().size() == 2; }));
+  SV_CHECK(sv::test::wait_until([&]() { return exact.got().size() == 1; }));
+  SV_CHECK(exact.got() == (std::vector<std::string>{ "prices/eur=1.08" }));
+  SV_CHECK(prefix.got() == (std::vector<std::string>{ "prices/eur=1.08", "prices/usd=1.00" }));
+  SV_CHECK(publisher.got().empty());
+  SV_CHECK(hub->stats().delivered == 3);
+
+  prefix.send(broker::make_unsubscribe("prices/*"));
+  SV_CHECK(sv::test::wait_until([&]() { return hub->subscriptions() == 1; }));
+  boost::asio::post(exact.session->socket().get_executor(), [s = exact.session]() { s->socket().close(); });
+  SV_CHECK(sv::test::wait_until([&]() { return hub->subscriptions() == 0; }));
+  publisher.send(broker::make_publish("prices/eur", "1.09"));
+  SV_CHECK(sv::test::wait_until([&]() { return hub->stats().published == 4; }));
+  std::this_thread::sleep_for(50ms);
+  SV_CHECK(prefix.got().size() == 2);
+  SV_CHECK(hub->stats().delivered == 3);
+  SV_CHECK(hub->server().shutdown(1s));
+}
+
+int main()
+{
+  sv::test::run("trie_matching", trie_matching);
+  sv::test::run("publish_subscribe", publish_subscribe);
+  return sv::test::result();
+}
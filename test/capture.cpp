@@ -0,0 +1,157 @@
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+std::string temp_path(const char* _name)
+{
+  return std::string("/tmp/sv.net.test.") + _name + "." + std::to_string(::getpid());
+}
+
+std::string value_of(packet::base::ptr const& _packet)
+{
+  return static_cast<packet::string_packet&>(*_packet).get_value();
+}
+
+} // namespace
+
+// the server logs what its session reads and writes. the log holds every
+// message both ways, in order, as it went over the wire; the echoes of the
+// second half go out as encoded packets.
+void session_log()
+{
+  constexpr int sc_count = 500;
+  auto path = temp_path("capture");
+  auto log = capture::writer::make(path);
+
+  std::atomic<int> echoed{ 0 };
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&](auto const& session)
+  {
+    session->protocol().set_capture(log);
+    auto* raw = session.get();
+    session->protocol().on_receive([raw](packet::base::ptr packet)
+    {
+      if (std::stoi(value_of(packet)) < sc_count / 2)
+      {
+        raw->protocol().send(packet);
+        return;
+      }
+      auto bytes = std::make_shared<const std::string>(packet::serialize(*packet));
+      raw->protocol().send(packet::encoded_packet::make(bytes, raw->id()));
+    });
+  });
+  server->execute(0);
+
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr const&) { ++echoed; });
+    connected.set_value(session);
+  });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+  for (int i = 0; i < sc_count; ++i)
+  {
+    session->protocol().send(packet::string_packet::make(std::to_string(i), 0));
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return echoed == sc_count; }));
+  SV_CHECK(server->shutdown(1s));
+  log->close();
+  SV_CHECK(log->dropped() == 0);
+
+  capture::reader reader(path);
+  capture::reader::entry entry;
+  int next[2] = { 0, 0 };
+  sv::id_type session_id = 0;
+  while (reader.next(entry))
+  {
+    auto& expected = next[static_cast<int>(entry.direction)];
+    auto packet = packet::deserialize(entry.session, entry.data, entry.size);
+    SV_CHECK(packet != nullptr);
+    if (packet == nullptr)
+      break;
+    SV_CHECK(value_of(packet) == std::to_string(expected));
+    SV_CHECK(session_id == 0 || entry.session == session_id);
+    session_id = entry.session;
+    ++expected;
+  }
+  SV_CHECK(next[static_cast<int>(capture::direction::received)] == sc_count);
+  SV_CHECK(next[static_cast<int>(capture::direction::sent)] == sc_count);
+  std::remove(path.c_str());
+}
+
+// appends from several threads at once, across a grow of the file: each
+// record is whole, and each thread's are in its order.
+void concurrent_appends()
+{
+  constexpr int sc_threads = 4;
+  constexpr int sc_count = 2000;
+  auto path = temp_path("capture.concurrent");
+  auto log = capture::writer::make(path);
+
+  // 4 threads * 2000 * ~9 KiB: over capture::writer::sc_grow.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < sc_threads; ++t)
+  {
+    threads.emplace_back([&log, t]()
+    {
+      for (int i = 0; i < sc_count; ++i)
+      {
+        auto message = packet::serialize(*packet::string_packet::make(std::to_string(i) + std::string(9000, 'a' + t), 0));
+        log->append(capture::direction::sent, sv::id_type(t + 1), message.data(), message.size());
+      }
+    });
+  }
+  for (auto& e : threads)
+  {
+    e.join();
+  }
+  SV_CHECK(log->size() > capture::writer::sc_grow);
+  log->close();
+  SV_CHECK(log->dropped() == 0);
+
+  capture::reader reader(path);
+  capture::reader::entry entry;
+  int next[sc_threads] = {};
+  int total = 0;
+  while (reader.next(entry))
+  {
+    int t = static_cast<int>(entry.session) - 1;
+    SV_CHECK(t >= 0 && t < sc_threads);
+    if (t < 0 || t >= sc_threads)
+      break;
+    auto packet = packet::deserialize(entry.session, entry.data, entry.size);
+    SV_CHECK(packet != nullptr && value_of(packet) == std::to_string(next[t]) + std::string(9000, 'a' + t));
+    ++next[t];
+    ++total;
+  }
+  SV_CHECK(total == sc_threads * sc_count);
+  std::remove(path.c_str());
+}
+
+int main()
+{
+  sv::test::run("session_log", session_log);
+  sv::test::run("concurrent_appends", concurrent_appends);
+  return sv::test::result();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <thread>
+
+namespace sv
+{
+namespace test
+{
+
+inline int& failures()
+{
+  static int count = 0;
+  return count;
+}
+
+// polls _done until it holds or _timeout passes; the last result.
+template<class F>
+bool wait_until(F&& _done, std::chrono::milliseconds _timeout = std::chrono::seconds(10))
+{
+  auto deadline = std::chrono::steady_clock::now() + _timeout;
+  while (!_done())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return _done();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+// runs one case and reports it.
+template<class F>
+void run(const char* _name, F&& _case)
+{
+  auto before = failures();
+  try
+  {
+    _case();
+  }
+  catch (std::exception const& e)
+  {
+    std::fprintf(stderr, "%s: exception: %s\n", _name, e.what());
+    ++failures();
+  }
+  std::printf("%s: %s\n", _name, failures() == before ? "ok" : "FAILED");
+  std::fflush(stdout);
+}
+
+inline int result()
+{
+  return failures() == 0 ? 0 : 1;
+}
+
+} // namespace test
+} // namespace sv
+
+// a failed check is reported with its line and the case goes on.
+#define SV_CHECK(expr)                                                                    \
+  do                                                                                      \
+  {                                                                                       \
+    if (!(expr))                                                                          \
+    {                                                                                     \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);      \
+      ++sv::test::failures();                                                             \
+    }                                                                                     \
+  } while (false)
@@ -0,0 +1,157 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+using namespace sv::net;
+
+namespace
+{
+
+std::uint32_t both(const void* _data, std::size_t _size, std::uint32_t _crc = 0)
+{
+  auto crc = checksum::crc32c(_data, _size, _crc);
+  SV_CHECK(crc == checksum::crc32c_software(_data, _size, _crc));
+  return crc;
+}
+
+packet::header good_header()
+{
+  packet::header h{};
+  h.tag = packet::base::sc_tag;
+  h.version = 1;
+  h.type = packet::string_body_type;
+  h.length = packet::base::sc_header_size + 4;
+  return h;
+}
+
+} // namespace
+
+// the check values of RFC 3720, B.4, and the usual "123456789".
+void known_vectors()
+{
+  std::vector<unsigned char> data(32);
+  SV_CHECK(both("123456789", 9) == 0xE3069283);
+  SV_CHECK(both(data.data(), data.size()) == 0x8A9136AA);
+  std::fill(data.begin(), data.end(), 0xFF);
+  SV_CHECK(both(data.data(), data.size()) == 0x62A8AB43);
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<unsigned char>(i);
+  SV_CHECK(both(data.data(), data.size()) == 0x46DD794E);
+  SV_CHECK(both(data.data(), 0) == 0);
+}
+
+// any start address and length, through every path of the three-way loop,
+// gives the crc of the portable code; and so does any split of the input.
+void unaligned_and_split()
+{
+  std::vector<unsigned char> data(3 * checksum::detail::sc_long + 1000);
+  std::uint32_t seed = 1;
+  for (auto& e : data)
+  {
+    seed = seed * 1103515245 + 12345;
+    e = static_cast<unsigned char>(seed >> 16);
+  }
+  std::size_t const sizes[] = { 1, 7, 8, 9, 63, 255, 3 * checksum::detail::sc_short + 5, 4097,
+                                3 * checksum::detail::sc_long + 11 };
+  for (std::size_t offset = 0; offset < 8; ++offset)
+  {
+    for (auto size : sizes)
+    {
+      both(data.data() + offset, size);
+    }
+  }
+
+  auto whole = both(data.data(), data.size());
+  std::size_t const cuts[] = { 1, 3, 255, 4096, checksum::detail::sc_long + 3, data.size() - 1 };
+  for (auto cut : cuts)
+  {
+    SV_CHECK(both(data.data() + cut, data.size() - cut, both(data.data(), cut)) == whole);
+  }
+}
+
+// headers that must not be read: a wrong tag, an unknown flag, a length too
+// short for the header and its extensions, or over the maximum.
+void header_rejections()
+{
+  SV_CHECK(packet::base::valid(good_header()));
+
+  auto h = good_header();
+  h.tag ^= 1;
+  SV_CHECK(!packet::base::valid(h));
+
+  h = good_header();
+  h.version |= 0x40000;
+  SV_CHECK(!packet::base::valid(h));
+  h.version = 1 | packet::base::sc_traced | packet::base::sc_checksummed;
+  h.length = packet::base::sc_header_size + sizeof(packet::trace_context) + sizeof(std::uint32_t);
+  SV_CHECK(packet::base::valid(h));
+
+  h.length -= 1;
+  SV_CHECK(!packet::base::valid(h));
+  h = good_header();
+  h.length = packet::base::sc_header_size - 1;
+  SV_CHECK(!packet::base::valid(h));
+  h.length = 0;
+  SV_CHECK(!packet::base::valid(h));
+
+  h.length = packet::base::sc_max_length;
+  SV_CHECK(packet::base::valid(h));
+  h.length = packet::base::sc_max_length + 1;
+  SV_CHECK(!packet::base::valid(h));
+  h.length = ~std::uint64_t(0);
+  SV_CHECK(!packet::base::valid(h));
+}
+
+// a flipped body byte fails the checksum.
+void corrupted_body()
+{
+  auto p = packet::string_packet::make(std::string("harbour"), 0);
+  p->set_checksum();
+  auto bytes = packet::serialize(*p);
+  SV_CHECK(packet::deserialize(0, bytes.data(), bytes.size()) != nullptr);
+  bytes.back() ^= 0x01;
+  SV_CHECK(packet::deserialize(0, bytes.data(), bytes.size()) == nullptr);
+}
+
+// a binary body is read into a file of its own, whole.
+void binary_round_trip()
+{
+  auto source = std::string("/tmp/sv.net.test.binary.") + std::to_string(::getpid());
+  std::string content;
+  for (int i = 0; i < 10000; ++i)
+    content += static_cast<char>(i * 7);
+  std::ofstream(source, std::ios::binary) << content;
+
+  auto p = packet::binary_packet::make(source, 0);
+  p->set_checksum();
+  auto bytes = packet::serialize(*p);
+  SV_CHECK(bytes.size() == p->get_header().length);
+  auto received = packet::deserialize(0, bytes.data(), bytes.size());
+  SV_CHECK(received != nullptr);
+  if (received != nullptr)
+  {
+    auto path = static_cast<packet::binary_packet&>(*received).get_value();
+    SV_CHECK(path != source);
+    std::ifstream file(path, std::ios::binary);
+    SV_CHECK(std::string(std::istreambuf_iterator<char>(file), {}) == content);
+    std::remove(path.c_str());
+  }
+  std::remove(source.c_str());
+}
+
+int main()
+{
+  sv::test::run("known_vectors", known_vectors);
+  sv::test::run("unaligned_and_split", unaligned_and_split);
+  sv::test::run("header_rejections", header_rejections);
+  sv::test::run("corrupted_body", corrupted_body);
+  sv::test::run("binary_round_trip", binary_round_trip);
+  return sv::test::result();
+}
@@ -0,0 +1,234 @@
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "sv/net/durable.hpp"
+#include "check.h"
+
+#if defined(SV_NET_HAS_WAL)
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+std::string temp_path(const char* _name)
+{
+  return std::string("/tmp/sv.net.test.") + _name + "." + std::to_string(::getpid());
+}
+
+std::string value_of(packet::base::ptr const& _packet)
+{
+  return static_cast<packet::string_packet&>(*_packet).get_value();
+}
+
+// a server whose sessions are attached to one receiver; what it hands on
+// is kept in order.
+struct sink
+{
+  sink()
+    : m_receiver([this](packet::base::ptr packet)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_values.push_back(value_of(packet));
+      })
+    , m_server(engine::basic_tcp_server<protocol::basic>::make())
+  {
+    engine::accept_policy policy;
+    policy.trace = false;
+    m_server->set_accept_policy(policy);
+    m_server->on_session([this](auto const& session) { m_receiver.attach(session); });
+    m_server->execute(0);
+  }
+  ~sink()
+  {
+    m_server->shutdown(1s);
+  }
+
+  unsigned short port() const
+  {
+    return m_server->local_endpoint().port();
+  }
+  std::vector<std::string> values()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_values;
+  }
+
+  std::mutex m_mutex;
+  std::vector<std::string> m_values;
+  durable::receiver m_receiver;
+  engine::basic_tcp_server<protocol::basic>::ptr m_server;
+};
+
+bool in_order(std::vector<std::string> const& _values, int _count)
+{
+  if (static_cast<int>(_values.size()) != _count)
+    return false;
+  for (int i = 0; i < _count; ++i)
+  {
+    if (_values[i] != std::to_string(i))
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+// records survive the log being reopened, across segments; truncated ones
+// are gone after it.
+void log_reopen()
+{
+  constexpr int sc_count = 300;
+  auto path = temp_path("wal");
+  wal::options options;
+  options.segment_size = 4096;
+  {
+    wal::log log(path, options);
+    SV_CHECK(log.first() == 1 && log.last() == 0);
+    for (int i = 0; i < sc_count; ++i)
+    {
+      auto value = std::to_string(i) + std::string(40, 'x');
+      SV_CHECK(log.append(value.data(), value.size()) == std::uint64_t(i + 1));
+    }
+    log.sync();
+    SV_CHECK(log.synced() == sc_count);
+    log.truncate(100);
+  }
+
+  wal::log log(path, options);
+  SV_CHECK(log.last() == sc_count);
+  SV_CHECK(log.first() == 101);
+  int next = 100;
+  auto end = log.read(1, sc_count, [&](std::uint64_t seq, const char* data, std::size_t size)
+  {
+    SV_CHECK(seq == std::uint64_t(next + 1));
+    SV_CHECK(std::string(data, size) == std::to_string(next) + std::string(40, 'x'));
+    ++next;
+    return true;
+  });
+  SV_CHECK(end == sc_count + 1);
+  SV_CHECK(next == sc_count);
+  std::filesystem::remove_all(path);
+}
+
+// every message pushed reaches the receiver once and in order, and is
+// acknowledged.
+void delivery()
+{
+  constexpr int sc_count = 1000;
+  auto path = temp_path("durable");
+  sink server;
+  {
+    auto sender = durable::basic_tcp_sender<>::make(path);
+    sender->execute(std::string("127.0.0.1"), server.port());
+    for (int i = 0; i < sc_count; ++i)
+    {
+      SV_CHECK(sender->push(*packet::string_packet::make(std::to_string(i), 0)) == std::uint64_t(i + 1));
+    }
+    sender->commit();
+    SV_CHECK(sender->stats().durable == sc_count);
+    SV_CHECK(sv::test::wait_until([&]() { return sender->stats().acknowledged == sc_count; }));
+  }
+  SV_CHECK(in_order(server.values(), sc_count));
+  std::filesystem::remove_all(path);
+}
+
+// messages pushed by a sender that never got to send them go out from the
+// next sender on the same directory; once acknowledged they are not sent
+// again by the one after.
+void resume_after_restart()
+{
+  constexpr int sc_count = 200;
+  auto path = temp_path("durable.restart");
+  sink server;
+  {
+    auto sender = durable::basic_tcp_sender<>::make(path);
+    for (int i = 0; i < sc_count; ++i)
+    {
+      sender->push(*packet::string_packet::make(std::to_string(i), 0));
+    }
+    sender->commit();
+  }
+  SV_CHECK(server.values().empty());
+  {
+    auto sender = durable::basic_tcp_sender<>::make(path);
+    SV_CHECK(sender->stats().pushed == sc_count);
+    SV_CHECK(sender->stats().acknowledged == 0);
+    sender->execute(std::string("127.0.0.1"), server.port());
+    SV_CHECK(sv::test::wait_until([&]() { return sender->stats().acknowledged == sc_count; }));
+  }
+  SV_CHECK(in_order(server.values(), sc_count));
+  {
+    auto sender = durable::basic_tcp_sender<>::make(path);
+    SV_CHECK(sender->stats().acknowledged == sc_count);
+    sender->execute(std::string("127.0.0.1"), server.port());
+    SV_CHECK(sender->push(*packet::string_packet::make(std::to_string(sc_count), 0)) == sc_count + 1);
+    SV_CHECK(sv::test::wait_until([&]() { return sender->stats().acknowledged == sc_count + 1; }));
+  }
+  SV_CHECK(in_order(server.values(), sc_count + 1));
+  std::filesystem::remove_all(path);
+}
+
+// an envelope seen before is acknowledged but not handed on again; plain
+// packets pass through.
+void duplicates_dropped()
+{
+  sink server;
+  std::atomic<std::uint64_t> acked{ 0 };
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr packet)
+    {
+      const char* data = nullptr;
+      std::size_t size = 0;
+      if (packet::view_of<durable::ack>(*packet, data, size))
+        acked = packet::struct_view<durable::ack>(data, size).get<&durable::ack::seq>();
+    });
+    connected.set_value(session);
+  });
+  client->execute(std::string("127.0.0.1"), server.port());
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+
+  auto envelope = [](std::uint64_t _seq, std::string const& _value)
+  {
+    auto message = packet::serialize(*packet::string_packet::make(_value, 0));
+    return packet::struct_packet<durable::envelope>::make(packet::flat_buffer(durable::envelope{ 7, _seq, message }), 0);
+  };
+  session->protocol().send(envelope(1, "0"));
+  session->protocol().send(envelope(2, "1"));
+  session->protocol().send(envelope(1, "0"));
+  session->protocol().send(envelope(2, "1"));
+  session->protocol().send(packet::string_packet::make(std::string("2"), 0));
+  session->protocol().send(envelope(3, "3"));
+  SV_CHECK(sv::test::wait_until([&]() { return server.values().size() == 4 && acked == 3; }));
+  SV_CHECK(in_order(server.values(), 4));
+}
+
+int main()
+{
+  sv::test::run("log_reopen", log_reopen);
+  sv::test::run("delivery", delivery);
+  sv::test::run("resume_after_restart", resume_after_restart);
+  sv::test::run("duplicates_dropped", duplicates_dropped);
+  return sv::test::result();
+}
+
+#else
+
+int main()
+{
+  return 0;
+}
+
+#endif // SV_NET_HAS_WAL
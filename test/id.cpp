@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "sv/base.hpp"
+#include "check.h"
+
+namespace
+{
+
+struct counted : sv::id_holder<counted>
+{
+};
+struct other : sv::id_holder<other>
+{
+};
+
+} // namespace
+
+// ids taken on several threads at once, more than one block each, are all
+// different and none is 0; each thread's rise.
+void unique_across_threads()
+{
+  constexpr int sc_threads = 8;
+  constexpr std::size_t sc_count = 5 * sv::detail::id_allocator<counted>::sc_block + 7;
+  std::vector<std::vector<sv::id_type>> ids(sc_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < sc_threads; ++t)
+  {
+    threads.emplace_back([&ids, t]()
+    {
+      for (std::size_t i = 0; i < sc_count; ++i)
+        ids[t].push_back(counted().id());
+    });
+  }
+  for (auto& e : threads)
+  {
+    e.join();
+  }
+
+  std::vector<sv::id_type> all;
+  for (auto const& e : ids)
+  {
+    SV_CHECK(std::is_sorted(e.begin(), e.end()));
+    all.insert(all.end(), e.begin(), e.end());
+  }
+  std::sort(all.begin(), all.end());
+  SV_CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+  SV_CHECK(all.front() != 0);
+  SV_CHECK(all.size() == sc_threads * sc_count);
+}
+
+// each type counts on its own.
+void per_type()
+{
+  std::thread([]()
+  {
+    SV_CHECK(sv::id_sequence(other().id()) == 1);
+    SV_CHECK(sv::id_sequence(other().id()) == 2);
+  }).join();
+}
+
+// the shard goes into the top bits of every id taken after it is set, and
+// the sequence stays in the rest.
+void shard_bits()
+{
+  sv::set_id_shard(0xBEEF);
+  std::thread([]()
+  {
+    auto id = counted().id();
+    SV_CHECK(sv::id_shard(id) == 0xBEEF);
+    SV_CHECK(sv::id_sequence(id) != 0);
+    SV_CHECK((id >> sv::sc_id_sequence_bits) == 0xBEEF);
+  }).join();
+  sv::set_id_shard(0xFFFF);
+  auto id = counted().id();
+  SV_CHECK(sv::id_shard(id) == 0xFFFF);
+  SV_CHECK(sv::id_sequence(id) <= sv::sc_id_sequence_mask);
+  sv::set_id_shard(0);
+  SV_CHECK(sv::id_shard(counted().id()) == 0);
+}
+
+int main()
+{
+  sv::test::run("unique_across_threads", unique_across_threads);
+  sv::test::run("per_type", per_type);
+  sv::test::run("shard_bits", shard_bits);
+  return sv::test::result();
+}
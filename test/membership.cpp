@@ -0,0 +1,293 @@
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sv/net/membership.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using membership::clock;
+using membership::endpoint_type;
+
+// detectors wired to each other by a queue, on a clock of their own: no
+// sockets and no waiting. a node that is down, or cut off, neither sends nor
+// receives.
+struct simulation
+{
+  struct datagram
+  {
+    std::size_t from;
+    std::size_t to;
+    std::string data;
+  };
+
+  explicit simulation(std::size_t _nodes, membership::options const& _options = membership::options())
+    : m_now(clock::now())
+    , m_up(_nodes, true)
+    , m_cut(_nodes, false)
+  {
+    for (std::size_t i = 0; i < _nodes; ++i)
+    {
+      m_endpoints.emplace_back(boost::asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(20000 + i));
+    }
+    for (std::size_t i = 0; i < _nodes; ++i)
+    {
+      m_nodes.push_back(std::make_unique<membership::detector>(
+        m_endpoints[i], _options,
+        [this, i](endpoint_type const& to, std::string data) { m_queue.push_back({ i, index(to), std::move(data) }); },
+        [](membership::member const&) {}));
+    }
+  }
+
+  std::size_t index(endpoint_type const& _endpoint) const
+  {
+    return static_cast<std::size_t>(_endpoint.port() - 20000);
+  }
+  bool reachable(std::size_t _node) const
+  {
+    return m_up[_node] && !m_cut[_node];
+  }
+  void join_all()
+  {
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      m_nodes[i]->join({ m_endpoints[0] }, m_now);
+    }
+    deliver();
+  }
+  void deliver()
+  {
+    while (!m_queue.empty())
+    {
+      auto d = std::move(m_queue.front());
+      m_queue.pop_front();
+      if (reachable(d.from) && reachable(d.to))
+      {
+        m_nodes[d.to]->receive(m_endpoints[d.from], d.data.data(), d.data.size(), m_now);
+      }
+    }
+  }
+  // steps of 10ms until _done holds or _limit has passed.
+  bool run(clock::duration _limit, std::function<bool()> const& _done)
+  {
+    for (auto end = m_now + _limit; m_now < end; m_now += 10ms)
+    {
+      for (std::size_t i = 0; i < m_nodes.size(); ++i)
+      {
+        if (m_up[i] && m_nodes[i]->next_timeout() <= m_now)
+        {
+          m_nodes[i]->on_timer(m_now);
+        }
+      }
+      deliver();
+      if (_done())
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+  // what _observer holds of _node, nullptr if nothing.
+  membership::member const* view(std::size_t _observer, std::size_t _node, membership::member& _out) const
+  {
+    for (auto const& e : m_nodes[_observer]->members())
+    {
+      if (e.endpoint == m_endpoints[_node])
+      {
+        _out = e;
+        return &_out;
+      }
+    }
+    return nullptr;
+  }
+  // every live node other than _node sees it in _state.
+  bool all_see(std::size_t _node, membership::state _state) const
+  {
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      membership::member m;
+      if (i != _node && m_up[i] && (view(i, _node, m) == nullptr || m.state != _state))
+        return false;
+    }
+    return true;
+  }
+  bool any_sees(std::size_t _node, membership::state _state) const
+  {
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      membership::member m;
+      if (i != _node && m_up[i] && view(i, _node, m) != nullptr && m.state == _state)
+        return true;
+    }
+    return false;
+  }
+  bool converged() const
+  {
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      if (!all_see(i, membership::state::alive))
+        return false;
+    }
+    return true;
+  }
+
+  clock::time_point m_now;
+  std::vector<endpoint_type> m_endpoints;
+  std::vector<std::unique_ptr<membership::detector>> m_nodes;
+  std::deque<datagram> m_queue;
+  std::vector<bool> m_up;
+  std::vector<bool> m_cut;
+};
+
+} // namespace
+
+// nodes joining through one seed learn of each other; a crashed node is
+// suspected and then declared dead by all the others.
+void join_and_detect()
+{
+  constexpr std::size_t sc_nodes = 8;
+  simulation sim(sc_nodes);
+  sim.join_all();
+  SV_CHECK(sim.run(10s, [&]() { return sim.converged(); }));
+  for (std::size_t i = 0; i < sc_nodes; ++i)
+  {
+    SV_CHECK(sim.m_nodes[i]->members().size() == sc_nodes - 1);
+  }
+
+  sim.m_up[5] = false;
+  SV_CHECK(sim.run(30s, [&]() { return sim.all_see(5, membership::state::dead); }));
+  std::uint64_t suspicions = 0;
+  for (std::size_t i = 0; i < sc_nodes; ++i)
+  {
+    suspicions += sim.m_nodes[i]->stats().suspicions;
+  }
+  SV_CHECK(suspicions > 0);
+  // the rest still see each other alive.
+  for (std::size_t i = 0; i < sc_nodes; ++i)
+  {
+    SV_CHECK(i == 5 || sim.all_see(i, membership::state::alive));
+  }
+}
+
+// a node cut off only long enough to be suspected refutes it with a higher
+// incarnation once it is back, and stays a member. while cut off it suspects
+// the others too; gossip can miss a node before its suspicion runs out, and
+// a sync heals that.
+void refute_suspicion()
+{
+  constexpr std::size_t sc_nodes = 5;
+  membership::options options;
+  options.sync_interval = 2s;
+  simulation sim(sc_nodes, options);
+  sim.join_all();
+  SV_CHECK(sim.run(10s, [&]() { return sim.converged(); }));
+  SV_CHECK(sim.m_nodes[2]->incarnation() == 0);
+
+  sim.m_cut[2] = true;
+  SV_CHECK(sim.run(10s, [&]() { return sim.any_sees(2, membership::state::suspect); }));
+  SV_CHECK(!sim.any_sees(2, membership::state::dead));
+  sim.m_cut[2] = false;
+  SV_CHECK(sim.run(30s, [&]() { return sim.converged(); }));
+  SV_CHECK(sim.m_nodes[2]->incarnation() > 0);
+  SV_CHECK(sim.m_nodes[2]->stats().refutations > 0);
+  SV_CHECK(!sim.any_sees(2, membership::state::dead));
+}
+
+// clusters on loopback find each other, and the others see one that stops
+// go dead; on_change reports it.
+void loopback_cluster()
+{
+  constexpr int sc_nodes = 3;
+  membership::options options;
+  options.period = 50ms;
+  options.probe_timeout = 20ms;
+
+  boost::asio::io_context ioc;
+  auto work = boost::asio::make_work_guard(ioc);
+  std::vector<std::unique_ptr<membership::cluster>> nodes;
+  std::mutex mutex;
+  std::vector<membership::member> changes;
+  for (int i = 0; i < sc_nodes; ++i)
+  {
+    nodes.push_back(std::make_unique<membership::cluster>(
+      ioc, endpoint_type(boost::asio::ip::make_address("127.0.0.1"), 0), options));
+  }
+  nodes[0]->on_change([&](membership::member const& m)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.push_back(m);
+  });
+  // local() is gone with a stopped node's socket.
+  std::vector<endpoint_type> endpoints;
+  for (auto const& e : nodes)
+  {
+    endpoints.push_back(e->local());
+  }
+  std::thread runner([&]() { ioc.run(); });
+
+  nodes[0]->start();
+  for (int i = 1; i < sc_nodes; ++i)
+  {
+    nodes[i]->start({ endpoints[0] });
+  }
+  auto sees = [&](int _observer, int _node, membership::state _state)
+  {
+    for (auto const& e : nodes[_observer]->members())
+    {
+      if (e.endpoint == endpoints[_node])
+        return e.state == _state;
+    }
+    return false;
+  };
+  SV_CHECK(sv::test::wait_until([&]()
+  {
+    for (int i = 0; i < sc_nodes; ++i)
+    {
+      for (int j = 0; j < sc_nodes; ++j)
+      {
+        if (i != j && !sees(i, j, membership::state::alive))
+          return false;
+      }
+    }
+    return true;
+  }));
+
+  nodes[2]->stop();
+  SV_CHECK(sv::test::wait_until([&]()
+  {
+    return sees(0, 2, membership::state::dead) && sees(1, 2, membership::state::dead);
+  }));
+  SV_CHECK(sees(0, 1, membership::state::alive));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    bool reported = false;
+    for (auto const& e : changes)
+    {
+      reported = reported || (e.endpoint == endpoints[2] && e.state == membership::state::dead);
+    }
+    SV_CHECK(reported);
+  }
+
+  work.reset();
+  ioc.stop();
+  runner.join();
+  nodes.clear();
+}
+
+int main()
+{
+  sv::test::run("join_and_detect", join_and_detect);
+  sv::test::run("refute_suspicion", refute_suspicion);
+  sv::test::run("loopback_cluster", loopback_cluster);
+  return sv::test::result();
+}
@@ -0,0 +1,186 @@
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sv/net/engine.hpp"
+#include "sv/net/mux.hpp"
+#include "check.h"
+
+using namespace std::chrono_literals;
+
+using sv::net::mux::connection;
+using sv::net::mux::frame_header;
+using sv::net::mux::frame_type;
+using sv::net::mux::stream_id;
+
+namespace
+{
+
+struct peer
+{
+  std::map<stream_id, std::vector<std::string>> delivered;
+  connection conn{ [this](stream_id _stream, std::string _message) { delivered[_stream].push_back(std::move(_message)); } };
+};
+
+// one frame as the wire carries it.
+std::string frame(frame_header const& _header, std::string const& _payload)
+{
+  std::string out(frame_header::sc_size, '\0');
+  _header.write(&out[0]);
+  return out + _payload;
+}
+
+std::string credit(std::uint32_t _credit)
+{
+  std::string out(4, '\0');
+  sv::net::packet::detail::store_le(&out[0], _credit);
+  return out;
+}
+
+// feeds every frame _from produces to _to; false if _to rejected one.
+bool pump(peer& _from, peer& _to)
+{
+  std::string wire;
+  while (_from.conn.produce(wire, 64 * 1024))
+  {
+    std::size_t at = 0;
+    while (at < wire.size())
+    {
+      auto header = frame_header::read(wire.data() + at);
+      if (!connection::valid(header) || !_to.conn.receive(header, wire.data() + at + frame_header::sc_size))
+      {
+        return false;
+      }
+      at += frame_header::sc_size + header.length;
+    }
+    wire.clear();
+  }
+  return true;
+}
+
+} // namespace
+
+// a bulk message and small ones on other streams all arrive, and the streams
+// are forgotten on both sides once the credit is back.
+void transfer()
+{
+  peer a, b;
+  std::string bulk(3 * connection::sc_connection_window, 'b');
+  a.conn.send(1, bulk);
+  for (stream_id id = 2; id < 100; ++id)
+  {
+    a.conn.send(id, "small");
+  }
+  for (int round = 0; round < 100 && (a.conn.pending() || b.conn.pending()); ++round)
+  {
+    SV_CHECK(pump(a, b));
+    SV_CHECK(pump(b, a));
+  }
+  SV_CHECK(b.delivered[1].size() == 1 && b.delivered[1][0] == bulk);
+  SV_CHECK(b.delivered[50].size() == 1 && b.delivered[50][0] == "small");
+  SV_CHECK(a.conn.streams() == 0);
+  SV_CHECK(b.conn.streams() == 0);
+}
+
+void invalid_frames()
+{
+  SV_CHECK(!connection::valid({ 1, frame_type::data, 0, std::uint32_t(connection::sc_max_frame + 1) }));
+  SV_CHECK(!connection::valid({ 1, frame_type::window_update, 0, 3 }));
+  SV_CHECK(!connection::valid({ 1, frame_type::window_update, 0, 8 }));
+  SV_CHECK(!connection::valid({ frame_header::sc_connection, frame_type::data, 0, 1 }));
+  SV_CHECK(!connection::valid({ 1, static_cast<frame_type>(7), 0, 0 }));
+  SV_CHECK(connection::valid({ 1, frame_type::data, 0, std::uint32_t(connection::sc_max_frame) }));
+}
+
+// a peer that ignores flow control or hands out absurd credit is an error.
+void misbehaving_peer()
+{
+  std::string full(connection::sc_max_frame, 'x');
+  {
+    peer b;
+    bool ok = true;
+    std::uint32_t sent = 0;
+    while (ok && sent <= connection::sc_stream_window)
+    {
+      ok = b.conn.receive({ 1, frame_type::data, 0, std::uint32_t(full.size()) }, full.data());
+      sent += std::uint32_t(full.size());
+    }
+    SV_CHECK(!ok && sent == connection::sc_stream_window + full.size());
+  }
+  {
+    peer b;
+    bool ok = true;
+    std::uint32_t sent = 0;
+    for (stream_id id = 1; ok && sent <= connection::sc_connection_window; ++id)
+    {
+      ok = b.conn.receive({ id, frame_type::data, 0, std::uint32_t(full.size()) }, full.data());
+      sent += std::uint32_t(full.size());
+    }
+    SV_CHECK(!ok && sent == connection::sc_connection_window + full.size());
+  }
+  {
+    peer b;
+    bool ok = true;
+    stream_id id = 0;
+    for (; ok && id <= connection::sc_max_streams; ++id)
+    {
+      ok = b.conn.receive({ id, frame_type::data, 0, 1 }, "x");
+    }
+    SV_CHECK(!ok && id == connection::sc_max_streams + 1);
+  }
+  {
+    peer a;
+    auto huge = credit(connection::sc_max_credit);
+    SV_CHECK(!a.conn.receive({ frame_header::sc_connection, frame_type::window_update, 0, 4 }, huge.data()));
+    a.conn.send(1, "x");
+    std::string wire;
+    a.conn.produce(wire, 1024);
+    auto one = credit(1);
+    SV_CHECK(a.conn.receive({ 1, frame_type::window_update, 0, 4 }, one.data()));
+    SV_CHECK(!a.conn.receive({ 1, frame_type::window_update, 0, 4 }, huge.data()));
+    SV_CHECK(!a.conn.receive({ 9, frame_type::window_update, 0, 4 }, one.data()));
+  }
+}
+
+// well-formed frames carrying a message that is not a packet end the
+// session with bad_message, as a bad packet does on a plain session.
+void undecodable_message()
+{
+  namespace asio = boost::asio;
+  std::atomic<int> bad_message{ 0 };
+  std::atomic<int> received{ 0 };
+
+  auto server = sv::net::engine::basic_tcp_server<sv::net::protocol::mux_basic>::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](sv::net::packet::base::ptr const&) { ++received; });
+    session->protocol().on_close([&](boost::system::error_code const& ec)
+    {
+      if (ec == boost::system::errc::bad_message)
+        ++bad_message;
+    });
+  });
+  server->execute(0);
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket peer(ioc);
+  peer.connect({ asio::ip::address_v4::loopback(), server->local_endpoint().port() });
+  std::string junk = "not a packet";
+  asio::write(peer, asio::buffer(frame({ 1, frame_type::data, frame_header::sc_end, std::uint32_t(junk.size()) }, junk)));
+  SV_CHECK(sv::test::wait_until([&]() { return bad_message == 1; }));
+  SV_CHECK(received == 0);
+  SV_CHECK(server->shutdown(1s));
+}
+
+int main()
+{
+  sv::test::run("transfer", transfer);
+  sv::test::run("invalid_frames", invalid_frames);
+  sv::test::run("misbehaving_peer", misbehaving_peer);
+  sv::test::run("undecodable_message", undecodable_message);
+  return sv::test::result();
+}
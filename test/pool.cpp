@@ -0,0 +1,164 @@
+#include <atomic>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+using protocol::detail::buffer;
+using protocol::detail::fifo;
+using protocol::detail::pool;
+
+// a released buffer is the next one taken of its size class on the thread;
+// a smaller reserve keeps the bytes it has.
+void buffer_reuse()
+{
+  char* first = nullptr;
+  {
+    buffer b;
+    SV_CHECK(b.data() == nullptr);
+    b.reserve(300);
+    first = b.data();
+    SV_CHECK(first != nullptr);
+    b.reserve(512);
+    SV_CHECK(b.data() == first);
+    b.reserve(100);
+    SV_CHECK(b.data() == first);
+  }
+  buffer again;
+  again.reserve(400);
+  SV_CHECK(again.data() == first);
+  buffer other_class;
+  other_class.reserve(1024);
+  SV_CHECK(other_class.data() != first);
+
+  // another thread has a pool of its own.
+  again.release();
+  char* elsewhere = nullptr;
+  std::thread([&elsewhere]()
+  {
+    buffer b;
+    b.reserve(400);
+    elsewhere = b.data();
+  }).join();
+  SV_CHECK(elsewhere != first);
+  again.reserve(400);
+  SV_CHECK(again.data() == first);
+}
+
+// a size class keeps at most sc_kept free buffers.
+void kept_per_class()
+{
+  constexpr std::size_t sc_count = pool::sc_kept + 4;
+  std::set<char*> released;
+  {
+    std::vector<std::unique_ptr<buffer>> buffers;
+    for (std::size_t i = 0; i < sc_count; ++i)
+    {
+      buffers.push_back(std::make_unique<buffer>());
+      buffers.back()->reserve(2048);
+      released.insert(buffers.back()->data());
+    }
+  }
+  std::vector<std::unique_ptr<buffer>> buffers;
+  std::size_t reused = 0;
+  for (std::size_t i = 0; i < pool::sc_kept; ++i)
+  {
+    buffers.push_back(std::make_unique<buffer>());
+    buffers.back()->reserve(2048);
+    reused += released.count(buffers.back()->data());
+  }
+  SV_CHECK(reused == pool::sc_kept);
+}
+
+// first in, first out, across compaction and draining; popped items are let
+// go at once.
+void fifo_order()
+{
+  fifo<std::shared_ptr<int>> queue;
+  SV_CHECK(queue.empty());
+  int next_in = 0;
+  int next_out = 0;
+  bool ordered = true;
+  for (int round = 0; round < 3; ++round)
+  {
+    for (int i = 0; i < 100; ++i)
+      queue.push_back(std::make_shared<int>(next_in++));
+    for (int i = 0; i < 60; ++i)
+    {
+      ordered = ordered && *queue.front() == next_out++;
+      queue.pop_front();
+    }
+  }
+  SV_CHECK(queue.size() == std::size_t(next_in - next_out));
+  while (!queue.empty())
+  {
+    ordered = ordered && *queue.front() == next_out++;
+    queue.pop_front();
+  }
+  SV_CHECK(ordered);
+  SV_CHECK(next_out == next_in);
+
+  auto item = std::make_shared<int>(7);
+  queue.push_back(item);
+  queue.push_back(std::make_shared<int>(8));
+  SV_CHECK(item.use_count() == 2);
+  queue.pop_front();
+  SV_CHECK(item.use_count() == 1);
+  SV_CHECK(*queue.front() == 8);
+}
+
+// packets of every size, from empty to past the largest pooled buffer, come
+// back from an echo as they went out: no bytes of an earlier, larger one
+// show through a reused buffer.
+void echo_sizes()
+{
+  std::size_t const sizes[] = { 0, 70000, 1, 300, 255, 65536, 100, 200000, 3, 4096, 64 * 1024 - 21, 10 };
+  auto body = [&](std::size_t i) { return std::string(sizes[i % std::size(sizes)], char('a' + i % 26)); };
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  server->on_session([](auto const& session)
+  {
+    auto* raw = session.get();
+    session->protocol().on_receive([raw](packet::base::ptr packet) { raw->protocol().send(packet); });
+  });
+  server->execute(0);
+
+  std::atomic<std::size_t> next{ 0 };
+  std::atomic<int> wrong{ 0 };
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr packet)
+    {
+      if (static_cast<packet::string_packet&>(*packet).get_value() != body(next++))
+        ++wrong;
+    });
+    connected.set_value(session);
+  });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+  auto session = connected.get_future().get();
+  constexpr std::size_t sc_rounds = 5;
+  for (std::size_t i = 0; i < sc_rounds * std::size(sizes); ++i)
+  {
+    session->protocol().send(packet::string_packet::make(body(i), 0));
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return next == sc_rounds * std::size(sizes); }));
+  SV_CHECK(wrong == 0);
+  SV_CHECK(server->shutdown(1s));
+}
+
+int main()
+{
+  sv::test::run("buffer_reuse", buffer_reuse);
+  sv::test::run("kept_per_class", kept_per_class);
+  sv::test::run("fifo_order", fifo_order);
+  sv::test::run("echo_sizes", echo_sizes);
+  return sv::test::result();
+}
@@ -0,0 +1,214 @@
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sv/net/engine.hpp"
+#include "sv/net/proxy.hpp"
+#include "check.h"
+
+#if defined(SV_NET_HAS_PROXY)
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using server_type = engine::basic_tcp_server<protocol::basic>;
+using client_type = engine::basic_tcp_client<protocol::basic>;
+using session_type = engine::basic_session<protocol::basic, transport::tcp>;
+
+// bodies over this go to the second backend.
+constexpr std::uint64_t sc_large = 64 * 1024;
+
+std::string value_of(packet::base::ptr const& _packet)
+{
+  return static_cast<packet::string_packet&>(*_packet).get_value();
+}
+
+// a server that keeps what it receives and answers each packet with its
+// name in front of it.
+struct backend
+{
+  explicit backend(std::string const& _name)
+    : m_server(server_type::make())
+  {
+    engine::accept_policy policy;
+    policy.trace = false;
+    m_server->set_accept_policy(policy);
+    m_server->on_session([this, _name](auto const& session)
+    {
+      auto* raw = session.get();
+      session->protocol().on_receive([this, raw, _name](packet::base::ptr packet)
+      {
+        auto value = value_of(packet);
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_values.push_back(value);
+        }
+        raw->protocol().send(packet::string_packet::make(_name + value, raw->id()));
+      });
+    });
+    m_server->execute(0);
+  }
+  ~backend()
+  {
+    m_server->shutdown(1s);
+  }
+
+  unsigned short port() const
+  {
+    return m_server->local_endpoint().port();
+  }
+  std::vector<std::string> values()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_values;
+  }
+
+  std::mutex m_mutex;
+  std::vector<std::string> m_values;
+  server_type::ptr m_server;
+};
+
+std::string message(int _i)
+{
+  auto value = std::to_string(_i);
+  return _i % 5 == 4 ? value + std::string(1024 * 1024, 'x') : value;
+}
+
+} // namespace
+
+// packets go to the backend the route picks, whole and in order, and the
+// replies of both backends come back over the one client connection.
+void route_and_reply()
+{
+  constexpr int sc_count = 100;
+  backend small("a:");
+  backend large("b:");
+
+  proxy::tcp_relay relay;
+  relay.add_backend(std::string("127.0.0.1"), small.port());
+  relay.add_backend(std::string("127.0.0.1"), large.port());
+  relay.set_route([](packet::header const& _header) -> std::size_t { return _header.length > sc_large ? 1 : 0; });
+  relay.execute(0);
+
+  std::mutex mutex;
+  std::vector<std::string> replies;
+  auto client = client_type::make();
+  std::promise<session_type::ptr> connected;
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr packet)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      replies.push_back(value_of(packet));
+    });
+    connected.set_value(session);
+  });
+  client->execute(std::string("127.0.0.1"), relay.local_endpoint().port());
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+  for (int i = 0; i < sc_count; ++i)
+  {
+    session->protocol().send(packet::string_packet::make(message(i), 0));
+  }
+  SV_CHECK(sv::test::wait_until([&]()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replies.size() == std::size_t(sc_count);
+  }));
+
+  std::vector<std::string> expected[2];
+  for (int i = 0; i < sc_count; ++i)
+  {
+    expected[i % 5 == 4].push_back(message(i));
+  }
+  SV_CHECK(small.values() == expected[0]);
+  SV_CHECK(large.values() == expected[1]);
+
+  // each backend's replies in order, whatever the interleaving.
+  std::size_t next[2] = { 0, 0 };
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto const& e : replies)
+    {
+      int which = e.compare(0, 2, "b:") == 0;
+      SV_CHECK(next[which] < expected[which].size() && e.substr(2) == expected[which][next[which]]);
+      ++next[which];
+    }
+  }
+  auto stats = relay.stats();
+  SV_CHECK(stats.links == 1);
+  SV_CHECK(stats.packets == 2 * sc_count);
+  SV_CHECK(stats.bytes > 2 * (sc_count / 5) * 1024 * 1024);
+}
+
+// a route out of range closes that link only; the relay takes the next.
+void bad_route()
+{
+  backend only("a:");
+  proxy::tcp_relay relay;
+  relay.add_backend(std::string("127.0.0.1"), only.port());
+  relay.set_route([](packet::header const& _header) -> std::size_t { return _header.length > sc_large ? 7 : 0; });
+  relay.execute(0);
+
+  std::atomic<int> closed{ 0 };
+  std::atomic<int> replies{ 0 };
+  std::mutex mutex;
+  std::vector<session_type::ptr> sessions;
+  auto client = client_type::make();
+  client->set_reconnect(10ms);
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr const&) { ++replies; });
+    session->protocol().on_close([&](boost::system::error_code const&) { ++closed; });
+    std::lock_guard<std::mutex> lock(mutex);
+    sessions.push_back(session);
+  });
+  client->execute(std::string("127.0.0.1"), relay.local_endpoint().port());
+  auto first = [&]()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sessions.empty() ? nullptr : sessions.front();
+  };
+  SV_CHECK(sv::test::wait_until([&]() { return first() != nullptr; }));
+  auto session = first();
+  session->protocol().send(packet::string_packet::make(message(0), 0));
+  SV_CHECK(sv::test::wait_until([&]() { return replies == 1; }));
+  session->protocol().send(packet::string_packet::make(message(4), 0));
+  SV_CHECK(sv::test::wait_until([&]() { return closed == 1; }));
+
+  SV_CHECK(sv::test::wait_until([&]()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sessions.size() == 2;
+  }));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    session = sessions.back();
+  }
+  session->protocol().send(packet::string_packet::make(message(1), 0));
+  SV_CHECK(sv::test::wait_until([&]() { return replies == 2; }));
+  SV_CHECK(relay.stats().links == 2);
+  SV_CHECK(only.values() == std::vector<std::string>({ message(0), message(1) }));
+}
+
+int main()
+{
+  sv::test::run("route_and_reply", route_and_reply);
+  sv::test::run("bad_route", bad_route);
+  return sv::test::result();
+}
+
+#else
+
+int main()
+{
+  return 0;
+}
+
+#endif // SV_NET_HAS_PROXY
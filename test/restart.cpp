@@ -0,0 +1,158 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+namespace asio = boost::asio;
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+using server_type = engine::basic_tcp_server<protocol::basic>;
+using session_type = engine::basic_session<protocol::basic, transport::tcp>;
+
+namespace
+{
+
+// every session is sent _count packets of _size bytes as soon as it starts.
+server_type::ptr backlog_server(std::size_t _count, std::size_t _size, std::atomic<int>* _sessions = nullptr)
+{
+  auto server = server_type::make();
+  server->on_session([=](session_type::ptr const& session)
+  {
+    if (_sessions != nullptr)
+      ++*_sessions;
+    for (std::size_t i = 0; i < _count; ++i)
+      session->protocol().send(packet::string_packet::make(std::string(_size, 'x'), session->id()));
+  });
+  return server;
+}
+
+std::size_t backlog_bytes(std::size_t _count, std::size_t _size)
+{
+  return _count * packet::string_packet::make(std::string(_size, 'x'), 0)->get_header().length;
+}
+
+// reads until the server ends the connection; the bytes read.
+std::size_t read_to_end(asio::ip::tcp::socket& _socket)
+{
+  std::size_t total = 0;
+  char buffer[16 * 1024];
+  boost::system::error_code ec;
+  while (!ec)
+  {
+    total += _socket.read_some(asio::buffer(buffer), ec);
+  }
+  return total;
+}
+
+asio::ip::tcp::endpoint loopback(unsigned short _port)
+{
+  return asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), _port);
+}
+
+} // namespace
+
+// shutdown lets a session write its whole backlog before it ends it, and
+// refuses new connections meanwhile.
+void drain_flushes()
+{
+  constexpr std::size_t sc_count = 32;
+  constexpr std::size_t sc_size = 64 * 1024;
+  std::atomic<int> sessions{ 0 };
+  auto server = backlog_server(sc_count, sc_size, &sessions);
+  server->execute(0);
+  auto port = server->local_endpoint().port();
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket client(ioc);
+  client.connect(loopback(port));
+  SV_CHECK(sv::test::wait_until([&]() { return sessions == 1; }));
+  auto read = std::async(std::launch::async, [&]() { return read_to_end(client); });
+  SV_CHECK(server->shutdown(5s));
+  SV_CHECK(read.get() == backlog_bytes(sc_count, sc_size));
+
+  asio::ip::tcp::socket late(ioc);
+  boost::system::error_code ec;
+  late.connect(loopback(port), ec);
+  SV_CHECK(!!ec);
+}
+
+// a session whose peer does not read is cut off at the deadline.
+void drain_deadline()
+{
+  auto server = backlog_server(64, 256 * 1024);
+  server->execute(0);
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket client(ioc);
+  client.connect(loopback(server->local_endpoint().port()));
+  std::this_thread::sleep_for(100ms);
+  auto begin = std::chrono::steady_clock::now();
+  SV_CHECK(!server->shutdown(200ms));
+  SV_CHECK(std::chrono::steady_clock::now() - begin < 3s);
+  SV_CHECK(read_to_end(client) < backlog_bytes(64, 256 * 1024));
+}
+
+// the listener moves to a successor: a client of the old server still gets
+// its backlog, and one connecting after the hand-off is the successor's.
+void hand_off()
+{
+  constexpr std::size_t sc_count = 16;
+  constexpr std::size_t sc_size = 64 * 1024;
+  auto path = "/tmp/sv.net.test.handoff." + std::to_string(::getpid());
+  std::atomic<int> old_sessions{ 0 };
+  std::atomic<int> new_sessions{ 0 };
+  auto old_server = backlog_server(sc_count, sc_size, &old_sessions);
+  old_server->execute(0);
+  auto port = old_server->local_endpoint().port();
+  auto new_server = backlog_server(sc_count, sc_size, &new_sessions);
+  auto successor = std::async(std::launch::async, [&]() { new_server->take_over(path); });
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket before(ioc);
+  before.connect(loopback(port));
+  SV_CHECK(sv::test::wait_until([&]() { return old_sessions == 1; }));
+  auto read_before = std::async(std::launch::async, [&]() { return read_to_end(before); });
+
+  // the successor may not be listening on path yet.
+  bool handed = false;
+  for (int i = 0; i < 100 && !handed; ++i)
+  {
+    try
+    {
+      SV_CHECK(old_server->hand_off(path, 5s));
+      handed = true;
+    }
+    catch (std::exception const&)
+    {
+      std::this_thread::sleep_for(20ms);
+    }
+  }
+  SV_CHECK(handed);
+  successor.get();
+
+  asio::ip::tcp::socket after(ioc);
+  after.connect(loopback(port));
+  SV_CHECK(sv::test::wait_until([&]() { return new_sessions == 1; }));
+  auto read_after = std::async(std::launch::async, [&]() { return read_to_end(after); });
+  SV_CHECK(read_before.get() == backlog_bytes(sc_count, sc_size));
+  SV_CHECK(old_sessions == 1);
+
+  SV_CHECK(new_server->shutdown(5s));
+  SV_CHECK(read_after.get() == backlog_bytes(sc_count, sc_size));
+  std::remove(path.c_str());
+}
+
+int main()
+{
+  sv::test::run("drain_flushes", drain_flushes);
+  sv::test::run("drain_deadline", drain_deadline);
+  sv::test::run("hand_off", hand_off);
+  return sv::test::result();
+}
@@ -0,0 +1,200 @@
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sv/net/resume.hpp"
+#include "check.h"
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+using error_code = boost::system::error_code;
+using namespace sv::net;
+
+namespace
+{
+
+// a tcp relay in front of the server; cut() drops every connection through
+// it, as a lost network would.
+class relay
+{
+public:
+  explicit relay(unsigned short _target)
+    : m_acceptor(m_ioc, { asio::ip::address_v4::loopback(), 0 })
+    , m_target(asio::ip::address_v4::loopback(), _target)
+  {
+    do_accept();
+    m_thread = std::thread([this]() { m_ioc.run(); });
+  }
+  ~relay()
+  {
+    m_ioc.stop();
+    m_thread.join();
+  }
+  unsigned short port() const
+  {
+    return m_acceptor.local_endpoint().port();
+  }
+  void cut()
+  {
+    asio::post(m_ioc, [this]()
+    {
+      for (auto& e : m_links)
+      {
+        e->close();
+      }
+      m_links.clear();
+    });
+  }
+
+private:
+  struct link
+  {
+    explicit link(asio::io_context& _ioc)
+      : client(_ioc)
+      , server(_ioc)
+    {
+    }
+    void close()
+    {
+      error_code ec;
+      client.close(ec);
+      server.close(ec);
+    }
+    tcp::socket client;
+    tcp::socket server;
+    std::array<char, 16 * 1024> up;
+    std::array<char, 16 * 1024> down;
+  };
+
+  void do_accept()
+  {
+    auto l = std::make_shared<link>(m_ioc);
+    m_acceptor.async_accept(l->client, [this, l](error_code const& ec)
+    {
+      if (!!ec)
+      {
+        return;
+      }
+      error_code connect_ec;
+      l->server.connect(m_target, connect_ec);
+      if (!connect_ec)
+      {
+        m_links.push_back(l);
+        pump(l, l->client, l->server, l->up);
+        pump(l, l->server, l->client, l->down);
+      }
+      do_accept();
+    });
+  }
+  void pump(std::shared_ptr<link> _link, tcp::socket& _from, tcp::socket& _to, std::array<char, 16 * 1024>& _buffer)
+  {
+    _from.async_read_some(asio::buffer(_buffer), [=, &_from, &_to, &_buffer](error_code const& ec, std::size_t bytes)
+    {
+      if (!!ec)
+      {
+        _link->close();
+        return;
+      }
+      asio::async_write(_to, asio::buffer(_buffer.data(), bytes), [=, &_from, &_to, &_buffer](error_code const& ec, std::size_t)
+      {
+        if (!!ec)
+        {
+          _link->close();
+          return;
+        }
+        pump(_link, _from, _to, _buffer);
+      });
+    });
+  }
+
+  asio::io_context m_ioc;
+  tcp::acceptor m_acceptor;
+  tcp::endpoint m_target;
+  std::vector<std::shared_ptr<link>> m_links;
+  std::thread m_thread;
+};
+
+int number(packet::base::ptr const& _packet)
+{
+  return std::stoi(static_cast<packet::string_packet&>(*_packet).get_value());
+}
+
+} // namespace
+
+// the client sends numbered messages and the server echoes them while the
+// connection is cut again and again: both sides get every message once, in
+// order, on the one channel.
+void dropped_connections()
+{
+  using server_type = resume::basic_tcp_server<>;
+  using client_type = resume::basic_tcp_client<>;
+  constexpr int sc_messages = 5000;
+
+  resume::options options;
+  options.retransmit_limit = sc_messages;
+  options.reconnect = std::chrono::milliseconds(10);
+
+  std::atomic<int> server_next{ 0 };
+  std::atomic<int> client_next{ 0 };
+  std::atomic<int> out_of_order{ 0 };
+  std::atomic<int> channels{ 0 };
+  std::atomic<int> closed{ 0 };
+
+  server_type server(options);
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server.server().set_accept_policy(policy);
+  server_type::channel_type::ptr channel;
+  server.on_channel([&](server_type::channel_type::ptr const& _channel)
+  {
+    ++channels;
+    channel = _channel;
+    auto* raw = _channel.get();
+    _channel->on_receive([&, raw](packet::base::ptr packet)
+    {
+      auto n = number(packet);
+      out_of_order += (n != server_next);
+      server_next = n + 1;
+      raw->send(packet::string_packet::make(std::to_string(n), 0));
+    });
+  });
+  server.execute(0);
+  relay link(server.server().local_endpoint().port());
+
+  client_type client(options);
+  client.channel().on_receive([&](packet::base::ptr packet)
+  {
+    auto n = number(packet);
+    out_of_order += (n != client_next);
+    client_next = n + 1;
+  });
+  client.channel().on_close([&]() { ++closed; });
+  client.execute(std::string("127.0.0.1"), link.port());
+
+  for (int i = 0; i < sc_messages; ++i)
+  {
+    client.channel().send(packet::string_packet::make(std::to_string(i), 0));
+    if (i % 1000 == 500)
+    {
+      SV_CHECK(sv::test::wait_until([&]() { return client_next > i - 100; }));
+      link.cut();
+    }
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return client_next == sc_messages; }, std::chrono::seconds(30)));
+
+  SV_CHECK(out_of_order == 0);
+  SV_CHECK(server_next == sc_messages);
+  SV_CHECK(client_next == sc_messages);
+  SV_CHECK(channels == 1);
+  SV_CHECK(closed == 0);
+  SV_CHECK(client.channel().stats().resumed >= 5);
+}
+
+int main()
+{
+  sv::test::run("dropped_connections", dropped_connections);
+  return sv::test::result();
+}
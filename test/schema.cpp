@@ -0,0 +1,207 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace test_schema
+{
+
+enum class kind : std::uint16_t
+{
+  ship = 7,
+  port = 9,
+};
+
+struct position
+{
+  std::int32_t x;
+  std::uint64_t when;
+  kind what;
+  std::string name;
+};
+
+struct other
+{
+  std::int32_t x;
+};
+
+// other's id taken by a second type.
+struct clash
+{
+  std::int32_t y;
+};
+
+} // namespace test_schema
+
+SV_NET_SCHEMA(test_schema::position, 0x7E01, &test_schema::position::x, &test_schema::position::when,
+              &test_schema::position::what, &test_schema::position::name)
+SV_NET_SCHEMA(test_schema::other, 0x7E02, &test_schema::other::x)
+SV_NET_SCHEMA(test_schema::clash, 0x7E02, &test_schema::clash::y)
+
+using test_schema::position;
+
+namespace
+{
+
+position sample()
+{
+  return position{ -42, 1234567890123ULL, test_schema::kind::port, "harbour" };
+}
+
+bool same(packet::struct_view<position> const& _view, position const& _value)
+{
+  return _view.get<&position::x>() == _value.x && _view.get<&position::when>() == _value.when
+         && _view.get<&position::what>() == _value.what && _view.get<&position::name>() == _value.name;
+}
+
+} // namespace
+
+// a packet built here is viewed as it is, and again after a round trip
+// through the wire format; it is not viewed as another schema.
+void encode_and_view()
+{
+  auto value = sample();
+  auto built = packet::struct_packet<position>::make(packet::flat_buffer(value), 0);
+  SV_CHECK(packet::is_struct_of<position>(built->get_header()));
+
+  const char* data = nullptr;
+  std::size_t size = 0;
+  SV_CHECK(packet::view_of<position>(*built, data, size));
+  SV_CHECK(size == built->get_body_size());
+  SV_CHECK(same(packet::struct_view<position>(data, size), value));
+  SV_CHECK(!packet::view_of<test_schema::other>(*built, data, size));
+
+  auto bytes = packet::serialize(*built);
+  auto received = packet::deserialize(0, bytes.data(), bytes.size());
+  SV_CHECK(received != nullptr);
+  SV_CHECK(packet::view_of<position>(*received, data, size));
+  SV_CHECK(same(packet::struct_view<position>(data, size), value));
+
+  // the same bytes shared as an encoded packet.
+  auto encoded = packet::encoded_packet::make(std::make_shared<const std::string>(bytes), 0);
+  SV_CHECK(packet::view_of<position>(*encoded, data, size));
+  SV_CHECK(same(packet::struct_view<position>(data, size), value));
+
+  auto text = packet::string_packet::make(std::string("harbour"), 0);
+  SV_CHECK(!packet::view_of<position>(*text, data, size));
+}
+
+// a body shorter than the fixed table, or a string slot reaching past the
+// end, is not a valid view.
+void invalid_views()
+{
+  packet::flat_buffer body(sample());
+  auto const& bytes = body.bytes();
+  constexpr auto sc_table = packet::struct_view<position>::sc_table_size;
+
+  SV_CHECK(packet::struct_view<position>(bytes.data(), bytes.size()).valid());
+  SV_CHECK(!packet::struct_view<position>(bytes.data(), sc_table - 1).valid());
+  SV_CHECK(!packet::struct_view<position>(nullptr, 0).valid());
+  // the name's bytes are the last ones.
+  SV_CHECK(!packet::struct_view<position>(bytes.data(), bytes.size() - 1).valid());
+
+  auto message = packet::serialize(*packet::struct_packet<position>::make(body, 0));
+  constexpr auto sc_name = packet::detail::field_offset<position, 3>();
+  packet::detail::store_le(&message[sizeof(packet::header) + sc_name], std::uint32_t(0xfffffff0));
+  auto received = packet::deserialize(0, message.data(), message.size());
+  SV_CHECK(received != nullptr);
+  const char* data = nullptr;
+  std::size_t size = 0;
+  SV_CHECK(!packet::view_of<position>(*received, data, size));
+}
+
+// the second type to use an id is refused, whether encoded or viewed.
+void colliding_ids()
+{
+  SV_CHECK(packet::schema_id<test_schema::other>() == 0x7E02);
+  bool refused = false;
+  try
+  {
+    packet::flat_buffer body(test_schema::clash{ 1 });
+  }
+  catch (std::logic_error const&)
+  {
+    refused = true;
+  }
+  SV_CHECK(refused);
+
+  refused = false;
+  try
+  {
+    packet::header h{};
+    packet::is_struct_of<test_schema::clash>(h);
+  }
+  catch (std::logic_error const&)
+  {
+    refused = true;
+  }
+  SV_CHECK(refused);
+  SV_CHECK(packet::schema_id<test_schema::other>() == 0x7E02);
+}
+
+// struct bodies are read off the socket into the packet; with a checksum
+// and a trace context in front of the body, too.
+void read_in_place()
+{
+  constexpr int sc_count = 100;
+  std::atomic<int> viewed{ 0 };
+  std::atomic<int> wrong{ 0 };
+
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&](auto const& session)
+  {
+    session->protocol().on_receive([&](packet::base::ptr packet)
+    {
+      const char* data = nullptr;
+      std::size_t size = 0;
+      auto value = sample();
+      value.x = viewed;
+      if (!packet::view_of<position>(*packet, data, size) || !same(packet::struct_view<position>(data, size), value))
+        ++wrong;
+      ++viewed;
+    });
+  });
+  server->execute(0);
+
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session) { connected.set_value(session); });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+  for (int i = 0; i < sc_count; ++i)
+  {
+    auto value = sample();
+    value.x = i;
+    auto p = packet::struct_packet<position>::make(packet::flat_buffer(value), 0);
+    if (i % 2 == 1)
+      p->set_checksum();
+    if (i % 3 == 1)
+      p->set_trace(packet::trace_context{});
+    session->protocol().send(p);
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return viewed == sc_count; }));
+  SV_CHECK(wrong == 0);
+  SV_CHECK(server->shutdown(1s));
+}
+
+int main()
+{
+  sv::test::run("encode_and_view", encode_and_view);
+  sv::test::run("invalid_views", invalid_views);
+  sv::test::run("colliding_ids", colliding_ids);
+  sv::test::run("read_in_place", read_in_place);
+  return sv::test::result();
+}
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+namespace asio = boost::asio;
+using namespace std::chrono_literals;
+
+using session_type = sv::net::engine::basic_session<sv::net::protocol::basic, sv::net::transport::tcp>;
+using server_type = sv::net::engine::basic_tcp_server<sv::net::protocol::basic>;
+
+// the peer reads a little, half-closes and stops reading. the server sees end
+// of stream while its writes are still pending on a full socket; the session
+// must outlive them and then go away.
+void half_closing_peer()
+{
+  constexpr int sc_peers = 20;
+
+  std::mutex mutex;
+  std::vector<std::weak_ptr<session_type>> sessions;
+  std::atomic<int> closed{ 0 };
+
+  auto server = server_type::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&](session_type::ptr const& session)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      sessions.push_back(session);
+    }
+    session->protocol().on_close([&](boost::system::error_code const&) { ++closed; });
+    for (int i = 0; i < 64; ++i)
+    {
+      session->protocol().send(sv::net::packet::string_packet::make(std::string(256 * 1024, 'x'), session->id()));
+    }
+  });
+  server->execute(0);
+  auto port = server->local_endpoint().port();
+
+  asio::io_context ioc;
+  std::vector<std::unique_ptr<asio::ip::tcp::socket>> peers;
+  for (int i = 0; i < sc_peers; ++i)
+  {
+    peers.push_back(std::make_unique<asio::ip::tcp::socket>(ioc));
+    peers.back()->connect({ asio::ip::address_v4::loopback(), port });
+    char data[4096];
+    asio::read(*peers.back(), asio::buffer(data));
+    peers.back()->shutdown(asio::socket_base::shutdown_send);
+  }
+
+  SV_CHECK(sv::test::wait_until([&]() { return closed == sc_peers; }));
+  peers.clear();
+  SV_CHECK(sv::test::wait_until([&]()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& e : sessions)
+    {
+      if (!e.expired())
+        return false;
+    }
+    return true;
+  }));
+  SV_CHECK(server->shutdown(1s));
+}
+
+// a header whose length is far over packet::base::sc_max_length ends the
+// session with bad_message before anything is allocated for the body, and
+// the server goes on serving other peers.
+void oversized_length()
+{
+  std::atomic<int> bad_message{ 0 };
+  std::atomic<int> received{ 0 };
+
+  auto server = server_type::make();
+  sv::net::engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->on_session([&](session_type::ptr const& session)
+  {
+    session->protocol().on_receive([&](sv::net::packet::base::ptr const&) { ++received; });
+    session->protocol().on_close([&](boost::system::error_code const& ec)
+    {
+      if (ec == boost::system::errc::bad_message)
+        ++bad_message;
+    });
+  });
+  server->execute(0);
+  asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), server->local_endpoint().port());
+
+  auto message = sv::net::packet::serialize(*sv::net::packet::string_packet::make(std::string("hello"), 0));
+  for (std::uint64_t length : { std::uint64_t(1) << 62, sv::net::packet::base::sc_max_length + 1 })
+  {
+    auto bad = message.substr(0, sv::net::packet::base::sc_header_size);
+    std::memcpy(&bad[offsetof(sv::net::packet::header, length)], &length, sizeof(length));
+
+    asio::io_context ioc;
+    asio::ip::tcp::socket peer(ioc);
+    peer.connect(endpoint);
+    asio::write(peer, asio::buffer(bad));
+    char data[1];
+    boost::system::error_code ec;
+    asio::read(peer, asio::buffer(data), ec);
+    SV_CHECK(ec == asio::error::eof || ec == asio::error::connection_reset);
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return bad_message == 2; }));
+
+  asio::io_context ioc;
+  asio::ip::tcp::socket peer(ioc);
+  peer.connect(endpoint);
+  asio::write(peer, asio::buffer(message));
+  SV_CHECK(sv::test::wait_until([&]() { return received == 1; }));
+  SV_CHECK(server->shutdown(1s));
+}
+
+int main()
+{
+  sv::test::run("half_closing_peer", half_closing_peer);
+  sv::test::run("oversized_length", oversized_length);
+  return sv::test::result();
+}
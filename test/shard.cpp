@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sv/net/shard.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr int sc_keys = 10000;
+
+std::string key(int _i)
+{
+  return "key." + std::to_string(_i);
+}
+
+std::vector<std::string> owners(shard::ring const& _ring)
+{
+  std::vector<std::string> result;
+  for (int i = 0; i < sc_keys; ++i)
+  {
+    result.push_back(_ring.locate(key(i)));
+  }
+  return result;
+}
+
+// a server keeping, per key, the sequence numbers it received ("key/n").
+struct node
+{
+  node()
+    : m_server(engine::basic_tcp_server<protocol::basic>::make())
+  {
+    engine::accept_policy policy;
+    policy.trace = false;
+    m_server->set_accept_policy(policy);
+    m_server->on_session([this](auto const& session)
+    {
+      session->protocol().on_receive([this](packet::base::ptr packet)
+      {
+        auto value = static_cast<packet::string_packet&>(*packet).get_value();
+        auto slash = value.find('/');
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_received[value.substr(0, slash)].push_back(std::stoi(value.substr(slash + 1)));
+        ++m_count;
+      });
+    });
+    m_server->execute(0);
+  }
+  ~node()
+  {
+    m_server->shutdown(1s);
+  }
+
+  unsigned short port() const
+  {
+    return m_server->local_endpoint().port();
+  }
+  std::map<std::string, std::vector<int>> received()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_received;
+  }
+  int count()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+  }
+
+  std::mutex m_mutex;
+  std::map<std::string, std::vector<int>> m_received;
+  int m_count = 0;
+  engine::basic_tcp_server<protocol::basic>::ptr m_server;
+};
+
+} // namespace
+
+// keys spread over the nodes; adding or removing one moves only the keys it
+// takes or gives up, and the order nodes came in does not matter.
+void ring_placement()
+{
+  shard::ring empty;
+  SV_CHECK(empty.find(key(0)) == nullptr && empty.locate(key(0)).empty());
+
+  shard::ring ring;
+  for (auto name : { "a", "b", "c", "d" })
+  {
+    SV_CHECK(ring.add(name, std::string("value.") + name));
+  }
+  SV_CHECK(!ring.add("a", "again"));
+  SV_CHECK(ring.size() == 4);
+  SV_CHECK(*ring.get("c") == "value.c");
+  SV_CHECK(*ring.find(key(1)) == "value." + ring.locate(key(1)));
+
+  auto before = owners(ring);
+  std::map<std::string, int> share;
+  for (auto const& e : before)
+  {
+    ++share[e];
+  }
+  for (auto const& e : share)
+  {
+    SV_CHECK(e.second > sc_keys / 8 && e.second < sc_keys * 3 / 8);
+  }
+
+  shard::ring reversed;
+  for (auto name : { "d", "c", "b", "a" })
+  {
+    reversed.add(name, name);
+  }
+  SV_CHECK(owners(reversed) == before);
+
+  SV_CHECK(ring.remove("b"));
+  SV_CHECK(!ring.remove("b"));
+  auto removed = owners(ring);
+  for (int i = 0; i < sc_keys; ++i)
+  {
+    SV_CHECK(before[i] == "b" ? removed[i] != "b" : removed[i] == before[i]);
+  }
+
+  ring.add("e", "value.e");
+  auto added = owners(ring);
+  int moved = 0;
+  for (int i = 0; i < sc_keys; ++i)
+  {
+    SV_CHECK(added[i] == "e" || added[i] == removed[i]);
+    moved += added[i] == "e";
+  }
+  SV_CHECK(moved > sc_keys / 8 && moved < sc_keys * 3 / 8);
+}
+
+// each key's messages reach the node it belongs to, in order; a removed
+// node's keys go to the others, and with no node left nothing is sent.
+void router_delivery()
+{
+  constexpr int sc_sent = 20;
+  constexpr int sc_routed = 200;
+  node nodes[3];
+  const char* names[3] = { "n0", "n1", "n2" };
+  shard::basic_tcp_router<> router;
+  SV_CHECK(!router.send(key(0), packet::string_packet::make(std::string("x"), 0)));
+  SV_CHECK(router.locate(key(0)).empty());
+  for (int i = 0; i < 3; ++i)
+  {
+    SV_CHECK(router.add_node(names[i], std::string("127.0.0.1"), nodes[i].port()));
+  }
+  SV_CHECK(!router.add_node("n0", std::string("127.0.0.1"), nodes[0].port()));
+  // every connection up, so that each key keeps to one.
+  SV_CHECK(sv::test::wait_until([&]()
+  {
+    auto stats = router.stats();
+    return stats.size() == 3 && std::all_of(stats.begin(), stats.end(), [](auto const& e) { return e.connected == 2; });
+  }));
+
+  auto index = [&names](std::string const& _name)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      if (_name == names[i])
+        return i;
+    }
+    return -1;
+  };
+  for (int n = 0; n < sc_sent; ++n)
+  {
+    for (int i = 0; i < sc_routed; ++i)
+    {
+      SV_CHECK(router.send(key(i), packet::string_packet::make(key(i) + "/" + std::to_string(n), 0)));
+    }
+  }
+  auto total = [&nodes]() { return nodes[0].count() + nodes[1].count() + nodes[2].count(); };
+  SV_CHECK(sv::test::wait_until([&]() { return total() == sc_sent * sc_routed; }));
+  std::vector<int> in_order(sc_sent);
+  for (int n = 0; n < sc_sent; ++n)
+  {
+    in_order[n] = n;
+  }
+  std::map<std::string, std::vector<int>> received[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    received[i] = nodes[i].received();
+  }
+  for (int i = 0; i < sc_routed; ++i)
+  {
+    auto owner = index(router.locate(key(i)));
+    SV_CHECK(owner >= 0 && received[owner][key(i)] == in_order);
+  }
+
+  SV_CHECK(router.remove_node("n1"));
+  SV_CHECK(!router.remove_node("n1"));
+  SV_CHECK(router.stats().size() == 2);
+  int before = nodes[1].count();
+  for (int i = 0; i < sc_routed; ++i)
+  {
+    SV_CHECK(router.locate(key(i)) != "n1");
+    SV_CHECK(router.send(key(i), packet::string_packet::make(key(i) + "/" + std::to_string(sc_sent), 0)));
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return total() == (sc_sent + 1) * sc_routed; }));
+  SV_CHECK(nodes[1].count() == before);
+
+  SV_CHECK(router.remove_node("n0") && router.remove_node("n2"));
+  SV_CHECK(!router.send(key(0), packet::string_packet::make(std::string("x"), 0)));
+}
+
+int main()
+{
+  sv::test::run("ring_placement", ring_placement);
+  sv::test::run("router_delivery", router_delivery);
+  return sv::test::result();
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include "sv/net/tls.hpp"
+#include "check.h"
+
+namespace asio = boost::asio;
+namespace tls = sv::net::tls;
+
+namespace
+{
+
+// self-signed P-256 certificate for _name: { cert, key } pem.
+std::pair<std::string, std::string> make_certificate(std::string const& _name)
+{
+  auto* key = EVP_EC_gen("P-256");
+  auto* cert = X509_new();
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 60 * 60);
+  X509_set_pubkey(cert, key);
+  auto* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(_name.c_str()), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  std::string alt = "DNS:" + _name;
+  auto* ext = X509V3_EXT_conf_nid(nullptr, nullptr, NID_subject_alt_name, alt.c_str());
+  X509_add_ext(cert, ext, -1);
+  X509_EXTENSION_free(ext);
+  X509_sign(cert, key, EVP_sha256());
+
+  auto to_string = [](BIO* bio)
+  {
+    char* data = nullptr;
+    auto size = BIO_get_mem_data(bio, &data);
+    std::string s(data, static_cast<std::size_t>(size));
+    BIO_free(bio);
+    return s;
+  };
+  auto* cert_bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_X509(cert_bio, cert);
+  auto* key_bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_PrivateKey(key_bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return { to_string(cert_bio), to_string(key_bio) };
+}
+
+// one client handshake against a server holding _cert; its error.
+tls::error_code handshake(std::pair<std::string, std::string> const& _cert, tls::config const& _client)
+{
+  tls::config server;
+  server.certificate_chain = _cert.first;
+  server.private_key = _cert.second;
+
+  asio::io_context ioc;
+  tls::acceptor acceptor(ioc, { asio::ip::address_v4::loopback(), 0 }, tls::context::make(server));
+  tls::stream peer(ioc);
+  acceptor.async_accept(peer, [](tls::error_code const&) {});
+
+  tls::stream client(ioc);
+  tls::error_code result = asio::error::would_block;
+  client.async_connect(acceptor.local_endpoint(), tls::context::make(_client), [&](tls::error_code const& ec)
+  {
+    result = ec;
+    client.close();
+    peer.close();
+  });
+  ioc.run_for(std::chrono::seconds(10));
+  return result;
+}
+
+} // namespace
+
+// a client checks the server certificate and its name unless told not to.
+void client_verification()
+{
+  auto cert = make_certificate("localhost");
+
+  tls::config trusted;
+  trusted.ca = cert.first;
+  trusted.server_name = "localhost";
+  SV_CHECK(!handshake(cert, trusted));
+
+  tls::config other_name = trusted;
+  other_name.server_name = "example.com";
+  SV_CHECK(!!handshake(cert, other_name));
+
+  // no name: checked against the address, which the certificate lacks.
+  tls::config address = trusted;
+  address.server_name.clear();
+  SV_CHECK(!!handshake(cert, address));
+
+  // no ca: the system's roots, which do not have a self-signed certificate.
+  tls::config system_roots;
+  system_roots.server_name = "localhost";
+  SV_CHECK(!!handshake(cert, system_roots));
+
+  tls::config unverified;
+  unverified.verify_server = false;
+  SV_CHECK(!handshake(cert, unverified));
+}
+
+// a peer that connects and never says hello is closed at the deadline; a
+// read waiting on the handshake fails with timed_out.
+void handshake_deadline()
+{
+  auto cert = make_certificate("localhost");
+  tls::config server;
+  server.certificate_chain = cert.first;
+  server.private_key = cert.second;
+  server.handshake_timeout = std::chrono::milliseconds(200);
+
+  asio::io_context ioc;
+  tls::acceptor acceptor(ioc, { asio::ip::address_v4::loopback(), 0 }, tls::context::make(server));
+  tls::stream peer(ioc);
+  char byte = 0;
+  tls::error_code read = asio::error::would_block;
+  acceptor.async_accept(peer, [&](tls::error_code const&)
+  {
+    peer.async_read_some(asio::buffer(&byte, 1), [&](tls::error_code const& ec, std::size_t) { read = ec; });
+  });
+
+  asio::ip::tcp::socket silent(ioc);
+  silent.connect(acceptor.local_endpoint());
+  auto started = std::chrono::steady_clock::now();
+  tls::error_code closed = asio::error::would_block;
+  silent.async_read_some(asio::buffer(&byte, 1), [&](tls::error_code const& ec, std::size_t) { closed = ec; });
+  ioc.run_for(std::chrono::seconds(10));
+
+  SV_CHECK(read == asio::error::timed_out);
+  SV_CHECK(!!closed && closed != asio::error::would_block);
+  SV_CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+  SV_CHECK(!peer.is_open());
+}
+
+int main()
+{
+  sv::test::run("client_verification", client_verification);
+  sv::test::run("handshake_deadline", handshake_deadline);
+  return sv::test::result();
+}
@@ -0,0 +1,163 @@
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+#include "sv/net/engine.hpp"
+#include "sv/net/trace.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+std::string temp_path(const char* _name)
+{
+  return std::string("/tmp/sv.net.test.") + _name + "." + std::to_string(::getpid());
+}
+
+bool same(trace::context const& _a, trace::context const& _b)
+{
+  return _a.trace_high == _b.trace_high && _a.trace_low == _b.trace_low && _a.span == _b.span && _a.flags == _b.flags;
+}
+
+} // namespace
+
+// the context goes over the wire after the header and comes back as it was,
+// alone or with a checksum; setting it again does not grow the packet.
+void context_on_the_wire()
+{
+  trace::context context{ 0x0123456789abcdefULL, 0xfedcba9876543210ULL, 0x1122334455667788ULL,
+                          trace::context::sc_sampled };
+  for (bool checksummed : { false, true })
+  {
+    auto p = packet::string_packet::make(std::string("harbour"), 0);
+    auto untraced = p->get_header().length;
+    p->set_trace(context);
+    p->set_trace(context);
+    if (checksummed)
+      p->set_checksum();
+    SV_CHECK(p->get_header().length
+             == untraced + sizeof(trace::context) + (checksummed ? sizeof(std::uint32_t) : 0));
+
+    auto bytes = packet::serialize(*p);
+    auto received = packet::deserialize(0, bytes.data(), bytes.size());
+    SV_CHECK(received != nullptr);
+    if (received == nullptr)
+      continue;
+    SV_CHECK(received->traced());
+    SV_CHECK(trace::sampled(*received));
+    SV_CHECK(same(received->get_trace(), context));
+    SV_CHECK(static_cast<packet::string_packet&>(*received).get_value() == "harbour");
+  }
+
+  auto plain = packet::string_packet::make(std::string("harbour"), 0);
+  auto bytes = packet::serialize(*plain);
+  auto received = packet::deserialize(0, bytes.data(), bytes.size());
+  SV_CHECK(received != nullptr && !received->traced() && !trace::sampled(*received));
+}
+
+// start makes a new sampled root at rate 1 and none at rate 0; follow keeps
+// the trace with a span of its own, and nothing of an untraced cause.
+void start_and_follow()
+{
+  auto path = temp_path("trace.start");
+  auto always = trace::tracer::make(path, 1.0);
+  auto request = packet::string_packet::make(std::string("request"), 0);
+  SV_CHECK(always->start(*request));
+  auto const& root = request->get_trace();
+  SV_CHECK(root.trace_high != 0 && root.trace_low != 0 && root.span != 0);
+  SV_CHECK(trace::sampled(*request));
+
+  auto reply = packet::string_packet::make(std::string("reply"), 0);
+  trace::tracer::follow(*reply, *request);
+  SV_CHECK(reply->get_trace().trace_high == root.trace_high);
+  SV_CHECK(reply->get_trace().trace_low == root.trace_low);
+  SV_CHECK(reply->get_trace().span != root.span);
+  SV_CHECK(trace::sampled(*reply));
+
+  auto untraced = packet::string_packet::make(std::string("request"), 0);
+  auto other = packet::string_packet::make(std::string("reply"), 0);
+  trace::tracer::follow(*other, *untraced);
+  SV_CHECK(!other->traced());
+
+  auto never = trace::tracer::make(path, 0.0);
+  for (int i = 0; i < 100; ++i)
+    SV_CHECK(!never->start(*untraced));
+  SV_CHECK(!untraced->traced());
+  std::remove(path.c_str());
+}
+
+// a request and its reply over a session: the reply carries the request's
+// trace, and both sides write their spans of it to the file.
+void session_round_trip()
+{
+  auto path = temp_path("trace.session");
+  auto tracer = trace::tracer::make(path, 1.0);
+
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  server->on_session([tracer](auto const& session)
+  {
+    session->protocol().set_tracer(tracer);
+    auto* raw = session.get();
+    session->protocol().on_receive([raw](packet::base::ptr request)
+    {
+      auto reply = packet::string_packet::make(std::string("reply"), raw->id());
+      trace::tracer::follow(*reply, *request);
+      raw->protocol().send(reply);
+    });
+  });
+  server->execute(0);
+
+  std::promise<packet::base::ptr> replied;
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session)
+  {
+    session->protocol().set_tracer(tracer);
+    session->protocol().on_receive([&](packet::base::ptr reply) { replied.set_value(reply); });
+    connected.set_value(session);
+  });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+  auto session = connected.get_future().get();
+
+  auto request = packet::string_packet::make(std::string("request"), 0);
+  SV_CHECK(tracer->start(*request));
+  auto root = request->get_trace();
+  session->protocol().send(request);
+  auto answer = replied.get_future();
+  SV_CHECK(answer.wait_for(10s) == std::future_status::ready);
+  auto reply = answer.get();
+  SV_CHECK(reply->traced());
+  SV_CHECK(reply->get_trace().trace_high == root.trace_high && reply->get_trace().trace_low == root.trace_low);
+
+  // sent and received, on both sides.
+  SV_CHECK(sv::test::wait_until([&]() { return tracer->spans() >= 4; }));
+  SV_CHECK(server->shutdown(1s));
+  tracer->close();
+
+  std::ifstream file(path);
+  std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  char trace_id[40];
+  std::snprintf(trace_id, sizeof(trace_id), "%016" PRIx64 "%016" PRIx64, root.trace_high, root.trace_low);
+  SV_CHECK(text.rfind("[", 0) == 0);
+  SV_CHECK(text.find("\n]\n") == text.size() - 3);
+  SV_CHECK(text.find(trace_id) != std::string::npos);
+  SV_CHECK(text.find("\"name\":\"receive\"") != std::string::npos);
+  SV_CHECK(text.find("\"name\":\"send\"") != std::string::npos);
+  std::remove(path.c_str());
+}
+
+int main()
+{
+  sv::test::run("context_on_the_wire", context_on_the_wire);
+  sv::test::run("start_and_follow", start_and_follow);
+  sv::test::run("session_round_trip", session_round_trip);
+  return sv::test::result();
+}
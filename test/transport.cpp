@@ -0,0 +1,198 @@
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+int number(packet::base::ptr const& _packet)
+{
+  return std::stoi(static_cast<packet::string_packet&>(*_packet).get_value());
+}
+
+engine::accept_policy quiet()
+{
+  engine::accept_policy policy;
+  policy.trace = false;
+  return policy;
+}
+
+// the client sends _count numbered packets and the server echoes each: all
+// come back, once and in order. _setup runs on the sessions of both sides,
+// _verify on the client's at the end.
+template<class Server, class Client, class Listen, class Connect, class Setup, class Verify>
+void echo(Listen&& _listen, Connect&& _connect, Setup&& _setup, Verify&& _verify, int _count)
+{
+  std::atomic<int> next{ 0 };
+  std::atomic<int> out_of_order{ 0 };
+
+  auto server = Server::make();
+  server->on_session([&](auto const& session)
+  {
+    _setup(*session);
+    auto* raw = session.get();
+    session->protocol().on_receive([raw](packet::base::ptr packet) { raw->protocol().send(packet); });
+  });
+  _listen(*server);
+
+  auto client = Client::make();
+  using session_ptr = typename Client::session_handler::argument_type;
+  std::promise<std::decay_t<session_ptr>> connected;
+  client->on_session([&](session_ptr session)
+  {
+    _setup(*session);
+    session->protocol().on_receive([&](packet::base::ptr packet)
+    {
+      auto n = number(packet);
+      out_of_order += (n != next);
+      next = n + 1;
+    });
+    connected.set_value(session);
+  });
+  _connect(*client, *server);
+
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+  for (int i = 0; i < _count; ++i)
+  {
+    session->protocol().send(packet::string_packet::make(std::to_string(i), 0));
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return next == _count; }, 30s));
+  SV_CHECK(out_of_order == 0);
+  _verify(*session);
+}
+
+auto nothing = [](auto&) {};
+
+} // namespace
+
+void inproc_echo()
+{
+  using server_type = engine::basic_inproc_server<protocol::basic>;
+  using client_type = engine::basic_inproc_client<protocol::basic>;
+  std::string name = "sv.net.test." + std::to_string(::getpid());
+  echo<server_type, client_type>([&](server_type& s) { s.set_accept_policy(quiet()); s.execute(name); },
+                                 [&](client_type& c, server_type&) { c.execute(name); }, nothing, nothing, 1000);
+}
+
+#if defined(__linux__)
+void shm_echo()
+{
+  using server_type = engine::basic_shm_server<protocol::basic>;
+  using client_type = engine::basic_shm_client<protocol::basic>;
+  std::string path = "/tmp/sv.net.test.shm." + std::to_string(::getpid());
+  echo<server_type, client_type>([&](server_type& s) { s.set_accept_policy(quiet()); s.execute(path); },
+                                 [&](client_type& c, server_type&) { c.execute(path); }, nothing, nothing, 1000);
+}
+#endif // __linux__
+
+// one packet per datagram, nothing resent: few enough that loopback keeps
+// them all.
+void udp_echo()
+{
+  using server_type = engine::basic_udp_server<protocol::datagram_basic>;
+  using client_type = engine::basic_udp_client<protocol::datagram_basic>;
+  echo<server_type, client_type>([](server_type& s) { s.execute(0); },
+                                 [](client_type& c, server_type& s)
+                                 { c.execute(std::string("127.0.0.1"), s.local_endpoint().port()); },
+                                 nothing, nothing, 100);
+}
+
+// a fifth of the datagrams lost and the rest delayed and reordered, both
+// ways: the reliable layer still delivers everything once and in order.
+void reliable_over_lossy_udp()
+{
+  using server_type = engine::basic_udp_server<protocol::reliable_basic>;
+  using client_type = engine::basic_udp_client<protocol::reliable_basic>;
+  reliable::impairment lossy;
+  lossy.loss = 0.2;
+  lossy.delay = 1ms;
+  lossy.jitter = 2ms;
+  echo<server_type, client_type>([](server_type& s) { s.execute(0); },
+                                 [](client_type& c, server_type& s)
+                                 { c.execute(std::string("127.0.0.1"), s.local_endpoint().port()); },
+                                 [&](auto& session) { session.protocol().set_impairment(lossy); },
+                                 [](auto& session) { SV_CHECK(session.protocol().stats().retransmitted > 0); }, 2000);
+}
+
+// small messages on stream 0 keep moving, in order, while bulk transfers
+// fill other streams past their flow-control windows.
+void mux_streams()
+{
+  using server_type = engine::basic_tcp_server<protocol::mux_basic>;
+  using client_type = engine::basic_tcp_client<protocol::mux_basic>;
+  using session_type = engine::basic_session<protocol::mux_basic, transport::tcp>;
+  constexpr int sc_bulk = 8;
+  constexpr int sc_small = 1000;
+
+  std::atomic<int> next{ 0 };
+  std::atomic<int> out_of_order{ 0 };
+  std::atomic<int> bulk{ 0 };
+  std::string body(1024 * 1024, 'b');
+
+  auto server = server_type::make();
+  server->set_accept_policy(quiet());
+  server->on_session([](session_type::ptr const& session)
+  {
+    auto* raw = session.get();
+    session->protocol().on_stream_receive([raw](mux::stream_id stream, packet::base::ptr packet)
+    {
+      raw->protocol().send(packet, stream);
+    });
+  });
+  server->execute(0);
+
+  auto client = client_type::make();
+  std::promise<session_type::ptr> connected;
+  client->on_session([&](session_type::ptr const& session)
+  {
+    session->protocol().on_stream_receive([&](mux::stream_id stream, packet::base::ptr packet)
+    {
+      if (stream != 0)
+      {
+        bulk += static_cast<packet::string_packet&>(*packet).get_value() == body;
+        return;
+      }
+      auto n = number(packet);
+      out_of_order += (n != next);
+      next = n + 1;
+    });
+    connected.set_value(session);
+  });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+  for (int i = 0; i < sc_bulk; ++i)
+  {
+    session->protocol().send(packet::string_packet::make(body, 0), 1 + i % 2);
+  }
+  for (int i = 0; i < sc_small; ++i)
+  {
+    session->protocol().send(packet::string_packet::make(std::to_string(i), 0));
+  }
+  SV_CHECK(sv::test::wait_until([&]() { return next == sc_small && bulk == sc_bulk; }, 30s));
+  SV_CHECK(out_of_order == 0);
+}
+
+int main()
+{
+  sv::test::run("inproc_echo", inproc_echo);
+#if defined(__linux__)
+  sv::test::run("shm_echo", shm_echo);
+#endif // __linux__
+  sv::test::run("udp_echo", udp_echo);
+  sv::test::run("reliable_over_lossy_udp", reliable_over_lossy_udp);
+  sv::test::run("mux_streams", mux_streams);
+  return sv::test::result();
+}
@@ -0,0 +1,58 @@
+#include <future>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include "sv/net/engine.hpp"
+#include "check.h"
+
+using namespace sv::net;
+using namespace std::chrono_literals;
+
+// a client's receive buffer is set before it connects: the window scale it
+// offers in the handshake follows that buffer, not the default one.
+void buffers_before_connect()
+{
+  auto server = engine::basic_tcp_server<protocol::basic>::make();
+  engine::accept_policy policy;
+  policy.trace = false;
+  server->set_accept_policy(policy);
+  server->execute(0);
+
+  tuning::options options;
+  options.receive_buffer = 4096;
+  auto client = engine::basic_tcp_client<protocol::basic>::make();
+  client->set_tuning(options);
+  std::promise<engine::basic_session<protocol::basic, transport::tcp>::ptr> connected;
+  client->on_session([&](auto const& session) { connected.set_value(session); });
+  client->execute(std::string("127.0.0.1"), server->local_endpoint().port());
+  auto ready = connected.get_future();
+  SV_CHECK(ready.wait_for(10s) == std::future_status::ready);
+  auto session = ready.get();
+
+  tcp_info info{};
+  socklen_t size = sizeof(info);
+  SV_CHECK(::getsockopt(session->socket().native_handle(), IPPROTO_TCP, TCP_INFO, &info, &size) == 0);
+  // the default buffers would scale by 7 or so.
+  SV_CHECK(info.tcpi_rcv_wscale == 0);
+  SV_CHECK(server->shutdown(1s));
+}
+
+// a cpu index out of range is refused rather than passed on.
+void pin_range()
+{
+  SV_CHECK(!tuning::pin({}, 0));
+  SV_CHECK(!tuning::pin({ -1 }, 0));
+  SV_CHECK(!tuning::pin({ CPU_SETSIZE }, 0));
+  SV_CHECK(!tuning::pin({ 0, CPU_SETSIZE + 5 }, 1));
+}
+
+int main()
+{
+  sv::test::run("buffers_before_connect", buffers_before_connect);
+  sv::test::run("pin_range", pin_range);
+  return sv::test::result();
+}